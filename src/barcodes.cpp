@@ -1,159 +1,294 @@
 #include "barcodes.hpp"
 #include "domain/barcode.hpp"
+#include "domain/barcode_capacity.hpp"
+#include "domain/random_streams.hpp"
+#include "domain/stem_sampler.hpp"
+#include <algorithm>
 #include <climits>
 
 
 //
-// DP algorithm for computing the number of barcodes satisfying given constraints
+// Fail fast if the barcodes cannot possibly fit, using the packing bound
+// of the capacity estimator
 //
 
 
-static inline std::vector<std::vector<size_t>> _inner_loop(
-    size_t length,
-    size_t max_au,
-    size_t max_gc,
-    size_t max_gu
+static inline void _check_if_enough_barcodes(
+    size_t count,
+    size_t stem_length,
+    const StemConfig& config,
+    const BarcodeIndex& index
 ) {
+    BarcodeCapacity capacity = estimate_barcode_capacity(
+        stem_length, config, index.min_distance(), index.min_edit_distance()
+    );
+    if (capacity.packing_bound < index.size() + count) {
+        throw std::runtime_error(
+            "The barcode length (" + std::to_string(stem_length) +
+            ") and maximum base-pair counts (" + std::to_string(config.max_au) +
+            ", " + std::to_string(config.max_gc) + " and " + std::to_string(config.max_gu) +
+            ") fit " + capacity.describe() + ", fewer than the required " +
+            std::to_string(index.size() + count) + "."
+        );
+    }
+}
 
-    std::vector<std::vector<size_t>> prev(max_au + 1, std::vector<size_t>(max_gc + 1, 0));
-    std::vector<std::vector<size_t>> curr(max_au + 1, std::vector<size_t>(max_gc + 1, 0));
-
-    prev[0][0] = 1;
-    for (size_t i = 1; i <= length; ++i) {
-        for (size_t a = 0; a <= max_au; ++a) {
-            for (size_t b = 0; b <= max_gc; ++b) {
-                size_t c = i - a - b;
-                if (c > max_gu || c < 0) { continue; }
+std::string _random_barcode(
+    BarcodeSampler& sampler,
+    std::mt19937 &gen,
+    const BarcodeIndex& existing
+) {
+    return sampler.next(gen, existing).str();
+}
 
-                size_t count = 0;
-                if (a > 0) count += prev[a - 1][b];
-                if (b > 0) count += prev[a][b - 1];
-                count += prev[a][b];
+bool _insert_if_not_neighbour(
+    const std::string& sequence,
+    BarcodeIndex& barcodes
+) {
+    return barcodes.insert_if_not_neighbor(sequence);
+}
 
-                curr[a][b] = count;
-            }
-        }
-        std::swap(prev, curr);
-    }
+// Candidates proposed by each lane per round of barcoding
+static constexpr size_t PROPOSAL_BATCH = 1024;
 
-    return prev;
+// Independent proposal lanes. Fixed, so that the barcodes do not depend on
+// the thread count; more threads than lanes go unused.
+static constexpr size_t BARCODE_LANES = 64;
 
-}
+//
+// Barcoding proceeds in rounds. In each round, every lane proposes a batch
+// of candidates that are not neighbours of the index as it stood at the start
+// of the round; the index is only read, so the threads running the lanes
+// share it freely. The proposals are then committed on one thread in lane
+// order, each checked again against the barcodes committed before it. This
+// enforces the Hamming rule exactly, and the output depends only on the seed.
+//
 
-static inline size_t _accumulate(
-    const std::vector<std::vector<size_t>>& dp_arr,
-    size_t length,
-    size_t max_au,
-    size_t max_gc,
-    size_t max_gu
+static inline void _get_barcodes_in_lanes(
+    size_t count,
+    size_t stem_length,
+    const StemConfig& config,
+    std::mt19937 &gen,
+    BarcodeIndex& index,
+    std::vector<std::string>& barcodes,
+    size_t threads,
+    const KmerScreen* screen
 ) {
+    std::vector<BarcodeSampler> samplers;
+    std::vector<std::mt19937> gens;
+    samplers.reserve(BARCODE_LANES);
+    gens.reserve(BARCODE_LANES);
+    for (size_t lane = 0; lane < BARCODE_LANES; lane++) {
+        samplers.emplace_back(stem_length, config, lane, BARCODE_LANES, screen);
+        gens.emplace_back(gen());
+    }
+
+    std::vector<std::vector<std::string>> proposals(BARCODE_LANES);
+    std::vector<char> exhausted(BARCODE_LANES, false);
+    threads = std::min(threads, BARCODE_LANES);
 
-    size_t result = 0;
-    for (size_t num_au = 0; num_au <= max_au; ++num_au) {
-        for (size_t num_gc = 0; num_gc <= max_gc; ++num_gc) {
-            size_t num_gu = length - num_au - num_gc;
-            if (num_gu <= max_gu) {
-                result += dp_arr[num_au][num_gc];
+    ProgressBar bar("Barcoding ");
+    size_t produced = 0;
+    while (produced < count) {
+        size_t batch = std::min(PROPOSAL_BATCH, (count - produced + BARCODE_LANES - 1) / BARCODE_LANES);
+
+        _run_workers(threads, [&](size_t worker) {
+            for (size_t lane = worker; lane < BARCODE_LANES; lane += threads) {
+                proposals[lane].clear();
+                if (exhausted[lane]) continue;
+                try {
+                    for (size_t ix = 0; ix < batch; ix++) {
+                        proposals[lane].push_back(
+                            _random_barcode(samplers[lane], gens[lane], index)
+                        );
+                    }
+                } catch (const BarcodesExhausted&) {
+                    // This lane's shard of the hairpin space is used up
+                    exhausted[lane] = true;
+                }
+            }
+        });
+
+        bool proposed = false;
+        for (auto& candidates : proposals) {
+            proposed = proposed || !candidates.empty();
+            for (auto& barcode : candidates) {
+                if (produced == count) break;
+                if (index.insert_if_not_neighbor(barcode)) {
+                    barcodes.push_back(std::move(barcode));
+                    produced++;
+                }
             }
         }
+        if (!proposed) {
+            throw std::runtime_error(
+                "No admissible barcodes remain after generating " +
+                std::to_string(produced) + " of the required " +
+                std::to_string(count) + "."
+            );
+        }
+        bar.update(produced, count);
     }
-
-    return result;
-
 }
 
-
-static inline size_t _stem_counts(
-    size_t length,
-    const StemConfig& config
+void _get_barcodes(
+    size_t count,
+    size_t stem_length,
+    const StemConfig& config,
+    std::mt19937 &gen,
+    BarcodeIndex& index,
+    std::vector<std::string>& barcodes,
+    size_t threads,
+    const KmerScreen* screen
 ) {
-    size_t max_au = std::min(config.max_au, length);
-    size_t max_gc = std::min(config.max_gc, length);
-    size_t max_gu = std::min(config.max_gu, length);
-    size_t closing_gc = config.closing_gc;
-
-    // Adjust for closing GC base pairs
-    max_gc -= closing_gc;
-    length -= closing_gc;
-
-    // Fill the DP array
-    std::vector<std::vector<size_t>> dp_arr = _inner_loop(length, max_au, max_gc, max_gu);
+    _check_if_enough_barcodes(count, stem_length, config, index);
 
-    // Accumulate results
-    size_t count = _accumulate(dp_arr, length, max_au, max_gc, max_gu);
-
-    // Account for both orientations of each base pair
-    size_t o_factor = 1ULL << (length + closing_gc);
-    return count * o_factor;
+    index.reserve(index.size() + count);
+    barcodes.reserve(barcodes.size() + count);
 
+    _get_barcodes_in_lanes(count, stem_length, config, gen, index, barcodes, threads, screen);
 }
 
-static inline void _check_if_enough_barcodes(
+// The largest hairpin space that is walked in full to build a complete
+// code, a few seconds of screening on one thread
+static constexpr uint64_t MAX_FULL_CODE_HAIRPINS = 1ULL << 24;
+
+void _get_maximal_barcodes(
     size_t count,
     size_t stem_length,
-    const StemConfig& config
+    const StemConfig& config,
+    BarcodeIndex& index,
+    std::vector<std::string>& barcodes,
+    size_t threads,
+    const KmerScreen* screen
 ) {
-    size_t _counts = _stem_counts(stem_length, config);
-    if (_counts < count) {
-        throw std::runtime_error(
+    StemSampler stems(stem_length, config);
+    uint64_t total = stems.size();
+    if (count == 0 && total > MAX_FULL_CODE_HAIRPINS) {
+        throw std::invalid_argument(
             "The barcode length (" + std::to_string(stem_length) +
-            ") and maximum base-pair counts (" + std::to_string(config.max_au) +
-            ", " + std::to_string(config.max_gc) + " and " + std::to_string(config.max_gu) +
-            ") are only large enough to accomodate " + std::to_string(_counts) +
-            " of the required " + std::to_string(count) + " unique barcodes."
+            ") allows too many hairpins to build the full code; pass --count "
+            "to stop after that many barcodes."
         );
     }
-}
+    // No up-front capacity check: the enumeration below is exact
+    if (count > 0) {
+        index.reserve(index.size() + count);
+        barcodes.reserve(barcodes.size() + count);
+    }
 
-std::string _random_barcode(
-    size_t stem_length,
-    const StemConfig& config,
-    std::mt19937 &gen,
-    const std::unordered_set<std::string>& existing
-) {
-    return Barcode::random(stem_length, config, gen, existing).str();
+    // Workers screen a block of consecutive ranks against the index as it
+    // stood before the block; the survivors are then committed in rank
+    // order, which gives exactly the serial lexicode.
+    size_t block = PROPOSAL_BATCH * threads;
+    std::vector<std::string> candidates(block);
+    std::vector<char> admissible(block);
+
+    ProgressBar bar("Barcoding ");
+    size_t produced = 0;
+    for (uint64_t rank = 0; rank < total && (count == 0 || produced < count); ) {
+        size_t n = static_cast<size_t>(std::min<uint64_t>(block, total - rank));
+        _run_workers(threads, [&](size_t worker) {
+            for (size_t ix = worker; ix < n; ix += threads) {
+                stems.unrank(rank + ix, candidates[ix]);
+                admissible[ix] = !index.has_neighbor(candidates[ix]) &&
+                    !(screen && screen->hits(candidates[ix]));
+            }
+        });
+        for (size_t ix = 0; ix < n && (count == 0 || produced < count); ix++) {
+            if (admissible[ix] && index.insert_if_not_neighbor(candidates[ix])) {
+                barcodes.push_back(candidates[ix]);
+                produced++;
+            }
+        }
+        rank += n;
+        if (count == 0) bar.update(rank, total);
+        else bar.update(produced, count);
+    }
+
+    if (count > 0 && produced < count) {
+        throw BarcodesExhausted(
+            "The maximal code at barcode length " + std::to_string(stem_length) +
+            " only holds " + std::to_string(produced) + " of the required " +
+            std::to_string(count) + " barcodes."
+        );
+    }
 }
 
-bool _insert_if_not_neighbour(
-    const std::string& sequence,
-    std::unordered_set<std::string>& barcodes
+void _get_pool_barcodes(
+    size_t count,
+    const BarcodePool& pool,
+    BarcodeIndex& index,
+    std::vector<std::string>& barcodes,
+    const KmerScreen* screen
 ) {
-    bool is_neighbour = Barcode(sequence).has_hamming_neighbor(barcodes);
-    if (!is_neighbour) {
-        barcodes.insert(sequence);
+    index.reserve(index.size() + count);
+    barcodes.reserve(barcodes.size() + count);
+
+    size_t produced = 0;
+    for (size_t ix = 0; ix < pool.size() && produced < count; ix++) {
+        std::string barcode(pool[ix]);
+        if (screen && screen->hits(barcode)) continue;
+        if (index.insert_if_not_neighbor(barcode)) {
+            barcodes.push_back(std::move(barcode));
+            produced++;
+        }
+    }
+    if (produced < count) {
+        throw BarcodesExhausted(
+            "The barcode pool only provides " + std::to_string(produced) +
+            " of the required " + std::to_string(count) + " barcodes."
+        );
     }
-    return !is_neighbour;
 }
 
 void _get_barcodes(
     size_t count,
-    size_t stem_length,
-    const StemConfig& config,
+    const BarcodeConfig& config,
     std::mt19937 &gen,
-    std::unordered_set<std::string>& barcodes
+    BarcodeIndex& index,
+    std::vector<std::string>& barcodes,
+    size_t threads,
+    const KmerScreen* screen
 ) {
-    _check_if_enough_barcodes(count, stem_length, config);
-
-    ProgressBar bar("Barcoding ");
-    for (size_t ix = 0; ix < count; ix++) {
-        std::string barcode = _random_barcode(stem_length, config, gen, barcodes);
-        barcodes.insert(barcode);
-        bar.update(ix + 1, count);
+    if (!config.pool_path.empty()) {
+        BarcodePool pool(config.pool_path);
+        pool.check_compatible(config);
+        _get_pool_barcodes(count, pool, index, barcodes, screen);
+    } else if (config.maximal) {
+        _get_maximal_barcodes(count, config.stem_length, config.stem, index, barcodes, threads, screen);
+    } else {
+        _get_barcodes(count, config.stem_length, config.stem, gen, index, barcodes, threads, screen);
     }
 }
 
 void _barcodes(
     size_t count,
     const std::string& output,
+    const std::string& pool,
     bool overwrite,
-    size_t stem_length,
-    const StemConfig& config
+    const BarcodeConfig& config,
+    size_t threads,
+    uint64_t seed
 ) {
-    _remove_if_exists(output, overwrite);
+    if (count == 0 && !config.maximal) {
+        throw std::invalid_argument("A positive --count is required unless --maximal is given.");
+    }
+    if (output.empty() && pool.empty()) {
+        throw std::invalid_argument("At least one of --output and --pool is required.");
+    }
+    if (!output.empty()) _remove_if_exists(output, overwrite);
+    if (!pool.empty()) _remove_if_exists(pool, overwrite);
 
-    std::mt19937 gen = _init_gen();
-    std::unordered_set<std::string> barcodes;
-    _get_barcodes(count, stem_length, config, gen, barcodes);
+    std::mt19937 gen = RandomStreams(seed).stream(RandomStreams::BARCODES);
+    BarcodeIndex index(config.min_distance, config.min_edit_distance);
+    std::vector<std::string> barcodes;
+    _get_barcodes(count, config, gen, index, barcodes, threads);
+
+    if (!pool.empty()) {
+        _write_barcode_pool(pool, config, barcodes);
+    }
+    if (output.empty()) return;
 
     std::ofstream file(output);
     if (!file.is_open()) {
@@ -173,10 +308,12 @@ void _barcodes(
 static inline std::string _PARSER_NAME = "barcodes";
 
 static inline std::string _COUNT_NAME = "--count";
-static inline std::string _COUNT_HELP = "The number of barcodes to generate.";
+static inline int _COUNT_DEFAULT = 0;
+static inline std::string _COUNT_HELP = "The number of barcodes to generate. With --maximal, a value of 0 writes the full code, for hairpin spaces of up to 2^24 stems.";
 
 static inline std::string _OUTPUT_NAME = "--output";
-static inline std::string _OUTPUT_HELP = "The output file.";
+static inline std::string _OUTPUT_DEFAULT = "";
+static inline std::string _OUTPUT_HELP = "The output text file, with one barcode per line.";
 
 // Required arguments
 static inline std::string _BARCODE_LENGTH_NAME = "--length";
@@ -202,14 +339,43 @@ static inline std::string _CLOSING_GC_NAME = "--closing-gc";
 static inline int _CLOSING_GC_DEFAULT = 1;
 static inline std::string _CLOSING_GC_HELP = "The number of GC pairs to close the stem with.";
 
+static inline std::string _MIN_DISTANCE_NAME = "--min-distance";
+static inline int _MIN_DISTANCE_DEFAULT = 1;
+static inline std::string _MIN_DISTANCE_HELP = "The minimum Hamming distance between barcodes. A value of 1 only excludes pairing-complement neighbours.";
+
+static inline std::string _MIN_EDIT_DISTANCE_NAME = "--min-edit-distance";
+static inline int _MIN_EDIT_DISTANCE_DEFAULT = 0;
+static inline std::string _MIN_EDIT_DISTANCE_HELP = "The minimum edit distance between barcodes, counting insertions and deletions. A value of 0 disables the check.";
+
+static inline std::string _MAXIMAL_NAME = "--maximal";
+static inline std::string _MAXIMAL_HELP = "Build a dense code deterministically, as a greedy lexicode over all allowed hairpins.";
+
+static inline std::string _POOL_NAME = "--pool";
+static inline std::string _POOL_DEFAULT = "";
+static inline std::string _POOL_HELP = "Also write the barcodes to a binary pool file (.fldbc), which design and pipeline can draw from.";
+
+static inline std::string _THREADS_NAME = "--threads";
+static inline int _THREADS_DEFAULT = 1;
+static inline std::string _THREADS_HELP = "The number of threads to generate barcodes with.";
+
+static inline std::string _SEED_NAME = "--seed";
+static inline std::string _SEED_DEFAULT = "";
+static inline std::string _SEED_HELP = "The seed to draw barcodes with, for reproducible output. A fresh seed is drawn and printed if not given.";
+
 BarcodesArgs::BarcodesArgs() :
     Program(_PARSER_NAME),
-    count(_parser, _COUNT_NAME, _COUNT_HELP),
-    output(_parser, _OUTPUT_NAME, _OUTPUT_HELP),
+    count(_parser, _COUNT_NAME, _COUNT_HELP, _COUNT_DEFAULT),
+    output(_parser, _OUTPUT_NAME, _OUTPUT_HELP, _OUTPUT_DEFAULT),
     overwrite(_parser, _OVERWRITE_NAME, _OVERWRITE_HELP),
     stem_length(_parser, _BARCODE_LENGTH_NAME, _BARCODE_LENGTH_HELP),
     max_au(_parser, _MAX_AU_NAME, _MAX_AU_HELP, _MAX_AU_DEFAULT),
     max_gc(_parser, _MAX_GC_NAME, _MAX_GC_HELP, _MAX_GC_DEFAULT),
     max_gu(_parser, _MAX_GU_NAME, _MAX_GU_HELP, _MAX_GU_DEFAULT),
-    closing_gc(_parser, _CLOSING_GC_NAME, _CLOSING_GC_HELP, _CLOSING_GC_DEFAULT) {
+    closing_gc(_parser, _CLOSING_GC_NAME, _CLOSING_GC_HELP, _CLOSING_GC_DEFAULT),
+    min_distance(_parser, _MIN_DISTANCE_NAME, _MIN_DISTANCE_HELP, _MIN_DISTANCE_DEFAULT),
+    min_edit_distance(_parser, _MIN_EDIT_DISTANCE_NAME, _MIN_EDIT_DISTANCE_HELP, _MIN_EDIT_DISTANCE_DEFAULT),
+    maximal(_parser, _MAXIMAL_NAME, _MAXIMAL_HELP),
+    pool(_parser, _POOL_NAME, _POOL_HELP, _POOL_DEFAULT),
+    threads(_parser, _THREADS_NAME, _THREADS_HELP, _THREADS_DEFAULT),
+    seed(_parser, _SEED_NAME, _SEED_HELP, _SEED_DEFAULT) {
 }
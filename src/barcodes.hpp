@@ -1,11 +1,13 @@
 #ifndef BARCODE_H
 #define BARCODE_H
 
+#include "config/barcode_config.hpp"
 #include "config/stem_config.hpp"
+#include "domain/barcode.hpp"
+#include "io/barcode_pool.hpp"
 #include "utils.hpp"
 #include "io/progress.hpp"
 #include <fstream>
-#include <unordered_set>
 
 
 
@@ -17,10 +19,9 @@
 
 
 std::string _random_barcode(
-    size_t stem_length,
-    const StemConfig& config,
+    BarcodeSampler& sampler,
     std::mt19937 &gen,
-    const std::unordered_set<std::string>& existing
+    const BarcodeIndex& existing
 );
 
 
@@ -34,13 +35,16 @@ std::string _random_barcode(
 
 bool _insert_if_not_neighbour(
     const std::string& sequence,
-    std::unordered_set<std::string>& barcodes
+    BarcodeIndex& barcodes
 );
 
 
 
 //
-// Insert the desired number of barcodes into the input unordered_set
+// Generate the desired number of barcodes, inserting each into the index
+// and appending it to the output vector in generation order. The output is
+// determined by the generator alone, whatever the thread count. Candidates
+// sharing a k-mer with the screen, if given, are rejected.
 //
 
 
@@ -50,13 +54,81 @@ void _get_barcodes(
     size_t stem_length,
     const StemConfig& config,
     std::mt19937 &gen,
-    std::unordered_set<std::string>& barcodes
+    BarcodeIndex& index,
+    std::vector<std::string>& barcodes,
+    size_t threads = 1,
+    const KmerScreen* screen = nullptr
 );
 
 
 
 //
-// Get the desired number of barcodes and write them to a text file
+// Build barcodes deterministically as a greedy lexicode: visit the allowed
+// hairpins in rank order and keep each one that is not a neighbour of the
+// index. Stops after count barcodes, or at the end of the hairpin space
+// when count is 0. The output does not depend on the thread count.
+//
+
+
+
+void _get_maximal_barcodes(
+    size_t count,
+    size_t stem_length,
+    const StemConfig& config,
+    BarcodeIndex& index,
+    std::vector<std::string>& barcodes,
+    size_t threads = 1,
+    const KmerScreen* screen = nullptr
+);
+
+
+
+//
+// Take barcodes from a precomputed pool in pool order, skipping any that are
+// neighbours of the index or hit the screen. Throws BarcodesExhausted if the
+// pool runs out.
+//
+
+
+
+void _get_pool_barcodes(
+    size_t count,
+    const BarcodePool& pool,
+    BarcodeIndex& index,
+    std::vector<std::string>& barcodes,
+    const KmerScreen* screen = nullptr
+);
+
+
+
+//
+// Get barcodes for the configuration into the index and output vector: from
+// its pool if it names one, from the greedy lexicode in maximal mode, and
+// at random otherwise.
+//
+
+
+
+void _get_barcodes(
+    size_t count,
+    const BarcodeConfig& config,
+    std::mt19937 &gen,
+    BarcodeIndex& index,
+    std::vector<std::string>& barcodes,
+    size_t threads = 1,
+    const KmerScreen* screen = nullptr
+);
+
+
+
+//
+// Get the desired number of barcodes and write them to a text file, a pool
+// file, or both. With a minimum distance of 2 or more, every pair of
+// barcodes differs in at least that many positions. A positive minimum edit
+// distance also separates them against insertions and deletions. In maximal
+// mode, the barcodes come from the greedy lexicode, and a count of 0 writes
+// the whole code. Otherwise they are drawn from the barcode stream of the
+// seed.
 //
 
 
@@ -64,9 +136,11 @@ void _get_barcodes(
 void _barcodes(
     size_t count,
     const std::string& output,
+    const std::string& pool,
     bool overwrite,
-    size_t stem_length,
-    const StemConfig& config
+    const BarcodeConfig& config,
+    size_t threads = 1,
+    uint64_t seed = 0
 );
 
 
@@ -88,6 +162,12 @@ public:
     Arg<int> max_gc;
     Arg<int> max_gu;
     Arg<int> closing_gc;
+    Arg<int> min_distance;
+    Arg<int> min_edit_distance;
+    Arg<bool> maximal;
+    Arg<std::string> pool;
+    Arg<int> threads;
+    Arg<std::string> seed;
     BarcodesArgs();
 };
 
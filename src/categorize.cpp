@@ -55,9 +55,12 @@ void _categorize(
     }
 
     // Read input FASTA and categorize
-    for_each_fasta(input, [&](const FastaEntry& entry) {
+    std::string dna;
+    for_each_fasta_record(input, [&](const FastaRecord& entry) {
         size_t bin_idx = _find_bin(entry.sequence.length(), sorted_bins);
-        out_files[bin_idx] << ">" << entry.name << "\n" << to_dna(entry.sequence) << "\n";
+        dna.assign(entry.sequence);
+        to_dna_in_place(dna);
+        out_files[bin_idx] << ">" << entry.name << "\n" << dna << "\n";
         counts[bin_idx]++;
     });
 
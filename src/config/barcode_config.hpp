@@ -2,10 +2,15 @@
 #define BARCODE_CONFIG_H
 
 #include "stem_config.hpp"
+#include <string>
 
 struct BarcodeConfig {
     size_t stem_length = 0;  // 0 means barcoding disabled
     StemConfig stem;
+    size_t min_distance = 1;  // 1 keeps the pairing-complement rule
+    size_t min_edit_distance = 0;  // 0 disables the indel check
+    bool maximal = false;  // Draw from the greedy lexicode instead of at random
+    std::string pool_path;  // Precomputed pool to draw from, if not empty
 
     bool is_enabled() const { return stem_length > 0; }
     void validate(size_t library_size) const;
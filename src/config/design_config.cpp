@@ -2,6 +2,9 @@
 
 void DesignConfig::validate() const {
     stem.validate();
+    if (threads == 0) {
+        throw std::invalid_argument("The number of threads must be at least 1.");
+    }
 }
 
 void DesignConfig::validate_with_library_size(size_t library_size) const {
@@ -3,6 +3,7 @@
 
 #include "stem_config.hpp"
 #include "barcode_config.hpp"
+#include <cstdint>
 #include <string>
 
 struct DesignConfig {
@@ -10,6 +11,8 @@ struct DesignConfig {
     std::string input_path;
     std::string output_prefix;
     bool overwrite = false;
+    // Write <prefix>.fldb instead of .csv and .fasta
+    bool table_output = false;
 
     // Padding
     size_t pad_to_length = 0;
@@ -18,6 +21,13 @@ struct DesignConfig {
     // Barcoding
     BarcodeConfig barcode;
 
+    // Keep the padding and barcodes of rows that already have them
+    bool append = false;
+
+    // k-mer length to screen padding and barcodes against the designs and
+    // constant regions with, or 0 to disable
+    size_t screen_kmer = 0;
+
     // Stem configuration for padding
     StemConfig stem;
 
@@ -25,6 +35,23 @@ struct DesignConfig {
     std::string five_const = "ACTCGAGTAGAGTCGAAAA";
     std::string three_const = "AAAAGAAACAACAACAACAAC";
 
+    // Parallelism
+    size_t threads = 1;
+
+    // Master seed of every random stage
+    uint64_t seed = 0;
+
+    // Rows to design at a time, or 0 to load the whole library
+    size_t chunk_size = 0;
+
+    // Paddings to pre-generate for each padding length, or 0 to generate
+    // every padding, and a file to keep the pool in across runs
+    size_t padding_pool_size = 0;
+    std::string padding_pool_path;
+
+    // Redraw padding whose hairpins do not fold as designed next to the design
+    bool fold_check = false;
+
     void validate() const;
     void validate_with_library_size(size_t library_size) const;
 };
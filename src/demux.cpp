@@ -0,0 +1,318 @@
+#include "demux.hpp"
+#include "domain/barcode_lookup.hpp"
+#include "domain/nucleotide_kernels.hpp"
+#include "domain/sequence.hpp"
+#include "io/compressed_file.hpp"
+#include "io/csv_format.hpp"
+#include "io/fastq_io.hpp"
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <unordered_set>
+
+static inline std::string _PARSER_NAME = "demux";
+
+static inline std::string _FILE_NAME = "file";
+static inline std::string _FILE_HELP = "The input FASTQ file, plain, gzip- or zstd-compressed.";
+
+static inline std::string _LIBRARY_NAME = "--library";
+static inline std::string _LIBRARY_HELP = "The library .csv file the reads were sequenced from.";
+
+static inline std::string _OUTPUT_NAME = "--output";
+static inline std::string _OUTPUT_HELP = "The output .csv file of read counts per construct.";
+
+static inline std::string _FASTQ_DIR_NAME = "--fastq-dir";
+static inline std::string _FASTQ_DIR_DEFAULT = "";
+static inline std::string _FASTQ_DIR_HELP = "Also write the reads of each construct to <index>.fastq in this directory.";
+
+static inline std::string _MAX_MISMATCHES_NAME = "--max-mismatches";
+static inline int _MAX_MISMATCHES_DEFAULT = 1;
+static inline std::string _MAX_MISMATCHES_HELP = "The number of barcode mismatches to correct, 0 or 1. An N counts as a mismatch. Barcodes of up to 32 nt (stems of at most 14 bp) can be demultiplexed.";
+
+static inline std::string _REVERSE_COMPLEMENT_NAME = "--reverse-complement";
+static inline std::string _REVERSE_COMPLEMENT_HELP = "The reads are the reverse complement of the library sequences.";
+
+static inline std::string _OVERWRITE_NAME = "--overwrite";
+static inline std::string _OVERWRITE_HELP = "Overwrite any existing files.";
+
+static inline std::string _THREADS_NAME = "--threads";
+static inline int _THREADS_DEFAULT = 1;
+static inline std::string _THREADS_HELP = "The number of threads to assign reads with.";
+
+DemuxArgs::DemuxArgs() :
+    Program(_PARSER_NAME),
+    file(_parser, _FILE_NAME, _FILE_HELP),
+    library(_parser, _LIBRARY_NAME, _LIBRARY_HELP),
+    output(_parser, _OUTPUT_NAME, _OUTPUT_HELP),
+    fastq_dir(_parser, _FASTQ_DIR_NAME, _FASTQ_DIR_HELP, _FASTQ_DIR_DEFAULT),
+    max_mismatches(_parser, _MAX_MISMATCHES_NAME, _MAX_MISMATCHES_HELP, _MAX_MISMATCHES_DEFAULT),
+    reverse_complement(_parser, _REVERSE_COMPLEMENT_NAME, _REVERSE_COMPLEMENT_HELP),
+    overwrite(_parser, _OVERWRITE_NAME, _OVERWRITE_HELP),
+    threads(_parser, _THREADS_NAME, _THREADS_HELP, _THREADS_DEFAULT)
+{
+    _parser.add_description(
+        "Count the reads of each construct in a sequencing run.\n\n"
+        "The barcode of a read is the sequence just 5' of the 3' constant\n"
+        "region. Barcodes with a single substitution are corrected unless\n"
+        "they are as close to another barcode."
+    );
+}
+
+// Bases of the 3' constant region used to locate the barcode
+static constexpr size_t ANCHOR_LENGTH = 12;
+
+// Reads classified per batch
+static constexpr size_t DEMUX_BATCH = 1 << 16;
+
+// Bytes of per-construct FASTQ held in memory before flushing
+static constexpr size_t FASTQ_BUFFER_LIMIT = 64 << 20;
+
+namespace {
+
+struct DemuxConstruct {
+    std::string index;
+    std::string name;
+    std::string barcode;
+};
+
+// The outcome of a single read
+enum class Assignment : uint8_t {
+    Exact,
+    Corrected,
+    Ambiguous,
+    Unmatched,
+    NoAnchor
+};
+
+}
+
+static void _reverse_complement(const std::string& seq, std::string& out) {
+    out.assign(seq);
+    reverse_complement_in_place(out, Alphabet::DNA);
+}
+
+static Assignment _assign(
+    std::string_view read,
+    const std::vector<std::string>& anchors,
+    const BarcodeLookup& lookup,
+    int32_t& construct
+) {
+    bool anchored = false;
+    bool ambiguous = false;
+    for (const std::string& anchor : anchors) {
+        size_t pos = read.find(anchor);
+        if (pos == std::string_view::npos) continue;
+        anchored = true;
+        for (size_t length : lookup.lengths()) {
+            if (length > pos) continue;
+            std::string_view barcode = read.substr(pos - length, length);
+            int32_t found = lookup.find(barcode);
+            if (found == BarcodeLookup::AMBIGUOUS) {
+                ambiguous = true;
+            } else if (found != BarcodeLookup::UNMATCHED) {
+                construct = found;
+                return lookup.is_exact(barcode, found) ? Assignment::Exact : Assignment::Corrected;
+            }
+        }
+    }
+    construct = BarcodeLookup::UNMATCHED;
+    if (ambiguous) return Assignment::Ambiguous;
+    return anchored ? Assignment::Unmatched : Assignment::NoAnchor;
+}
+
+static std::vector<DemuxConstruct> _load_demux_library(
+    const std::string& filename,
+    std::vector<std::string>& anchors
+) {
+    _throw_if_not_exists(filename);
+    InputFile in(filename);
+    std::string line;
+    std::getline(in, line);
+    csv::Header header(line);
+    header.validate();
+
+    csv::Projection projection(header);
+    size_t index_slot = projection.add(csv::COL_INDEX);
+    size_t name_slot = projection.add(csv::COL_NAME);
+    size_t barcode_slot = projection.add(csv::COL_BARCODE);
+    size_t three_const_slot = projection.add(csv::COL_THREE_CONST);
+    csv::Row row(projection);
+
+    std::vector<DemuxConstruct> constructs;
+    std::unordered_set<std::string> unique_anchors;
+    while (std::getline(in, line)) {
+        if (line.empty()) continue;
+        row.parse(line);
+        DemuxConstruct construct;
+        construct.index = row.has(index_slot) ? std::string(row[index_slot]) : std::to_string(constructs.size() + 1);
+        construct.name = row[name_slot];
+        construct.barcode = row[barcode_slot];
+        std::string three_const = to_dna(std::string(row[three_const_slot]));
+        if (!construct.barcode.empty()) {
+            if (three_const.empty()) {
+                throw std::runtime_error(
+                    "Construct " + construct.index + " has no 3' constant region to locate its barcode by."
+                );
+            }
+            std::string anchor = three_const.substr(0, ANCHOR_LENGTH);
+            if (unique_anchors.insert(anchor).second) {
+                anchors.push_back(anchor);
+            }
+        }
+        constructs.push_back(std::move(construct));
+    }
+    if (anchors.empty()) {
+        throw std::runtime_error("The library " + filename + " has no barcodes to demultiplex by.");
+    }
+    return constructs;
+}
+
+static std::string _fastq_path(const std::string& directory, const DemuxConstruct& construct) {
+    return (std::filesystem::path(directory) / (construct.index + ".fastq")).string();
+}
+
+static void _flush_fastq(
+    const std::string& directory,
+    const std::vector<DemuxConstruct>& constructs,
+    std::vector<std::string>& buffers
+) {
+    for (size_t ix = 0; ix < buffers.size(); ix++) {
+        if (buffers[ix].empty()) continue;
+        _append_fastq(_fastq_path(directory, constructs[ix]), buffers[ix]);
+        buffers[ix].clear();
+    }
+}
+
+DemuxStats _demux(
+    const std::string& reads_file,
+    const std::string& library_file,
+    const std::string& output,
+    const std::string& fastq_dir,
+    size_t max_mismatches,
+    bool reverse_complement,
+    bool overwrite,
+    size_t threads
+) {
+    _throw_if_not_exists(reads_file);
+    _remove_if_exists(output, overwrite);
+
+    std::vector<std::string> anchors;
+    std::vector<DemuxConstruct> constructs = _load_demux_library(library_file, anchors);
+    std::vector<std::string> barcodes;
+    barcodes.reserve(constructs.size());
+    for (const DemuxConstruct& construct : constructs) {
+        barcodes.push_back(construct.barcode);
+    }
+    BarcodeLookup lookup(barcodes, max_mismatches);
+
+    bool write_fastq = !fastq_dir.empty();
+    std::vector<std::string> buffers;
+    if (write_fastq) {
+        std::filesystem::create_directories(fastq_dir);
+        for (const DemuxConstruct& construct : constructs) {
+            _remove_if_exists(_fastq_path(fastq_dir, construct), overwrite);
+        }
+        buffers.resize(constructs.size());
+    }
+
+    DemuxStats stats;
+    std::vector<uint64_t> counts(constructs.size(), 0);
+    std::vector<int32_t> assigned(DEMUX_BATCH);
+    std::vector<Assignment> outcomes(DEMUX_BATCH);
+    size_t buffered = 0;
+
+    // Read the next batch while the current one is assigned
+    FastqReader reader(reads_file);
+    std::vector<FastqRecord> batch;
+    std::vector<FastqRecord> next;
+    bool more = reader.read_batch(batch, DEMUX_BATCH);
+    while (more) {
+        std::future<bool> reading = std::async(std::launch::async, [&]() {
+            return reader.read_batch(next, DEMUX_BATCH);
+        });
+
+        size_t workers = std::min(threads, batch.size());
+        size_t per_worker = (batch.size() + workers - 1) / workers;
+        try {
+            _run_workers(workers, [&](size_t worker) {
+                std::string complement;
+                size_t end = std::min(batch.size(), (worker + 1) * per_worker);
+                for (size_t ix = worker * per_worker; ix < end; ix++) {
+                    std::string_view read = batch[ix].sequence;
+                    if (reverse_complement) {
+                        _reverse_complement(batch[ix].sequence, complement);
+                        read = complement;
+                    }
+                    outcomes[ix] = _assign(read, anchors, lookup, assigned[ix]);
+                }
+            });
+        } catch (...) {
+            reading.wait();
+            throw;
+        }
+
+        for (size_t ix = 0; ix < batch.size(); ix++) {
+            switch (outcomes[ix]) {
+                case Assignment::Exact: stats.exact++; break;
+                case Assignment::Corrected: stats.corrected++; break;
+                case Assignment::Ambiguous: stats.ambiguous++; break;
+                case Assignment::Unmatched: stats.unmatched++; break;
+                case Assignment::NoAnchor: stats.no_anchor++; break;
+            }
+            if (assigned[ix] < 0) continue;
+            counts[assigned[ix]]++;
+            if (write_fastq) {
+                const FastqRecord& record = batch[ix];
+                std::string& buffer = buffers[assigned[ix]];
+                size_t before = buffer.size();
+                buffer += '@';
+                buffer += record.name;
+                buffer += '\n';
+                buffer += record.sequence;
+                buffer += "\n+\n";
+                buffer += record.quality;
+                buffer += '\n';
+                buffered += buffer.size() - before;
+            }
+        }
+        stats.reads += batch.size();
+
+        if (write_fastq && buffered > FASTQ_BUFFER_LIMIT) {
+            _flush_fastq(fastq_dir, constructs, buffers);
+            buffered = 0;
+        }
+
+        more = reading.get();
+        std::swap(batch, next);
+    }
+    if (write_fastq) {
+        _flush_fastq(fastq_dir, constructs, buffers);
+    }
+
+    std::ofstream out(output);
+    if (!out.is_open()) {
+        throw std::runtime_error("Failed to open output file: " + output);
+    }
+    out << csv::COL_INDEX << ',' << csv::COL_NAME << ',' << csv::COL_BARCODE << ',' << csv::COL_READS << '\n';
+    for (size_t ix = 0; ix < constructs.size(); ix++) {
+        const DemuxConstruct& construct = constructs[ix];
+        out << construct.index << ',' << _quote_csv_field(construct.name) << ','
+            << construct.barcode << ',' << counts[ix] << '\n';
+    }
+
+    std::cout << "Demultiplexed " << stats.reads << " reads.\n";
+    if (stats.reads > 0) {
+        auto report = [&](const std::string& label, size_t count) {
+            std::cout << "  " << label << count << " (" << std::fixed << std::setprecision(2)
+                      << _percent(count, stats.reads) << "%)\n";
+        };
+        report("Exact:     ", stats.exact);
+        report("Corrected: ", stats.corrected);
+        report("Ambiguous: ", stats.ambiguous);
+        report("Unmatched: ", stats.unmatched);
+        report("No anchor: ", stats.no_anchor);
+    }
+    return stats;
+}
@@ -0,0 +1,40 @@
+#ifndef DEMUX_H
+#define DEMUX_H
+
+#include "utils.hpp"
+
+class DemuxArgs : public Program {
+public:
+    Arg<std::string> file;
+    Arg<std::string> library;
+    Arg<std::string> output;
+    Arg<std::string> fastq_dir;
+    Arg<int> max_mismatches;
+    Arg<bool> reverse_complement;
+    Arg<bool> overwrite;
+    Arg<int> threads;
+    DemuxArgs();
+};
+
+// How the reads of a run were assigned
+struct DemuxStats {
+    size_t reads = 0;
+    size_t exact = 0;       // Barcode matched exactly
+    size_t corrected = 0;   // Barcode matched after correcting one base
+    size_t ambiguous = 0;   // Barcode within one base of several constructs
+    size_t unmatched = 0;   // Anchor found, but no barcode before it
+    size_t no_anchor = 0;   // No 3' constant region found
+};
+
+DemuxStats _demux(
+    const std::string& reads_file,
+    const std::string& library_file,
+    const std::string& output,
+    const std::string& fastq_dir,
+    size_t max_mismatches,
+    bool reverse_complement,
+    bool overwrite,
+    size_t threads = 1
+);
+
+#endif
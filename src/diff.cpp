@@ -18,26 +18,33 @@ bool _diff(
     _throw_if_not_exists(file1);
     _throw_if_not_exists(file2);
 
-    auto seqs1 = read_fasta(file1);
-    auto seqs2 = read_fasta(file2);
+    // Read both files in step, so neither is held in memory
+    FastaReader reader1(file1);
+    FastaReader reader2(file2);
+    FastaRecord entry1;
+    FastaRecord entry2;
+    bool more1 = reader1.next(entry1);
+    bool more2 = reader2.next(entry2);
+    size_t count1 = 0;
+    size_t count2 = 0;
 
     std::vector<size_t> diff_indices;
-    size_t max_size = std::max(seqs1.size(), seqs2.size());
-
-    for (size_t i = 0; i < max_size; i++) {
-        bool differs = false;
-        if (i >= seqs1.size() || i >= seqs2.size()) {
-            differs = true;
-        } else if (seqs1[i].sequence != seqs2[i].sequence) {
-            differs = true;
+    while (more1 || more2) {
+        if (!more1 || !more2 || entry1.sequence != entry2.sequence) {
+            diff_indices.push_back(std::max(count1, count2) + 1);  // 1-indexed
         }
-        if (differs) {
-            diff_indices.push_back(i + 1);  // 1-indexed
+        if (more1) {
+            count1++;
+            more1 = reader1.next(entry1);
+        }
+        if (more2) {
+            count2++;
+            more2 = reader2.next(entry2);
         }
     }
 
     if (diff_indices.empty()) {
-        std::cout << "Files are identical (" << seqs1.size() << " sequences)\n";
+        std::cout << "Files are identical (" << count1 << " sequences)\n";
         return true;
     }
 
@@ -48,8 +55,8 @@ bool _diff(
     }
     std::cout << "\n";
 
-    if (seqs1.size() != seqs2.size()) {
-        std::cout << "  (file1: " << seqs1.size() << " sequences, file2: " << seqs2.size() << " sequences)\n";
+    if (count1 != count2) {
+        std::cout << "  (file1: " << count1 << " sequences, file2: " << count2 << " sequences)\n";
     }
 
     return false;
@@ -1,8 +1,24 @@
 #include "barcode.hpp"
 #include "hairpin.hpp"
 #include "sequence.hpp"
+#include <algorithm>
 #include <stdexcept>
 
+// Proposals per window when measuring the rejection rate
+static constexpr size_t REJECTION_WINDOW = 1024;
+
+// Rejection rate above which the sampler switches to walking the space
+static constexpr double REJECTION_THRESHOLD = 0.9;
+
+static inline uint64_t _mix(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
 // The pairing complement for Hamming ball calculation
 // Only mutations that preserve base-pairing are considered:
 // A <-> G, C <-> T
@@ -33,6 +49,24 @@ std::vector<std::string> Barcode::hamming_ball(const std::string& seq) {
     return results;
 }
 
+std::vector<std::string> Barcode::substitution_ball(const std::string& seq) {
+    const std::vector<char>& bases = alphabet_bases(detect_alphabet(seq));
+    std::vector<std::string> results;
+    results.reserve(3 * seq.length() + 1);
+
+    for (size_t ix = 0; ix < seq.length(); ix++) {
+        for (char base : bases) {
+            if (base == seq[ix]) continue;
+            std::string variant = seq;
+            variant[ix] = base;
+            results.push_back(std::move(variant));
+        }
+    }
+
+    results.push_back(seq);  // Include the original
+    return results;
+}
+
 bool Barcode::is_hamming_neighbor(
     const std::string& seq,
     const std::unordered_set<std::string>& existing
@@ -50,17 +84,126 @@ bool Barcode::has_hamming_neighbor(const std::unordered_set<std::string>& existi
     return is_hamming_neighbor(_sequence, existing);
 }
 
+bool Barcode::has_hamming_neighbor(const BarcodeIndex& existing) const {
+    return existing.has_neighbor(_sequence);
+}
+
 Barcode Barcode::random(
     size_t stem_length,
     const StemConfig& config,
     std::mt19937& gen,
     const std::unordered_set<std::string>& existing
 ) {
-    std::string barcode;
+    std::string barcode(Hairpin::length_for(stem_length), '\0');
     do {
-        Hairpin hp = Hairpin::random(stem_length, config, gen);
-        barcode = hp.str();
+        Hairpin::write_random(stem_length, config, gen, barcode);
     } while (is_hamming_neighbor(barcode, existing));
 
     return Barcode(std::move(barcode));
 }
+
+Barcode Barcode::random(
+    size_t stem_length,
+    const StemConfig& config,
+    std::mt19937& gen,
+    const BarcodeIndex& existing,
+    const KmerScreen* screen
+) {
+    BarcodeSampler sampler(stem_length, config, 0, 1, screen);
+    return sampler.next(gen, existing);
+}
+
+RankPermutation::RankPermutation(uint64_t size, std::mt19937& gen)
+    : _size(size), _done(size == 0) {
+    // Each half of the permuted domain is at least one bit
+    _half_bits = 1;
+    while (_half_bits < 32 && (1ULL << (2 * _half_bits)) < size) {
+        _half_bits++;
+    }
+    for (uint64_t& key : _keys) {
+        key = (static_cast<uint64_t>(gen()) << 32) | gen();
+    }
+}
+
+uint64_t RankPermutation::_permute(uint64_t value) const {
+    uint64_t mask = (1ULL << _half_bits) - 1;
+    uint64_t left = value >> _half_bits;
+    uint64_t right = value & mask;
+    for (uint64_t key : _keys) {
+        uint64_t mixed = left ^ (_mix(right ^ key) & mask);
+        left = right;
+        right = mixed;
+    }
+    return (left << _half_bits) | right;
+}
+
+bool RankPermutation::next(uint64_t& value) {
+    // The last value of the domain, which may be UINT64_MAX itself
+    uint64_t last = (_half_bits == 32) ? UINT64_MAX : (1ULL << (2 * _half_bits)) - 1;
+    while (!_done) {
+        uint64_t permuted = _permute(_next);
+        if (_next == last) {
+            _done = true;
+        } else {
+            _next++;
+        }
+        if (permuted < _size) {
+            value = permuted;
+            return true;
+        }
+    }
+    return false;
+}
+
+BarcodeSampler::BarcodeSampler(
+    size_t stem_length,
+    const StemConfig& config,
+    size_t shard,
+    size_t shards,
+    const KmerScreen* screen
+) : _stems(stem_length, config), _shard(shard), _shards(shards), _screen(screen) {}
+
+bool BarcodeSampler::_admissible(const BarcodeIndex& existing) const {
+    return !existing.has_neighbor(_buffer) && !(_screen && _screen->hits(_buffer));
+}
+
+Barcode BarcodeSampler::next(std::mt19937& gen, const BarcodeIndex& existing) {
+    while (!_enumerating) {
+        _stems.sample(gen, _buffer);
+        _proposals++;
+        if (_admissible(existing)) {
+            return Barcode(_buffer);
+        }
+        _rejections++;
+
+        if (_proposals >= REJECTION_WINDOW) {
+            double rate = static_cast<double>(_rejections) / _proposals;
+            _proposals = 0;
+            _rejections = 0;
+            if (rate >= REJECTION_THRESHOLD) {
+                // The ranks of this shard are shard, shard + shards, ...
+                uint64_t ranks = (_stems.size() > _shard) ? (_stems.size() - _shard - 1) / _shards + 1 : 0;
+                _walk = RankPermutation(ranks, gen);
+                _enumerating = true;
+            }
+        }
+    }
+
+    // Each rank is visited once; those taken or neighbouring a barcode
+    // placed so far are skipped, and stay inadmissible for good
+    uint64_t index;
+    while (_walk.next(index)) {
+        _stems.unrank(_shard + index * _shards, _buffer);
+        if (_admissible(existing)) {
+            return Barcode(_buffer);
+        }
+    }
+
+    throw BarcodesExhausted(
+        "No admissible barcodes remain: every allowed hairpin" +
+        std::string(_shards > 1 ? " in this shard" : "") + " with stem length " +
+        std::to_string(_stems.stem_length()) +
+        " is a Hamming neighbor of an existing barcode" +
+        std::string(_screen ? " or shares a " + std::to_string(_screen->k()) + "-mer with the library" : "") + "."
+    );
+}
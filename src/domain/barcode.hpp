@@ -1,10 +1,16 @@
 #ifndef BARCODE_DOMAIN_H
 #define BARCODE_DOMAIN_H
 
+#include <array>
+#include <cstdint>
+#include <stdexcept>
 #include <string>
 #include <unordered_set>
 #include <random>
 #include "../config/stem_config.hpp"
+#include "barcode_index.hpp"
+#include "kmer_screen.hpp"
+#include "stem_sampler.hpp"
 
 // A barcode is a hairpin sequence used to uniquely identify constructs.
 // Barcodes must maintain minimum Hamming distance from each other to
@@ -21,14 +27,23 @@ public:
 
     // Check if this barcode is within Hamming distance 1 of any in the set
     bool has_hamming_neighbor(const std::unordered_set<std::string>& existing) const;
+    bool has_hamming_neighbor(const BarcodeIndex& existing) const;
 
-    // Generate a random barcode that is not a Hamming neighbor of any existing
+    // Generate a random barcode that is not a Hamming neighbor of any
+    // existing, nor shares a k-mer with the screen if one is given
     static Barcode random(
         size_t stem_length,
         const StemConfig& config,
         std::mt19937& gen,
         const std::unordered_set<std::string>& existing
     );
+    static Barcode random(
+        size_t stem_length,
+        const StemConfig& config,
+        std::mt19937& gen,
+        const BarcodeIndex& existing,
+        const KmerScreen* screen = nullptr
+    );
 
     // String conversion
     operator const std::string&() const { return _sequence; }
@@ -36,6 +51,11 @@ public:
     // Generate the Hamming ball (all sequences at distance 1)
     static std::vector<std::string> hamming_ball(const std::string& seq);
 
+    // Generate every sequence within one arbitrary substitution, as
+    // sequencing errors need not preserve base-pairing. Bases are written
+    // in the alphabet of the sequence; the original comes last.
+    static std::vector<std::string> substitution_ball(const std::string& seq);
+
 private:
     std::string _sequence;
 
@@ -46,4 +66,83 @@ private:
     );
 };
 
+// Thrown when no allowed hairpin is left that is not a Hamming neighbor
+// of an existing barcode
+class BarcodesExhausted : public std::runtime_error {
+public:
+    using std::runtime_error::runtime_error;
+};
+
+// A random permutation of [0, size), walked one value at a time in
+// constant memory. A Feistel network permutes the smallest power of four
+// at least size, and the values at or past size are skipped, so a walk
+// visits every value exactly once in under four steps per value.
+class RankPermutation {
+public:
+    RankPermutation() = default;
+    RankPermutation(uint64_t size, std::mt19937& gen);
+
+    // Move to the next value, returning false once every value has been
+    // visited
+    bool next(uint64_t& value);
+
+private:
+    static constexpr size_t ROUNDS = 4;
+
+    uint64_t _size = 0;
+    unsigned _half_bits = 0;
+    uint64_t _next = 0;
+    bool _done = true;
+    std::array<uint64_t, ROUNDS> _keys{};
+
+    uint64_t _permute(uint64_t value) const;
+};
+
+// Draws barcodes uniformly from the hairpins allowed by a StemConfig,
+// rejecting Hamming neighbors of the existing barcodes. Once the observed
+// rejection rate crosses a threshold, the sampler switches to walking the
+// whole hairpin space in a random order, skipping hairpins that are not
+// admissible, so filling a library takes bounded time right up to capacity
+// and constant memory however large the space is.
+//
+// Samplers used by parallel workers can be given a shard of the hairpin
+// space, so that their walks are disjoint and together cover it.
+//
+// With a k-mer screen, hairpins sharing a k-mer with it are rejected too.
+// The screen is not owned and must outlive the sampler.
+class BarcodeSampler {
+public:
+    BarcodeSampler(
+        size_t stem_length,
+        const StemConfig& config,
+        size_t shard = 0,
+        size_t shards = 1,
+        const KmerScreen* screen = nullptr
+    );
+
+    // Generate a barcode that is not a Hamming neighbor of any existing.
+    // Throws BarcodesExhausted if every allowed hairpin is a neighbor or
+    // screened out.
+    Barcode next(std::mt19937& gen, const BarcodeIndex& existing);
+
+    // Whether the sampler has switched to walking the hairpin space
+    bool enumerating() const { return _enumerating; }
+
+    // The underlying stem counts
+    const StemSampler& stems() const { return _stems; }
+
+private:
+    StemSampler _stems;
+    size_t _shard;
+    size_t _shards;
+    const KmerScreen* _screen;
+    std::string _buffer;
+    size_t _proposals = 0;
+    size_t _rejections = 0;
+    bool _enumerating = false;
+    RankPermutation _walk;
+
+    bool _admissible(const BarcodeIndex& existing) const;
+};
+
 #endif
@@ -0,0 +1,184 @@
+#include "barcode_capacity.hpp"
+#include "barcode_index.hpp"
+#include "hairpin.hpp"
+#include "stem_sampler.hpp"
+#include <algorithm>
+#include <cmath>
+
+// Stem spaces up to this many hairpins are packed exactly
+static constexpr uint64_t GREEDY_LIMIT = 1ULL << 14;
+
+// Longest stem StemSampler can enumerate
+static constexpr size_t MAX_GREEDY_STEM = 40;
+
+// Counts are accumulated in long double, which holds integers below 2^64
+// exactly and saturates gracefully above, then clamped on the way out
+static uint64_t _clamp(long double value) {
+    if (!(value > 0)) return 0;
+    if (value >= 18446744073709551615.0L) return UINT64_MAX;
+    return static_cast<uint64_t>(std::floor(value));
+}
+
+static long double _binomial(size_t n, size_t k) {
+    long double result = 1;
+    for (size_t ix = 1; ix <= k; ix++) {
+        result = result * static_cast<long double>(n - k + ix) / static_cast<long double>(ix);
+    }
+    return std::round(result);
+}
+
+namespace {
+
+// The free pair limits of a stem, after the closing GC pairs
+struct FreePairs {
+    size_t length;
+    size_t max_au;
+    size_t max_gc;
+    size_t max_gu;
+    bool valid;
+
+    FreePairs(size_t stem_length, const StemConfig& config) {
+        valid = config.closing_gc <= stem_length && config.closing_gc <= config.max_gc;
+        length = valid ? stem_length - config.closing_gc : 0;
+        max_au = std::min(config.max_au, length);
+        max_gc = valid ? std::min(config.max_gc - config.closing_gc, length) : 0;
+        max_gu = std::min(config.max_gu, length);
+    }
+
+    // Call visit(a, b, c, count) for each allowed composition of a prefix
+    // of the given length, with count the number of type sequences
+    template <typename Visit>
+    void compositions(size_t prefix, Visit visit) const {
+        for (size_t a = 0; a <= std::min(max_au, prefix); a++) {
+            for (size_t b = 0; b <= std::min(max_gc, prefix - a); b++) {
+                size_t c = prefix - a - b;
+                if (c > max_gu) continue;
+                visit(a, b, c, _binomial(prefix, a) * _binomial(prefix - a, b));
+            }
+        }
+    }
+};
+
+}
+
+static long double _hairpins(size_t stem_length, const StemConfig& config) {
+    FreePairs free(stem_length, config);
+    if (!free.valid) return 0;
+    long double types = 0;
+    free.compositions(free.length, [&](size_t, size_t, size_t, long double count) {
+        types += count;
+    });
+    return types * std::ldexp(1.0L, static_cast<int>(stem_length)) * Hairpin::tetraloops().size();
+}
+
+// Independent set bound for the pairing-complement rule. Within the allowed
+// hairpins, a single transition turns a GU pair into an AU or GC pair or
+// back, so edges are counted once from their GU end.
+static long double _neighbor_bound(size_t stem_length, const StemConfig& config) {
+    FreePairs free(stem_length, config);
+    if (!free.valid) return 0;
+
+    long double per_type = std::ldexp(1.0L, static_cast<int>(stem_length)) * Hairpin::tetraloops().size();
+    long double hairpins = 0;
+    long double edges = 0;
+    size_t max_degree = 0;
+    free.compositions(free.length, [&](size_t a, size_t b, size_t c, long double count) {
+        size_t to_wc = (a + 1 <= free.max_au) + (b + 1 <= free.max_gc);
+        size_t to_gu = (c + 1 <= free.max_gu) ? 1 : 0;
+        hairpins += count * per_type;
+        edges += count * per_type * c * to_wc;
+        max_degree = std::max(max_degree, c * to_wc + (a + b) * to_gu);
+    });
+    if (max_degree == 0) return hairpins;
+    return hairpins - edges / max_degree;
+}
+
+// Singleton-style bound for a minimum distance d >= 2: dropping the last
+// floor((d - 1) / 2) pairs changes at most d - 1 bases, so it keeps
+// separated barcodes distinct
+static long double _projection_bound(size_t stem_length, const StemConfig& config, size_t distance) {
+    FreePairs free(stem_length, config);
+    if (!free.valid) return 0;
+
+    size_t dropped = (distance - 1) / 2;
+    size_t kept = (dropped < stem_length) ? stem_length - dropped : 0;
+    long double types = 1;
+    if (dropped < free.length) {
+        types = 0;
+        free.compositions(free.length - dropped, [&](size_t, size_t, size_t, long double count) {
+            types += count;
+        });
+    }
+    return types * std::ldexp(1.0L, static_cast<int>(kept)) * Hairpin::tetraloops().size();
+}
+
+static long double _bound(
+    size_t stem_length,
+    const StemConfig& config,
+    size_t min_distance,
+    size_t min_edit_distance
+) {
+    long double bound = _hairpins(stem_length, config);
+    if (min_distance <= 1) {
+        bound = std::min(bound, _neighbor_bound(stem_length, config));
+    }
+    size_t distance = std::max(min_distance, min_edit_distance);
+    if (distance >= 2) {
+        bound = std::min(bound, _projection_bound(stem_length, config, distance));
+    }
+    return bound;
+}
+
+static uint64_t _greedy_pack(
+    size_t stem_length,
+    const StemConfig& config,
+    size_t min_distance,
+    size_t min_edit_distance
+) {
+    StemSampler stems(stem_length, config);
+    BarcodeIndex index(min_distance, min_edit_distance);
+    std::string buffer;
+    for (uint64_t rank = 0; rank < stems.size(); rank++) {
+        stems.unrank(rank, buffer);
+        index.insert_if_not_neighbor(buffer);
+    }
+    return index.size();
+}
+
+BarcodeCapacity estimate_barcode_capacity(
+    size_t stem_length,
+    const StemConfig& config,
+    size_t min_distance,
+    size_t min_edit_distance
+) {
+    BarcodeCapacity capacity;
+    capacity.hairpins = _clamp(_hairpins(stem_length, config));
+    long double bound = _bound(stem_length, config, min_distance, min_edit_distance);
+    capacity.packing_bound = _clamp(bound);
+    capacity.greedy_estimate = capacity.packing_bound;
+
+    // Pack the longest stem that is small enough, and scale its packing
+    // ratio up to the requested length
+    size_t shortest = std::max<size_t>(config.closing_gc, 1);
+    for (size_t length = std::min(stem_length, MAX_GREEDY_STEM); length >= shortest; length--) {
+        long double hairpins = _hairpins(length, config);
+        if (hairpins > GREEDY_LIMIT) continue;
+        if (hairpins == 0) break;
+
+        uint64_t packed = _greedy_pack(length, config, min_distance, min_edit_distance);
+        if (length == stem_length) {
+            capacity.greedy_estimate = packed;
+        } else {
+            long double ratio = packed / _bound(length, config, min_distance, min_edit_distance);
+            capacity.greedy_estimate = _clamp(std::min(bound, ratio * bound));
+        }
+        break;
+    }
+    return capacity;
+}
+
+std::string BarcodeCapacity::describe() const {
+    return "at most " + std::to_string(packing_bound) +
+        " mutually separated barcodes (about " + std::to_string(greedy_estimate) +
+        " by greedy packing, out of " + std::to_string(hairpins) + " hairpins)";
+}
@@ -0,0 +1,42 @@
+#ifndef BARCODE_CAPACITY_H
+#define BARCODE_CAPACITY_H
+
+#include <cstdint>
+#include <string>
+#include "../config/stem_config.hpp"
+
+// How many mutually separated barcodes fit at a given stem length.
+// All counts saturate at UINT64_MAX rather than overflowing.
+struct BarcodeCapacity {
+    // Allowed hairpins, ignoring separation
+    uint64_t hairpins = 0;
+
+    // Upper bound on the number of mutually separated barcodes. A library
+    // larger than this cannot be barcoded.
+    uint64_t packing_bound = 0;
+
+    // Empirical estimate from a greedy packing, exact for small stem
+    // spaces and extrapolated from a shorter stem otherwise
+    uint64_t greedy_estimate = 0;
+
+    // A one-line summary for error messages
+    std::string describe() const;
+};
+
+// Estimate the barcode capacity of a stem length and configuration.
+//
+// With the default pairing-complement rule, allowed hairpins are only
+// neighbours through GU pairs, and the bound is the independent set bound
+// N - E / D over the neighbour graph, with N hairpins, E edges and maximum
+// degree D, all counted from the pair compositions. With a minimum
+// Hamming or edit distance d >= 2, two barcodes agreeing on all but the
+// last floor((d - 1) / 2) pairs would be too close, so the bound is the
+// number of allowed hairpins with those pairs removed.
+BarcodeCapacity estimate_barcode_capacity(
+    size_t stem_length,
+    const StemConfig& config,
+    size_t min_distance = 1,
+    size_t min_edit_distance = 0
+);
+
+#endif
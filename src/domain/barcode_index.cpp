@@ -0,0 +1,266 @@
+#include "barcode_index.hpp"
+#include "barcode.hpp"
+#include "hairpin.hpp"
+#include "sequence.hpp"
+#include <algorithm>
+#include <bit>
+#include <stdexcept>
+
+// Key layout (least significant bit first):
+//   [0, 36)   sense stem, 2 bits per base
+//   [36, 54)  wobble flag per base pair
+//   [54, 59)  stem length
+//   [59, 61)  tetraloop index
+static constexpr size_t WOBBLE_SHIFT = 2 * BarcodeIndex::MAX_PACKED_STEM;
+static constexpr size_t LENGTH_SHIFT = WOBBLE_SHIFT + BarcodeIndex::MAX_PACKED_STEM;
+static constexpr size_t LOOP_SHIFT = LENGTH_SHIFT + 5;
+static constexpr uint64_t LOOP_MASK = 3ULL << LOOP_SHIFT;
+static constexpr size_t MAX_LOOPS = 4;
+
+// Never a valid key, since the top bits of a key are always zero
+static constexpr uint64_t EMPTY_SLOT = ~0ULL;
+
+static constexpr size_t MIN_CAPACITY = 16;
+
+// 2-bit base codes, chosen so that the pairing complement (A <-> G,
+// C <-> T) is an XOR with 2 and the Watson-Crick partner is an XOR with 3
+static inline int _base_code(char base) {
+    switch (base) {
+        case BASE_A: return 0;
+        case BASE_C: return 1;
+        case BASE_G: return 2;
+        case BASE_T: return 3;
+        default:     return -1;
+    }
+}
+
+static inline int _loop_index(const std::string& seq, size_t offset) {
+    const std::vector<std::string>& loops = Hairpin::tetraloops();
+    for (size_t ix = 0; ix < loops.size() && ix < MAX_LOOPS; ix++) {
+        if (seq.compare(offset, HAIRPIN_LOOP_LENGTH, loops[ix]) == 0) {
+            return static_cast<int>(ix);
+        }
+    }
+    return -1;
+}
+
+// For each tetraloop, the tetraloops reachable from it by a single
+// pairing-complement mutation. Empty for the standard loops, but kept
+// so the index stays exact if the loop set changes.
+static const std::vector<std::vector<uint64_t>>& _loop_neighbors() {
+    static const std::vector<std::vector<uint64_t>> neighbors = [] {
+        const std::vector<std::string>& loops = Hairpin::tetraloops();
+        size_t count = std::min(loops.size(), MAX_LOOPS);
+        std::vector<std::vector<uint64_t>> result(count);
+        for (size_t ix = 0; ix < count; ix++) {
+            for (size_t jx = 0; jx < count; jx++) {
+                if (ix == jx) continue;
+                size_t diffs = 0;
+                bool transitions = true;
+                for (size_t kx = 0; kx < HAIRPIN_LOOP_LENGTH; kx++) {
+                    int a = _base_code(loops[ix][kx]);
+                    int b = _base_code(loops[jx][kx]);
+                    if (a == b) continue;
+                    diffs++;
+                    transitions = transitions && ((a ^ b) == 2);
+                }
+                if (diffs == 1 && transitions) {
+                    result[ix].push_back(jx);
+                }
+            }
+        }
+        return result;
+    }();
+    return neighbors;
+}
+
+static inline size_t _slot_for(uint64_t key, size_t capacity) {
+    uint64_t hash = key * 0x9E3779B97F4A7C15ULL;
+    return static_cast<size_t>(hash >> 32) & (capacity - 1);
+}
+
+bool BarcodeIndex::encode(const std::string& seq, uint64_t& key) {
+    if (seq.length() <= HAIRPIN_LOOP_LENGTH) return false;
+    size_t stem = seq.length() - HAIRPIN_LOOP_LENGTH;
+    if (stem % 2 != 0) return false;
+    stem /= 2;
+    if (stem > MAX_PACKED_STEM) return false;
+
+    int loop = _loop_index(seq, stem);
+    if (loop < 0) return false;
+
+    uint64_t sense = 0;
+    uint64_t wobble = 0;
+    for (size_t ix = 0; ix < stem; ix++) {
+        int five = _base_code(seq[ix]);
+        int three = _base_code(seq[seq.length() - ix - 1]);
+        if (five < 0 || three < 0) return false;
+        if (three != (five ^ 3)) {
+            // Only G-U and U-G wobbles are allowed besides Watson-Crick
+            if (!(five & 2) || three != (five ^ 1)) return false;
+            wobble |= 1ULL << ix;
+        }
+        sense |= static_cast<uint64_t>(five) << (2 * ix);
+    }
+
+    key = sense |
+          (wobble << WOBBLE_SHIFT) |
+          (static_cast<uint64_t>(stem) << LENGTH_SHIFT) |
+          (static_cast<uint64_t>(loop) << LOOP_SHIFT);
+    return true;
+}
+
+BarcodeIndex::BarcodeIndex(size_t min_distance, size_t min_edit_distance) {
+    if (min_distance == 0) {
+        throw std::invalid_argument("The minimum barcode distance must be at least 1.");
+    }
+    if (min_distance > 1) {
+        _distant.emplace(min_distance, true);
+    }
+    if (min_edit_distance > 0) {
+        _indels.emplace(min_edit_distance);
+    }
+}
+
+size_t BarcodeIndex::min_distance() const {
+    return _distant ? _distant->min_distance() : 1;
+}
+
+size_t BarcodeIndex::min_edit_distance() const {
+    return _indels ? _indels->min_distance() : 0;
+}
+
+size_t BarcodeIndex::size() const {
+    if (_distant) return _distant->size();
+    return _size + _fallback.size();
+}
+
+void BarcodeIndex::reserve(size_t count) {
+    if (_indels) {
+        _indels->reserve(count);
+    }
+    if (_distant) {
+        _distant->reserve(count);
+        return;
+    }
+    size_t capacity = std::bit_ceil(std::max(MIN_CAPACITY, 2 * count));
+    if (capacity > _slots.size()) {
+        _rehash(capacity);
+    }
+}
+
+bool BarcodeIndex::_contains_key(uint64_t key) const {
+    if (_slots.empty()) return false;
+    size_t mask = _slots.size() - 1;
+    for (size_t ix = _slot_for(key, _slots.size()); ; ix = (ix + 1) & mask) {
+        if (_slots[ix] == key) return true;
+        if (_slots[ix] == EMPTY_SLOT) return false;
+    }
+}
+
+// A mutation on the sense strand flips the base and the wobble flag of
+// that pair; a mutation on the antisense strand flips the wobble flag
+// alone. Keys that do not describe a valid pair are never stored, so
+// they can be probed without further checks.
+bool BarcodeIndex::_key_has_neighbor(uint64_t key) const {
+    if (_size == 0) return false;
+    if (_contains_key(key)) return true;
+
+    size_t stem = (key >> LENGTH_SHIFT) & 31;
+    for (size_t ix = 0; ix < stem; ix++) {
+        uint64_t antisense = key ^ (1ULL << (WOBBLE_SHIFT + ix));
+        if (_contains_key(antisense)) return true;
+        uint64_t sense = antisense ^ (2ULL << (2 * ix));
+        if (_contains_key(sense)) return true;
+    }
+
+    size_t loop = (key & LOOP_MASK) >> LOOP_SHIFT;
+    for (uint64_t other : _loop_neighbors()[loop]) {
+        if (_contains_key((key & ~LOOP_MASK) | (other << LOOP_SHIFT))) return true;
+    }
+    return false;
+}
+
+bool BarcodeIndex::_fallback_has_neighbor(const std::string& seq) const {
+    if (_fallback.empty()) return false;
+    for (const auto& element : Barcode::hamming_ball(seq)) {
+        if (_fallback.find(element) != _fallback.end()) return true;
+    }
+    return false;
+}
+
+bool BarcodeIndex::has_neighbor(const std::string& seq) const {
+    if (_indels && _indels->has_close(seq)) {
+        return true;
+    }
+    if (_distant) {
+        return _distant->has_close(seq);
+    }
+
+    uint64_t key;
+    if (encode(seq, key)) {
+        return _key_has_neighbor(key) || _fallback_has_neighbor(seq);
+    }
+
+    // Rare path: a sequence that cannot be packed may still have packed
+    // sequences in its Hamming ball
+    for (const auto& element : Barcode::hamming_ball(seq)) {
+        if (encode(element, key) && _contains_key(key)) return true;
+        if (_fallback.find(element) != _fallback.end()) return true;
+    }
+    return false;
+}
+
+void BarcodeIndex::_rehash(size_t capacity) {
+    std::vector<uint64_t> old = std::move(_slots);
+    _slots.assign(capacity, EMPTY_SLOT);
+    size_t mask = capacity - 1;
+    for (uint64_t key : old) {
+        if (key == EMPTY_SLOT) continue;
+        size_t ix = _slot_for(key, capacity);
+        while (_slots[ix] != EMPTY_SLOT) {
+            ix = (ix + 1) & mask;
+        }
+        _slots[ix] = key;
+    }
+}
+
+void BarcodeIndex::_insert_key(uint64_t key) {
+    if (2 * (_size + 1) > _slots.size()) {
+        _rehash(std::max(MIN_CAPACITY, 2 * _slots.size()));
+    }
+    size_t mask = _slots.size() - 1;
+    for (size_t ix = _slot_for(key, _slots.size()); ; ix = (ix + 1) & mask) {
+        if (_slots[ix] == key) return;
+        if (_slots[ix] == EMPTY_SLOT) {
+            _slots[ix] = key;
+            _size++;
+            return;
+        }
+    }
+}
+
+void BarcodeIndex::insert(const std::string& seq) {
+    if (_indels) {
+        _indels->insert(seq);
+    }
+    if (_distant) {
+        _distant->insert(seq);
+        return;
+    }
+
+    uint64_t key;
+    if (encode(seq, key)) {
+        _insert_key(key);
+    } else {
+        _fallback.insert(seq);
+    }
+}
+
+bool BarcodeIndex::insert_if_not_neighbor(const std::string& seq) {
+    if (has_neighbor(seq)) {
+        return false;
+    }
+    insert(seq);
+    return true;
+}
@@ -0,0 +1,85 @@
+#ifndef BARCODE_INDEX_H
+#define BARCODE_INDEX_H
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <unordered_set>
+#include <vector>
+#include "edit_index.hpp"
+#include "hamming_index.hpp"
+
+// A set of barcodes supporting fast Hamming-ball membership queries.
+//
+// Barcodes that are hairpins (stem, one of the standard tetraloops,
+// antisense stem) are stored as a single 64-bit key: the sense stem
+// packed at 2 bits per base, one wobble bit per pair (the antisense
+// half is implied by the sense half and these bits), the stem length
+// and the loop index. A pairing-complement mutation (A <-> G, C <-> T)
+// then becomes an XOR on the key, so probing the neighbour ball is a
+// handful of integer lookups with no allocation.
+//
+// Sequences that cannot be packed this way (foreign loops, mispaired
+// stems, long stems) are kept verbatim and checked with the string
+// Hamming ball, so the index is exact for arbitrary input.
+//
+// With a minimum distance of 2 or more, barcodes must instead differ
+// in at least that many positions over all substitutions, which also
+// rules out the pairing-complement neighbours. These are kept in a
+// pigeonhole multi-index (see HammingIndex).
+//
+// A minimum edit distance can be enforced on top of either rule, to
+// separate barcodes against insertions and deletions (see EditIndex).
+class BarcodeIndex {
+public:
+    // Longest stem that fits in a packed key
+    static constexpr size_t MAX_PACKED_STEM = 18;
+
+    // A minimum edit distance of 0 disables the edit distance check
+    explicit BarcodeIndex(size_t min_distance = 1, size_t min_edit_distance = 0);
+
+    // The minimum distance enforced between barcodes
+    size_t min_distance() const;
+
+    // The minimum edit distance enforced between barcodes, or 0
+    size_t min_edit_distance() const;
+
+    // Number of barcodes in the index
+    size_t size() const;
+    bool empty() const { return size() == 0; }
+
+    // Pre-size the table for the given number of barcodes
+    void reserve(size_t count);
+
+    // Check if the sequence is too close to any barcode: within the
+    // pairing-complement Hamming ball for a minimum distance of 1, or
+    // at Hamming distance below the minimum distance otherwise, or at
+    // edit distance below the minimum edit distance
+    bool has_neighbor(const std::string& seq) const;
+
+    // Add a sequence to the index, without checking its neighbours
+    void insert(const std::string& seq);
+
+    // Add the sequence only if it has no neighbour in the index.
+    // Return false if not inserted.
+    bool insert_if_not_neighbor(const std::string& seq);
+
+    // Pack a hairpin barcode into a key. Returns false if the sequence
+    // is not a hairpin that can be packed.
+    static bool encode(const std::string& seq, uint64_t& key);
+
+private:
+    std::vector<uint64_t> _slots;
+    size_t _size = 0;
+    std::unordered_set<std::string> _fallback;
+    std::optional<HammingIndex> _distant;
+    std::optional<EditIndex> _indels;
+
+    bool _contains_key(uint64_t key) const;
+    bool _key_has_neighbor(uint64_t key) const;
+    bool _fallback_has_neighbor(const std::string& seq) const;
+    void _insert_key(uint64_t key);
+    void _rehash(size_t capacity);
+};
+
+#endif
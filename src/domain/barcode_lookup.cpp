@@ -0,0 +1,129 @@
+#include "barcode_lookup.hpp"
+#include "barcode.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+bool BarcodeLookup::encode(std::string_view sequence, uint64_t& key) {
+    key = 0;
+    for (char base : sequence) {
+        uint64_t code;
+        switch (base) {
+            case 'A': code = 0; break;
+            case 'C': code = 1; break;
+            case 'G': code = 2; break;
+            case 'T':
+            case 'U': code = 3; break;
+            default: return false;
+        }
+        key = (key << 2) | code;
+    }
+    return true;
+}
+
+BarcodeLookup::BarcodeLookup(const std::vector<std::string>& barcodes, size_t max_mismatches) :
+    _max_mismatches(max_mismatches) {
+    if (max_mismatches > 1) {
+        throw std::invalid_argument("At most one mismatch per barcode can be corrected.");
+    }
+
+    _tables.resize(MAX_LENGTH + 1);
+    _corrected.resize(MAX_LENGTH + 1);
+    _exact.resize(barcodes.size(), 0);
+
+    // Exact barcodes first, so that corrections never shadow them
+    for (size_t ix = 0; ix < barcodes.size(); ix++) {
+        const std::string& barcode = barcodes[ix];
+        if (barcode.empty()) continue;
+        if (barcode.length() > MAX_LENGTH) {
+            throw std::invalid_argument(
+                "Barcodes longer than " + std::to_string(MAX_LENGTH) +
+                " nt (stems over 14 bp) cannot be demultiplexed: " + barcode
+            );
+        }
+        uint64_t key;
+        if (!encode(barcode, key)) {
+            throw std::invalid_argument("Invalid base in barcode: " + barcode);
+        }
+        _exact[ix] = key;
+        auto [it, inserted] = _tables[barcode.length()].try_emplace(key, static_cast<int32_t>(ix));
+        if (!inserted) {
+            it->second = AMBIGUOUS;
+        }
+    }
+
+    // Then every sequence one substitution away. A sequence reached from
+    // two barcodes cannot be corrected.
+    if (max_mismatches == 1) {
+        for (size_t ix = 0; ix < barcodes.size(); ix++) {
+            const std::string& barcode = barcodes[ix];
+            if (barcode.empty()) continue;
+            const auto& exact = _tables[barcode.length()];
+            auto& table = _corrected[barcode.length()];
+            for (const std::string& variant : Barcode::substitution_ball(barcode)) {
+                uint64_t key;
+                encode(variant, key);
+                if (exact.count(key)) continue;
+                auto [it, inserted] = table.try_emplace(key, static_cast<int32_t>(ix));
+                if (!inserted && it->second != static_cast<int32_t>(ix)) {
+                    it->second = AMBIGUOUS;
+                }
+            }
+        }
+    }
+
+    for (size_t length = MAX_LENGTH + 1; length-- > 0;) {
+        if (!_tables[length].empty() || !_corrected[length].empty()) {
+            _lengths.push_back(length);
+        }
+    }
+}
+
+int32_t BarcodeLookup::find(std::string_view sequence) const {
+    if (sequence.length() > MAX_LENGTH) return UNMATCHED;
+    uint64_t key;
+    if (!encode(sequence, key)) return _find_unknown_base(sequence);
+    const auto& exact = _tables[sequence.length()];
+    auto it = exact.find(key);
+    if (it != exact.end()) return it->second;
+    const auto& corrected = _corrected[sequence.length()];
+    it = corrected.find(key);
+    return (it == corrected.end()) ? UNMATCHED : it->second;
+}
+
+// A sequence with one unknown base is corrected to the barcode that
+// matches every other base, if there is exactly one
+int32_t BarcodeLookup::_find_unknown_base(std::string_view sequence) const {
+    if (_max_mismatches == 0) return UNMATCHED;
+    size_t unknown = sequence.length();
+    for (size_t ix = 0; ix < sequence.length(); ix++) {
+        switch (sequence[ix]) {
+            case 'A': case 'C': case 'G': case 'T': case 'U': continue;
+        }
+        if (unknown != sequence.length()) return UNMATCHED;
+        unknown = ix;
+    }
+
+    const auto& exact = _tables[sequence.length()];
+    std::string variant(sequence);
+    int32_t found = UNMATCHED;
+    for (char base : {'A', 'C', 'G', 'T'}) {
+        variant[unknown] = base;
+        uint64_t key;
+        encode(variant, key);
+        auto it = exact.find(key);
+        if (it == exact.end()) continue;
+        if (found != UNMATCHED || it->second == AMBIGUOUS) return AMBIGUOUS;
+        found = it->second;
+    }
+    return found;
+}
+
+bool BarcodeLookup::has_length(size_t length) const {
+    return length <= MAX_LENGTH && (!_tables[length].empty() || !_corrected[length].empty());
+}
+
+bool BarcodeLookup::is_exact(std::string_view sequence, int32_t construct) const {
+    if (construct < 0) return false;
+    uint64_t key;
+    return encode(sequence, key) && key == _exact[construct];
+}
@@ -0,0 +1,56 @@
+#ifndef BARCODE_LOOKUP_H
+#define BARCODE_LOOKUP_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Assigns observed barcodes to the constructs they came from.
+//
+// The table is precomputed from the substitution ball of every barcode, so
+// a read with up to one sequencing error is assigned by a single hash
+// lookup. An exact match always wins over a corrected one. A sequence
+// within one substitution of several barcodes is marked ambiguous rather
+// than assigned to any of them. A single base other than A, C, G, T or U,
+// such as an N, counts as the one correctable substitution. Keys are
+// packed two bits per base, so barcodes may be up to 32 nt, a stem of at
+// most 14 bp; T and U are equivalent.
+class BarcodeLookup {
+public:
+    static constexpr int32_t UNMATCHED = -1;
+    static constexpr int32_t AMBIGUOUS = -2;
+    static constexpr size_t MAX_LENGTH = 32;
+
+    // Build the table for barcodes[i] identifying construct i. Empty
+    // barcodes are skipped.
+    BarcodeLookup(const std::vector<std::string>& barcodes, size_t max_mismatches = 1);
+
+    // The construct a sequence is assigned to, or UNMATCHED or AMBIGUOUS
+    int32_t find(std::string_view sequence) const;
+
+    // Whether a sequence of this length could be a barcode
+    bool has_length(size_t length) const;
+
+    // The distinct barcode lengths, longest first
+    const std::vector<size_t>& lengths() const { return _lengths; }
+
+    // Whether the sequence is an exact copy of its assigned barcode
+    bool is_exact(std::string_view sequence, int32_t construct) const;
+
+    // Pack a sequence two bits per base, or return false on a base
+    // other than A, C, G, T or U
+    static bool encode(std::string_view sequence, uint64_t& key);
+
+private:
+    size_t _max_mismatches;
+    std::vector<size_t> _lengths;
+    std::vector<std::unordered_map<uint64_t, int32_t>> _tables;     // Exact, by length
+    std::vector<std::unordered_map<uint64_t, int32_t>> _corrected;  // By length
+    std::vector<uint64_t> _exact;                                    // By construct
+
+    int32_t _find_unknown_base(std::string_view sequence) const;
+};
+
+#endif
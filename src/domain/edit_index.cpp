@@ -0,0 +1,131 @@
+#include "edit_index.hpp"
+#include <algorithm>
+#include <functional>
+#include <optional>
+#include <stdexcept>
+
+MyersPattern::MyersPattern(const std::string& pattern) : _length(pattern.length()) {
+    if (_length > MAX_LENGTH) {
+        throw std::invalid_argument(
+            "Patterns longer than " + std::to_string(MAX_LENGTH) + " characters are not supported."
+        );
+    }
+    for (size_t ix = 0; ix < _length; ix++) {
+        _peq[static_cast<unsigned char>(pattern[ix])] |= 1ULL << ix;
+    }
+}
+
+// Myers' algorithm, in Hyyrö's formulation for global alignment: the
+// vertical deltas of one DP column are kept as bit vectors, and the top
+// row contributes a +1 horizontal delta at every step.
+size_t MyersPattern::distance(const std::string& text) const {
+    if (_length == 0) return text.length();
+
+    uint64_t pv = (_length == 64) ? ~0ULL : (1ULL << _length) - 1;
+    uint64_t mv = 0;
+    uint64_t high = 1ULL << (_length - 1);
+    size_t score = _length;
+
+    for (char c : text) {
+        uint64_t eq = _peq[static_cast<unsigned char>(c)];
+        uint64_t xv = eq | mv;
+        uint64_t xh = (((eq & pv) + pv) ^ pv) | eq;
+        uint64_t ph = mv | ~(xh | pv);
+        uint64_t mh = pv & xh;
+        if (ph & high) score++;
+        else if (mh & high) score--;
+        ph = (ph << 1) | 1;
+        mh <<= 1;
+        pv = mh | ~(xv | ph);
+        mv = ph & xv;
+    }
+    return score;
+}
+
+// Plain DP, for sequences too long for a single machine word
+static size_t _dp_distance(const std::string& a, const std::string& b) {
+    std::vector<size_t> prev(b.length() + 1), cur(b.length() + 1);
+    for (size_t jx = 0; jx <= b.length(); jx++) prev[jx] = jx;
+    for (size_t ix = 1; ix <= a.length(); ix++) {
+        cur[0] = ix;
+        for (size_t jx = 1; jx <= b.length(); jx++) {
+            size_t sub = prev[jx - 1] + (a[ix - 1] != b[jx - 1]);
+            cur[jx] = std::min({sub, prev[jx] + 1, cur[jx - 1] + 1});
+        }
+        std::swap(prev, cur);
+    }
+    return prev[b.length()];
+}
+
+size_t EditIndex::distance(const std::string& a, const std::string& b) {
+    if (a.length() <= MyersPattern::MAX_LENGTH) return MyersPattern(a).distance(b);
+    if (b.length() <= MyersPattern::MAX_LENGTH) return MyersPattern(b).distance(a);
+    return _dp_distance(a, b);
+}
+
+EditIndex::EditIndex(size_t min_distance) : _min_distance(min_distance) {
+    if (min_distance == 0) {
+        throw std::invalid_argument("The minimum edit distance must be at least 1.");
+    }
+}
+
+void EditIndex::reserve(size_t count) {
+    _sequences.reserve(count);
+    _segments.reserve(count * _min_distance);
+}
+
+uint64_t EditIndex::_segment_key(std::string_view segment, size_t length, size_t index) const {
+    uint64_t hash = std::hash<std::string_view>{}(segment);
+    uint64_t tag = (static_cast<uint64_t>(length) << 8) | index;
+    return hash ^ (tag * 0x9E3779B97F4A7C15ULL);
+}
+
+bool EditIndex::has_close(const std::string& seq) const {
+    size_t n = seq.length();
+    size_t slack = _min_distance - 1;
+
+    std::optional<MyersPattern> pattern;
+    if (n <= MyersPattern::MAX_LENGTH) pattern.emplace(seq);
+
+    // Close sequences have a length within the slack of the query
+    size_t min_length = (n > slack) ? n - slack : 0;
+    for (size_t length = min_length; length <= n + slack; length++) {
+        for (size_t segment = 0; segment < _min_distance; segment++) {
+            size_t begin = segment * length / _min_distance;
+            size_t end = (segment + 1) * length / _min_distance;
+            size_t width = end - begin;
+
+            // The untouched segment is shifted by at most the slack
+            size_t first = (begin > slack) ? begin - slack : 0;
+            for (size_t pos = first; pos <= begin + slack && pos + width <= n; pos++) {
+                uint64_t key = _segment_key(
+                    std::string_view(seq).substr(pos, width), length, segment
+                );
+                auto it = _segments.find(key);
+                if (it == _segments.end()) continue;
+                for (uint32_t id : it->second) {
+                    const std::string& other = _sequences[id];
+                    size_t d = pattern ? pattern->distance(other) : distance(seq, other);
+                    if (d < _min_distance) return true;
+                }
+            }
+        }
+    }
+    return false;
+}
+
+void EditIndex::insert(const std::string& seq) {
+    uint32_t id = static_cast<uint32_t>(_sequences.size());
+    _sequences.push_back(seq);
+    size_t length = seq.length();
+    for (size_t segment = 0; segment < _min_distance; segment++) {
+        size_t begin = segment * length / _min_distance;
+        size_t end = (segment + 1) * length / _min_distance;
+        uint64_t key = _segment_key(
+            std::string_view(seq).substr(begin, end - begin), length, segment
+        );
+        auto& ids = _segments[key];
+        // A sequence may repeat a segment key only through a hash collision
+        if (ids.empty() || ids.back() != id) ids.push_back(id);
+    }
+}
@@ -0,0 +1,67 @@
+#ifndef EDIT_INDEX_H
+#define EDIT_INDEX_H
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// A set of sequences supporting "is any sequence closer than d?" queries
+// in edit distance (substitutions, insertions and deletions).
+//
+// Each sequence is cut into d contiguous segments. If two sequences are
+// within d - 1 edits, at least one segment of the stored sequence is
+// untouched and appears verbatim in the query, shifted by at most d - 1
+// positions. Segments are hashed together with their index and the
+// length of their sequence, so a query probes each plausible length,
+// segment and shift, and only verifies the sequences found this way.
+// Verification uses Myers' bit-parallel edit distance.
+class EditIndex {
+public:
+    explicit EditIndex(size_t min_distance);
+
+    // The minimum allowed edit distance between sequences
+    size_t min_distance() const { return _min_distance; }
+
+    // Number of sequences in the index
+    size_t size() const { return _sequences.size(); }
+
+    // Pre-size the tables for the given number of sequences
+    void reserve(size_t count);
+
+    // Check if any sequence is at edit distance below min_distance()
+    bool has_close(const std::string& seq) const;
+
+    // Add a sequence, without checking its distance to the others
+    void insert(const std::string& seq);
+
+    // The edit distance between two sequences
+    static size_t distance(const std::string& a, const std::string& b);
+
+private:
+    size_t _min_distance;
+    std::vector<std::string> _sequences;
+    // From segment key to the ids of the sequences containing it
+    std::unordered_map<uint64_t, std::vector<uint32_t>> _segments;
+
+    uint64_t _segment_key(std::string_view segment, size_t length, size_t index) const;
+};
+
+// Match masks for Myers' algorithm, with bit i of a base's mask set where
+// the pattern has that base. Patterns are limited to 64 characters.
+struct MyersPattern {
+    static constexpr size_t MAX_LENGTH = 64;
+
+    explicit MyersPattern(const std::string& pattern);
+
+    // The edit distance between the pattern and the text
+    size_t distance(const std::string& text) const;
+
+private:
+    size_t _length;
+    std::array<uint64_t, 256> _peq{};
+};
+
+#endif
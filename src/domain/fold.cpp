@@ -0,0 +1,442 @@
+#include "fold.hpp"
+#include "hairpin.hpp"
+#include "sequence.hpp"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+
+// Energies are in hundredths of a kcal/mol. Unreachable states are INF,
+// small enough that a few of them add up without overflowing.
+static constexpr int32_t INF = 10'000'000;
+
+// Unpaired bases closed by a hairpin, and at most in a bulge or interior loop
+static constexpr size_t MIN_HAIRPIN = 3;
+static constexpr size_t MAX_LOOP = 6;
+
+// Multiloop closing, per branch and per unpaired base
+static constexpr int32_t ML_CLOSING = 340;
+static constexpr int32_t ML_INTERN = 40;
+static constexpr int32_t ML_BASE = 0;
+
+// Penalty for an AU or GU pair ending a helix
+static constexpr int32_t TERMINAL_AU = 50;
+
+// Flat terminal mismatch bonus of hairpin loops longer than three
+static constexpr int32_t HAIRPIN_MISMATCH = -80;
+
+// Bulges and interior loops by the number of unpaired bases
+static constexpr int32_t BULGE[MAX_LOOP + 1] = {0, 380, 280, 320, 360, 400, 440};
+static constexpr int32_t INTERIOR[MAX_LOOP + 1] = {0, 0, 50, 160, 110, 200, 200};
+static constexpr int32_t INTERIOR_ASYMMETRY = 60;
+static constexpr int32_t MAX_ASYMMETRY = 300;
+static constexpr int32_t INTERIOR_AU = 70;
+
+// Pair types, read 5' to 3' from the first base of the pair
+enum PairType : uint8_t { NP, AU, CG, GC, UA, GU, UG, PAIR_TYPES };
+
+// A, C, G, T or U, and anything else
+static constexpr uint8_t UNPAIRABLE = 4;
+
+static constexpr uint8_t PAIR_TYPE[5][5] = {
+    //  A   C   G   U   N
+    {NP, NP, NP, AU, NP},  // A
+    {NP, NP, CG, NP, NP},  // C
+    {NP, GC, NP, GU, NP},  // G
+    {UA, NP, UG, NP, NP},  // U
+    {NP, NP, NP, NP, NP},  // N
+};
+
+// Stacking of an outer pair on the pair inside it. Watson-Crick stacks are
+// the Turner 2004 values; stacks with a GU pair are flat approximations.
+static constexpr int32_t STACK[PAIR_TYPES][PAIR_TYPES] = {
+    //       NP    AU    CG    GC    UA    GU    UG
+    /* NP */ {0,    0,    0,    0,    0,    0,    0},
+    /* AU */ {0,  -93, -224, -208, -110,  -60,  -60},
+    /* CG */ {0, -211, -326, -236, -208, -130, -130},
+    /* GC */ {0, -235, -342, -326, -224, -130, -130},
+    /* UA */ {0, -133, -235, -211,  -93,  -60,  -60},
+    /* GU */ {0,  -60, -130, -130,  -60,  -50,  -50},
+    /* UG */ {0,  -60, -130, -130,  -60,  -50,  -50},
+};
+
+static constexpr uint8_t _code_of(char c) {
+    switch (c) {
+        case 'A': case 'a': return 0;
+        case 'C': case 'c': return 1;
+        case 'G': case 'g': return 2;
+        case 'T': case 't': case 'U': case 'u': return 3;
+        default: return UNPAIRABLE;
+    }
+}
+
+static constexpr bool _weak(uint8_t type) {
+    return type == AU || type == UA || type == GU || type == UG;
+}
+
+static constexpr int32_t _terminal(uint8_t type) {
+    return _weak(type) ? TERMINAL_AU : 0;
+}
+
+// Hairpin loop initiation up to nine unpaired bases, extrapolated
+// logarithmically beyond
+static int32_t _hairpin_initiation(size_t unpaired) {
+    static constexpr int32_t INITIATION[10] = {0, 0, 0, 540, 560, 570, 540, 600, 550, 640};
+    if (unpaired <= 9) return INITIATION[unpaired];
+    return INITIATION[9] + static_cast<int32_t>(std::lround(107.85 * std::log(unpaired / 9.0)));
+}
+
+// A stack, bulge or interior loop between an outer and an inner pair, with
+// the given unpaired bases on either side
+static constexpr int32_t _loop(uint8_t outer, uint8_t inner, size_t left, size_t right) {
+    if (left == 0 && right == 0) {
+        return STACK[outer][inner];
+    }
+    if (left == 0 || right == 0) {
+        size_t bulge = left + right;
+        if (bulge == 1) return BULGE[1] + STACK[outer][inner];
+        return BULGE[bulge] + _terminal(outer) + _terminal(inner);
+    }
+    int32_t asymmetry = static_cast<int32_t>(left > right ? left - right : right - left) * INTERIOR_ASYMMETRY;
+    return INTERIOR[left + right] + std::min(asymmetry, MAX_ASYMMETRY) +
+        INTERIOR_AU * (_weak(outer) + _weak(inner));
+}
+
+// Every loop energy by outer pair, inner pair and unpaired bases on either
+// side, so that the loop search is a lookup without branches
+struct LoopTable {
+    int32_t energy[PAIR_TYPES][PAIR_TYPES][MAX_LOOP + 1][MAX_LOOP + 1];
+};
+
+static constexpr LoopTable LOOPS = []() {
+    LoopTable table{};
+    for (uint8_t outer = 0; outer < PAIR_TYPES; outer++) {
+        for (uint8_t inner = 0; inner < PAIR_TYPES; inner++) {
+            for (size_t left = 0; left <= MAX_LOOP; left++) {
+                for (size_t right = 0; left + right <= MAX_LOOP; right++) {
+                    table.energy[outer][inner][left][right] = _loop(outer, inner, left, right);
+                }
+            }
+        }
+    }
+    return table;
+}();
+
+// The best sum of two tables over a run of split points. Both runs are
+// contiguous, so the compiler vectorises the loop. A sum with an
+// unreachable side is unreachable, however low the other side.
+static inline int32_t _min_plus(const int32_t* a, const int32_t* b, size_t count) {
+    int32_t best = INF;
+    for (size_t ix = 0; ix < count; ix++) {
+        best = std::min(best, a[ix] + b[ix]);
+    }
+    return (best >= INF / 2) ? INF : best;
+}
+
+FoldEngine::FoldEngine(size_t max_span) : _max_span(max_span) {
+    if (max_span <= MIN_HAIRPIN + 1) {
+        throw std::invalid_argument(
+            "The maximum base pair span must be over " + std::to_string(MIN_HAIRPIN + 1) + " bases."
+        );
+    }
+    // No hairpin loop is as long as the span
+    _hairpins.resize(max_span);
+    for (size_t unpaired = 0; unpaired < max_span; unpaired++) {
+        _hairpins[unpaired] = _hairpin_initiation(unpaired);
+    }
+}
+
+int32_t FoldEngine::_hairpin(uint8_t type, size_t unpaired) const {
+    return _hairpins[unpaired] + ((unpaired == MIN_HAIRPIN) ? _terminal(type) : HAIRPIN_MISMATCH);
+}
+
+uint8_t FoldEngine::_type(size_t i, size_t j) const {
+    return PAIR_TYPE[_codes[i]][_codes[j]];
+}
+
+int FoldEngine::fold(std::string_view seq) {
+    size_t n = seq.size();
+    _codes.resize(n);
+    for (size_t ix = 0; ix < n; ix++) {
+        _codes[ix] = _code_of(seq[ix]);
+    }
+    _partner.assign(n, NO_PARTNER);
+    if (n == 0) return 0;
+
+    // Tables hold the pairs (i, j) with j - i up to the span, by row and,
+    // for the multiloop tables, also by column, so that both sides of a
+    // split are contiguous
+    _span = std::min(_max_span, n - 1);
+    _width = _span + 1;
+    _v.assign(n * _width, INF);
+    _wm.assign(n * _width, INF);
+    _wm_by_end.assign(n * _width, INF);
+    _f.assign(n + 1, 0);
+
+    _fill(n);
+    _traceback(n);
+    return _f[n];
+}
+
+void FoldEngine::_fill(size_t n) {
+    for (size_t i = n; i-- > 0;) {
+        size_t last = std::min(n - 1, i + _span);
+        for (size_t j = i; j <= last; j++) {
+            size_t d = j - i;
+            uint8_t type = _type(i, j);
+
+            int32_t v = INF;
+            if (type != NP && d > MIN_HAIRPIN) {
+                v = _hairpin(type, d - 1);
+
+                // Inner pairs that cannot form are INF in the table, and
+                // stay out of reach after adding any loop energy
+                for (size_t left = 0; left <= MAX_LOOP; left++) {
+                    size_t p = i + 1 + left;
+                    for (size_t right = 0; left + right <= MAX_LOOP; right++) {
+                        // The inner pair closes a hairpin of its own
+                        if (p + MIN_HAIRPIN + right + 1 >= j) break;
+                        size_t q = j - 1 - right;
+                        v = std::min(v, _v[_row(p, q)] + LOOPS.energy[type][_type(p, q)][left][right]);
+                    }
+                }
+                v = (v >= INF / 2) ? INF : v;
+
+                // Split i + 1 .. j - 1 into two runs of at least one branch each
+                int32_t branches = _min_plus(&_wm[_row(i + 1, i + 1)], &_wm_by_end[_column(i + 2, j - 1)], d - 2);
+                v = std::min(v, branches + ML_CLOSING + ML_INTERN + _terminal(type));
+            }
+            _v[_row(i, j)] = v;
+
+            int32_t wm = INF;
+            if (v < INF) {
+                wm = v + ML_INTERN + _terminal(type);
+            }
+            if (d > 0) {
+                wm = std::min({wm, _wm[_row(i + 1, j)] + ML_BASE, _wm[_row(i, j - 1)] + ML_BASE});
+                wm = std::min(wm, _min_plus(&_wm[_row(i, i)], &_wm_by_end[_column(i + 1, j)], d));
+            }
+            wm = std::min(wm, INF);
+            _wm[_row(i, j)] = wm;
+            _wm_by_end[_column(i, j)] = wm;
+        }
+    }
+
+    // Prefixes, each ending unpaired or with a helix closed by its last base
+    for (size_t j = 0; j < n; j++) {
+        int32_t best = _f[j];
+        for (size_t i = (j > _span) ? j - _span : 0; i + MIN_HAIRPIN < j; i++) {
+            int32_t v = _v[_row(i, j)];
+            if (v < INF) {
+                best = std::min(best, _f[i] + v + _terminal(_type(i, j)));
+            }
+        }
+        _f[j + 1] = best;
+    }
+}
+
+void FoldEngine::_traceback(size_t n) {
+    enum Table { F, V, WM };
+    struct State {
+        Table table;
+        size_t i;
+        size_t j;
+    };
+
+    std::vector<State> stack = {{F, 0, n}};
+    while (!stack.empty()) {
+        State s = stack.back();
+        stack.pop_back();
+
+        if (s.table == F) {
+            size_t j = s.j;
+            if (j == 0) continue;
+            if (_f[j] == _f[j - 1]) {
+                stack.push_back({F, 0, j - 1});
+                continue;
+            }
+            for (size_t i = (j - 1 > _span) ? j - 1 - _span : 0; i + MIN_HAIRPIN < j - 1; i++) {
+                int32_t v = _v[_row(i, j - 1)];
+                if (v < INF && _f[i] + v + _terminal(_type(i, j - 1)) == _f[j]) {
+                    stack.push_back({V, i, j - 1});
+                    stack.push_back({F, 0, i});
+                    break;
+                }
+            }
+            continue;
+        }
+
+        size_t i = s.i;
+        size_t j = s.j;
+        size_t d = j - i;
+        uint8_t type = _type(i, j);
+        int32_t v = _v[_row(i, j)];
+
+        if (s.table == V) {
+            _partner[i] = j;
+            _partner[j] = i;
+            if (v == _hairpin(type, d - 1)) continue;
+
+            bool found = false;
+            for (size_t p = i + 1; !found && p <= i + 1 + MAX_LOOP && p + MIN_HAIRPIN < j; p++) {
+                size_t left = p - i - 1;
+                for (size_t q = j - 1; q > p + MIN_HAIRPIN && left + (j - q - 1) <= MAX_LOOP; q--) {
+                    uint8_t inner = _type(p, q);
+                    if (inner == NP || _v[_row(p, q)] >= INF) continue;
+                    if (_v[_row(p, q)] + _loop(type, inner, left, j - q - 1) == v) {
+                        stack.push_back({V, p, q});
+                        found = true;
+                        break;
+                    }
+                }
+            }
+            if (found) continue;
+
+            int32_t branches = v - ML_CLOSING - ML_INTERN - _terminal(type);
+            for (size_t k = i + 1; k + 1 < j; k++) {
+                if (_wm[_row(i + 1, k)] + _wm[_row(k + 1, j - 1)] == branches) {
+                    stack.push_back({WM, i + 1, k});
+                    stack.push_back({WM, k + 1, j - 1});
+                    break;
+                }
+            }
+            continue;
+        }
+
+        int32_t wm = _wm[_row(i, j)];
+        if (v < INF && v + ML_INTERN + _terminal(type) == wm) {
+            stack.push_back({V, i, j});
+        } else if (d > 0 && _wm[_row(i + 1, j)] + ML_BASE == wm) {
+            stack.push_back({WM, i + 1, j});
+        } else if (d > 0 && _wm[_row(i, j - 1)] + ML_BASE == wm) {
+            stack.push_back({WM, i, j - 1});
+        } else {
+            for (size_t k = i; k < j; k++) {
+                if (_wm[_row(i, k)] + _wm[_row(k + 1, j)] == wm) {
+                    stack.push_back({WM, i, k});
+                    stack.push_back({WM, k + 1, j});
+                    break;
+                }
+            }
+        }
+    }
+}
+
+std::optional<int> FoldEngine::energy(std::string_view seq, const std::vector<size_t>& partners) const {
+    size_t n = seq.size();
+    auto type = [&](size_t i, size_t j) {
+        return PAIR_TYPE[_code_of(seq[i])][_code_of(seq[j])];
+    };
+
+    // The pairs directly inside each loop, from the exterior loop inwards
+    int32_t total = 0;
+    struct Loop {
+        size_t i;
+        size_t j;
+    };
+    std::vector<Loop> loops = {{NO_PARTNER, n}};
+    std::vector<Loop> branches;
+    while (!loops.empty()) {
+        Loop loop = loops.back();
+        loops.pop_back();
+        bool exterior = loop.i == NO_PARTNER;
+        size_t begin = exterior ? 0 : loop.i + 1;
+
+        branches.clear();
+        for (size_t k = begin; k < loop.j; k++) {
+            size_t partner = partners[k];
+            if (partner == NO_PARTNER) continue;
+            if (partner <= k || partner >= loop.j || partners[partner] != k) return std::nullopt;
+            if (partner - k > _max_span || type(k, partner) == NP) return std::nullopt;
+            branches.push_back({k, partner});
+            loops.push_back({k, partner});
+            k = partner;
+        }
+
+        if (exterior) {
+            for (const Loop& branch : branches) {
+                total += _terminal(type(branch.i, branch.j));
+            }
+            continue;
+        }
+
+        uint8_t closing = type(loop.i, loop.j);
+        if (branches.empty()) {
+            if (loop.j - loop.i - 1 < MIN_HAIRPIN) return std::nullopt;
+            total += _hairpin(closing, loop.j - loop.i - 1);
+        } else if (branches.size() == 1) {
+            size_t left = branches[0].i - loop.i - 1;
+            size_t right = loop.j - branches[0].j - 1;
+            if (left + right > MAX_LOOP) return std::nullopt;
+            total += _loop(closing, type(branches[0].i, branches[0].j), left, right);
+        } else {
+            total += ML_CLOSING + ML_INTERN + _terminal(closing);
+            size_t paired = 0;
+            for (const Loop& branch : branches) {
+                total += ML_INTERN + _terminal(type(branch.i, branch.j));
+                paired += branch.j - branch.i + 1;
+            }
+            total += ML_BASE * static_cast<int32_t>(loop.j - loop.i - 1 - paired);
+        }
+    }
+    return total;
+}
+
+size_t FoldEngine::formed(const Helix& helix) const {
+    size_t pairs = 0;
+    for (size_t k = 0; k < helix.length; k++) {
+        pairs += _partner[helix.five + k] == helix.three - k;
+    }
+    return pairs;
+}
+
+static bool _can_pair(char a, char b) {
+    return PAIR_TYPE[_code_of(a)][_code_of(b)] != NP;
+}
+
+// Whether a sequence is a perfect hairpin with the given stem length
+static bool _is_hairpin(std::string_view seq, size_t stem_length) {
+    if (seq.size() != Hairpin::length_for(stem_length)) return false;
+    for (size_t k = 0; k < stem_length; k++) {
+        if (!_can_pair(seq[k], seq[seq.size() - 1 - k])) return false;
+    }
+    return true;
+}
+
+void padding_helices(
+    std::string_view padding,
+    const StemConfig& config,
+    size_t offset,
+    std::vector<Helix>& out
+) {
+    size_t min_hairpin = Hairpin::length_for(config.min_length);
+    size_t pos = 0;
+    while (padding.size() - pos >= min_hairpin + config.spacer_length) {
+        size_t remaining = padding.size() - pos - config.spacer_length;
+        size_t max_stem = std::min((remaining - HAIRPIN_LOOP_LENGTH) / 2, config.max_length);
+
+        size_t stem = config.min_length;
+        for (; stem <= max_stem; stem++) {
+            size_t length = Hairpin::length_for(stem);
+            std::string_view spacer = padding.substr(pos + length, config.spacer_length);
+            if (_is_hairpin(padding.substr(pos, length), stem) &&
+                std::all_of(spacer.begin(), spacer.end(), [](char c) { return c == BASE_A; })) {
+                break;
+            }
+        }
+        if (stem > max_stem) return;
+
+        size_t length = Hairpin::length_for(stem);
+        out.push_back({offset + pos, offset + pos + length - 1, stem});
+        pos += length + config.spacer_length;
+    }
+}
+
+std::optional<Helix> hairpin_helix(std::string_view hairpin, size_t offset) {
+    if (hairpin.size() < Hairpin::length_for(1) || (hairpin.size() - HAIRPIN_LOOP_LENGTH) % 2 != 0) {
+        return std::nullopt;
+    }
+    size_t stem = (hairpin.size() - HAIRPIN_LOOP_LENGTH) / 2;
+    if (!_is_hairpin(hairpin, stem)) return std::nullopt;
+    return Helix{offset, offset + hairpin.size() - 1, stem};
+}
@@ -0,0 +1,94 @@
+#ifndef FOLD_H
+#define FOLD_H
+
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <vector>
+#include "../config/stem_config.hpp"
+
+// The stem of a designed hairpin: base five + k pairs with base three - k,
+// for k below length.
+struct Helix {
+    size_t five;
+    size_t three;
+    size_t length;
+};
+
+// A minimum free energy folding engine, for checking that padding and
+// barcode hairpins fold as designed next to the rest of a construct.
+//
+// The energy model is a reduced nearest-neighbour model: Watson-Crick
+// stacking energies, flat approximations for stacks with GU pairs, hairpin
+// loops by length, bulges and interior loops of up to six unpaired bases,
+// and a linear multiloop penalty, with no dangles or special loops. That
+// is enough to tell whether a designed stem holds against what it could
+// pair with instead, at a small fraction of the cost of a full model.
+//
+// Pairs are banded: no pair spans more than max_span bases, which bounds
+// the work per base and keeps folding linear in the sequence length. The
+// engine keeps its tables between calls, so each thread should have one.
+class FoldEngine {
+public:
+    static constexpr size_t DEFAULT_MAX_SPAN = 100;
+    static constexpr size_t NO_PARTNER = static_cast<size_t>(-1);
+
+    explicit FoldEngine(size_t max_span = DEFAULT_MAX_SPAN);
+
+    size_t max_span() const { return _max_span; }
+
+    // Fold a sequence, returning its minimum free energy in hundredths of
+    // a kcal/mol. Bases other than A, C, G, T and U, in either case, do
+    // not pair.
+    int fold(std::string_view seq);
+
+    // The base paired with each position in the last fold, or NO_PARTNER
+    size_t partner(size_t pos) const { return _partner[pos]; }
+    const std::vector<size_t>& partners() const { return _partner; }
+
+    // The number of pairs of a helix present in the last fold
+    size_t formed(const Helix& helix) const;
+
+    // The free energy of a given structure under the same model, or nothing
+    // if the model cannot form it: a pair that is not canonical, spans too
+    // far or closes too small a hairpin, or a bulge or interior loop that
+    // is too large.
+    std::optional<int> energy(std::string_view seq, const std::vector<size_t>& partners) const;
+
+private:
+    size_t _max_span;
+    size_t _span = 0;
+    size_t _width = 0;
+    std::vector<uint8_t> _codes;
+    std::vector<int32_t> _v;
+    std::vector<int32_t> _wm;
+    std::vector<int32_t> _wm_by_end;
+    std::vector<int32_t> _f;
+    std::vector<size_t> _partner;
+    std::vector<int32_t> _hairpins;
+
+    size_t _row(size_t i, size_t j) const { return i * _width + (j - i); }
+    size_t _column(size_t i, size_t j) const { return j * _width + (_span - (j - i)); }
+    uint8_t _type(size_t i, size_t j) const;
+    int32_t _hairpin(uint8_t type, size_t unpaired) const;
+
+    void _fill(size_t n);
+    void _traceback(size_t n);
+};
+
+// The stems of a padding laid out as write_padding lays it out: hairpins
+// each followed by a poly-A spacer, then disordered sequence. Positions are
+// offset by where the padding starts. Parsing stops at the first segment
+// that is not such a hairpin.
+void padding_helices(
+    std::string_view padding,
+    const StemConfig& config,
+    size_t offset,
+    std::vector<Helix>& out
+);
+
+// The stem of a sequence that is a single hairpin, such as a barcode, or
+// nothing if it is not one.
+std::optional<Helix> hairpin_helix(std::string_view hairpin, size_t offset);
+
+#endif
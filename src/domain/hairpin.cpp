@@ -2,24 +2,55 @@
 #include "sequence.hpp"
 #include "sampling.hpp"
 #include <algorithm>
+#include <array>
+#include <cstdint>
+#include <stdexcept>
 
 static const std::vector<std::string> TETRALOOPS = {"TTCG", "GTGA", "TACG"};
 
-static const std::vector<BasePair> AT_PAIRS = {
-    BasePair(BASE_A, BASE_T),
-    BasePair(BASE_T, BASE_A),
-};
+namespace {
 
-static const std::vector<BasePair> GC_PAIRS = {
-    BasePair(BASE_C, BASE_G),
-    BasePair(BASE_G, BASE_C),
+// The six base pairs, coded by their index: two AU, two GC, then two GU,
+// so that code / 2 is the pair type
+struct PairBases {
+    char five_prime;
+    char three_prime;
 };
 
-static const std::vector<BasePair> GU_PAIRS = {
-    BasePair(BASE_T, BASE_G),
-    BasePair(BASE_G, BASE_T)
+constexpr std::array<PairBases, 6> PAIRS = {{
+    {BASE_A, BASE_T},
+    {BASE_T, BASE_A},
+    {BASE_C, BASE_G},
+    {BASE_G, BASE_C},
+    {BASE_T, BASE_G},
+    {BASE_G, BASE_T},
+}};
+
+enum PairType : size_t { AU, GC, GU };
+
+// The pairs to sample from, for each combination of pair types with budget
+// left, indexed by one bit per type
+struct PairTable {
+    size_t size = 0;
+    std::array<uint8_t, PAIRS.size()> codes{};
 };
 
+constexpr std::array<PairTable, 8> PAIR_TABLES = [] {
+    std::array<PairTable, 8> tables{};
+    for (size_t mask = 0; mask < tables.size(); mask++) {
+        for (uint8_t code = 0; code < PAIRS.size(); code++) {
+            if (mask & (1u << (code / 2))) {
+                tables[mask].codes[tables[mask].size++] = code;
+            }
+        }
+    }
+    return tables;
+}();
+
+constexpr const PairTable& GC_TABLE = PAIR_TABLES[1u << GC];
+
+}
+
 bool BasePair::is_au(char b1, char b2) {
     return (b1 == BASE_A && b2 == BASE_T) || (b1 == BASE_T && b2 == BASE_A);
 }
@@ -39,74 +70,95 @@ BasePairType BasePair::type() const {
     return BasePairType::None;
 }
 
-static std::vector<BasePair> get_bp_sample_arr(bool use_au, bool use_gc, bool use_gu) {
-    std::vector<BasePair> bp_arr;
-    if (use_au) {
-        bp_arr.insert(bp_arr.end(), AT_PAIRS.begin(), AT_PAIRS.end());
-    }
-    if (use_gc) {
-        bp_arr.insert(bp_arr.end(), GC_PAIRS.begin(), GC_PAIRS.end());
-    }
-    if (use_gu) {
-        bp_arr.insert(bp_arr.end(), GU_PAIRS.begin(), GU_PAIRS.end());
-    }
-    return bp_arr;
-}
-
-static BasePair random_base_pair(std::mt19937& gen, bool use_au, bool use_gc, bool use_gu) {
-    std::vector<BasePair> bp_arr = get_bp_sample_arr(use_au, use_gc, use_gu);
-    return sample_from_vector(bp_arr, gen);
-}
-
-static void update_counts(const BasePair& pair, size_t& max_au, size_t& max_gc, size_t& max_gu) {
-    switch (pair.type()) {
-        case BasePairType::AU: max_au--; break;
-        case BasePairType::GC: max_gc--; break;
-        case BasePairType::GU: max_gu--; break;
-        case BasePairType::None: break;
-    }
+const std::vector<std::string>& Hairpin::tetraloops() {
+    return TETRALOOPS;
 }
 
 Hairpin::Hairpin(std::vector<BasePair> pairs, std::string loop)
     : _pairs(std::move(pairs)), _loop(std::move(loop)) {}
 
-Hairpin Hairpin::random(
+// The sense strand holds pair codes until the stem is shuffled, then the
+// pairs are spelled out on both strands. AU pairs are only counted against
+// their budget when the stem is long enough to run out of them, and GU
+// pairs not at all when none are allowed.
+template <bool LIMIT_AU, bool ALLOW_GU>
+static void _write_hairpin(
     size_t stem_length,
     const StemConfig& config,
-    std::mt19937& gen
+    std::mt19937& gen,
+    std::span<char> out
 ) {
-    size_t max_au = config.max_au;
-    size_t max_gc = config.max_gc;
-    size_t max_gu = config.max_gu;
-    size_t closing_gc = config.closing_gc;
-
-    std::vector<BasePair> pairs(stem_length);
+    size_t closing_gc = std::min(config.closing_gc, stem_length);
+    std::array<size_t, 3> budget = {config.max_au, config.max_gc - closing_gc, config.max_gu};
 
-    // First, add closing GC pairs
+    char* codes = out.data();
     for (size_t ix = 0; ix < closing_gc; ix++) {
-        pairs[ix] = random_base_pair(gen, false, true, false);
-        max_gc--;
+        codes[ix] = static_cast<char>(GC_TABLE.codes[sample_from_range(0, GC_TABLE.size - 1, gen)]);
     }
-
-    // Then fill the rest of the stem
     for (size_t ix = closing_gc; ix < stem_length; ix++) {
-        BasePair pair = random_base_pair(
-            gen,
-            max_au > 0,
-            max_gc > 0,
-            max_gu > 0
-        );
-        pairs[ix] = pair;
-        update_counts(pair, max_au, max_gc, max_gu);
+        size_t mask = ((!LIMIT_AU || budget[AU] > 0) ? 1u << AU : 0) |
+            ((budget[GC] > 0) ? 1u << GC : 0) |
+            ((ALLOW_GU && budget[GU] > 0) ? 1u << GU : 0);
+        const PairTable& table = PAIR_TABLES[mask];
+        if (table.size == 0) {
+            throw std::invalid_argument(
+                "The stem constraints allow no base pair at position " + std::to_string(ix + 1) +
+                " of a stem of length " + std::to_string(stem_length) + "."
+            );
+        }
+        uint8_t code = table.codes[sample_from_range(0, table.size - 1, gen)];
+        codes[ix] = static_cast<char>(code);
+        budget[code / 2]--;
     }
+    std::shuffle(codes + closing_gc, codes + stem_length, gen);
 
-    // Shuffle non-closing pairs
-    std::shuffle(pairs.begin() + closing_gc, pairs.end(), gen);
+    const std::string& loop = TETRALOOPS[sample_from_range(0, TETRALOOPS.size() - 1, gen)];
+    std::copy(loop.begin(), loop.end(), out.begin() + stem_length);
 
-    // Pick a random tetraloop
-    std::string loop = sample_from_vector(TETRALOOPS, gen);
+    char* antisense = out.data() + stem_length + HAIRPIN_LOOP_LENGTH;
+    for (size_t ix = 0; ix < stem_length; ix++) {
+        const PairBases& pair = PAIRS[static_cast<uint8_t>(codes[ix])];
+        codes[ix] = pair.five_prime;
+        antisense[stem_length - ix - 1] = pair.three_prime;
+    }
+}
 
-    return Hairpin(std::move(pairs), std::move(loop));
+void Hairpin::write_random(
+    size_t stem_length,
+    const StemConfig& config,
+    std::mt19937& gen,
+    std::span<char> out
+) {
+    if (out.size() != length_for(stem_length)) {
+        throw std::invalid_argument(
+            "A hairpin with a stem of length " + std::to_string(stem_length) + " needs " +
+            std::to_string(length_for(stem_length)) + " bases, not " + std::to_string(out.size()) + "."
+        );
+    }
+    bool limit_au = config.max_au < stem_length;
+    bool allow_gu = config.max_gu > 0;
+    if (limit_au) {
+        if (allow_gu) _write_hairpin<true, true>(stem_length, config, gen, out);
+        else _write_hairpin<true, false>(stem_length, config, gen, out);
+    } else {
+        if (allow_gu) _write_hairpin<false, true>(stem_length, config, gen, out);
+        else _write_hairpin<false, false>(stem_length, config, gen, out);
+    }
+}
+
+Hairpin Hairpin::random(
+    size_t stem_length,
+    const StemConfig& config,
+    std::mt19937& gen
+) {
+    std::string seq(length_for(stem_length), '\0');
+    write_random(stem_length, config, gen, seq);
+
+    std::vector<BasePair> pairs(stem_length);
+    for (size_t ix = 0; ix < stem_length; ix++) {
+        pairs[ix] = BasePair(seq[ix], seq[seq.size() - ix - 1]);
+    }
+    return Hairpin(std::move(pairs), seq.substr(stem_length, HAIRPIN_LOOP_LENGTH));
 }
 
 std::string Hairpin::str() const {
@@ -1,6 +1,7 @@
 #ifndef HAIRPIN_H
 #define HAIRPIN_H
 
+#include <span>
 #include <string>
 #include <vector>
 #include <random>
@@ -44,6 +45,21 @@ public:
         std::mt19937& gen
     );
 
+    // Write a random hairpin straight into a buffer of length_for(stem_length)
+    // bases, without allocating. Draws from gen exactly as random() does,
+    // so both give the same hairpin.
+    static void write_random(
+        size_t stem_length,
+        const StemConfig& config,
+        std::mt19937& gen,
+        std::span<char> out
+    );
+
+    // The length of a hairpin with the given stem length
+    static constexpr size_t length_for(size_t stem_length) {
+        return 2 * stem_length + HAIRPIN_LOOP_LENGTH;
+    }
+
     // Get the string representation (5' -> stem -> loop -> antisense stem -> 3')
     std::string str() const;
 
@@ -53,6 +69,9 @@ public:
     // Get the tetraloop sequence
     const std::string& loop() const { return _loop; }
 
+    // The tetraloops that random hairpins are capped with
+    static const std::vector<std::string>& tetraloops();
+
 private:
     std::vector<BasePair> _pairs;
     std::string _loop;
@@ -0,0 +1,88 @@
+#include "hamming_index.hpp"
+#include "hairpin.hpp"
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+
+HammingIndex::HammingIndex(size_t min_distance, bool hairpins) :
+    _min_distance(min_distance),
+    _hairpins(hairpins),
+    _segments(min_distance) {
+    if (min_distance == 0) {
+        throw std::invalid_argument("The minimum Hamming distance must be at least 1.");
+    }
+}
+
+void HammingIndex::reserve(size_t count) {
+    _sequences.reserve(count);
+    for (auto& table : _segments) {
+        table.reserve(count);
+    }
+}
+
+// Hash of one segment, mixed with the sequence length so that sequences
+// of different lengths land in different buckets. Collisions only cost
+// an extra verification.
+uint64_t HammingIndex::_segment_key(std::string_view seq, size_t segment) const {
+    size_t length = seq.length();
+    uint64_t salt = static_cast<uint64_t>(length) * 0x9E3779B97F4A7C15ULL;
+    if (_hairpins && length > HAIRPIN_LOOP_LENGTH &&
+        (length - HAIRPIN_LOOP_LENGTH) % 2 == 0) {
+        // Split the sense stem. The first segment also carries the loop,
+        // since its closing pairs are the most constrained.
+        size_t stem = (length - HAIRPIN_LOOP_LENGTH) / 2;
+        size_t begin = segment * stem / _min_distance;
+        size_t end = (segment + 1) * stem / _min_distance;
+        uint64_t hash = std::hash<std::string_view>{}(seq.substr(begin, end - begin));
+        if (segment == 0) {
+            uint64_t loop = std::hash<std::string_view>{}(seq.substr(stem, HAIRPIN_LOOP_LENGTH));
+            hash ^= loop + 0x9E3779B97F4A7C15ULL + (hash << 6) + (hash >> 2);
+        }
+        return hash ^ salt;
+    }
+    size_t begin = segment * length / _min_distance;
+    size_t end = (segment + 1) * length / _min_distance;
+    uint64_t hash = std::hash<std::string_view>{}(seq.substr(begin, end - begin));
+    return hash ^ salt;
+}
+
+bool HammingIndex::_is_close(const std::string& a, const std::string& b) const {
+    if (a.length() != b.length()) return false;
+    size_t mismatches = 0;
+    for (size_t ix = 0; ix < a.length(); ix++) {
+        if (a[ix] != b[ix] && ++mismatches >= _min_distance) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool HammingIndex::has_close(const std::string& seq) const {
+    for (size_t segment = 0; segment < _min_distance; segment++) {
+        const auto& table = _segments[segment];
+        auto it = table.find(_segment_key(seq, segment));
+        if (it == table.end()) continue;
+        for (uint32_t id : it->second) {
+            if (_is_close(seq, _sequences[id])) return true;
+        }
+    }
+    return false;
+}
+
+size_t HammingIndex::largest_bucket() const {
+    size_t largest = 0;
+    for (const auto& table : _segments) {
+        for (const auto& [key, ids] : table) {
+            largest = std::max(largest, ids.size());
+        }
+    }
+    return largest;
+}
+
+void HammingIndex::insert(const std::string& seq) {
+    uint32_t id = static_cast<uint32_t>(_sequences.size());
+    _sequences.push_back(seq);
+    for (size_t segment = 0; segment < _min_distance; segment++) {
+        _segments[segment][_segment_key(seq, segment)].push_back(id);
+    }
+}
@@ -0,0 +1,61 @@
+#ifndef HAMMING_INDEX_H
+#define HAMMING_INDEX_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// A set of sequences supporting "is any sequence closer than d?" queries
+// over all substitutions, using pigeonhole multi-index hashing.
+//
+// Each sequence is cut into d contiguous segments. Two sequences of the
+// same length at Hamming distance below d differ in at most d - 1
+// segments, so at least one segment matches exactly. Each segment is
+// hashed into its own table, and a query only verifies the sequences
+// that share a segment with it, which keeps both insert and query
+// sublinear in the size of the set. Sequences of different lengths are
+// never considered close.
+//
+// With hairpins set, sequences shaped like a hairpin are only cut along
+// their free positions: the sense stem, with the tetraloop as one extra
+// unit on the first segment. The antisense stem mostly mirrors the sense
+// stem and the loop has only a few values, so segments over the whole
+// string would share buckets far more often. Distance over a subset of
+// positions never exceeds the full distance, so the pigeonhole still
+// holds for any sequence.
+class HammingIndex {
+public:
+    explicit HammingIndex(size_t min_distance, bool hairpins = false);
+
+    // The minimum allowed distance between sequences
+    size_t min_distance() const { return _min_distance; }
+
+    // Number of sequences in the index
+    size_t size() const { return _sequences.size(); }
+
+    // Pre-size the tables for the given number of sequences
+    void reserve(size_t count);
+
+    // Check if any sequence is at Hamming distance below min_distance()
+    bool has_close(const std::string& seq) const;
+
+    // Add a sequence, without checking its distance to the others
+    void insert(const std::string& seq);
+
+    // Number of sequences in the fullest bucket of any segment
+    size_t largest_bucket() const;
+
+private:
+    size_t _min_distance;
+    bool _hairpins;
+    std::vector<std::string> _sequences;
+    // One table per segment, from segment hash to sequence ids
+    std::vector<std::unordered_map<uint64_t, std::vector<uint32_t>>> _segments;
+
+    uint64_t _segment_key(std::string_view seq, size_t segment) const;
+    bool _is_close(const std::string& a, const std::string& b) const;
+};
+
+#endif
@@ -0,0 +1,141 @@
+#include "kmer_screen.hpp"
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+// Never a canonical key: all-T packs to all ones, and its reverse
+// complement all-A is smaller
+static constexpr uint64_t EMPTY = UINT64_MAX;
+
+static constexpr size_t INITIAL_SLOTS = 1024;
+
+// The table grows past three quarters full
+static inline bool _over_loaded(size_t keys, size_t slots) {
+    return 4 * keys > 3 * slots;
+}
+
+// Bloom filter bits per table slot. The table is at most three quarters
+// full, so this is over 10 bits per key.
+static constexpr size_t BLOOM_BITS_PER_SLOT = 8;
+static constexpr size_t BLOOM_PROBES = 3;
+
+static inline uint64_t _mix(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+// Probe positions by double hashing on the two halves of one hash
+static inline uint64_t _bloom_bit(uint64_t hash, size_t probe) {
+    return (hash & 0xffffffffULL) + probe * ((hash >> 32) | 1);
+}
+
+static inline int _code(char base) {
+    switch (base) {
+        case 'A': return 0;
+        case 'C': return 1;
+        case 'G': return 2;
+        case 'T':
+        case 'U': return 3;
+        default: return -1;
+    }
+}
+
+KmerScreen::KmerScreen(size_t k) : _k(k) {
+    if (k == 0 || k > MAX_K) {
+        throw std::invalid_argument(
+            "The k-mer length must be between 1 and " + std::to_string(MAX_K) + "."
+        );
+    }
+    _slots.assign(INITIAL_SLOTS, EMPTY);
+    _bloom.assign(INITIAL_SLOTS * BLOOM_BITS_PER_SLOT / 64, 0);
+}
+
+template <typename Visit>
+bool KmerScreen::_for_each(std::string_view seq, Visit visit) const {
+    uint64_t mask = (_k == 32) ? UINT64_MAX : (1ULL << (2 * _k)) - 1;
+    size_t shift = 2 * (_k - 1);
+    uint64_t forward = 0;
+    uint64_t reverse = 0;
+    size_t valid = 0;
+    for (char base : seq) {
+        int code = _code(base);
+        if (code < 0) {
+            valid = 0;
+            continue;
+        }
+        forward = ((forward << 2) | static_cast<uint64_t>(code)) & mask;
+        reverse = (reverse >> 2) | (static_cast<uint64_t>(3 - code) << shift);
+        if (++valid >= _k && visit(std::min(forward, reverse))) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void KmerScreen::_rehash(size_t slots) {
+    std::vector<uint64_t> old = std::move(_slots);
+    _slots.assign(slots, EMPTY);
+    _bloom.assign(_slots.size() * BLOOM_BITS_PER_SLOT / 64, 0);
+    _size = 0;
+    for (uint64_t key : old) {
+        if (key != EMPTY) _insert(key);
+    }
+}
+
+void KmerScreen::_insert(uint64_t key) {
+    uint64_t hash = _mix(key);
+    size_t mask = _slots.size() - 1;
+    size_t slot = hash & mask;
+    while (_slots[slot] != EMPTY) {
+        if (_slots[slot] == key) return;
+        slot = (slot + 1) & mask;
+    }
+    _slots[slot] = key;
+    _size++;
+
+    uint64_t bloom = _mix(hash);
+    size_t mask_bits = _bloom.size() * 64 - 1;
+    for (size_t probe = 0; probe < BLOOM_PROBES; probe++) {
+        size_t bit = _bloom_bit(bloom, probe) & mask_bits;
+        _bloom[bit / 64] |= 1ULL << (bit % 64);
+    }
+}
+
+bool KmerScreen::_contains(uint64_t key) const {
+    uint64_t hash = _mix(key);
+    uint64_t bloom = _mix(hash);
+    size_t mask_bits = _bloom.size() * 64 - 1;
+    for (size_t probe = 0; probe < BLOOM_PROBES; probe++) {
+        size_t bit = _bloom_bit(bloom, probe) & mask_bits;
+        if (!(_bloom[bit / 64] & (1ULL << (bit % 64)))) return false;
+    }
+
+    size_t mask = _slots.size() - 1;
+    for (size_t slot = hash & mask; _slots[slot] != EMPTY; slot = (slot + 1) & mask) {
+        if (_slots[slot] == key) return true;
+    }
+    return false;
+}
+
+void KmerScreen::reserve(size_t count) {
+    size_t slots = _slots.size();
+    while (_over_loaded(count, slots)) slots *= 2;
+    if (slots > _slots.size()) _rehash(slots);
+}
+
+void KmerScreen::add(std::string_view seq) {
+    _for_each(seq, [&](uint64_t key) {
+        if (_over_loaded(_size + 1, _slots.size())) _rehash(2 * _slots.size());
+        _insert(key);
+        return false;
+    });
+}
+
+bool KmerScreen::hits(std::string_view seq) const {
+    if (_size == 0) return false;
+    return _for_each(seq, [&](uint64_t key) { return _contains(key); });
+}
@@ -0,0 +1,55 @@
+#ifndef KMER_SCREEN_H
+#define KMER_SCREEN_H
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+// The k-mers of a set of sequences, for screening barcode and padding
+// candidates against the designs and constant regions of a library.
+//
+// Each k-mer is packed at 2 bits per base and stored in canonical form,
+// the smaller of the k-mer and its reverse complement, so a candidate hits
+// whether it shares a k-mer with either strand. Keys live in an
+// open-addressing table, fronted by a Bloom filter of over 10 bits per key
+// that rejects nearly all misses without touching the table. Bases other than
+// A, C, G, T and U break the k-mers that span them.
+class KmerScreen {
+public:
+    static constexpr size_t MAX_K = 32;
+
+    explicit KmerScreen(size_t k);
+
+    // The k-mer length
+    size_t k() const { return _k; }
+
+    // Number of distinct canonical k-mers
+    size_t size() const { return _size; }
+    bool empty() const { return _size == 0; }
+
+    // Pre-size the table for the given number of k-mers
+    void reserve(size_t count);
+
+    // Add every k-mer of a sequence
+    void add(std::string_view seq);
+
+    // Check if the sequence shares any k-mer with the screen
+    bool hits(std::string_view seq) const;
+
+private:
+    size_t _k;
+    std::vector<uint64_t> _slots;
+    std::vector<uint64_t> _bloom;
+    size_t _size = 0;
+
+    void _rehash(size_t slots);
+    void _insert(uint64_t key);
+    bool _contains(uint64_t key) const;
+
+    // Call visit(key) on each canonical k-mer of the sequence, stopping
+    // early if it returns true. Returns whether it stopped early.
+    template <typename Visit>
+    bool _for_each(std::string_view seq, Visit visit) const;
+};
+
+#endif
@@ -0,0 +1,198 @@
+#include "nucleotide_kernels.hpp"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+
+#if defined(__AVX2__) || defined(__SSE4_1__)
+#include <immintrin.h>
+#endif
+
+static constexpr uint8_t CASE_BIT = 0x20;
+
+// The base each low nibble stands for. Unused nibbles hold a byte with a
+// different low nibble, which no input can equal.
+static constexpr std::array<char, 16> BASES = [] {
+    std::array<char, 16> table{};
+    for (size_t nibble = 0; nibble < 16; nibble++) {
+        table[nibble] = static_cast<char>(nibble == 0x0F ? 0x00 : 0xFF);
+    }
+    for (char base : {BASE_A, BASE_C, BASE_G, BASE_T, BASE_U}) {
+        table[base & 0x0F] = base;
+    }
+    return table;
+}();
+
+static constexpr std::array<char, 16> _complements(char complement_of_a) {
+    std::array<char, 16> table{};
+    table[BASE_A & 0x0F] = complement_of_a;
+    table[BASE_C & 0x0F] = BASE_G;
+    table[BASE_G & 0x0F] = BASE_C;
+    table[BASE_T & 0x0F] = BASE_A;
+    table[BASE_U & 0x0F] = BASE_A;
+    return table;
+}
+
+static constexpr std::array<char, 16> DNA_COMPLEMENTS = _complements(BASE_T);
+static constexpr std::array<char, 16> RNA_COMPLEMENTS = _complements(BASE_U);
+
+static inline bool _is_base(char c) {
+    return BASES[c & 0x0F] == c;
+}
+
+static inline char _lower(char c) {
+    return static_cast<char>(c | CASE_BIT);
+}
+
+//
+// One vector register of bases, for whichever instruction set the build
+// targets
+//
+
+#if defined(__AVX2__)
+
+namespace {
+struct Lanes {
+    using Reg = __m256i;
+    static constexpr size_t WIDTH = 32;
+    static constexpr uint32_t ALL = 0xFFFFFFFFu;
+
+    static Reg load(const char* ptr) { return _mm256_loadu_si256(reinterpret_cast<const Reg*>(ptr)); }
+    static void store(char* ptr, Reg reg) { _mm256_storeu_si256(reinterpret_cast<Reg*>(ptr), reg); }
+    static Reg splat(char c) { return _mm256_set1_epi8(c); }
+    static Reg table(const std::array<char, 16>& entries) {
+        return _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(entries.data())));
+    }
+    static Reg lookup(Reg table, Reg reg) { return _mm256_shuffle_epi8(table, _mm256_and_si256(reg, splat(0x0F))); }
+    static Reg eq(Reg a, Reg b) { return _mm256_cmpeq_epi8(a, b); }
+    static Reg either(Reg a, Reg b) { return _mm256_or_si256(a, b); }
+    static Reg select(Reg mask, Reg yes, Reg no) { return _mm256_blendv_epi8(no, yes, mask); }
+    static uint32_t bits(Reg mask) { return static_cast<uint32_t>(_mm256_movemask_epi8(mask)); }
+};
+}
+#define HAVE_LANES 1
+
+#elif defined(__SSE4_1__)
+
+namespace {
+struct Lanes {
+    using Reg = __m128i;
+    static constexpr size_t WIDTH = 16;
+    static constexpr uint32_t ALL = 0xFFFFu;
+
+    static Reg load(const char* ptr) { return _mm_loadu_si128(reinterpret_cast<const Reg*>(ptr)); }
+    static void store(char* ptr, Reg reg) { _mm_storeu_si128(reinterpret_cast<Reg*>(ptr), reg); }
+    static Reg splat(char c) { return _mm_set1_epi8(c); }
+    static Reg table(const std::array<char, 16>& entries) {
+        return _mm_loadu_si128(reinterpret_cast<const Reg*>(entries.data()));
+    }
+    static Reg lookup(Reg table, Reg reg) { return _mm_shuffle_epi8(table, _mm_and_si128(reg, splat(0x0F))); }
+    static Reg eq(Reg a, Reg b) { return _mm_cmpeq_epi8(a, b); }
+    static Reg either(Reg a, Reg b) { return _mm_or_si128(a, b); }
+    static Reg select(Reg mask, Reg yes, Reg no) { return _mm_blendv_epi8(no, yes, mask); }
+    static uint32_t bits(Reg mask) { return static_cast<uint32_t>(_mm_movemask_epi8(mask)); }
+};
+}
+#define HAVE_LANES 1
+
+#endif
+
+void replace_base_in_place(std::span<char> seq, char from, char to) {
+    size_t ix = 0;
+#ifdef HAVE_LANES
+    const Lanes::Reg from_upper = Lanes::splat(from);
+    const Lanes::Reg from_lower = Lanes::splat(_lower(from));
+    const Lanes::Reg to_upper = Lanes::splat(to);
+    const Lanes::Reg to_lower = Lanes::splat(_lower(to));
+    for (; ix + Lanes::WIDTH <= seq.size(); ix += Lanes::WIDTH) {
+        Lanes::Reg reg = Lanes::load(seq.data() + ix);
+        reg = Lanes::select(Lanes::eq(reg, from_upper), to_upper, reg);
+        reg = Lanes::select(Lanes::eq(reg, from_lower), to_lower, reg);
+        Lanes::store(seq.data() + ix, reg);
+    }
+#endif
+    for (; ix < seq.size(); ix++) {
+        if (seq[ix] == from) seq[ix] = to;
+        else if (seq[ix] == _lower(from)) seq[ix] = _lower(to);
+    }
+}
+
+void complement_in_place(std::span<char> seq, Alphabet alphabet) {
+    const std::array<char, 16>& complements =
+        (alphabet == Alphabet::RNA) ? RNA_COMPLEMENTS : DNA_COMPLEMENTS;
+    size_t ix = 0;
+#ifdef HAVE_LANES
+    const Lanes::Reg bases = Lanes::table(BASES);
+    const Lanes::Reg table = Lanes::table(complements);
+    const Lanes::Reg unknown = Lanes::splat('N');
+    for (; ix + Lanes::WIDTH <= seq.size(); ix += Lanes::WIDTH) {
+        Lanes::Reg reg = Lanes::load(seq.data() + ix);
+        Lanes::Reg valid = Lanes::eq(reg, Lanes::lookup(bases, reg));
+        Lanes::store(seq.data() + ix, Lanes::select(valid, Lanes::lookup(table, reg), unknown));
+    }
+#endif
+    for (; ix < seq.size(); ix++) {
+        seq[ix] = _is_base(seq[ix]) ? complements[seq[ix] & 0x0F] : 'N';
+    }
+}
+
+void reverse_complement_in_place(std::span<char> seq, Alphabet alphabet) {
+    complement_in_place(seq, alphabet);
+    std::reverse(seq.begin(), seq.end());
+}
+
+size_t find_polybase(std::string_view seq) {
+    size_t ix = 0;
+#ifdef HAVE_LANES
+    const Lanes::Reg bases = Lanes::table(BASES);
+    for (; ix + Lanes::WIDTH <= seq.size(); ix += Lanes::WIDTH) {
+        Lanes::Reg reg = Lanes::load(seq.data() + ix);
+        uint32_t valid = Lanes::bits(Lanes::eq(reg, Lanes::lookup(bases, reg)));
+        if (valid != Lanes::ALL) {
+            return ix + std::countr_one(valid);
+        }
+    }
+#endif
+    for (; ix < seq.size(); ix++) {
+        if (!_is_base(seq[ix])) return ix;
+    }
+    return std::string_view::npos;
+}
+
+size_t find_base(std::string_view seq, char base) {
+    size_t ix = 0;
+#ifdef HAVE_LANES
+    const Lanes::Reg case_bit = Lanes::splat(CASE_BIT);
+    const Lanes::Reg lower = Lanes::splat(_lower(base));
+    for (; ix + Lanes::WIDTH <= seq.size(); ix += Lanes::WIDTH) {
+        Lanes::Reg reg = Lanes::either(Lanes::load(seq.data() + ix), case_bit);
+        uint32_t found = Lanes::bits(Lanes::eq(reg, lower));
+        if (found != 0) {
+            return ix + std::countr_zero(found);
+        }
+    }
+#endif
+    for (; ix < seq.size(); ix++) {
+        if (_lower(seq[ix]) == _lower(base)) return ix;
+    }
+    return std::string_view::npos;
+}
+
+size_t count_gc(std::string_view seq) {
+    size_t count = 0;
+    size_t ix = 0;
+#ifdef HAVE_LANES
+    const Lanes::Reg case_bit = Lanes::splat(CASE_BIT);
+    const Lanes::Reg g = Lanes::splat(_lower(BASE_G));
+    const Lanes::Reg c = Lanes::splat(_lower(BASE_C));
+    for (; ix + Lanes::WIDTH <= seq.size(); ix += Lanes::WIDTH) {
+        Lanes::Reg reg = Lanes::either(Lanes::load(seq.data() + ix), case_bit);
+        count += std::popcount(Lanes::bits(Lanes::either(Lanes::eq(reg, g), Lanes::eq(reg, c))));
+    }
+#endif
+    for (; ix < seq.size(); ix++) {
+        char lower = _lower(seq[ix]);
+        count += (lower == _lower(BASE_G) || lower == _lower(BASE_C));
+    }
+    return count;
+}
@@ -0,0 +1,37 @@
+#ifndef NUCLEOTIDE_KERNELS_H
+#define NUCLEOTIDE_KERNELS_H
+
+#include "sequence.hpp"
+#include <span>
+#include <string_view>
+
+// Whole-sequence nucleotide kernels, for the transforms that touch every
+// base of every file.
+//
+// Bases are told apart by their low nibble, which differs across A, C, G, T
+// and U, so one 16-entry table lookup classifies or complements a whole
+// vector of them. With AVX2 the kernels take 32 bases a step, with SSE4.1
+// 16, and the tail, or every base on other targets, goes through the same
+// tables one at a time, so all paths give the same result.
+
+// Replace a base with another throughout, in either case, keeping the case.
+void replace_base_in_place(std::span<char> seq, char from, char to);
+
+// Complement every base, writing A as T or U according to the alphabet.
+// Anything other than upper-case A, C, G, T and U becomes N.
+void complement_in_place(std::span<char> seq, Alphabet alphabet);
+
+// Complement and reverse, as above.
+void reverse_complement_in_place(std::span<char> seq, Alphabet alphabet);
+
+// The position of the first character other than upper-case A, C, G, T and
+// U, such as an IUPAC polybase code, or npos if there is none.
+size_t find_polybase(std::string_view seq);
+
+// The position of the first occurrence of a base in either case, or npos.
+size_t find_base(std::string_view seq, char base);
+
+// The number of G and C bases, in either case.
+size_t count_gc(std::string_view seq);
+
+#endif
@@ -0,0 +1,244 @@
+#include "packed_sequence.hpp"
+#include "nucleotide_kernels.hpp"
+#include <algorithm>
+#include <bit>
+#include <limits>
+#include <stdexcept>
+
+static constexpr size_t BASES_PER_WORD = 32;
+
+// The low bit of every two-bit code
+static constexpr uint64_t LOW_BITS = 0x5555555555555555ULL;
+
+static constexpr char DNA_LETTERS[4] = {BASE_A, BASE_C, BASE_G, BASE_T};
+static constexpr char RNA_LETTERS[4] = {BASE_A, BASE_C, BASE_G, BASE_U};
+
+// Bits 1 and 2 of A, C, G, T and U differ just enough that their xor is
+// the code of the base, with T and U alike
+static inline uint64_t _code_of(char c) {
+    return static_cast<uint64_t>((c >> 1) ^ (c >> 2)) & 3;
+}
+
+static inline size_t _shift(size_t pos) {
+    return 2 * (BASES_PER_WORD - 1 - pos % BASES_PER_WORD);
+}
+
+static inline char _lower(char c) {
+    return static_cast<char>(c | 0x20);
+}
+
+// Bases compare alike if they are equal or both T or U, in the same case
+static inline char _canonical(char c) {
+    if (c == BASE_U) return BASE_T;
+    if (c == _lower(BASE_U)) return _lower(BASE_T);
+    return c;
+}
+
+static inline uint64_t _mix(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xBF58476D1CE4E5B9ULL;
+    x ^= x >> 27;
+    x *= 0x94D049BB133111EBULL;
+    x ^= x >> 31;
+    return x;
+}
+
+static inline size_t _find_from(std::string_view seq, size_t from, size_t found) {
+    return (found == std::string_view::npos) ? found : from + found;
+}
+
+PackedSequence::PackedSequence(std::string_view seq) {
+    if (seq.size() > std::numeric_limits<uint32_t>::max()) {
+        throw std::length_error("Sequence too long to pack: " + std::to_string(seq.size()) + " bases.");
+    }
+    _length = static_cast<uint32_t>(seq.size());
+    _alphabet = (seq.find(BASE_U) != std::string_view::npos) ? Alphabet::RNA : Alphabet::DNA;
+
+    _words.assign((seq.size() + BASES_PER_WORD - 1) / BASES_PER_WORD, 0);
+    for (size_t word = 0; word < _words.size(); word++) {
+        size_t begin = word * BASES_PER_WORD;
+        size_t end = std::min(begin + BASES_PER_WORD, seq.size());
+        uint64_t bits = 0;
+        for (size_t ix = begin; ix < end; ix++) {
+            bits = (bits << 2) | _code_of(seq[ix]);
+        }
+        _words[word] = bits << (2 * (BASES_PER_WORD - (end - begin)));
+    }
+
+    // Move anything that is not a base of the alphabet to the side channel
+    char foreign = (_alphabet == Alphabet::RNA) ? BASE_T : BASE_U;
+    size_t polybase = find_polybase(seq);
+    size_t other = seq.find(foreign);
+    while (polybase != std::string_view::npos || other != std::string_view::npos) {
+        size_t pos = std::min(polybase, other);
+        _degenerate.push_back({static_cast<uint32_t>(pos), seq[pos]});
+        _words[pos / BASES_PER_WORD] &= ~(3ULL << _shift(pos));
+        if (pos == polybase) {
+            polybase = _find_from(seq, pos + 1, find_polybase(seq.substr(pos + 1)));
+        }
+        if (pos == other) {
+            other = seq.find(foreign, pos + 1);
+        }
+    }
+}
+
+PackedSequence::PackedSequence(const Sequence& seq) : PackedSequence(std::string_view(seq.str())) {}
+
+uint64_t PackedSequence::_code(size_t pos) const {
+    return (_words[pos / BASES_PER_WORD] >> _shift(pos)) & 3;
+}
+
+char PackedSequence::_base(size_t pos) const {
+    auto it = std::lower_bound(_degenerate.begin(), _degenerate.end(), pos,
+        [](const Degenerate& d, size_t p) { return d.position < p; });
+    if (it != _degenerate.end() && it->position == pos) {
+        return it->base;
+    }
+    const char* letters = (_alphabet == Alphabet::RNA) ? RNA_LETTERS : DNA_LETTERS;
+    return letters[_code(pos)];
+}
+
+char PackedSequence::operator[](size_t pos) const {
+    return _base(pos);
+}
+
+std::string PackedSequence::str() const {
+    std::string out;
+    append_to(out);
+    return out;
+}
+
+void PackedSequence::append_to(std::string& out, size_t pos, size_t count) const {
+    if (pos > _length) {
+        throw std::out_of_range("Position " + std::to_string(pos) + " is past the end of a sequence of length " +
+            std::to_string(_length) + ".");
+    }
+    count = std::min<size_t>(count, _length - pos);
+    size_t start = out.size();
+    out.resize(start + count);
+    char* dest = out.data() + start;
+
+    const char* letters = (_alphabet == Alphabet::RNA) ? RNA_LETTERS : DNA_LETTERS;
+    size_t ix = pos;
+    size_t end = pos + count;
+    while (ix < end) {
+        uint64_t bits = _words[ix / BASES_PER_WORD] << (2 * (ix % BASES_PER_WORD));
+        size_t stop = std::min(end, (ix / BASES_PER_WORD + 1) * BASES_PER_WORD);
+        for (; ix < stop; ix++) {
+            *dest++ = letters[bits >> 62];
+            bits <<= 2;
+        }
+    }
+
+    auto it = std::lower_bound(_degenerate.begin(), _degenerate.end(), pos,
+        [](const Degenerate& d, size_t p) { return d.position < p; });
+    for (; it != _degenerate.end() && it->position < end; ++it) {
+        out[start + it->position - pos] = it->base;
+    }
+}
+
+Sequence PackedSequence::to_sequence() const {
+    return Sequence(str());
+}
+
+PackedSequence PackedSequence::to_dna() const {
+    return _converted(Alphabet::DNA);
+}
+
+PackedSequence PackedSequence::to_rna() const {
+    return _converted(Alphabet::RNA);
+}
+
+// Rewrite the T or U of the other alphabet throughout. Side channel bases
+// that become the native base of the alphabet move back into the words.
+PackedSequence PackedSequence::_converted(Alphabet alphabet) const {
+    char native = (alphabet == Alphabet::RNA) ? BASE_U : BASE_T;
+    char from = (alphabet == Alphabet::RNA) ? BASE_T : BASE_U;
+
+    PackedSequence result;
+    result._length = _length;
+    result._words = _words;
+    for (Degenerate d : _degenerate) {
+        if (d.base == from) d.base = native;
+        else if (d.base == _lower(from)) d.base = _lower(native);
+
+        if (d.base == native) {
+            result._words[d.position / BASES_PER_WORD] |= 3ULL << _shift(d.position);
+        } else {
+            result._degenerate.push_back(d);
+        }
+    }
+
+    // A sequence is RNA only if it has a U, which in the words is code 3
+    bool has_u = false;
+    if (alphabet == Alphabet::RNA) {
+        for (uint64_t word : result._words) {
+            has_u = has_u || (word & (word >> 1) & LOW_BITS) != 0;
+        }
+    }
+    result._alphabet = has_u ? Alphabet::RNA : Alphabet::DNA;
+    return result;
+}
+
+PackedSequence PackedSequence::replace_polybases(std::mt19937& gen) const {
+    return PackedSequence(::replace_polybases(str(), gen));
+}
+
+size_t PackedSequence::hamming_distance(const PackedSequence& other) const {
+    if (_length != other._length) {
+        throw std::invalid_argument("Hamming distance between sequences of different lengths (" +
+            std::to_string(_length) + " and " + std::to_string(other._length) + ").");
+    }
+
+    // A base differs if either bit of its code does
+    size_t distance = 0;
+    for (size_t word = 0; word < _words.size(); word++) {
+        uint64_t diff = _words[word] ^ other._words[word];
+        distance += std::popcount((diff | (diff >> 1)) & LOW_BITS);
+    }
+
+    // Side channel positions of either sequence were counted by their
+    // placeholder codes; count them again by their bases
+    auto ours = _degenerate.begin();
+    auto theirs = other._degenerate.begin();
+    while (ours != _degenerate.end() || theirs != other._degenerate.end()) {
+        size_t pos;
+        if (theirs == other._degenerate.end() ||
+            (ours != _degenerate.end() && ours->position <= theirs->position)) {
+            pos = ours->position;
+        } else {
+            pos = theirs->position;
+        }
+        if (ours != _degenerate.end() && ours->position == pos) ++ours;
+        if (theirs != other._degenerate.end() && theirs->position == pos) ++theirs;
+
+        bool counted = _code(pos) != other._code(pos);
+        bool differs = _canonical(_base(pos)) != _canonical(other._base(pos));
+        distance = distance + differs - counted;
+    }
+    return distance;
+}
+
+std::strong_ordering PackedSequence::operator<=>(const PackedSequence& other) const {
+    // Codes are in alphabetical order and the unused bits of the last word
+    // are zero, so the words order plain sequences of one alphabet as their
+    // strings would, with a prefix first
+    if (_degenerate.empty() && other._degenerate.empty() && _alphabet == other._alphabet) {
+        auto order = std::lexicographical_compare_three_way(
+            _words.begin(), _words.end(), other._words.begin(), other._words.end());
+        if (order != 0) return order;
+        return _length <=> other._length;
+    }
+    return str() <=> other.str();
+}
+
+size_t PackedSequence::hash() const {
+    uint64_t h = _mix(_length ^ (static_cast<uint64_t>(_alphabet) << 32));
+    for (uint64_t word : _words) {
+        h = _mix(h ^ word);
+    }
+    for (const Degenerate& d : _degenerate) {
+        h = _mix(h ^ ((static_cast<uint64_t>(d.position) << 8) | static_cast<uint8_t>(d.base)));
+    }
+    return static_cast<size_t>(h);
+}
@@ -0,0 +1,81 @@
+#ifndef PACKED_SEQUENCE_H
+#define PACKED_SEQUENCE_H
+
+#include "sequence.hpp"
+#include <compare>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// A nucleotide sequence stored at two bits per base, for the libraries that
+// merge, merge_padding and sort hold in memory.
+//
+// Bases are coded A = 0, C = 1, G = 2 and T or U = 3, 32 to a word with the
+// first base in the highest bits, so comparing words compares bases in
+// order. The sequence is DNA or RNA as a whole, by whether it contains an
+// upper-case U. Anything else, such as an IUPAC polybase code, a lower-case
+// base, or a T in an RNA sequence, is kept in a side channel by position,
+// with code 0 in the words, so every sequence has exactly one packed form.
+class PackedSequence {
+public:
+    PackedSequence() = default;
+    explicit PackedSequence(std::string_view seq);
+    explicit PackedSequence(const Sequence& seq);
+
+    size_t length() const { return _length; }
+    bool empty() const { return _length == 0; }
+    Alphabet alphabet() const { return _alphabet; }
+
+    // The base at a position
+    char operator[](size_t pos) const;
+
+    // Unpack the whole sequence, or append some of it to a buffer
+    std::string str() const;
+    void append_to(std::string& out, size_t pos = 0, size_t count = std::string::npos) const;
+    Sequence to_sequence() const;
+
+    // The number of bases outside A, C, G and T or U
+    size_t degenerate() const { return _degenerate.size(); }
+
+    // Transformations, as on Sequence
+    PackedSequence to_dna() const;
+    PackedSequence to_rna() const;
+    PackedSequence replace_polybases(std::mt19937& gen) const;
+
+    // The number of positions at which two sequences of the same length
+    // have different bases, with T and U the same base. Throws on
+    // sequences of different lengths.
+    size_t hamming_distance(const PackedSequence& other) const;
+
+    // Equality and order are those of the unpacked strings
+    bool operator==(const PackedSequence& other) const = default;
+    std::strong_ordering operator<=>(const PackedSequence& other) const;
+
+    size_t hash() const;
+
+private:
+    struct Degenerate {
+        uint32_t position;
+        char base;
+
+        bool operator==(const Degenerate& other) const = default;
+    };
+
+    std::vector<uint64_t> _words;
+    std::vector<Degenerate> _degenerate;
+    uint32_t _length = 0;
+    Alphabet _alphabet = Alphabet::DNA;
+
+    uint64_t _code(size_t pos) const;
+    char _base(size_t pos) const;
+    PackedSequence _converted(Alphabet alphabet) const;
+};
+
+template <>
+struct std::hash<PackedSequence> {
+    size_t operator()(const PackedSequence& seq) const { return seq.hash(); }
+};
+
+#endif
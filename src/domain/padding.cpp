@@ -2,8 +2,12 @@
 #include "hairpin.hpp"
 #include "sequence.hpp"
 #include "sampling.hpp"
+#include <algorithm>
 #include <stdexcept>
 
+// Draws of a padding segment before giving up on the k-mer screen
+static constexpr size_t MAX_SCREEN_ATTEMPTS = 1000;
+
 enum class PadType {
     Hairpin,
     Disordered
@@ -13,16 +17,8 @@ static size_t stem_length_for(size_t length) {
     return (length - HAIRPIN_LOOP_LENGTH) / 2;
 }
 
-static size_t hairpin_length_for(size_t stem_length) {
-    return 2 * stem_length + HAIRPIN_LOOP_LENGTH;
-}
-
-static std::string poly_a(size_t count) {
-    return std::string(count, BASE_A);
-}
-
 static PadType get_pad_type(size_t length, const StemConfig& config) {
-    size_t min_hairpin_length = hairpin_length_for(config.min_length);
+    size_t min_hairpin_length = Hairpin::length_for(config.min_length);
     if (length >= min_hairpin_length + config.spacer_length) {
         return PadType::Hairpin;
     } else {
@@ -42,21 +38,46 @@ static size_t get_pad_stem_length(
     return sample_from_range(config.min_length, max_stem_length, gen);
 }
 
-static std::string get_single_pad(
-    size_t length,
+// Redraw the segment in place until it passes the screen
+template <typename Draw>
+static void draw_screened(const KmerScreen* screen, std::span<char> segment, Draw draw) {
+    draw();
+    if (!screen) return;
+    std::string_view view(segment.data(), segment.size());
+    for (size_t attempt = 1; screen->hits(view); attempt++) {
+        if (attempt == MAX_SCREEN_ATTEMPTS) {
+            throw std::runtime_error(
+                "Could not draw padding free of the library's " + std::to_string(screen->k()) +
+                "-mers after " + std::to_string(MAX_SCREEN_ATTEMPTS) + " attempts. Try a longer k-mer."
+            );
+        }
+        draw();
+    }
+}
+
+// Write one hairpin and its spacer, or disordered sequence to the end of
+// the buffer, and return the number of bases written
+static size_t write_single_pad(
+    std::span<char> out,
     const StemConfig& config,
-    std::mt19937& gen
+    std::mt19937& gen,
+    const KmerScreen* screen
 ) {
-    switch (get_pad_type(length, config)) {
+    switch (get_pad_type(out.size(), config)) {
         case PadType::Disordered: {
-            return random_sequence(length, gen);
+            draw_screened(screen, out, [&]() { random_sequence_in_place(out, gen); });
+            return out.size();
         }
         case PadType::Hairpin: {
-            size_t stem_length = get_pad_stem_length(length, config, gen);
-            std::string hairpin = Hairpin::random(stem_length, config, gen).str();
-            std::string spacer = poly_a(config.spacer_length);
+            size_t stem_length = get_pad_stem_length(out.size(), config, gen);
+            std::span<char> hairpin = out.first(Hairpin::length_for(stem_length));
+            draw_screened(screen, hairpin, [&]() {
+                Hairpin::write_random(stem_length, config, gen, hairpin);
+            });
             // The spacer always goes on the 3' end
-            return hairpin + spacer;
+            std::span<char> spacer = out.subspan(hairpin.size(), config.spacer_length);
+            std::fill(spacer.begin(), spacer.end(), BASE_A);
+            return hairpin.size() + spacer.size();
         }
         default: {
             throw std::runtime_error("Invalid pad type.");
@@ -64,16 +85,25 @@ static std::string get_single_pad(
     }
 }
 
+void write_padding(
+    std::span<char> out,
+    const StemConfig& config,
+    std::mt19937& gen,
+    const KmerScreen* screen
+) {
+    size_t written = 0;
+    while (written < out.size()) {
+        written += write_single_pad(out.subspan(written), config, gen, screen);
+    }
+}
+
 std::string get_padding(
     size_t length,
     const StemConfig& config,
-    std::mt19937& gen
+    std::mt19937& gen,
+    const KmerScreen* screen
 ) {
-    std::string padding;
-    while (length > 0) {
-        std::string tmp = get_single_pad(length, config, gen);
-        length -= tmp.length();
-        padding += tmp;
-    }
+    std::string padding(length, '\0');
+    write_padding(padding, config, gen, screen);
     return padding;
 }
@@ -1,17 +1,30 @@
 #ifndef PADDING_DOMAIN_H
 #define PADDING_DOMAIN_H
 
+#include <span>
 #include <string>
 #include <random>
 #include "../config/stem_config.hpp"
+#include "kmer_screen.hpp"
 
 // Generates a padding sequence of exactly the given length, built from
 // hairpins with poly-A spacers where space allows, and disordered random
-// sequence otherwise.
+// sequence otherwise. With a k-mer screen, hairpins and disordered
+// segments sharing a k-mer with it are redrawn.
 std::string get_padding(
     size_t length,
     const StemConfig& config,
-    std::mt19937& gen
+    std::mt19937& gen,
+    const KmerScreen* screen = nullptr
+);
+
+// Writes padding of exactly the length of the buffer into it, drawing from
+// gen as get_padding does, without allocating.
+void write_padding(
+    std::span<char> out,
+    const StemConfig& config,
+    std::mt19937& gen,
+    const KmerScreen* screen = nullptr
 );
 
 #endif
@@ -0,0 +1,139 @@
+#include "padding_pool.hpp"
+#include "padding.hpp"
+#include "random_streams.hpp"
+#include "../utils.hpp"
+#include <algorithm>
+#include <atomic>
+#include <stdexcept>
+
+// Paddings per unit of parallel work. Fixed, so that the random streams
+// do not depend on the thread count.
+static constexpr size_t POOL_BLOCK = 256;
+
+PaddingPool::PaddingPool(const StemConfig& config, size_t per_length, uint64_t seed, bool full)
+    : _config(config), _per_length(per_length), _seed(seed), _full(full) {}
+
+void PaddingPool::fill(const std::map<size_t, size_t>& demand, size_t threads, const KmerScreen* screen) {
+    // The slots [begin, end) of one block of a length
+    struct Job {
+        size_t length;
+        size_t block;
+        size_t begin;
+        size_t end;
+        Entries* entries;
+    };
+
+    std::vector<Job> jobs;
+    for (const auto& [length, needed] : demand) {
+        if (length == 0 || needed == 0 || _per_length == 0) continue;
+        Entries& entries = _entries[length];
+        size_t target = _full ? _per_length : std::min(_per_length, entries.next + needed);
+        if (target <= entries.count) continue;
+        entries.bases.resize(length * target, '\0');
+        for (size_t block = entries.count / POOL_BLOCK; block * POOL_BLOCK < target; block++) {
+            size_t begin = std::max(entries.count, block * POOL_BLOCK);
+            size_t end = std::min(target, (block + 1) * POOL_BLOCK);
+            jobs.push_back({length, block, begin, end, &entries});
+        }
+        entries.count = target;
+        _grown = true;
+    }
+    if (jobs.empty()) return;
+
+    // Each block of a length draws from the stream of that (length, block).
+    // A block that was partly generated before is redrawn from its start,
+    // keeping only the new slots, so slots never depend on the demand.
+    RandomStreams streams(_seed);
+    std::atomic<size_t> next{0};
+    _run_workers(std::min(threads, jobs.size()), [&](size_t) {
+        for (size_t ix = next++; ix < jobs.size(); ix = next++) {
+            const Job& job = jobs[ix];
+            std::mt19937 gen = streams.stream(
+                RandomStreams::PADDING_POOL,
+                (static_cast<uint64_t>(job.length) << 32) | job.block
+            );
+            std::string redrawn(job.length, '\0');
+            for (size_t slot = job.block * POOL_BLOCK; slot < job.end; slot++) {
+                std::span<char> padding = (slot < job.begin)
+                    ? std::span<char>(redrawn)
+                    : std::span<char>(job.entries->bases.data() + slot * job.length, job.length);
+                write_padding(padding, _config, gen, screen);
+            }
+        }
+    });
+}
+
+size_t PaddingPool::_slot(const Entries& entries, size_t taken) {
+    if (taken >= entries.added) return taken;
+    return (entries.start + taken) % entries.added;
+}
+
+size_t PaddingPool::take(size_t length, const KmerScreen* screen) {
+    auto it = _entries.find(length);
+    if (it == _entries.end()) return npos;
+    Entries& entries = it->second;
+    while (entries.next < entries.count) {
+        size_t slot = _slot(entries, entries.next++);
+        if (!screen || !screen->hits(at(length, slot))) {
+            return slot;
+        }
+    }
+    return npos;
+}
+
+std::string_view PaddingPool::at(size_t length, size_t slot) const {
+    const Entries& entries = _entries.at(length);
+    return std::string_view(entries.bases).substr(slot * length, length);
+}
+
+size_t PaddingPool::count(size_t length) const {
+    auto it = _entries.find(length);
+    return (it == _entries.end()) ? 0 : it->second.count;
+}
+
+size_t PaddingPool::remaining(size_t length) const {
+    auto it = _entries.find(length);
+    return (it == _entries.end()) ? 0 : it->second.count - it->second.next;
+}
+
+std::vector<size_t> PaddingPool::lengths() const {
+    std::vector<size_t> lengths;
+    for (const auto& [length, entries] : _entries) {
+        lengths.push_back(length);
+    }
+    return lengths;
+}
+
+void PaddingPool::add(size_t length, std::string bases) {
+    if (length == 0 || bases.size() % length != 0) {
+        throw std::invalid_argument(
+            "Padding pool entries of length " + std::to_string(length) +
+            " cannot fill " + std::to_string(bases.size()) + " bases."
+        );
+    }
+    Entries& entries = _entries[length];
+    entries.count = bases.size() / length;
+    entries.next = 0;
+    entries.bases = std::move(bases);
+    entries.added = entries.count;
+    entries.start = 0;
+    if (entries.count > 0) {
+        std::mt19937 gen = RandomStreams(_seed).stream(RandomStreams::PADDING_POOL_START, length);
+        entries.start = std::uniform_int_distribution<size_t>(0, entries.count - 1)(gen);
+    }
+}
+
+void PaddingPool::check_compatible(const StemConfig& config) const {
+    bool same = _config.min_length == config.min_length &&
+        _config.max_length == config.max_length &&
+        _config.max_au == config.max_au &&
+        _config.max_gc == config.max_gc &&
+        _config.max_gu == config.max_gu &&
+        _config.closing_gc == config.closing_gc &&
+        _config.spacer_length == config.spacer_length;
+    if (!same) {
+        throw std::invalid_argument(
+            "The padding pool was generated with different stem constraints than requested."
+        );
+    }
+}
@@ -0,0 +1,88 @@
+#ifndef PADDING_POOL_H
+#define PADDING_POOL_H
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "../config/stem_config.hpp"
+#include "kmer_screen.hpp"
+
+// Paddings pre-generated for each padding length, so that padding a
+// construct is a lookup instead of a hairpin synthesis.
+//
+// A pool holds up to a fixed number of paddings for every length it has
+// seen: only as many as have been asked for, or all of them for a full
+// pool that is saved for later runs. They are generated in parallel, in
+// fixed blocks that each draw from their own stream of the pool's seed, so
+// slot i of a length does not depend on the thread count or on how the
+// demand was split. Paddings are taken in pool order and never handed out
+// twice; once a length runs out, callers generate padding as usual.
+//
+// Paddings added from a file are taken starting at an offset derived from
+// the pool's seed, so runs with different seeds that share a pool file
+// start at different paddings. Runs with the same seed still share them.
+class PaddingPool {
+public:
+    static constexpr size_t npos = static_cast<size_t>(-1);
+
+    PaddingPool(const StemConfig& config, size_t per_length, uint64_t seed, bool full = false);
+
+    // The configuration the paddings were generated with
+    const StemConfig& config() const { return _config; }
+
+    // The most paddings generated for each length
+    size_t per_length() const { return _per_length; }
+
+    // Generate paddings so that each length has as many untaken as its
+    // demand, up to per_length() in all, or per_length() outright for a
+    // full pool. New paddings are free of the screen's k-mers if one is
+    // given.
+    void fill(const std::map<size_t, size_t>& demand, size_t threads, const KmerScreen* screen = nullptr);
+
+    // Take the next unused padding of a length that is not hit by the
+    // screen, returning its slot, or npos if the length has run out
+    size_t take(size_t length, const KmerScreen* screen = nullptr);
+
+    // The padding in a slot of a length
+    std::string_view at(size_t length, size_t slot) const;
+
+    // The number of paddings of a length, and how many are left untaken
+    size_t count(size_t length) const;
+    size_t remaining(size_t length) const;
+
+    // The lengths in the pool, in increasing order
+    std::vector<size_t> lengths() const;
+
+    // Add the paddings of a length, back to back, as read from a file
+    void add(size_t length, std::string bases);
+
+    // Whether lengths were generated since the pool was created or loaded
+    bool grown() const { return _grown; }
+
+    // Throw if paddings from this pool do not satisfy the configuration
+    void check_compatible(const StemConfig& config) const;
+
+private:
+    struct Entries {
+        std::string bases;
+        size_t count = 0;
+        size_t next = 0;
+        // The paddings added from a file are taken from start onwards,
+        // wrapping around, before any generated after them
+        size_t added = 0;
+        size_t start = 0;
+    };
+
+    StemConfig _config;
+    size_t _per_length;
+    uint64_t _seed;
+    bool _full;
+    std::map<size_t, Entries> _entries;
+    bool _grown = false;
+
+    static size_t _slot(const Entries& entries, size_t taken);
+};
+
+#endif
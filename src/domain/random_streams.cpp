@@ -0,0 +1,37 @@
+#include "random_streams.hpp"
+
+static constexpr uint32_t PHILOX_M0 = 0xD2511F53;
+static constexpr uint32_t PHILOX_M1 = 0xCD9E8D57;
+static constexpr uint32_t PHILOX_W0 = 0x9E3779B9;
+static constexpr uint32_t PHILOX_W1 = 0xBB67AE85;
+static constexpr size_t PHILOX_ROUNDS = 10;
+
+RandomStreams::RandomStreams(uint64_t seed) : _seed(seed) {}
+
+std::array<uint32_t, 4> RandomStreams::philox(
+    std::array<uint32_t, 4> counter,
+    std::array<uint32_t, 2> key
+) {
+    for (size_t round = 0; round < PHILOX_ROUNDS; round++) {
+        uint64_t product0 = static_cast<uint64_t>(PHILOX_M0) * counter[0];
+        uint64_t product1 = static_cast<uint64_t>(PHILOX_M1) * counter[2];
+        counter = {
+            static_cast<uint32_t>(product1 >> 32) ^ counter[1] ^ key[0],
+            static_cast<uint32_t>(product1),
+            static_cast<uint32_t>(product0 >> 32) ^ counter[3] ^ key[1],
+            static_cast<uint32_t>(product0)
+        };
+        key[0] += PHILOX_W0;
+        key[1] += PHILOX_W1;
+    }
+    return counter;
+}
+
+std::mt19937 RandomStreams::stream(Stage stage, uint64_t index) const {
+    std::array<uint32_t, 4> block = philox(
+        {static_cast<uint32_t>(index), static_cast<uint32_t>(index >> 32), stage, 0},
+        {static_cast<uint32_t>(_seed), static_cast<uint32_t>(_seed >> 32)}
+    );
+    std::seed_seq seq(block.begin(), block.end());
+    return std::mt19937(seq);
+}
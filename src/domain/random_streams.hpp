@@ -0,0 +1,46 @@
+#ifndef RANDOM_STREAMS_H
+#define RANDOM_STREAMS_H
+
+#include <array>
+#include <cstdint>
+#include <random>
+
+// Reproducible random streams, all derived from one master seed.
+//
+// A stream is named by a stage and an index, such as the padding of the
+// constructs in one block of a library. Its generator is seeded from the
+// Philox4x32-10 block of that (stage, index) counter under the master seed,
+// so any stream can be rebuilt on its own without drawing the ones before
+// it, and work split across threads gives the same bytes as serial work.
+class RandomStreams {
+public:
+    // The stages that draw random numbers. Each has its own streams, so
+    // adding draws to one stage never shifts another.
+    enum Stage : uint32_t {
+        POLYBASES,
+        PADDING,
+        BARCODES,
+        SEQUENCES,
+        PADDING_POOL,
+        PADDING_POOL_START
+    };
+
+    explicit RandomStreams(uint64_t seed);
+
+    // The master seed
+    uint64_t seed() const { return _seed; }
+
+    // The generator of a stream, the same on every call
+    std::mt19937 stream(Stage stage, uint64_t index = 0) const;
+
+    // The Philox4x32-10 block of a counter under a key
+    static std::array<uint32_t, 4> philox(
+        std::array<uint32_t, 4> counter,
+        std::array<uint32_t, 2> key
+    );
+
+private:
+    uint64_t _seed;
+};
+
+#endif
@@ -1,4 +1,5 @@
 #include "sequence.hpp"
+#include "nucleotide_kernels.hpp"
 #include "sampling.hpp"
 #include <stdexcept>
 
@@ -42,8 +43,8 @@ static const std::vector<char>& get_polybase_arr(char base) {
     }
 }
 
-Alphabet detect_alphabet(const std::string& seq) {
-    if (seq.find(BASE_U) != std::string::npos || seq.find('u') != std::string::npos) {
+Alphabet detect_alphabet(std::string_view seq) {
+    if (find_base(seq, BASE_U) != std::string_view::npos) {
         return Alphabet::RNA;
     }
     return Alphabet::DNA;
@@ -65,52 +66,53 @@ char complement(char base, Alphabet alphabet) {
     }
 }
 
-static char base_to_dna(char base) {
-    switch (base) {
-        case 'U': return 'T';
-        case 'u': return 't';
-        default:  return base;
-    }
-}
-
-static char base_to_rna(char base) {
-    switch (base) {
-        case 'T': return 'U';
-        case 't': return 'u';
-        default:  return base;
-    }
-}
-
 std::string to_dna(const std::string& seq) {
-    std::string dna(seq.length(), '\0');
-    for (size_t ix = 0; ix < seq.length(); ix++) {
-        dna[ix] = base_to_dna(seq[ix]);
-    }
+    std::string dna = seq;
+    to_dna_in_place(dna);
     return dna;
 }
 
 std::string to_rna(const std::string& seq) {
-    std::string rna(seq.length(), '\0');
-    for (size_t ix = 0; ix < seq.length(); ix++) {
-        rna[ix] = base_to_rna(seq[ix]);
-    }
+    std::string rna = seq;
+    to_rna_in_place(rna);
     return rna;
 }
 
 std::string replace_polybases(const std::string& seq, std::mt19937& gen) {
-    std::string result(seq.length(), '\0');
-    for (size_t ix = 0; ix < seq.length(); ix++) {
-        const std::vector<char>& bases = get_polybase_arr(seq[ix]);
-        result[ix] = sample_from_vector(bases, gen);
-    }
+    std::string result = seq;
+    replace_polybases_in_place(result, gen);
     return result;
 }
 
+void to_dna_in_place(std::span<char> seq) {
+    replace_base_in_place(seq, BASE_U, BASE_T);
+}
+
+void to_rna_in_place(std::span<char> seq) {
+    replace_base_in_place(seq, BASE_T, BASE_U);
+}
+
+// U becomes T, and other concrete bases are skipped without drawing, so the
+// generator only advances at polybase codes
+void replace_polybases_in_place(std::span<char> seq, std::mt19937& gen) {
+    replace_base_in_place(seq, BASE_U, BASE_T);
+    std::string_view view(seq.data(), seq.size());
+    for (size_t ix = find_polybase(view); ix != std::string_view::npos; ) {
+        seq[ix] = sample_from_vector(get_polybase_arr(seq[ix]), gen);
+        size_t next = find_polybase(view.substr(ix + 1));
+        ix = (next == std::string_view::npos) ? next : ix + 1 + next;
+    }
+}
+
+void random_sequence_in_place(std::span<char> seq, std::mt19937& gen) {
+    for (char& base : seq) {
+        base = sample_from_vector(N_BASES, gen);
+    }
+}
+
 std::string random_sequence(size_t length, std::mt19937& gen) {
     std::string seq(length, '\0');
-    for (size_t ix = 0; ix < length; ix++) {
-        seq[ix] = sample_from_vector(N_BASES, gen);
-    }
+    random_sequence_in_place(seq, gen);
     return seq;
 }
 
@@ -129,7 +131,7 @@ bool Sequence::empty() const {
 }
 
 bool Sequence::is_valid_base(char c) {
-    return c == BASE_A || c == BASE_C || c == BASE_G || c == BASE_T || c == BASE_U;
+    return find_polybase(std::string_view(&c, 1)) == std::string_view::npos;
 }
 
 Sequence Sequence::to_dna() const {
@@ -2,8 +2,10 @@
 #define SEQUENCE_H
 
 #include <string>
+#include <string_view>
 #include <vector>
 #include <random>
+#include <span>
 
 // Valid nucleotide bases
 constexpr char BASE_A = 'A';
@@ -19,7 +21,7 @@ enum class Alphabet {
 };
 
 // Returns RNA if the sequence contains U, and DNA otherwise.
-Alphabet detect_alphabet(const std::string& seq);
+Alphabet detect_alphabet(std::string_view seq);
 
 // Returns the four bases of the given alphabet.
 const std::vector<char>& alphabet_bases(Alphabet alphabet);
@@ -32,6 +34,14 @@ char complement(char base, Alphabet alphabet);
 std::string to_dna(const std::string& seq);
 std::string to_rna(const std::string& seq);
 
+// In-place variants, for sequences that live inside a larger buffer.
+// replace_polybases_in_place and random_sequence_in_place draw from gen
+// exactly as replace_polybases and random_sequence.
+void to_dna_in_place(std::span<char> seq);
+void to_rna_in_place(std::span<char> seq);
+void replace_polybases_in_place(std::span<char> seq, std::mt19937& gen);
+void random_sequence_in_place(std::span<char> seq, std::mt19937& gen);
+
 // Replaces IUPAC polybase codes with random concrete bases.
 // Emits DNA bases; generation is DNA-canonical, so convert at output
 // boundaries with to_rna.
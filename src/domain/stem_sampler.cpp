@@ -0,0 +1,170 @@
+#include "stem_sampler.hpp"
+#include "hairpin.hpp"
+#include "sequence.hpp"
+#include "sampling.hpp"
+#include <algorithm>
+
+// Sequences of 40 free pair types number at most 3^40 < 2^64
+static constexpr size_t MAX_STEM_LENGTH = 40;
+
+// Both orientations of each pair type, as (5', 3') bases
+static constexpr char AU_ORIENTATIONS[2][2] = {{BASE_A, BASE_T}, {BASE_T, BASE_A}};
+static constexpr char GC_ORIENTATIONS[2][2] = {{BASE_C, BASE_G}, {BASE_G, BASE_C}};
+static constexpr char GU_ORIENTATIONS[2][2] = {{BASE_T, BASE_G}, {BASE_G, BASE_T}};
+
+static inline uint64_t _saturating_mul(uint64_t a, uint64_t b) {
+    uint64_t result;
+    if (__builtin_mul_overflow(a, b, &result)) {
+        return UINT64_MAX;
+    }
+    return result;
+}
+
+StemSampler::StemSampler(size_t stem_length, const StemConfig& config) :
+    _stem_length(stem_length),
+    _closing_gc(config.closing_gc) {
+
+    if (stem_length > MAX_STEM_LENGTH) {
+        throw std::invalid_argument(
+            "Stem length " + std::to_string(stem_length) +
+            " exceeds the maximum of " + std::to_string(MAX_STEM_LENGTH) + "."
+        );
+    }
+    if (config.closing_gc > stem_length || config.closing_gc > config.max_gc) {
+        throw std::invalid_argument(
+            "The number of closing GC pairs (" + std::to_string(config.closing_gc) +
+            ") exceeds the stem length or the maximum GC content."
+        );
+    }
+
+    _free_length = stem_length - _closing_gc;
+    _max_au = std::min(config.max_au, _free_length);
+    _max_gc = std::min(config.max_gc - _closing_gc, _free_length);
+    _max_gu = std::min(config.max_gu, _free_length);
+    _loops = Hairpin::tetraloops().size();
+
+    _counts.assign(
+        _free_length + 1,
+        std::vector<std::vector<uint64_t>>(_max_au + 1, std::vector<uint64_t>(_max_gc + 1, 0))
+    );
+    _counts[0][0][0] = 1;
+    for (size_t i = 1; i <= _free_length; ++i) {
+        for (size_t a = 0; a <= std::min(_max_au, i); ++a) {
+            for (size_t b = 0; b <= std::min(_max_gc, i - a); ++b) {
+                size_t c = i - a - b;
+                if (c > _max_gu) continue;
+
+                uint64_t count = 0;
+                if (a > 0) count += _counts[i - 1][a - 1][b];
+                if (b > 0) count += _counts[i - 1][a][b - 1];
+                if (c > 0) count += _counts[i - 1][a][b];
+                _counts[i][a][b] = count;
+            }
+        }
+    }
+
+    for (size_t a = 0; a <= _max_au; ++a) {
+        for (size_t b = 0; b <= _max_gc; ++b) {
+            _type_count += _counts[_free_length][a][b];
+        }
+    }
+
+    _size = _saturating_mul(stem_count(), _loops);
+}
+
+uint64_t StemSampler::stem_count() const {
+    if (_stem_length >= 64) return UINT64_MAX;
+    return _saturating_mul(_type_count, 1ULL << _stem_length);
+}
+
+bool StemSampler::_final_composition(uint64_t& type_rank, size_t& a, size_t& b) const {
+    for (a = 0; a <= _max_au; ++a) {
+        for (b = 0; b <= _max_gc; ++b) {
+            uint64_t count = _counts[_free_length][a][b];
+            if (type_rank < count) {
+                return true;
+            }
+            type_rank -= count;
+        }
+    }
+    return false;
+}
+
+void StemSampler::_write(
+    uint64_t type_rank,
+    uint64_t orientation,
+    size_t loop,
+    std::string& out
+) const {
+    size_t length = 2 * _stem_length + HAIRPIN_LOOP_LENGTH;
+    out.resize(length);
+
+    auto place = [&](size_t ix, const char (&pairs)[2][2]) {
+        const char* pair = pairs[(orientation >> ix) & 1];
+        out[ix] = pair[0];
+        out[length - ix - 1] = pair[1];
+    };
+
+    for (size_t ix = 0; ix < _closing_gc; ix++) {
+        place(ix, GC_ORIENTATIONS);
+    }
+
+    // Choose the final composition, then walk back through the table
+    size_t a = 0;
+    size_t b = 0;
+    if (!_final_composition(type_rank, a, b)) {
+        throw std::out_of_range("Stem rank out of range.");
+    }
+
+    for (size_t i = _free_length; i > 0; --i) {
+        size_t ix = _closing_gc + i - 1;
+        size_t c = i - a - b;
+        if (a > 0) {
+            uint64_t count = _counts[i - 1][a - 1][b];
+            if (type_rank < count) {
+                place(ix, AU_ORIENTATIONS);
+                a--;
+                continue;
+            }
+            type_rank -= count;
+        }
+        if (b > 0) {
+            uint64_t count = _counts[i - 1][a][b - 1];
+            if (type_rank < count) {
+                place(ix, GC_ORIENTATIONS);
+                b--;
+                continue;
+            }
+            type_rank -= count;
+        }
+        if (c > 0) {
+            place(ix, GU_ORIENTATIONS);
+        }
+    }
+
+    const std::string& tetraloop = Hairpin::tetraloops()[loop];
+    std::copy(tetraloop.begin(), tetraloop.end(), out.begin() + _stem_length);
+}
+
+void StemSampler::unrank(uint64_t rank, std::string& out) const {
+    if (rank >= _size) {
+        throw std::out_of_range("Hairpin rank out of range.");
+    }
+    size_t loop = rank % _loops;
+    rank /= _loops;
+    uint64_t orientation = rank & ((1ULL << _stem_length) - 1);
+    uint64_t type_rank = rank >> _stem_length;
+    _write(type_rank, orientation, loop, out);
+}
+
+void StemSampler::sample(std::mt19937& gen, std::string& out) const {
+    if (_type_count == 0) {
+        throw std::runtime_error("No stems satisfy the base pair constraints.");
+    }
+    std::uniform_int_distribution<uint64_t> types(0, _type_count - 1);
+    std::uniform_int_distribution<uint64_t> orientations(0, (1ULL << _stem_length) - 1);
+    uint64_t type_rank = types(gen);
+    uint64_t orientation = orientations(gen);
+    size_t loop = sample_from_range(0, _loops - 1, gen);
+    _write(type_rank, orientation, loop, out);
+}
@@ -0,0 +1,70 @@
+#ifndef STEM_SAMPLER_H
+#define STEM_SAMPLER_H
+
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+#include "../config/stem_config.hpp"
+
+// Counts, ranks and uniformly samples the hairpins of a fixed stem
+// length allowed by a StemConfig.
+//
+// The stem is split into its closing GC pairs, which come first, and
+// the remaining free pairs. A DP table counts the sequences of free
+// pair types (AU, GC, GU) with exactly a AU and b GC pairs, keeping
+// every prefix length so a type sequence can be unranked position by
+// position. Each pair then has two orientations, and the hairpin is
+// capped by one of the standard tetraloops.
+//
+// A hairpin rank is ((type_rank * 2^stem_length) + orientation) *
+// loops + loop, so ranks in [0, size()) cover every allowed hairpin
+// exactly once.
+class StemSampler {
+public:
+    StemSampler(size_t stem_length, const StemConfig& config);
+
+    // The stem length in base pairs
+    size_t stem_length() const { return _stem_length; }
+
+    // Number of allowed sequences of base pair types
+    uint64_t type_count() const { return _type_count; }
+
+    // Number of allowed stems, counting both orientations of each pair.
+    // Saturates at UINT64_MAX.
+    uint64_t stem_count() const;
+
+    // Number of allowed hairpins (stems times tetraloops). Saturates at
+    // UINT64_MAX, in which case the hairpins cannot be enumerated.
+    uint64_t size() const { return _size; }
+
+    // Write the hairpin with the given rank into the buffer, which is
+    // resized to the hairpin length
+    void unrank(uint64_t rank, std::string& out) const;
+
+    // Write a uniformly random allowed hairpin into the buffer
+    void sample(std::mt19937& gen, std::string& out) const;
+
+private:
+    size_t _stem_length;
+    size_t _closing_gc;
+    size_t _free_length;
+    size_t _max_au;
+    size_t _max_gc;
+    size_t _max_gu;
+    size_t _loops;
+    // _counts[i][a][b]: type sequences of length i with a AU and b GC pairs
+    std::vector<std::vector<std::vector<uint64_t>>> _counts;
+    uint64_t _type_count = 0;
+    uint64_t _size = 0;
+
+    bool _final_composition(uint64_t& type_rank, size_t& a, size_t& b) const;
+    void _write(
+        uint64_t type_rank,
+        uint64_t orientation,
+        size_t loop,
+        std::string& out
+    ) const;
+};
+
+#endif
@@ -12,11 +12,14 @@ void _duplicate(
 
     FastaOutputStream out(output);
 
-    for_each_fasta(input, [&](const FastaEntry& entry) {
+    std::string name;
+    for_each_fasta_record(input, [&](const FastaRecord& entry) {
         for (int ix = 0; ix < count; ix++) {
-            out.write(entry.name + "_" + std::to_string(ix), entry.sequence);
+            name.assign(entry.name).append("_").append(std::to_string(ix));
+            out.write(name, entry.sequence);
         }
     });
+    out.close();
 }
 
 
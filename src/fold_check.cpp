@@ -0,0 +1,228 @@
+#include "fold_check.hpp"
+#include "domain/fold.hpp"
+#include "io/compressed_file.hpp"
+#include "io/csv_format.hpp"
+#include <atomic>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+static inline std::string _PARSER_NAME = "fold-check";
+
+static inline std::string _FILE_NAME = "file";
+static inline std::string _FILE_HELP = "The library .csv file to check.";
+
+static inline std::string _OUTPUT_NAME = "--output";
+static inline std::string _OUTPUT_DEFAULT = "";
+static inline std::string _OUTPUT_HELP = "Also list every misfolded hairpin in this .csv file.";
+
+static inline std::string _OVERWRITE_NAME = "--overwrite";
+static inline std::string _OVERWRITE_HELP = "Overwrite any existing files.";
+
+static inline std::string _MIN_STEM_LENGTH_NAME = "--min-stem-length";
+static inline int _MIN_STEM_LENGTH_DEFAULT = 7;
+static inline std::string _MIN_STEM_LENGTH_HELP = "The minimum length of the stem of a padding hairpin, as designed.";
+
+static inline std::string _MAX_STEM_LENGTH_NAME = "--max-stem-length";
+static inline int _MAX_STEM_LENGTH_DEFAULT = 9;
+static inline std::string _MAX_STEM_LENGTH_HELP = "The maximum length of the stem of a padding hairpin, as designed.";
+
+static inline std::string _SPACER_NAME = "--spacer";
+static inline int _SPACER_DEFAULT = 2;
+static inline std::string _SPACER_HELP = "The length of the polyA spacer between padding hairpins, as designed.";
+
+static inline std::string _MAX_SPAN_NAME = "--max-span";
+static inline int _MAX_SPAN_DEFAULT = static_cast<int>(FoldEngine::DEFAULT_MAX_SPAN);
+static inline std::string _MAX_SPAN_HELP = "The largest number of bases a base pair may span when folding.";
+
+static inline std::string _THREADS_NAME = "--threads";
+static inline int _THREADS_DEFAULT = 1;
+static inline std::string _THREADS_HELP = "The number of threads to fold constructs with.";
+
+FoldCheckArgs::FoldCheckArgs() :
+    Program(_PARSER_NAME),
+    file(_parser, _FILE_NAME, _FILE_HELP),
+    output(_parser, _OUTPUT_NAME, _OUTPUT_HELP, _OUTPUT_DEFAULT),
+    overwrite(_parser, _OVERWRITE_NAME, _OVERWRITE_HELP),
+    min_stem_length(_parser, _MIN_STEM_LENGTH_NAME, _MIN_STEM_LENGTH_HELP, _MIN_STEM_LENGTH_DEFAULT),
+    max_stem_length(_parser, _MAX_STEM_LENGTH_NAME, _MAX_STEM_LENGTH_HELP, _MAX_STEM_LENGTH_DEFAULT),
+    spacer(_parser, _SPACER_NAME, _SPACER_HELP, _SPACER_DEFAULT),
+    max_span(_parser, _MAX_SPAN_NAME, _MAX_SPAN_HELP, _MAX_SPAN_DEFAULT),
+    threads(_parser, _THREADS_NAME, _THREADS_HELP, _THREADS_DEFAULT)
+{
+    _parser.add_description(
+        "Check that the padding and barcode hairpins of a library fold.\n\n"
+        "Each construct is folded whole, and a hairpin passes if every pair\n"
+        "of its stem is in the minimum free energy structure."
+    );
+}
+
+// Rows read and folded at a time
+static constexpr size_t FOLD_CHECK_BATCH = 4096;
+
+// The hairpins a column of a construct is designed to hold
+enum class Hairpins {
+    None,
+    Padding,
+    Barcode
+};
+
+// A designed hairpin of a construct, and the column it came from
+struct CheckedHairpin {
+    const char* element;
+    Helix helix;
+    size_t formed = 0;
+};
+
+struct CheckedConstruct {
+    std::string index;
+    std::string name;
+    std::string seq;
+    std::vector<CheckedHairpin> hairpins;
+};
+
+static void _add_hairpins(
+    CheckedConstruct& construct,
+    const char* element,
+    const std::vector<Helix>& helices
+) {
+    for (const Helix& helix : helices) {
+        construct.hairpins.push_back({element, helix});
+    }
+}
+
+// The parts of a construct in order, and the hairpins each holds
+static constexpr std::pair<const char*, Hairpins> CONSTRUCT_PARTS[] = {
+    {csv::COL_FIVE_CONST, Hairpins::None},
+    {csv::COL_FIVE_PADDING, Hairpins::Padding},
+    {csv::COL_DESIGN, Hairpins::None},
+    {csv::COL_THREE_PADDING, Hairpins::Padding},
+    {csv::COL_BARCODE, Hairpins::Barcode},
+    {csv::COL_THREE_CONST, Hairpins::None}
+};
+
+// Projection slots: the index, the name, then each part in order
+static constexpr size_t INDEX_SLOT = 0;
+static constexpr size_t NAME_SLOT = 1;
+static constexpr size_t FIRST_PART_SLOT = 2;
+
+// Lay out a row and find its designed hairpins
+static CheckedConstruct _checked_construct(
+    const csv::Row& row,
+    size_t row_num,
+    const StemConfig& config
+) {
+    CheckedConstruct construct;
+    construct.index = row.has(INDEX_SLOT) ? std::string(row[INDEX_SLOT]) : std::to_string(row_num);
+    construct.name = row[NAME_SLOT];
+
+    std::vector<Helix> helices;
+    size_t slot = FIRST_PART_SLOT;
+    for (auto [column, hairpins] : CONSTRUCT_PARTS) {
+        std::string_view part = row[slot++];
+        size_t offset = construct.seq.size();
+        construct.seq += part;
+        helices.clear();
+        if (hairpins == Hairpins::Padding) {
+            padding_helices(part, config, offset, helices);
+        } else if (hairpins == Hairpins::Barcode) {
+            if (auto helix = hairpin_helix(part, offset)) helices.push_back(*helix);
+        }
+        _add_hairpins(construct, column, helices);
+    }
+    return construct;
+}
+
+// Fold a batch of constructs, each worker with its own engine
+static void _fold_batch(std::vector<CheckedConstruct>& batch, size_t max_span, size_t threads) {
+    std::atomic<size_t> next{0};
+    _run_workers(std::min(threads, batch.size()), [&](size_t) {
+        FoldEngine engine(max_span);
+        for (size_t ix = next++; ix < batch.size(); ix = next++) {
+            CheckedConstruct& construct = batch[ix];
+            if (construct.hairpins.empty()) continue;
+            engine.fold(construct.seq);
+            for (CheckedHairpin& hairpin : construct.hairpins) {
+                hairpin.formed = engine.formed(hairpin.helix);
+            }
+        }
+    });
+}
+
+FoldCheckStats _fold_check(
+    const std::string& library_file,
+    const std::string& output,
+    bool overwrite,
+    const StemConfig& config,
+    size_t max_span,
+    size_t threads
+) {
+    _throw_if_not_exists(library_file);
+    // Fail on a bad span before reading anything
+    FoldEngine{max_span};
+
+    std::ofstream report;
+    if (!output.empty()) {
+        _remove_if_exists(output, overwrite);
+        report.open(output);
+        if (!report.is_open()) {
+            throw std::runtime_error("Failed to open output file: " + output);
+        }
+        report << csv::COL_INDEX << ',' << csv::COL_NAME << ",element,position,stem_length,pairs_formed\n";
+    }
+
+    InputFile file(library_file);
+    std::string line;
+    std::getline(file, line);
+    csv::Header header(line);
+    header.validate();
+
+    csv::Projection projection(header);
+    projection.add(csv::COL_INDEX);
+    projection.add(csv::COL_NAME);
+    for (const auto& part : CONSTRUCT_PARTS) {
+        projection.add(part.first);
+    }
+    csv::Row row(projection);
+
+    FoldCheckStats stats;
+    std::vector<CheckedConstruct> batch;
+    auto check_batch = [&]() {
+        _fold_batch(batch, max_span, threads);
+        for (const CheckedConstruct& construct : batch) {
+            bool misfolded = false;
+            for (const CheckedHairpin& hairpin : construct.hairpins) {
+                stats.hairpins++;
+                if (hairpin.formed == hairpin.helix.length) continue;
+                stats.misfolded_hairpins++;
+                misfolded = true;
+                if (report.is_open()) {
+                    report << construct.index << ',' << _quote_csv_field(construct.name) << ','
+                           << hairpin.element << ',' << hairpin.helix.five + 1 << ','
+                           << hairpin.helix.length << ',' << hairpin.formed << '\n';
+                }
+            }
+            stats.misfolded_constructs += misfolded;
+        }
+        stats.constructs += batch.size();
+        batch.clear();
+    };
+
+    size_t row_num = 1;
+    while (std::getline(file, line)) {
+        if (line.empty()) continue;
+        row.parse(line);
+        batch.push_back(_checked_construct(row, row_num++, config));
+        if (batch.size() == FOLD_CHECK_BATCH) check_batch();
+    }
+    check_batch();
+
+    std::cout << "Checked " << stats.hairpins << " hairpins in " << stats.constructs << " constructs.\n";
+    if (stats.hairpins > 0) {
+        std::cout << "  Misfolded hairpins:   " << stats.misfolded_hairpins << " (" << std::fixed
+                  << std::setprecision(2) << _percent(stats.misfolded_hairpins, stats.hairpins) << "%)\n";
+        std::cout << "  Misfolded constructs: " << stats.misfolded_constructs << " (" << std::fixed
+                  << std::setprecision(2) << _percent(stats.misfolded_constructs, stats.constructs) << "%)\n";
+    }
+    return stats;
+}
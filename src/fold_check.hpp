@@ -0,0 +1,41 @@
+#ifndef FOLD_CHECK_H
+#define FOLD_CHECK_H
+
+#include "utils.hpp"
+#include "config/stem_config.hpp"
+
+class FoldCheckArgs : public Program {
+public:
+    Arg<std::string> file;
+    Arg<std::string> output;
+    Arg<bool> overwrite;
+    Arg<int> min_stem_length;
+    Arg<int> max_stem_length;
+    Arg<int> spacer;
+    Arg<int> max_span;
+    Arg<int> threads;
+    FoldCheckArgs();
+};
+
+// How the hairpins of a library folded
+struct FoldCheckStats {
+    size_t constructs = 0;
+    size_t hairpins = 0;
+    size_t misfolded_hairpins = 0;    // Hairpins missing a pair of their stem
+    size_t misfolded_constructs = 0;  // Constructs with any such hairpin
+};
+
+// Fold every construct of a library and check that its padding and barcode
+// hairpins form. Padding is parsed with the stem lengths and spacer of the
+// configuration. With an output path, every misfolded hairpin is listed
+// there.
+FoldCheckStats _fold_check(
+    const std::string& library_file,
+    const std::string& output,
+    bool overwrite,
+    const StemConfig& config,
+    size_t max_span,
+    size_t threads = 1
+);
+
+#endif
@@ -7,23 +7,18 @@ static inline std::string _FILES_NAME = "files";
 static inline std::string _FILES_HELP = "The input .fasta file or files.";
 static inline std::string _SORT_NAME = "--sort";
 static inline std::string _SORT_HELP = "Sort the output sequences by count rather than length.";
+static inline std::string _THREADS_NAME = "--threads";
+static inline std::string _THREADS_HELP = "The number of threads to read each file with.";
+static inline int _THREADS_DEFAULT = 1;
 
 InspectArgs::InspectArgs() :
     Program(_PARSER_NAME),
     files(_parser, _FILES_NAME, _FILES_HELP),
-    sort(_parser, _SORT_NAME, _SORT_HELP) {
+    sort(_parser, _SORT_NAME, _SORT_HELP),
+    threads(_parser, _THREADS_NAME, _THREADS_HELP, _THREADS_DEFAULT) {
 
 }
 
-static inline std::unordered_map<size_t, size_t> _get_length_counts(const std::string& filename) {
-    std::unordered_map<size_t, size_t> counts;
-    _throw_if_not_exists(filename);
-    for_each_fasta(filename, [&counts](const FastaEntry& entry) {
-        counts[entry.sequence.length()]++;
-    });
-    return counts;
-}
-
 static inline bool _compare_by_length(
     const std::pair<size_t, size_t>& a,
     const std::pair<size_t, size_t>& b
@@ -72,6 +67,26 @@ static inline void _merge_counts(
     }
 }
 
+static inline std::unordered_map<size_t, size_t> _get_length_counts(
+    const std::string& filename,
+    size_t threads
+) {
+    _throw_if_not_exists(filename);
+    std::vector<std::unordered_map<size_t, size_t>> chunk_counts(std::max<size_t>(threads, 1));
+    std::unordered_map<size_t, size_t> counts;
+    for_each_fasta_chunk(filename, threads, [&](size_t slot, const FastaChunk& chunk) {
+        chunk_counts[slot].clear();
+        FastaReader reader(chunk.text, chunk.ends_file);
+        FastaRecord entry;
+        while (reader.next(entry)) {
+            chunk_counts[slot][entry.sequence.length()]++;
+        }
+    }, [&](size_t slot) {
+        _merge_counts(counts, chunk_counts[slot]);
+    });
+    return counts;
+}
+
 static inline void _print_length_counts(
     const std::unordered_map<size_t, size_t>& counts,
     bool sort_by_count,
@@ -117,17 +132,17 @@ static inline void _print_length_counts(
     std::cout << "  Total: " << total << _pluralize(" sequence", total) << "\n";
 }
 
-void _inspect(const std::vector<std::string>& files, bool sort) {
+void _inspect(const std::vector<std::string>& files, bool sort, size_t threads) {
     if (files.size() == 1) {
         // Single file - just show its stats
-        auto counts = _get_length_counts(files[0]);
+        auto counts = _get_length_counts(files[0], threads);
         _print_length_counts(counts, sort);
     } else {
         // Multiple files - show per-file stats and total
         std::unordered_map<size_t, size_t> total_counts;
 
         for (const auto& file : files) {
-            auto counts = _get_length_counts(file);
+            auto counts = _get_length_counts(file, threads);
             _print_length_counts(counts, sort, file);
             _merge_counts(total_counts, counts);
         }
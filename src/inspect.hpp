@@ -7,9 +7,10 @@ class InspectArgs : public Program {
 public:
     Arg<std::vector<std::string>> files;
     Arg<bool> sort;
+    Arg<int> threads;
     InspectArgs();
 };
 
-void _inspect(const std::vector<std::string>& filename, bool sort);
+void _inspect(const std::vector<std::string>& filename, bool sort, size_t threads = 1);
 
 #endif
@@ -0,0 +1,146 @@
+#include "barcode_pool.hpp"
+#include "../domain/hairpin.hpp"
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+struct PoolHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t stem_length;
+    uint32_t barcode_length;
+    uint32_t maximal;
+    uint64_t max_au;
+    uint64_t max_gc;
+    uint64_t max_gu;
+    uint64_t closing_gc;
+    uint64_t min_distance;
+    uint64_t min_edit_distance;
+    uint64_t count;
+};
+
+static_assert(sizeof(PoolHeader) == 80, "PoolHeader must have no padding");
+
+}
+
+BarcodePool::BarcodePool(const std::string& filename) : _filename(filename) {
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Failed to open barcode pool: " + filename);
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(PoolHeader)) {
+        ::close(fd);
+        throw std::runtime_error("Not a barcode pool: " + filename);
+    }
+    _mapped = static_cast<size_t>(st.st_size);
+    _data = ::mmap(nullptr, _mapped, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (_data == MAP_FAILED) {
+        _data = nullptr;
+        throw std::runtime_error("Failed to map barcode pool: " + filename);
+    }
+
+    PoolHeader header;
+    std::memcpy(&header, _data, sizeof(header));
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION) {
+        ::munmap(_data, _mapped);
+        throw std::runtime_error("Not a barcode pool, or an unsupported version: " + filename);
+    }
+
+    _length = header.barcode_length;
+    _count = header.count;
+    // The count is checked against the size by division first, so that a
+    // damaged count cannot wrap the product around to match
+    size_t records = _mapped - sizeof(PoolHeader);
+    if (_length == 0 || _count > records / _length) {
+        ::munmap(_data, _mapped);
+        throw std::runtime_error("Corrupt barcode pool: " + filename);
+    }
+    if (records != _length * _count) {
+        ::munmap(_data, _mapped);
+        throw std::runtime_error("Truncated barcode pool: " + filename);
+    }
+    _records = static_cast<const char*>(_data) + sizeof(PoolHeader);
+
+    _config.stem_length = header.stem_length;
+    _config.stem = StemConfig::for_barcode(header.stem_length);
+    _config.stem.max_au = header.max_au;
+    _config.stem.max_gc = header.max_gc;
+    _config.stem.max_gu = header.max_gu;
+    _config.stem.closing_gc = header.closing_gc;
+    _config.min_distance = header.min_distance;
+    _config.min_edit_distance = header.min_edit_distance;
+    _config.maximal = header.maximal != 0;
+}
+
+BarcodePool::~BarcodePool() {
+    if (_data) {
+        ::munmap(_data, _mapped);
+    }
+}
+
+void BarcodePool::check_compatible(const BarcodeConfig& config) const {
+    const StemConfig& ours = _config.stem;
+    const StemConfig& theirs = config.stem;
+    bool same_stems = _config.stem_length == config.stem_length &&
+        ours.max_au == theirs.max_au &&
+        ours.max_gc == theirs.max_gc &&
+        ours.max_gu == theirs.max_gu &&
+        ours.closing_gc == theirs.closing_gc;
+    if (!same_stems) {
+        throw std::invalid_argument(
+            "The barcode pool " + _filename + " was generated for stem length " +
+            std::to_string(_config.stem_length) + " with different stem constraints."
+        );
+    }
+    if (_config.min_distance < config.min_distance ||
+        _config.min_edit_distance < config.min_edit_distance) {
+        throw std::invalid_argument(
+            "The barcode pool " + _filename + " is separated by a minimum distance of " +
+            std::to_string(_config.min_distance) + " and edit distance of " +
+            std::to_string(_config.min_edit_distance) + ", less than requested."
+        );
+    }
+}
+
+void _write_barcode_pool(
+    const std::string& filename,
+    const BarcodeConfig& config,
+    const std::vector<std::string>& barcodes
+) {
+    PoolHeader header{};
+    std::memcpy(header.magic, BarcodePool::MAGIC, sizeof(header.magic));
+    header.version = BarcodePool::VERSION;
+    header.stem_length = static_cast<uint32_t>(config.stem_length);
+    header.barcode_length = static_cast<uint32_t>(2 * config.stem_length + HAIRPIN_LOOP_LENGTH);
+    header.maximal = config.maximal ? 1 : 0;
+    header.max_au = config.stem.max_au;
+    header.max_gc = config.stem.max_gc;
+    header.max_gu = config.stem.max_gu;
+    header.closing_gc = config.stem.closing_gc;
+    header.min_distance = config.min_distance;
+    header.min_edit_distance = config.min_edit_distance;
+    header.count = barcodes.size();
+
+    std::ofstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("Failed to open output file: " + filename);
+    }
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    for (const std::string& barcode : barcodes) {
+        if (barcode.length() != header.barcode_length) {
+            throw std::runtime_error("Barcode of unexpected length in pool: " + barcode);
+        }
+        file.write(barcode.data(), barcode.length());
+    }
+    if (!file) {
+        throw std::runtime_error("Failed to write barcode pool: " + filename);
+    }
+}
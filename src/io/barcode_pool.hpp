@@ -0,0 +1,61 @@
+#ifndef BARCODE_POOL_H
+#define BARCODE_POOL_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "../config/barcode_config.hpp"
+
+// A precomputed pool of barcodes on disk (.fldbc).
+//
+// The file is a fixed header recording the configuration the barcodes
+// were generated with, followed by the barcodes back to back with no
+// separators, all of the same length. Integers are stored in host byte
+// order. A pool is opened with mmap, so reading a barcode is a pointer
+// offset, and processes opening the same pool share its pages.
+class BarcodePool {
+public:
+    static constexpr char MAGIC[8] = {'F', 'L', 'D', 'B', 'C', 'P', 'L', '\0'};
+    static constexpr uint32_t VERSION = 1;
+
+    explicit BarcodePool(const std::string& filename);
+    ~BarcodePool();
+
+    BarcodePool(const BarcodePool&) = delete;
+    BarcodePool& operator=(const BarcodePool&) = delete;
+
+    // The configuration the pool was generated with
+    const BarcodeConfig& config() const { return _config; }
+
+    // Number of barcodes in the pool
+    size_t size() const { return _count; }
+
+    // The barcode at the given position
+    std::string_view operator[](size_t ix) const {
+        return std::string_view(_records + ix * _length, _length);
+    }
+
+    // Throw if barcodes from this pool do not satisfy the configuration:
+    // the stem constraints must match, and the pool must be separated at
+    // least as strictly as requested
+    void check_compatible(const BarcodeConfig& config) const;
+
+private:
+    std::string _filename;
+    void* _data = nullptr;
+    size_t _mapped = 0;
+    const char* _records = nullptr;
+    size_t _length = 0;
+    size_t _count = 0;
+    BarcodeConfig _config;
+};
+
+// Write barcodes generated with the given configuration to a pool file
+void _write_barcode_pool(
+    const std::string& filename,
+    const BarcodeConfig& config,
+    const std::vector<std::string>& barcodes
+);
+
+#endif
@@ -0,0 +1,400 @@
+#include "compressed_file.hpp"
+#include "../utils.hpp"
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#ifdef FLD_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+// Bytes decompressed per read from a gzip file
+static constexpr size_t READ_BUFFER_SIZE = 1 << 20;
+
+// Bytes of output compressed at a time, as one gzip member or zstd frame
+static constexpr size_t COMPRESS_BLOCK = 1 << 20;
+
+// zstd level for output: the library default, which compresses about as
+// well as gzip at several times the speed
+static constexpr int ZSTD_LEVEL = 3;
+
+static inline bool _ends_with(const std::string& str, const std::string& suffix) {
+    return str.size() >= suffix.size() &&
+        str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+static inline void _throw_no_zstd(const std::string& filename) {
+    throw std::runtime_error(filename + " is zstd-compressed, but fld was built without zstd.");
+}
+
+// The compression told by the first bytes of a stream
+static Compression _compression_of(const unsigned char* magic, size_t size) {
+    if (size >= 2 && magic[0] == 0x1f && magic[1] == 0x8b) {
+        return Compression::Gzip;
+    }
+    if (size >= 4 && magic[0] == 0x28 && magic[1] == 0xb5 && magic[2] == 0x2f && magic[3] == 0xfd) {
+        return Compression::Zstd;
+    }
+    return Compression::None;
+}
+
+Compression detect_compression(const std::string& filename) {
+    std::ifstream file(filename, std::ios::binary);
+    unsigned char magic[4] = {0, 0, 0, 0};
+    file.read(reinterpret_cast<char*>(magic), sizeof(magic));
+    return _compression_of(magic, static_cast<size_t>(file.gcount()));
+}
+
+Compression compression_for(const std::string& filename) {
+    if (_ends_with(filename, ".gz")) {
+        return Compression::Gzip;
+    }
+    if (_ends_with(filename, ".zst")) {
+        return Compression::Zstd;
+    }
+    return Compression::None;
+}
+
+bool zstd_supported() {
+#ifdef FLD_HAVE_ZSTD
+    return true;
+#else
+    return false;
+#endif
+}
+
+//
+// DecompressingReader
+//
+
+DecompressingReader::DecompressingReader(const std::string& filename) : _filename(filename) {
+    // Only regular files are sniffed ahead of time: reading the first bytes
+    // of a pipe consumes them. zlib reads a pipe as gzip or as plain bytes,
+    // and a zstd stream is told from the first bytes it passes through.
+    std::error_code error;
+    bool regular = std::filesystem::is_regular_file(filename, error);
+    if (regular && detect_compression(filename) == Compression::Zstd) {
+        if (!zstd_supported()) {
+            _throw_no_zstd(filename);
+        }
+        _raw = std::fopen(filename.c_str(), "rb");
+        if (!_raw) {
+            throw std::runtime_error("Failed to open file: " + filename);
+        }
+        _start_zstd();
+        return;
+    }
+    _gz = gzopen(filename.c_str(), "rb");
+    if (!_gz) {
+        throw std::runtime_error("Failed to open file: " + filename);
+    }
+    gzbuffer(_gz, READ_BUFFER_SIZE);
+    _sniff = !regular;
+}
+
+DecompressingReader::~DecompressingReader() {
+    if (_gz) {
+        gzclose(_gz);
+    }
+#ifdef FLD_HAVE_ZSTD
+    if (_zstd) {
+        ZSTD_freeDStream(static_cast<ZSTD_DStream*>(_zstd));
+    }
+#endif
+    if (_raw) {
+        std::fclose(_raw);
+    }
+}
+
+size_t DecompressingReader::read(char* out, size_t size) {
+    if (_sniff) {
+        _sniff_stream();
+    }
+    if (_zstd) {
+        return _read_zstd(out, size);
+    }
+    // Hand out the bytes read ahead by _sniff_stream first
+    if (_in_pos < _in_end) {
+        size_t count = std::min(size, _in_end - _in_pos);
+        std::memcpy(out, _in.data() + _in_pos, count);
+        _in_pos += count;
+        return count;
+    }
+    return _read_gz(out, size);
+}
+
+size_t DecompressingReader::_read_gz(char* out, size_t size) {
+    int read = gzread(_gz, out, static_cast<unsigned>(std::min<size_t>(size, INT_MAX)));
+    if (read < 0) {
+        int code;
+        throw std::runtime_error("Failed to read " + _filename + ": " + gzerror(_gz, &code));
+    }
+    return static_cast<size_t>(read);
+}
+
+void DecompressingReader::_sniff_stream() {
+    _sniff = false;
+    _in.resize(4);
+    while (_in_end < _in.size()) {
+        size_t read = _read_gz(_in.data() + _in_end, _in.size() - _in_end);
+        if (read == 0) break;
+        _in_end += read;
+    }
+    // zlib passes bytes that are not gzip through unchanged
+    if (gzdirect(_gz) && _compression_of(reinterpret_cast<const unsigned char*>(_in.data()), _in_end) == Compression::Zstd) {
+        _start_zstd();
+    }
+}
+
+void DecompressingReader::_start_zstd() {
+#ifdef FLD_HAVE_ZSTD
+    ZSTD_DStream* stream = ZSTD_createDStream();
+    ZSTD_initDStream(stream);
+    _zstd = stream;
+    // Keeps any bytes already read ahead
+    _in.resize(ZSTD_DStreamInSize());
+#else
+    _throw_no_zstd(_filename);
+#endif
+}
+
+size_t DecompressingReader::_read_zstd(char* out, size_t size) {
+#ifdef FLD_HAVE_ZSTD
+    ZSTD_outBuffer output = {out, size, 0};
+    while (output.pos == 0 && size > 0) {
+        if (_in_pos == _in_end) {
+            _in_pos = 0;
+            // From the file, or from a pipe through zlib
+            _in_end = _raw ? std::fread(_in.data(), 1, _in.size(), _raw) : _read_gz(_in.data(), _in.size());
+            if (_in_end == 0) {
+                if ((_raw && std::ferror(_raw)) || !_frame_done) {
+                    throw std::runtime_error("Failed to read " + _filename + ": truncated zstd stream");
+                }
+                return 0;
+            }
+        }
+        ZSTD_inBuffer input = {_in.data(), _in_end, _in_pos};
+        size_t result = ZSTD_decompressStream(static_cast<ZSTD_DStream*>(_zstd), &output, &input);
+        if (ZSTD_isError(result)) {
+            throw std::runtime_error("Failed to read " + _filename + ": " + ZSTD_getErrorName(result));
+        }
+        _in_pos = input.pos;
+        _frame_done = result == 0;
+    }
+    return output.pos;
+#else
+    (void)out;
+    (void)size;
+    _throw_no_zstd(_filename);
+    return 0;
+#endif
+}
+
+//
+// InputFile
+//
+
+class InputFile::Buffer : public std::streambuf {
+public:
+    explicit Buffer(const std::string& filename) : _reader(filename), _data(READ_BUFFER_SIZE) {}
+
+protected:
+    int_type underflow() override {
+        size_t read = _reader.read(_data.data(), _data.size());
+        if (read == 0) {
+            return traits_type::eof();
+        }
+        setg(_data.data(), _data.data(), _data.data() + read);
+        return traits_type::to_int_type(_data[0]);
+    }
+
+private:
+    DecompressingReader _reader;
+    std::vector<char> _data;
+};
+
+InputFile::InputFile(const std::string& filename) : std::istream(nullptr) {
+    std::error_code error;
+    if (!std::filesystem::exists(filename, error)) {
+        setstate(std::ios::failbit);
+        return;
+    }
+    _buffer = std::make_unique<Buffer>(filename);
+    rdbuf(_buffer.get());
+}
+
+InputFile::~InputFile() = default;
+
+void InputFile::close() {
+    rdbuf(nullptr);
+    _buffer.reset();
+}
+
+//
+// OutputFile
+//
+
+static void _compress_gzip(const std::string& in, std::string& out) {
+    z_stream stream{};
+    if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        throw std::runtime_error("Failed to start gzip compression");
+    }
+    out.resize(deflateBound(&stream, in.size()));
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(in.data()));
+    stream.avail_in = static_cast<uInt>(in.size());
+    stream.next_out = reinterpret_cast<Bytef*>(out.data());
+    stream.avail_out = static_cast<uInt>(out.size());
+    int result = deflate(&stream, Z_FINISH);
+    deflateEnd(&stream);
+    if (result != Z_STREAM_END) {
+        throw std::runtime_error("Failed to gzip a block of output");
+    }
+    out.resize(stream.total_out);
+}
+
+static void _compress_zstd(const std::string& in, std::string& out) {
+#ifdef FLD_HAVE_ZSTD
+    out.resize(ZSTD_compressBound(in.size()));
+    size_t size = ZSTD_compress(out.data(), out.size(), in.data(), in.size(), ZSTD_LEVEL);
+    if (ZSTD_isError(size)) {
+        throw std::runtime_error(std::string("Failed to compress a block of output: ") + ZSTD_getErrorName(size));
+    }
+    out.resize(size);
+#else
+    (void)in;
+    (void)out;
+#endif
+}
+
+class OutputFile::Buffer : public std::streambuf {
+public:
+    Buffer(const std::string& filename, size_t threads)
+        : _filename(filename), _compression(compression_for(filename)), _threads(std::max<size_t>(threads, 1)) {
+        if (_compression == Compression::Zstd && !zstd_supported()) {
+            throw std::runtime_error("Cannot write " + filename + ": fld was built without zstd.");
+        }
+        _file.open(filename, std::ios::binary);
+        _block.resize(COMPRESS_BLOCK);
+        setp(_block.data(), _block.data() + _block.size());
+    }
+
+    bool is_open() const { return _file.is_open(); }
+
+    // Write out the rest and close the file, throwing if any of the
+    // output failed to reach it
+    void finish() {
+        _cut();
+        _write_pending();
+        _file.close();
+        if (!_file) {
+            throw std::runtime_error("Failed to write " + _filename);
+        }
+    }
+
+protected:
+    int_type overflow(int_type c) override {
+        _cut();
+        if (!traits_type::eq_int_type(c, traits_type::eof())) {
+            *pptr() = traits_type::to_char_type(c);
+            pbump(1);
+        }
+        return traits_type::not_eof(c);
+    }
+
+    int sync() override {
+        if (_compression == Compression::None) {
+            _cut();
+            _file.flush();
+        }
+        return _file ? 0 : -1;
+    }
+
+private:
+    std::string _filename;
+    Compression _compression;
+    size_t _threads;
+    std::ofstream _file;
+    std::string _block;
+    std::vector<std::string> _pending;
+    std::vector<std::string> _compressed;
+    size_t _pending_count = 0;
+
+    // End the current block: write it out if plain, or queue it for
+    // compression
+    void _cut() {
+        size_t used = static_cast<size_t>(pptr() - pbase());
+        if (used == 0) return;
+        if (_compression == Compression::None) {
+            _file.write(pbase(), static_cast<std::streamsize>(used));
+        } else {
+            if (_pending.size() == _pending_count) {
+                _pending.emplace_back();
+            }
+            _pending[_pending_count++].assign(pbase(), used);
+            if (_pending_count == _threads) {
+                _write_pending();
+            }
+        }
+        setp(_block.data(), _block.data() + _block.size());
+    }
+
+    // Compress the queued blocks in parallel, and write them in order
+    void _write_pending() {
+        if (_pending_count == 0) return;
+        _compressed.resize(std::max(_compressed.size(), _pending_count));
+        std::atomic<size_t> next{0};
+        _run_workers(std::min(_threads, _pending_count), [&](size_t) {
+            for (size_t ix = next++; ix < _pending_count; ix = next++) {
+                if (_compression == Compression::Gzip) {
+                    _compress_gzip(_pending[ix], _compressed[ix]);
+                } else {
+                    _compress_zstd(_pending[ix], _compressed[ix]);
+                }
+            }
+        });
+        for (size_t ix = 0; ix < _pending_count; ix++) {
+            _file.write(_compressed[ix].data(), static_cast<std::streamsize>(_compressed[ix].size()));
+        }
+        _pending_count = 0;
+    }
+};
+
+OutputFile::OutputFile() : std::ostream(nullptr) {}
+
+OutputFile::OutputFile(const std::string& filename, size_t threads) : std::ostream(nullptr) {
+    open(filename, threads);
+}
+
+OutputFile::~OutputFile() {
+    try {
+        close();
+    } catch (const std::exception&) {
+        // Destructors must not throw; call close() to see errors
+    }
+}
+
+void OutputFile::open(const std::string& filename, size_t threads) {
+    close();
+    auto buffer = std::make_unique<Buffer>(filename, threads);
+    if (!buffer->is_open()) {
+        setstate(std::ios::failbit);
+        return;
+    }
+    _buffer = std::move(buffer);
+    rdbuf(_buffer.get());
+}
+
+bool OutputFile::is_open() const {
+    return _buffer && _buffer->is_open();
+}
+
+void OutputFile::close() {
+    if (!_buffer) return;
+    // Let go of the buffer first, so that a failed close is not retried
+    std::unique_ptr<Buffer> buffer = std::move(_buffer);
+    rdbuf(nullptr);
+    buffer->finish();
+}
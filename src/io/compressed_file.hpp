@@ -0,0 +1,103 @@
+#ifndef COMPRESSED_FILE_H
+#define COMPRESSED_FILE_H
+
+#include <cstdio>
+#include <istream>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <zlib.h>
+
+// How a file is compressed
+enum class Compression {
+    None,
+    Gzip,
+    Zstd
+};
+
+// The compression of an existing file, told by its first bytes. A file
+// that cannot be read counts as uncompressed.
+Compression detect_compression(const std::string& filename);
+
+// The compression to write a file with, told by its extension: .gz for
+// gzip and .zst for zstd
+Compression compression_for(const std::string& filename);
+
+// Whether this build reads and writes zstd
+bool zstd_supported();
+
+// Streams the decompressed bytes of a file, plain, gzip- or
+// zstd-compressed. zlib reads plain files through unchanged. Pipes, such
+// as /dev/stdin, are read as they come, without being opened twice.
+class DecompressingReader {
+public:
+    explicit DecompressingReader(const std::string& filename);
+    ~DecompressingReader();
+
+    DecompressingReader(const DecompressingReader&) = delete;
+    DecompressingReader& operator=(const DecompressingReader&) = delete;
+
+    // Read up to size bytes into out, returning the number read, which is
+    // zero only at the end of the file
+    size_t read(char* out, size_t size);
+
+private:
+    std::string _filename;
+    gzFile _gz = nullptr;
+    std::FILE* _raw = nullptr;
+    void* _zstd = nullptr;
+    std::vector<char> _in;
+    size_t _in_pos = 0;
+    size_t _in_end = 0;
+    bool _frame_done = true;
+    // Whether the first bytes of a pipe are still to be checked for zstd
+    bool _sniff = false;
+
+    size_t _read_gz(char* out, size_t size);
+    size_t _read_zstd(char* out, size_t size);
+    void _sniff_stream();
+    void _start_zstd();
+};
+
+// An input stream over a file, plain or compressed, decompressed as it is
+// read. Like std::ifstream, a file that cannot be opened leaves the stream
+// failed rather than throwing.
+class InputFile : public std::istream {
+public:
+    explicit InputFile(const std::string& filename);
+    ~InputFile();
+
+    bool is_open() const { return _buffer != nullptr; }
+    void close();
+
+private:
+    class Buffer;
+    std::unique_ptr<Buffer> _buffer;
+};
+
+// An output stream to a file, compressed as its extension says.
+//
+// Compressed output is cut into blocks, and each block is compressed on
+// its own, as a gzip member or a zstd frame; decompressors read the blocks
+// back as one stream. Blocks are compressed on the given number of threads
+// and written in order. Flushing does not cut a block short, so compressed
+// output reaches the file a block at a time, and in full on close. close()
+// throws if any output failed to reach the file; the destructor cannot, so
+// call close() to see write errors.
+class OutputFile : public std::ostream {
+public:
+    OutputFile();
+    explicit OutputFile(const std::string& filename, size_t threads = 1);
+    ~OutputFile();
+
+    void open(const std::string& filename, size_t threads = 1);
+    bool is_open() const;
+    void close();
+
+private:
+    class Buffer;
+    std::unique_ptr<Buffer> _buffer;
+};
+
+#endif
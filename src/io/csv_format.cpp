@@ -1,6 +1,12 @@
 #include "csv_format.hpp"
+#include "../utils.hpp"
 #include <sstream>
 #include <algorithm>
+#include <bit>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
 
 namespace csv {
 
@@ -79,6 +85,17 @@ Header::Header(const std::string& line) : _header(line) {
         _columns[i] = col;
         _col_indices[col] = static_cast<int>(i);
     }
+    _sequence_slots.assign(_columns.size(), -1);
+    for (size_t slot = 0; slot < _required_columns.size(); slot++) {
+        int idx = index_of(_required_columns[slot]);
+        if (idx >= 0) {
+            _sequence_slots[idx] = static_cast<int>(slot);
+        }
+    }
+}
+
+int Header::sequence_slot(size_t column) const {
+    return (column < _sequence_slots.size()) ? _sequence_slots[column] : -1;
 }
 
 bool Header::has(const std::string& col) const {
@@ -119,6 +136,286 @@ void Header::validate() const {
     }
 }
 
+//
+// Tokenizer
+//
+
+static constexpr char QUOTE = '"';
+
+// Call visit(pos) on each delimiter and quote of text, in order, until it
+// returns false
+template <typename Visit>
+static inline void _for_each_structural(std::string_view text, char delimiter, Visit visit) {
+    size_t ix = 0;
+#if defined(__AVX2__)
+    const __m256i delimiters = _mm256_set1_epi8(delimiter);
+    const __m256i quotes = _mm256_set1_epi8(QUOTE);
+    for (; ix + 32 <= text.size(); ix += 32) {
+        __m256i reg = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text.data() + ix));
+        uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_or_si256(
+            _mm256_cmpeq_epi8(reg, delimiters), _mm256_cmpeq_epi8(reg, quotes)
+        )));
+        for (; mask != 0; mask &= mask - 1) {
+            if (!visit(ix + std::countr_zero(mask))) return;
+        }
+    }
+#elif defined(__SSE2__)
+    const __m128i delimiters = _mm_set1_epi8(delimiter);
+    const __m128i quotes = _mm_set1_epi8(QUOTE);
+    for (; ix + 16 <= text.size(); ix += 16) {
+        __m128i reg = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text.data() + ix));
+        uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(_mm_or_si128(
+            _mm_cmpeq_epi8(reg, delimiters), _mm_cmpeq_epi8(reg, quotes)
+        )));
+        for (; mask != 0; mask &= mask - 1) {
+            if (!visit(ix + std::countr_zero(mask))) return;
+        }
+    }
+#endif
+    for (; ix < text.size(); ix++) {
+        if (text[ix] == delimiter || text[ix] == QUOTE) {
+            if (!visit(ix)) return;
+        }
+    }
+}
+
+// Call field(column, raw, quotes) on each field of a line, in order, with
+// the number of quotes in it, until it returns false
+template <typename Field>
+static inline void _split_fields(std::string_view line, char delimiter, Field field) {
+    size_t column = 0;
+    size_t start = 0;
+    size_t quotes = 0;
+    bool quoted = false;
+    bool more = true;
+    _for_each_structural(line, delimiter, [&](size_t pos) {
+        if (line[pos] == QUOTE) {
+            quoted = !quoted;
+            quotes++;
+            return true;
+        }
+        if (quoted) return true;
+        more = field(column++, line.substr(start, pos - start), quotes);
+        start = pos + 1;
+        quotes = 0;
+        return more;
+    });
+    if (more) {
+        field(column, line.substr(start), quotes);
+    }
+}
+
+// The text of a field without its quoting: a view into the field, or into
+// scratch if quotes inside it had to be removed. Quotes outside a quoted
+// field are dropped.
+static inline std::string_view _unquote(std::string_view raw, size_t quotes, std::string& scratch) {
+    if (quotes == 0) {
+        return raw;
+    }
+    bool enclosed = raw.size() >= 2 && raw.front() == QUOTE && raw.back() == QUOTE;
+    if (enclosed && quotes == 2) {
+        return raw.substr(1, raw.size() - 2);
+    }
+    scratch.clear();
+    if (enclosed) {
+        std::string_view inner = raw.substr(1, raw.size() - 2);
+        for (size_t ix = 0; ix < inner.size(); ix++) {
+            if (inner[ix] != QUOTE) {
+                scratch += inner[ix];
+            } else if (ix + 1 < inner.size() && inner[ix + 1] == QUOTE) {
+                scratch += QUOTE;
+                ix++;
+            }
+        }
+    } else {
+        for (char c : raw) {
+            if (c != QUOTE) scratch += c;
+        }
+    }
+    return scratch;
+}
+
+Projection::Projection(const Header& header)
+    : _header(&header), _slots(header.size(), -1) {}
+
+size_t Projection::add(const std::string& col) {
+    int column = _header->index_of(col);
+    if (column >= 0 && _slots[column] >= 0) {
+        return static_cast<size_t>(_slots[column]);
+    }
+    size_t slot = _columns.size();
+    _columns.push_back(column);
+    if (column >= 0) {
+        _slots[column] = static_cast<int>(slot);
+        _end = std::max(_end, static_cast<size_t>(column) + 1);
+    }
+    return slot;
+}
+
+void Projection::add_all() {
+    for (size_t column = 0; column < _slots.size(); column++) {
+        if (_slots[column] < 0) {
+            _slots[column] = static_cast<int>(_columns.size());
+            _columns.push_back(static_cast<int>(column));
+        }
+    }
+    _end = _slots.size();
+}
+
+Row::Row(const Projection& projection)
+    : _projection(&projection),
+      _fields(projection.size()),
+      _present(projection.size(), 0),
+      _unescaped(projection.size()) {}
+
+void Row::parse(std::string_view line) {
+    const Projection& projection = *_projection;
+    size_t parsed = 0;
+    _split_fields(line, ',', [&](size_t column, std::string_view raw, size_t quotes) {
+        parsed = column + 1;
+        int slot = (column < projection._slots.size()) ? projection._slots[column] : -1;
+        if (slot >= 0) {
+            _fields[slot] = _unquote(raw, quotes, _unescaped[slot]);
+        }
+        return parsed < projection._end;
+    });
+    for (size_t slot = 0; slot < _fields.size(); slot++) {
+        int column = projection._columns[slot];
+        _present[slot] = column >= 0 && static_cast<size_t>(column) < parsed;
+        if (!_present[slot]) {
+            _fields[slot] = std::string_view();
+        }
+    }
+}
+
+void split(std::string_view line, char delimiter, std::vector<std::string>& out) {
+    out.clear();
+    std::string scratch;
+    _split_fields(line, delimiter, [&](size_t, std::string_view raw, size_t quotes) {
+        out.emplace_back(_unquote(raw, quotes, scratch));
+        return true;
+    });
+}
+
+//
+// PackedRow
+//
+
+PackedRow::PackedRow(const Header& header, const std::vector<std::string>& fields)
+    : PackedRow(header, std::vector<std::string_view>(fields.begin(), fields.end())) {}
+
+PackedRow::PackedRow(const Header& header, std::span<const std::string_view> fields)
+    : _header(&header), _fields(static_cast<uint32_t>(fields.size())) {
+    std::array<std::string_view, SEQUENCE_COLUMNS> columns{};
+    for (size_t i = 0; i < fields.size(); i++) {
+        int slot = header.sequence_slot(i);
+        if (slot >= 0) {
+            columns[slot] = fields[i];
+        } else {
+            _text += fields[i];
+            _text += '\n';
+        }
+    }
+    _pack(columns);
+}
+
+void PackedRow::_pack(const std::array<std::string_view, SEQUENCE_COLUMNS>& columns) {
+    std::string sequence;
+    for (size_t slot = 0; slot < SEQUENCE_COLUMNS; slot++) {
+        sequence += columns[slot];
+        _ends[slot] = static_cast<uint32_t>(sequence.size());
+    }
+    _sequence = PackedSequence(sequence);
+}
+
+// Text fields are those of the columns that are not sequence columns, in
+// order
+std::string_view PackedRow::_text_field(size_t column) const {
+    size_t ordinal = 0;
+    for (size_t i = 0; i < column; i++) {
+        if (_header->sequence_slot(i) < 0) ordinal++;
+    }
+    size_t begin = 0;
+    for (; ordinal > 0; ordinal--) {
+        begin = _text.find('\n', begin) + 1;
+    }
+    return std::string_view(_text).substr(begin, _text.find('\n', begin) - begin);
+}
+
+std::string PackedRow::get(const std::string& col, const std::string& default_value) const {
+    int idx = _header->index_of(col);
+    if (idx < 0 || static_cast<size_t>(idx) >= _fields) {
+        return default_value;
+    }
+    int slot = _header->sequence_slot(idx);
+    if (slot < 0) {
+        return std::string(_text_field(idx));
+    }
+    size_t begin = (slot == 0) ? 0 : _ends[slot - 1];
+    std::string field;
+    _sequence.append_to(field, begin, _ends[slot] - begin);
+    return field;
+}
+
+void PackedRow::set(const std::string& col, std::string_view value) {
+    int idx = _header->index_of(col);
+    if (idx < 0 || static_cast<size_t>(idx) >= _fields) {
+        return;
+    }
+    int slot = _header->sequence_slot(idx);
+    if (slot < 0) {
+        std::string_view old = _text_field(idx);
+        size_t begin = old.data() - _text.data();
+        _text.replace(begin, old.size(), value);
+        return;
+    }
+    std::string sequence = _sequence.str();
+    std::array<std::string_view, SEQUENCE_COLUMNS> columns;
+    for (size_t s = 0; s < SEQUENCE_COLUMNS; s++) {
+        size_t begin = (s == 0) ? 0 : _ends[s - 1];
+        columns[s] = std::string_view(sequence).substr(begin, _ends[s] - begin);
+    }
+    columns[slot] = value;
+    _pack(columns);
+}
+
+template <typename Visit>
+void PackedRow::_for_each_field(Visit visit) const {
+    std::string field;
+    size_t text_begin = 0;
+    for (size_t i = 0; i < _fields; i++) {
+        int slot = _header->sequence_slot(i);
+        field.clear();
+        if (slot < 0) {
+            size_t text_end = _text.find('\n', text_begin);
+            field.assign(_text, text_begin, text_end - text_begin);
+            text_begin = text_end + 1;
+        } else {
+            size_t begin = (slot == 0) ? 0 : _ends[slot - 1];
+            _sequence.append_to(field, begin, _ends[slot] - begin);
+        }
+        visit(i, field);
+    }
+}
+
+void PackedRow::append_csv(std::string& out) const {
+    _for_each_field([&](size_t i, const std::string& field) {
+        if (i > 0) out += ',';
+        out += _quote_csv_field(field);
+    });
+}
+
+void PackedRow::fields(std::vector<std::string>& out) const {
+    out.resize(_fields);
+    _for_each_field([&](size_t i, const std::string& field) {
+        out[i] = field;
+    });
+}
+
+void PackedRow::append_sequence(std::string& out) const {
+    _sequence.append_to(out);
+}
+
 bool is_valid_header(const std::string& line) {
     try {
         Header h(line);
@@ -14,7 +14,12 @@
 #ifndef CSV_FORMAT_H
 #define CSV_FORMAT_H
 
+#include "../domain/packed_sequence.hpp"
+#include <array>
+#include <cstdint>
+#include <span>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <unordered_map>
 #include <stdexcept>
@@ -74,6 +79,10 @@ public:
     /// Number of columns
     size_t size() const { return _columns.size(); }
 
+    /// Position of a column among the required columns, or -1 if it is
+    /// not one of them
+    int sequence_slot(size_t column) const;
+
     /// Validate that all required columns are present
     /// Throws std::runtime_error if validation fails
     void validate() const;
@@ -82,6 +91,134 @@ private:
     std::string _header;
     std::vector<std::string> _columns;
     std::unordered_map<std::string, int> _col_indices;
+    std::vector<int> _sequence_slots;
+};
+
+/**
+ * @brief The columns of a file that a reader needs.
+ *
+ * Built once from the header, so that each row is split only as far as the
+ * last column needed, and its fields are found by slot rather than looked
+ * up by name. The header must outlive the projection.
+ */
+class Projection {
+public:
+    explicit Projection(const Header& header);
+
+    /// Add a column and return its slot. A column missing from the header
+    /// reads as the default.
+    size_t add(const std::string& col);
+
+    /// Add every column of the header in order. On an empty projection,
+    /// the slot of each column is its index, even where names repeat.
+    void add_all();
+
+    /// Number of slots
+    size_t size() const { return _columns.size(); }
+
+    /// The header column of a slot, or -1 if it is missing
+    int column(size_t slot) const { return _columns[slot]; }
+
+private:
+    friend class Row;
+    const Header* _header;
+    // The header column of each slot, or -1
+    std::vector<int> _columns;
+    // The slot of each header column, or -1
+    std::vector<int> _slots;
+    // One past the last header column with a slot
+    size_t _end = 0;
+};
+
+/**
+ * @brief The fields of one CSV row, as chosen by a Projection.
+ *
+ * Fields follow RFC 4180: a field in double quotes may hold commas, and a
+ * doubled quote within it stands for one quote. The row is scanned for
+ * commas and quotes a vector register at a time. Fields are views into the
+ * line, except those with escaped quotes, which are unescaped into buffers
+ * the row reuses; either way they are valid until the next parse.
+ */
+class Row {
+public:
+    explicit Row(const Projection& projection);
+
+    /// Split a line, without its newline
+    void parse(std::string_view line);
+
+    /// A field, or empty if the column is not present
+    std::string_view operator[](size_t slot) const { return _fields[slot]; }
+
+    /// Whether the column is present in both the header and the row
+    bool has(size_t slot) const { return _present[slot]; }
+
+    /// A field, or default if the column is not present in the header or
+    /// the row
+    std::string_view get(size_t slot, std::string_view default_value) const {
+        return _present[slot] ? _fields[slot] : default_value;
+    }
+
+    /// Every field, by slot
+    std::span<const std::string_view> fields() const { return _fields; }
+
+private:
+    const Projection* _projection;
+    std::vector<std::string_view> _fields;
+    std::vector<uint8_t> _present;
+    std::vector<std::string> _unescaped;
+};
+
+/// Split a line of delimited text into every field, by the rules of Row
+void split(std::string_view line, char delimiter, std::vector<std::string>& out);
+
+/**
+ * @brief A parsed row that holds its sequence columns packed.
+ *
+ * For commands that keep a whole library in memory. The required columns
+ * are packed back to back, in sequence order, at two bits per base, and the
+ * other fields are kept as text. The header must outlive the row.
+ */
+class PackedRow {
+public:
+    PackedRow(const Header& header, const std::vector<std::string>& fields);
+
+    /// From a row split with every column, in order
+    PackedRow(const Header& header, std::span<const std::string_view> fields);
+
+    /// Get a field, or default if the column is not present
+    std::string get(const std::string& col, const std::string& default_value = "") const;
+
+    /// Replace a field, if the column is present
+    void set(const std::string& col, std::string_view value);
+
+    /// Append the fields as a CSV record, without a newline
+    void append_csv(std::string& out) const;
+
+    /// Unpack every field, in column order
+    void fields(std::vector<std::string>& out) const;
+
+    /// Append the full construct sequence
+    void append_sequence(std::string& out) const;
+
+private:
+    static constexpr size_t SEQUENCE_COLUMNS = 6;
+
+    const Header* _header;
+    PackedSequence _sequence;
+    // Where each sequence column ends in the packed sequence
+    std::array<uint32_t, SEQUENCE_COLUMNS> _ends{};
+    // The other fields, each followed by a newline, which no field read
+    // line by line can hold
+    std::string _text;
+    uint32_t _fields = 0;
+
+    void _pack(const std::array<std::string_view, SEQUENCE_COLUMNS>& columns);
+    std::string_view _text_field(size_t column) const;
+
+    // Call visit(column, field) on each field in order, with the field in a
+    // buffer reused between calls
+    template <typename Visit>
+    void _for_each_field(Visit visit) const;
 };
 
 // Legacy support - column indices for standard format
@@ -1,54 +1,130 @@
 #include "fasta_io.hpp"
+#include <atomic>
+#include <cstring>
+#include <filesystem>
 #include <stdexcept>
 
-static inline bool is_header(const std::string& line) {
-    return !line.empty() && line[0] == '>';
+// Bytes decompressed at a time into the window of a compressed file
+static constexpr size_t DECOMPRESS_BLOCK = 1 << 20;
+
+FastaSource::FastaSource(const std::string& path) {
+    // Pipes are not sniffed, since reading their first bytes consumes them
+    if (std::filesystem::is_regular_file(path) && detect_compression(path) != Compression::None) {
+        _reader.emplace(path);
+    } else {
+        _file.emplace(path);
+    }
 }
 
-static inline std::string extract_name(const std::string& header_line) {
-    return header_line.substr(1);
+bool FastaSource::next(std::string_view& text, bool& ends_file, size_t min_bytes) {
+    if (_done) {
+        return false;
+    }
+    if (_file) {
+        text = _file->view();
+        ends_file = true;
+        _done = true;
+        return !text.empty();
+    }
+
+    // Keep what followed the last window, then decompress until there is
+    // enough text and a header to cut it at
+    _buffer.erase(0, _window);
+    size_t cut = 0;
+    while (!_done) {
+        while (_buffer.size() < min_bytes) {
+            size_t size = _buffer.size();
+            _buffer.resize(size + DECOMPRESS_BLOCK);
+            size_t read = _reader->read(_buffer.data() + size, DECOMPRESS_BLOCK);
+            _buffer.resize(size + read);
+            if (read == 0) {
+                _done = true;
+                break;
+            }
+        }
+        if (_done) {
+            cut = _buffer.size();
+        } else {
+            size_t header = std::string_view(_buffer).rfind("\n>");
+            cut = (header == std::string_view::npos) ? 0 : header + 1;
+            if (cut > 0) break;
+            // One entry fills the window, so widen it
+            min_bytes = 2 * _buffer.size();
+        }
+    }
+    _window = cut;
+    text = std::string_view(_buffer).substr(0, cut);
+    ends_file = _done;
+    return !text.empty();
 }
 
-std::vector<FastaEntry> read_fasta(const std::string& path) {
-    std::vector<FastaEntry> entries;
-    for_each_fasta(path, [&entries](const FastaEntry& entry) {
-        entries.push_back(entry);
-    });
-    return entries;
+FastaReader::FastaReader(const std::string& path) : _ends_file(false) {
+    _source.emplace(path);
 }
 
-void for_each_fasta(const std::string& path, FastaCallback callback) {
-    std::ifstream file(path);
-    if (!file) {
-        throw std::runtime_error("Cannot open FASTA file: " + path);
-    }
+FastaReader::FastaReader(std::string_view text, bool ends_file)
+    : _text(text), _ends_file(ends_file) {}
 
-    std::string line;
-    FastaEntry current;
-    bool has_entry = false;
+// The line at the read position, without its newline, moving past it
+std::string_view FastaReader::_line() {
+    const char* begin = _text.data() + _pos;
+    size_t remaining = _text.size() - _pos;
+    const char* end = static_cast<const char*>(std::memchr(begin, '\n', remaining));
+    size_t length = end ? static_cast<size_t>(end - begin) : remaining;
+    _pos += end ? length + 1 : length;
+    return std::string_view(begin, length);
+}
 
-    while (std::getline(file, line)) {
+bool FastaReader::next(FastaRecord& record) {
+    std::string_view line;
+    do {
+        if (_pos >= _text.size()) {
+            if (!_source || !_source->next(_text, _ends_file)) {
+                return false;
+            }
+            _pos = 0;
+        }
+        line = _line();
+    } while (line.empty() || line[0] != '>');
+    record.name = line.substr(1);
+
+    // Sequence lines run up to the next header
+    record.sequence = std::string_view();
+    bool joined = false;
+    while (_pos < _text.size() && _text[_pos] != '>') {
+        line = _line();
         if (line.empty()) {
             continue;
         }
-
-        if (is_header(line)) {
-            // Process previous entry if exists
-            if (has_entry) {
-                callback(current);
-                current.sequence.clear();
-            }
-            current.name = extract_name(line);
-            has_entry = true;
-        } else {
-            current.sequence += line;
+        if (record.sequence.empty()) {
+            record.sequence = line;
+            continue;
+        }
+        if (!joined) {
+            _sequence.assign(record.sequence);
+            joined = true;
         }
+        _sequence += line;
+        record.sequence = _sequence;
     }
+    return !record.sequence.empty() || _pos < _text.size() || !_ends_file;
+}
 
-    // Process final entry
-    if (has_entry && !current.sequence.empty()) {
-        callback(current);
-    }
+std::vector<FastaEntry> read_fasta(const std::string& path) {
+    std::vector<FastaEntry> entries;
+    for_each_fasta_record(path, [&entries](const FastaRecord& record) {
+        entries.push_back({std::string(record.name), std::string(record.sequence)});
+    });
+    return entries;
+}
+
+void for_each_fasta(const std::string& path, FastaCallback callback) {
+    FastaEntry entry;
+    for_each_fasta_record(path, [&](const FastaRecord& record) {
+        entry.name.assign(record.name);
+        entry.sequence.assign(record.sequence);
+        callback(entry);
+    });
 }
 
 void for_each_fasta_indexed(
@@ -61,36 +137,119 @@ void for_each_fasta_indexed(
     });
 }
 
-size_t count_fasta_entries(const std::string& path) {
+// The start of the first header line at or after pos, or the end of the text
+static size_t _next_header(std::string_view text, size_t pos) {
+    while (pos < text.size()) {
+        if (text[pos] == '>' && (pos == 0 || text[pos - 1] == '\n')) {
+            return pos;
+        }
+        const char* newline = static_cast<const char*>(
+            std::memchr(text.data() + pos, '\n', text.size() - pos)
+        );
+        if (!newline) {
+            break;
+        }
+        pos = static_cast<size_t>(newline - text.data()) + 1;
+    }
+    return text.size();
+}
+
+// The number of header lines in a chunk
+static size_t _count_headers(std::string_view text) {
     size_t count = 0;
-    std::ifstream file(path);
-    if (!file) {
-        throw std::runtime_error("Cannot open FASTA file: " + path);
+    for (size_t pos = _next_header(text, 0); pos < text.size(); pos = _next_header(text, pos + 1)) {
+        count++;
+    }
+    return count;
+}
+
+std::vector<FastaChunk> split_fasta(std::string_view text, size_t chunk_bytes) {
+    std::vector<FastaChunk> chunks;
+    size_t begin = 0;
+    while (begin < text.size()) {
+        size_t end = _next_header(text, std::min(begin + std::max<size_t>(chunk_bytes, 1), text.size()));
+        chunks.push_back({text.substr(begin, end - begin), 0, end == text.size()});
+        begin = end;
     }
+    return chunks;
+}
 
-    std::string line;
-    while (std::getline(file, line)) {
-        if (is_header(line)) {
-            count++;
+void for_each_fasta_chunk(
+    const std::string& path,
+    size_t threads,
+    const std::function<void(size_t slot, const FastaChunk& chunk)>& work,
+    const std::function<void(size_t slot)>& done,
+    size_t chunk_bytes
+) {
+    threads = std::max<size_t>(threads, 1);
+    FastaSource source(path);
+    std::string_view text;
+    bool ends_file = false;
+
+    // Headers are counted before a wave is read, so that each chunk knows
+    // the index of its first entry
+    std::vector<size_t> headers(threads);
+    size_t first = 0;
+    while (source.next(text, ends_file, threads * chunk_bytes)) {
+        std::vector<FastaChunk> chunks = split_fasta(text, chunk_bytes);
+        chunks.back().ends_file = ends_file;
+        for (size_t wave = 0; wave < chunks.size(); wave += threads) {
+            size_t width = std::min(threads, chunks.size() - wave);
+            _run_workers(width, [&](size_t slot) {
+                headers[slot] = _count_headers(chunks[wave + slot].text);
+            });
+            for (size_t slot = 0; slot < width; slot++) {
+                chunks[wave + slot].first = first;
+                first += headers[slot];
+            }
+            _run_workers(width, [&](size_t slot) {
+                work(slot, chunks[wave + slot]);
+            });
+            for (size_t slot = 0; slot < width; slot++) {
+                done(slot);
+            }
         }
     }
+}
+
+size_t count_fasta_entries(const std::string& path, size_t threads) {
+    threads = std::max<size_t>(threads, 1);
+    FastaSource source(path);
+    std::string_view text;
+    bool ends_file = false;
+    std::atomic<size_t> count{0};
+    while (source.next(text, ends_file, threads * FASTA_CHUNK_BYTES)) {
+        std::vector<FastaChunk> chunks = split_fasta(text, FASTA_CHUNK_BYTES);
+        std::atomic<size_t> next{0};
+        _run_workers(std::min(threads, chunks.size()), [&](size_t) {
+            for (size_t ix = next++; ix < chunks.size(); ix = next++) {
+                count += _count_headers(chunks[ix].text);
+            }
+        });
+    }
     return count;
 }
 
-FastaOutputStream::FastaOutputStream(const std::string& path) {
-    _file.open(path);
+FastaOutputStream::FastaOutputStream(const std::string& path, size_t threads) {
+    _file.open(path, threads);
     if (!_file) {
         throw std::runtime_error("Cannot create FASTA file: " + path);
     }
 }
 
 FastaOutputStream::~FastaOutputStream() {
-    if (_file.is_open()) {
+    try {
         _file.close();
+    } catch (const std::exception&) {
+        // Destructors must not throw; call close() to see errors
     }
 }
 
-void FastaOutputStream::write(const std::string& name, const std::string& sequence) {
+void FastaOutputStream::close() {
+    _file.close();
+}
+
+void FastaOutputStream::write(std::string_view name, std::string_view sequence) {
     _file << ">" << name << "\n" << sequence << "\n";
 }
 
@@ -2,9 +2,14 @@
 #define FASTA_IO_H
 
 #include <string>
+#include <string_view>
 #include <vector>
 #include <fstream>
 #include <functional>
+#include <optional>
+#include <span>
+#include "compressed_file.hpp"
+#include "mapped_file.hpp"
 #include "../utils.hpp"
 
 // Represents a single FASTA entry (header + sequence)
@@ -13,9 +18,78 @@ struct FastaEntry {
     std::string sequence;
 };
 
+// A FASTA entry read in place. The views are valid until the next entry
+// is read.
+struct FastaRecord {
+    std::string_view name;
+    std::string_view sequence;
+};
+
 // Callback type for processing FASTA entries
 using FastaCallback = std::function<void(const FastaEntry&)>;
 
+// Bytes of FASTA text read per chunk by for_each_fasta_chunk, and per
+// window of a compressed file
+static constexpr size_t FASTA_CHUNK_BYTES = 4 << 20;
+
+// The text of a FASTA file in windows of whole entries: all of a plain
+// file at once through a memory map, or a gzip- or zstd-compressed file a
+// window at a time as it is decompressed.
+class FastaSource {
+public:
+    explicit FastaSource(const std::string& path);
+
+    // The next window, of at least min_bytes unless the file ends first.
+    // The text is valid until the next call, and ends_file says whether it
+    // is the last window. Returns false at the end of the file.
+    bool next(std::string_view& text, bool& ends_file, size_t min_bytes = FASTA_CHUNK_BYTES);
+
+private:
+    std::optional<MappedFile> _file;
+    std::optional<DecompressingReader> _reader;
+    std::string _buffer;
+    size_t _window = 0;
+    bool _done = false;
+};
+
+// Reads the entries of a FASTA file without copying them.
+//
+// A sequence on a single line is a view into the file; one wrapped over
+// several lines is joined into a buffer reused from entry to entry. Empty
+// lines, and lines before the first header, are skipped. A final entry
+// with no sequence is dropped. Compressed files are decompressed a window
+// at a time.
+class FastaReader {
+public:
+    explicit FastaReader(const std::string& path);
+
+    // Read FASTA text already in memory, such as a chunk of a mapped file.
+    // Unless the text ends the file, a final entry with no sequence is kept.
+    FastaReader(std::string_view text, bool ends_file);
+
+    // Read the next entry, returning false at the end of the text
+    bool next(FastaRecord& record);
+
+private:
+    std::optional<FastaSource> _source;
+    std::string_view _text;
+    bool _ends_file = true;
+    size_t _pos = 0;
+    std::string _sequence;
+
+    std::string_view _line();
+};
+
+// Process each entry in a FASTA file in place, without a copy per entry
+template <typename Visit>
+void for_each_fasta_record(const std::string& path, Visit visit) {
+    FastaReader reader(path);
+    FastaRecord record;
+    while (reader.next(record)) {
+        visit(static_cast<const FastaRecord&>(record));
+    }
+}
+
 // Read all entries from a FASTA file
 std::vector<FastaEntry> read_fasta(const std::string& path);
 
@@ -28,20 +102,50 @@ void for_each_fasta_indexed(
     std::function<void(size_t index, const FastaEntry&)> callback
 );
 
+// A run of whole entries of a FASTA file
+struct FastaChunk {
+    std::string_view text;
+    // The index in the file of the first entry
+    size_t first = 0;
+    bool ends_file = false;
+};
+
+// Split FASTA text into chunks of whole entries, each cut at the first
+// header line after roughly chunk_bytes.
+std::vector<FastaChunk> split_fasta(std::string_view text, size_t chunk_bytes);
+
+// Process the entries of a FASTA file on several threads.
+//
+// The file is split into chunks, which are handed out in waves of one per
+// thread. work(slot, chunk) reads the chunk at a slot of the wave, with a
+// FastaReader over chunk.text. Once the whole wave is read, done(slot) runs
+// on the calling thread for each slot in file order, so whatever the work
+// buffered can be written out in the order of the file.
+void for_each_fasta_chunk(
+    const std::string& path,
+    size_t threads,
+    const std::function<void(size_t slot, const FastaChunk& chunk)>& work,
+    const std::function<void(size_t slot)>& done,
+    size_t chunk_bytes = FASTA_CHUNK_BYTES
+);
+
 // Count entries in a FASTA file without loading all sequences
-size_t count_fasta_entries(const std::string& path);
+size_t count_fasta_entries(const std::string& path, size_t threads = 1);
 
 // FASTA writer helper
 class FastaOutputStream {
 public:
-    explicit FastaOutputStream(const std::string& path);
+    explicit FastaOutputStream(const std::string& path, size_t threads = 1);
     ~FastaOutputStream();
 
-    void write(const std::string& name, const std::string& sequence);
+    void write(std::string_view name, std::string_view sequence);
     void write(const FastaEntry& entry);
 
+    // Close the file, throwing if any output failed to reach it
+    void close();
+
 private:
-    std::ofstream _file;
+    OutputFile _file;
 };
 
 /**
@@ -50,7 +154,7 @@ private:
  * Common pattern for commands that read a FASTA, transform each sequence,
  * and write the result to a new FASTA file.
  *
- * @tparam TransformFunc Callable that takes (const FastaEntry&) and returns std::string
+ * @tparam TransformFunc Callable that takes (const FastaRecord&) and returns std::string
  * @param input Input FASTA file path
  * @param output Output FASTA file path
  * @param overwrite Whether to overwrite existing output file
@@ -70,10 +174,46 @@ size_t transform_fasta(
     FastaOutputStream out(output);
     size_t count = 0;
 
-    for_each_fasta(input, [&](const FastaEntry& entry) {
+    for_each_fasta_record(input, [&](const FastaRecord& entry) {
         out.write(entry.name, transform(entry));
         count++;
     });
+    out.close();
+
+    return count;
+}
+
+/**
+ * @brief Edit each sequence in a FASTA file in place and write to output.
+ *
+ * Like transform_fasta, for edits that keep the length, such as alphabet
+ * conversion. Each sequence is copied into one reused buffer, so no string
+ * is allocated per entry.
+ *
+ * @tparam EditFunc Callable that takes (std::span<char>) and edits it
+ * @return Number of sequences processed
+ */
+template <typename EditFunc>
+size_t edit_fasta(
+    const std::string& input,
+    const std::string& output,
+    bool overwrite,
+    EditFunc edit
+) {
+    _throw_if_not_exists(input);
+    _remove_if_exists(output, overwrite);
+
+    FastaOutputStream out(output);
+    std::string sequence;
+    size_t count = 0;
+
+    for_each_fasta_record(input, [&](const FastaRecord& entry) {
+        sequence.assign(entry.sequence);
+        edit(std::span<char>(sequence));
+        out.write(entry.name, sequence);
+        count++;
+    });
+    out.close();
 
     return count;
 }
@@ -0,0 +1,101 @@
+#include "fastq_io.hpp"
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+// Bytes decompressed per read from the file
+static constexpr size_t READ_BUFFER_SIZE = 1 << 20;
+
+FastqReader::FastqReader(const std::string& filename) :
+    _file(filename),
+    _filename(filename),
+    _buffer(READ_BUFFER_SIZE)
+{}
+
+bool FastqReader::_fill() {
+    if (_eof) return false;
+    if (_begin > 0) {
+        std::memmove(_buffer.data(), _buffer.data() + _begin, _end - _begin);
+        _end -= _begin;
+        _begin = 0;
+    }
+    if (_end == _buffer.size()) {
+        _buffer.resize(2 * _buffer.size());
+    }
+    size_t read = _file.read(_buffer.data() + _end, _buffer.size() - _end);
+    if (read == 0) {
+        _eof = true;
+        return false;
+    }
+    _end += read;
+    return true;
+}
+
+bool FastqReader::_getline(std::string& out) {
+    size_t scanned = _begin;
+    while (true) {
+        const char* start = _buffer.data() + scanned;
+        const char* newline = static_cast<const char*>(std::memchr(start, '\n', _end - scanned));
+        if (newline) {
+            size_t stop = newline - _buffer.data();
+            size_t length = stop - _begin;
+            if (length > 0 && _buffer[stop - 1] == '\r') length--;
+            out.assign(_buffer.data() + _begin, length);
+            _begin = stop + 1;
+            _line++;
+            return true;
+        }
+        scanned = _end - _begin;
+        if (!_fill()) break;
+        // _fill moves the unread bytes to the front of the buffer
+        scanned += _begin;
+    }
+    if (_begin == _end) return false;
+
+    // The last line has no trailing newline
+    out.assign(_buffer.data() + _begin, _end - _begin);
+    _begin = _end;
+    _line++;
+    return true;
+}
+
+bool FastqReader::read_batch(std::vector<FastqRecord>& batch, size_t max) {
+    if (batch.size() < max) {
+        batch.resize(max);
+    }
+    size_t count = 0;
+    std::string separator;
+    while (count < max) {
+        FastqRecord& record = batch[count];
+        if (!_getline(record.name)) break;
+        if (record.name.empty()) continue;
+        if (record.name[0] != '@') {
+            throw std::runtime_error(
+                "Invalid FASTQ record in " + _filename + " at line " +
+                std::to_string(_line) + ": expected a header starting with '@'."
+            );
+        }
+        record.name.erase(0, 1);
+        if (!_getline(record.sequence) || !_getline(separator) || !_getline(record.quality) ||
+            separator.empty() || separator[0] != '+') {
+            throw std::runtime_error(
+                "Truncated FASTQ record in " + _filename + " at line " + std::to_string(_line) + "."
+            );
+        }
+        count++;
+    }
+    batch.resize(count);
+    return count > 0;
+}
+
+void _append_fastq(const std::string& filename, const std::string& records) {
+    std::ofstream file(filename, std::ios::app | std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("Failed to open output file: " + filename);
+    }
+    file.write(records.data(), records.size());
+    file.close();
+    if (!file) {
+        throw std::runtime_error("Failed to write FASTQ file: " + filename);
+    }
+}
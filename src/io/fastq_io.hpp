@@ -0,0 +1,47 @@
+#ifndef FASTQ_IO_H
+#define FASTQ_IO_H
+
+#include <string>
+#include <vector>
+#include "compressed_file.hpp"
+
+// A single FASTQ record. The name excludes the leading '@'.
+struct FastqRecord {
+    std::string name;
+    std::string sequence;
+    std::string quality;
+};
+
+// Streams records from a FASTQ file, plain, gzip- or zstd-compressed.
+// Records are read in batches into reused buffers, so steady-state reading
+// does not allocate.
+class FastqReader {
+public:
+    explicit FastqReader(const std::string& filename);
+
+    FastqReader(const FastqReader&) = delete;
+    FastqReader& operator=(const FastqReader&) = delete;
+
+    // Read up to max records into batch, reusing its elements, and
+    // resize it to the number read. Returns false at end of file.
+    bool read_batch(std::vector<FastqRecord>& batch, size_t max);
+
+private:
+    DecompressingReader _file;
+    std::string _filename;
+    std::vector<char> _buffer;
+    size_t _begin = 0;
+    size_t _end = 0;
+    bool _eof = false;
+    size_t _line = 0;
+
+    // Read the next line into out without its newline. Returns false at
+    // end of file.
+    bool _getline(std::string& out);
+    bool _fill();
+};
+
+// Append FASTQ records to a file, creating it if needed
+void _append_fastq(const std::string& filename, const std::string& records);
+
+#endif
@@ -0,0 +1,646 @@
+#include "library_table.hpp"
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+namespace {
+
+struct TableHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t columns;
+    uint64_t rows;
+};
+
+struct ColumnEntry {
+    uint32_t kind;
+    uint32_t name_length;
+    uint64_t name_offset;
+    uint64_t offset;
+    uint64_t size;
+};
+
+// Followed by the first base of each row and one past the last, the
+// words, the exception positions, a byte per row that is 1 for RNA, and
+// the exception bases
+struct SequenceSection {
+    uint64_t words;
+    uint64_t exceptions;
+};
+
+// Followed by where each entry starts and one past the last, the entry of
+// each row as a uint32_t, and the text of the entries
+struct StringSection {
+    uint64_t entries;
+    uint64_t bytes;
+};
+
+static_assert(sizeof(TableHeader) == 24, "TableHeader must have no padding");
+static_assert(sizeof(ColumnEntry) == 32, "ColumnEntry must have no padding");
+
+}
+
+// Significant digits of a real, as std::ostream writes by default
+static constexpr int REAL_PRECISION = 6;
+
+static constexpr size_t BASES_PER_WORD = 32;
+
+// Distinct values per string column that later equal values share an
+// entry with; values past them get entries of their own
+static constexpr size_t MAX_DICTIONARY = 1 << 16;
+
+static inline size_t _aligned(size_t size) {
+    return (size + 7) & ~static_cast<size_t>(7);
+}
+
+static inline size_t _words_for(size_t bases) {
+    return (bases + BASES_PER_WORD - 1) / BASES_PER_WORD;
+}
+
+static inline size_t _sequence_size(size_t rows, const SequenceSection& section) {
+    return sizeof(SequenceSection) +
+        (rows + 1 + section.words + section.exceptions) * sizeof(uint64_t) +
+        rows + section.exceptions;
+}
+
+static inline size_t _string_size(size_t rows, const StringSection& section) {
+    return sizeof(StringSection) +
+        (section.entries + 1) * sizeof(uint64_t) +
+        rows * sizeof(uint32_t) + section.bytes;
+}
+
+// The code of a base in a DNA or RNA row, or -1 if it is kept on the side
+static inline int _code(char base, bool rna) {
+    switch (base) {
+        case 'A': return 0;
+        case 'C': return 1;
+        case 'G': return 2;
+        case 'T': return rna ? -1 : 3;
+        case 'U': return rna ? 3 : -1;
+        default: return -1;
+    }
+}
+
+static inline void _append_integer(std::string& out, uint64_t value) {
+    char digits[24];
+    auto [end, error] = std::to_chars(digits, digits + sizeof(digits), value);
+    out.append(digits, end);
+}
+
+// Read text as an unsigned integer, if it is written back exactly by
+// _append_integer
+static bool _read_integer(std::string_view text, uint64_t& value) {
+    auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+    if (error != std::errc() || end != text.data() + text.size()) return false;
+    std::string back;
+    _append_integer(back, value);
+    return back == text;
+}
+
+// Read text as a real, if it is written back exactly by append_real
+static bool _read_real(std::string_view text, double& value) {
+    auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+    if (error != std::errc() || end != text.data() + text.size()) return false;
+    std::string back;
+    append_real(back, value);
+    return back == text;
+}
+
+template <typename T>
+static void _write_array(std::ofstream& file, const T* data, size_t count) {
+    file.write(reinterpret_cast<const char*>(data), static_cast<std::streamsize>(count * sizeof(T)));
+}
+
+static void _write_padding(std::ofstream& file, size_t size) {
+    static const char zeros[8] = {};
+    file.write(zeros, static_cast<std::streamsize>(_aligned(size) - size));
+}
+
+bool is_library_table(const std::string& filename) {
+    std::ifstream file(filename, std::ios::binary);
+    char magic[sizeof(LIBRARY_TABLE_MAGIC)];
+    return file.read(magic, sizeof(magic)) &&
+        std::memcmp(magic, LIBRARY_TABLE_MAGIC, sizeof(magic)) == 0;
+}
+
+void append_real(std::string& out, double value) {
+    char digits[32];
+    auto [end, error] = std::to_chars(
+        digits, digits + sizeof(digits), value, std::chars_format::general, REAL_PRECISION
+    );
+    out.append(digits, end);
+}
+
+//
+// LibraryTable
+//
+
+LibraryTable::LibraryTable(const std::string& filename) : _filename(filename), _file(filename) {
+    const char* data = _file.data();
+    size_t size = _file.size();
+
+    TableHeader header;
+    if (size < sizeof(header)) {
+        throw std::runtime_error("Not a library table: " + filename);
+    }
+    std::memcpy(&header, data, sizeof(header));
+    if (std::memcmp(header.magic, LIBRARY_TABLE_MAGIC, sizeof(LIBRARY_TABLE_MAGIC)) != 0 ||
+        header.version != LIBRARY_TABLE_VERSION) {
+        throw std::runtime_error("Not a library table, or an unsupported version: " + filename);
+    }
+    _rows = header.rows;
+
+    auto truncated = [&]() {
+        return std::runtime_error("Truncated library table: " + filename);
+    };
+    auto corrupt = [&]() {
+        return std::runtime_error("Corrupt library table: " + filename);
+    };
+    // Counts are bounded by the file size before any arithmetic on them,
+    // so that none of the sums and products below can overflow
+    if (header.columns > (size - sizeof(header)) / sizeof(ColumnEntry) ||
+        (header.columns > 0 && _rows > size)) {
+        throw truncated();
+    }
+
+    std::string names;
+    for (size_t ix = 0; ix < header.columns; ix++) {
+        ColumnEntry entry;
+        std::memcpy(&entry, data + sizeof(header) + ix * sizeof(ColumnEntry), sizeof(entry));
+        if (entry.name_offset > size || entry.name_length > size - entry.name_offset ||
+            entry.offset % 8 != 0 || entry.offset > size || entry.size > size - entry.offset) {
+            throw truncated();
+        }
+        if (ix > 0) names += ',';
+        names.append(data + entry.name_offset, entry.name_length);
+
+        Column column;
+        column.kind = static_cast<Kind>(entry.kind);
+        const char* section = data + entry.offset;
+        switch (column.kind) {
+            case Kind::Sequence: {
+                SequenceSection counts;
+                if (entry.size < sizeof(counts)) throw truncated();
+                std::memcpy(&counts, section, sizeof(counts));
+                if (counts.words > entry.size / sizeof(uint64_t) || counts.exceptions > entry.size ||
+                    entry.size != _sequence_size(_rows, counts)) {
+                    throw truncated();
+                }
+                auto words = reinterpret_cast<const uint64_t*>(section + sizeof(counts));
+                column.starts = words;
+                column.words = column.starts + _rows + 1;
+                column.exception_positions = column.words + counts.words;
+                column.rna = reinterpret_cast<const uint8_t*>(column.exception_positions + counts.exceptions);
+                column.exception_bases = reinterpret_cast<const char*>(column.rna + _rows);
+                column.exceptions = counts.exceptions;
+                if (column.starts[_rows] > counts.words * BASES_PER_WORD) throw truncated();
+                // Rows are read as the bases between one start and the next,
+                // and their exceptions are found by binary search
+                for (size_t row = 0; row < _rows; row++) {
+                    if (column.starts[row] > column.starts[row + 1]) throw corrupt();
+                }
+                for (size_t ex = 0; ex < column.exceptions; ex++) {
+                    if (column.exception_positions[ex] >= column.starts[_rows] ||
+                        (ex > 0 && column.exception_positions[ex] <= column.exception_positions[ex - 1])) {
+                        throw corrupt();
+                    }
+                }
+                break;
+            }
+            case Kind::Integer:
+            case Kind::Real:
+                if (entry.size != _rows * sizeof(uint64_t)) throw truncated();
+                column.values = section;
+                break;
+            case Kind::String: {
+                StringSection counts;
+                if (entry.size < sizeof(counts)) throw truncated();
+                std::memcpy(&counts, section, sizeof(counts));
+                if (counts.entries > entry.size / sizeof(uint64_t) || counts.bytes > entry.size ||
+                    entry.size != _string_size(_rows, counts)) {
+                    throw truncated();
+                }
+                column.offsets = reinterpret_cast<const uint64_t*>(section + sizeof(counts));
+                column.ids = reinterpret_cast<const uint32_t*>(column.offsets + counts.entries + 1);
+                column.text = reinterpret_cast<const char*>(column.ids + _rows);
+                column.entries = counts.entries;
+                if (column.offsets[counts.entries] > counts.bytes) throw truncated();
+                for (size_t id = 0; id < counts.entries; id++) {
+                    if (column.offsets[id] > column.offsets[id + 1]) throw corrupt();
+                }
+                break;
+            }
+            default:
+                throw std::runtime_error("Unknown column type in library table: " + filename);
+        }
+        _columns.push_back(column);
+    }
+    _header.emplace(names);
+}
+
+void LibraryTable::_append_sequence(const Column& column, size_t row, std::string& out) const {
+    static constexpr char DNA[] = "ACGT";
+    static constexpr char RNA[] = "ACGU";
+    const char* bases = column.rna[row] ? RNA : DNA;
+    size_t begin = column.starts[row];
+    size_t end = column.starts[row + 1];
+    size_t at = out.size();
+    out.resize(at + (end - begin));
+    char* write = out.data() + at;
+
+    for (size_t pos = begin; pos < end;) {
+        size_t in_word = pos % BASES_PER_WORD;
+        size_t count = std::min(BASES_PER_WORD - in_word, end - pos);
+        uint64_t word = column.words[pos / BASES_PER_WORD] << (2 * in_word);
+        for (size_t k = 0; k < count; k++) {
+            *write++ = bases[word >> 62];
+            word <<= 2;
+        }
+        pos += count;
+    }
+
+    const uint64_t* first = std::lower_bound(
+        column.exception_positions, column.exception_positions + column.exceptions, begin
+    );
+    for (const uint64_t* it = first; it != column.exception_positions + column.exceptions && *it < end; it++) {
+        out[at + (*it - begin)] = column.exception_bases[it - column.exception_positions];
+    }
+}
+
+void LibraryTable::append_field(size_t row, size_t column, std::string& out) const {
+    const Column& col = _columns[column];
+    switch (col.kind) {
+        case Kind::Sequence:
+            _append_sequence(col, row, out);
+            break;
+        case Kind::Integer:
+            _append_integer(out, static_cast<const uint64_t*>(col.values)[row]);
+            break;
+        case Kind::Real:
+            append_real(out, static_cast<const double*>(col.values)[row]);
+            break;
+        case Kind::String:
+            out += text(row, column);
+            break;
+    }
+}
+
+std::string_view LibraryTable::text(size_t row, size_t column) const {
+    const Column& col = _columns[column];
+    uint32_t id = col.ids[row];
+    if (id >= col.entries) {
+        throw std::runtime_error("Corrupt string column in library table: " + _filename);
+    }
+    return std::string_view(col.text + col.offsets[id], col.offsets[id + 1] - col.offsets[id]);
+}
+
+size_t LibraryTable::sequence_length(size_t row, size_t column) const {
+    const Column& col = _columns[column];
+    return col.starts[row + 1] - col.starts[row];
+}
+
+//
+// LibraryTableWriter
+//
+
+void LibraryTableWriter::Spill::open(const std::string& name) {
+    path = name;
+    file.open(path, std::ios::binary | std::ios::in | std::ios::out | std::ios::trunc);
+    if (!file.is_open()) {
+        throw std::runtime_error("Failed to open output file: " + path);
+    }
+}
+
+void LibraryTableWriter::Spill::write(const void* data, size_t size) {
+    file.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+}
+
+void LibraryTableWriter::Spill::copy_to(std::ofstream& out) {
+    file.flush();
+    file.seekg(0);
+    char buffer[1 << 16];
+    while (file.read(buffer, sizeof(buffer)) || file.gcount() > 0) {
+        out.write(buffer, file.gcount());
+    }
+    if (file.bad()) {
+        throw std::runtime_error("Failed to read back " + path);
+    }
+    remove();
+}
+
+void LibraryTableWriter::Spill::remove() {
+    if (path.empty()) return;
+    file.close();
+    std::error_code error;
+    std::filesystem::remove(path, error);
+    path.clear();
+}
+
+LibraryTableWriter::LibraryTableWriter(
+    const std::string& filename,
+    const std::vector<std::string>& columns
+) : _filename(filename), _names(columns) {
+    _file.open(filename, std::ios::binary);
+    if (!_file.is_open()) {
+        throw std::runtime_error("Failed to open output file: " + filename);
+    }
+
+    const std::vector<std::string>& sequence_columns = csv::required_columns();
+    for (const std::string& name : _names) {
+        bool sequence = std::find(sequence_columns.begin(), sequence_columns.end(), name) != sequence_columns.end();
+        _sequence_of.push_back(sequence ? static_cast<int>(_sequences.size()) : -1);
+        _string_of.push_back(sequence ? -1 : static_cast<int>(_strings.size()));
+        if (sequence) {
+            _sequences.emplace_back();
+        } else {
+            _strings.emplace_back();
+        }
+    }
+
+    uint64_t zero = 0;
+    try {
+        for (SequenceColumn& column : _sequences) {
+            for (Spill* spill : {&column.starts, &column.words, &column.exception_positions,
+                                 &column.rna, &column.exception_bases}) {
+                _open_spill(*spill);
+            }
+            column.starts.write(&zero, sizeof(zero));
+        }
+        for (StringColumn& column : _strings) {
+            for (Spill* spill : {&column.ids, &column.offsets, &column.text,
+                                 &column.integer_values, &column.real_values}) {
+                _open_spill(*spill);
+            }
+            column.offsets.write(&zero, sizeof(zero));
+        }
+    } catch (...) {
+        _remove_spills();
+        throw;
+    }
+}
+
+LibraryTableWriter::~LibraryTableWriter() {
+    try {
+        close();
+    } catch (const std::exception&) {
+        // Destructors must not throw; call close() to see errors
+    }
+    _remove_spills();
+}
+
+void LibraryTableWriter::_open_spill(Spill& spill) {
+    spill.open(_filename + ".spill" + std::to_string(_spills++));
+}
+
+void LibraryTableWriter::_remove_spills() {
+    for (SequenceColumn& column : _sequences) {
+        for (Spill* spill : {&column.starts, &column.words, &column.exception_positions,
+                             &column.rna, &column.exception_bases}) {
+            spill->remove();
+        }
+    }
+    for (StringColumn& column : _strings) {
+        for (Spill* spill : {&column.ids, &column.offsets, &column.text,
+                             &column.integer_values, &column.real_values}) {
+            spill->remove();
+        }
+    }
+}
+
+void LibraryTableWriter::_add_sequence(SequenceColumn& column, std::string_view seq) {
+    bool rna = seq.find('U') != std::string_view::npos;
+    uint64_t pos = column.bases;
+    for (char base : seq) {
+        int code = _code(base, rna);
+        if (code < 0) {
+            column.exception_positions.write(&pos, sizeof(pos));
+            column.exception_bases.write(&base, 1);
+            column.exceptions++;
+            code = 0;
+        }
+        column.word |= static_cast<uint64_t>(code) << (62 - 2 * (pos % BASES_PER_WORD));
+        pos++;
+        if (pos % BASES_PER_WORD == 0) {
+            column.words.write(&column.word, sizeof(column.word));
+            column.word = 0;
+        }
+    }
+    column.bases = pos;
+    column.starts.write(&pos, sizeof(pos));
+    uint8_t flag = rna ? 1 : 0;
+    column.rna.write(&flag, sizeof(flag));
+}
+
+void LibraryTableWriter::_add_string(StringColumn& column, std::string_view value) {
+    std::string key(value);
+    auto it = column.lookup.find(key);
+    uint32_t id;
+    if (it != column.lookup.end()) {
+        id = it->second;
+    } else {
+        id = static_cast<uint32_t>(column.entries++);
+        column.text.write(value.data(), value.size());
+        column.bytes += value.size();
+        column.offsets.write(&column.bytes, sizeof(column.bytes));
+        if (column.lookup.size() < MAX_DICTIONARY) {
+            column.lookup.emplace(std::move(key), id);
+        }
+    }
+    column.ids.write(&id, sizeof(id));
+
+    // Drop the numeric copy of the column at its first value that does not
+    // read back exactly
+    if (column.integers) {
+        uint64_t integer;
+        column.integers = _read_integer(value, integer);
+        if (column.integers) {
+            column.integer_values.write(&integer, sizeof(integer));
+        } else {
+            column.integer_values.remove();
+        }
+    }
+    if (column.reals) {
+        double real;
+        column.reals = _read_real(value, real);
+        if (column.reals) {
+            column.real_values.write(&real, sizeof(real));
+        } else {
+            column.real_values.remove();
+        }
+    }
+}
+
+void LibraryTableWriter::add(std::span<const std::string_view> fields) {
+    for (size_t ix = 0; ix < _names.size(); ix++) {
+        std::string_view field = (ix < fields.size()) ? fields[ix] : std::string_view();
+        if (_sequence_of[ix] >= 0) {
+            _add_sequence(_sequences[_sequence_of[ix]], field);
+        } else {
+            _add_string(_strings[_string_of[ix]], field);
+        }
+    }
+    _rows++;
+}
+
+void LibraryTableWriter::add(const csv::PackedRow& row, std::initializer_list<double> numbers) {
+    row.fields(_unpacked);
+    for (double number : numbers) {
+        _unpacked.emplace_back();
+        append_real(_unpacked.back(), number);
+    }
+    _views.assign(_unpacked.begin(), _unpacked.end());
+    add(_views);
+}
+
+void LibraryTableWriter::close() {
+    if (_closed) return;
+    _closed = true;
+
+    // Store each string column as integers or reals if every value reads
+    // back the same
+    std::vector<LibraryTable::Kind> kinds;
+    std::vector<size_t> sizes;
+    for (size_t ix = 0; ix < _names.size(); ix++) {
+        if (_sequence_of[ix] >= 0) {
+            SequenceColumn& column = _sequences[_sequence_of[ix]];
+            if (column.bases % BASES_PER_WORD != 0) {
+                column.words.write(&column.word, sizeof(column.word));
+            }
+            kinds.push_back(LibraryTable::Kind::Sequence);
+            sizes.push_back(_sequence_size(_rows, {_words_for(column.bases), column.exceptions}));
+            continue;
+        }
+        const StringColumn& column = _strings[_string_of[ix]];
+        if (column.entries > 0 && column.integers) {
+            kinds.push_back(LibraryTable::Kind::Integer);
+            sizes.push_back(_rows * sizeof(uint64_t));
+        } else if (column.entries > 0 && column.reals) {
+            kinds.push_back(LibraryTable::Kind::Real);
+            sizes.push_back(_rows * sizeof(uint64_t));
+        } else {
+            kinds.push_back(LibraryTable::Kind::String);
+            sizes.push_back(_string_size(_rows, {column.entries, column.bytes}));
+        }
+    }
+
+    // Lay out the directory, the names and then each column
+    TableHeader header{};
+    std::memcpy(header.magic, LIBRARY_TABLE_MAGIC, sizeof(header.magic));
+    header.version = LIBRARY_TABLE_VERSION;
+    header.columns = static_cast<uint32_t>(_names.size());
+    header.rows = _rows;
+
+    std::vector<ColumnEntry> entries(_names.size());
+    size_t offset = sizeof(TableHeader) + _names.size() * sizeof(ColumnEntry);
+    for (size_t ix = 0; ix < _names.size(); ix++) {
+        entries[ix].kind = static_cast<uint32_t>(kinds[ix]);
+        entries[ix].name_length = static_cast<uint32_t>(_names[ix].size());
+        entries[ix].name_offset = offset;
+        offset += _names[ix].size();
+    }
+    offset = _aligned(offset);
+    for (size_t ix = 0; ix < _names.size(); ix++) {
+        entries[ix].offset = offset;
+        entries[ix].size = sizes[ix];
+        offset = _aligned(offset + sizes[ix]);
+    }
+
+    _file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    _write_array(_file, entries.data(), entries.size());
+    size_t names = 0;
+    for (const std::string& name : _names) {
+        _file.write(name.data(), static_cast<std::streamsize>(name.size()));
+        names += name.size();
+    }
+    _write_padding(_file, sizeof(TableHeader) + _names.size() * sizeof(ColumnEntry) + names);
+
+    for (size_t ix = 0; ix < _names.size(); ix++) {
+        if (kinds[ix] == LibraryTable::Kind::Sequence) {
+            SequenceColumn& column = _sequences[_sequence_of[ix]];
+            SequenceSection counts{_words_for(column.bases), column.exceptions};
+            _file.write(reinterpret_cast<const char*>(&counts), sizeof(counts));
+            column.starts.copy_to(_file);
+            column.words.copy_to(_file);
+            column.exception_positions.copy_to(_file);
+            column.rna.copy_to(_file);
+            column.exception_bases.copy_to(_file);
+        } else if (kinds[ix] == LibraryTable::Kind::String) {
+            StringColumn& column = _strings[_string_of[ix]];
+            StringSection counts{column.entries, column.bytes};
+            _file.write(reinterpret_cast<const char*>(&counts), sizeof(counts));
+            column.offsets.copy_to(_file);
+            column.ids.copy_to(_file);
+            column.text.copy_to(_file);
+        } else if (kinds[ix] == LibraryTable::Kind::Integer) {
+            _strings[_string_of[ix]].integer_values.copy_to(_file);
+        } else {
+            _strings[_string_of[ix]].real_values.copy_to(_file);
+        }
+        _write_padding(_file, sizes[ix]);
+    }
+    _remove_spills();
+
+    _file.close();
+    if (!_file) {
+        throw std::runtime_error("Failed to write library table: " + _filename);
+    }
+}
+
+//
+// LibraryRows
+//
+
+LibraryRows::LibraryRows(const std::string& filename) {
+    if (is_library_table(filename)) {
+        _table = std::make_unique<LibraryTable>(filename);
+    } else {
+        _csv = std::make_unique<InputFile>(filename);
+        std::getline(*_csv, _line);
+        _header.emplace(_line);
+    }
+    _projection = std::make_unique<csv::Projection>(header());
+}
+
+bool LibraryRows::next() {
+    const csv::Projection& projection = *_projection;
+    if (!_started) {
+        _fields.assign(projection.size(), std::string_view());
+        _present.assign(projection.size(), 0);
+        _buffers.resize(projection.size());
+        if (_csv) {
+            _row = std::make_unique<csv::Row>(projection);
+        }
+        _started = true;
+    }
+
+    if (_csv) {
+        do {
+            if (!std::getline(*_csv, _line)) return false;
+        } while (_line.empty());
+        _row->parse(_line);
+        for (size_t slot = 0; slot < _fields.size(); slot++) {
+            _fields[slot] = (*_row)[slot];
+            _present[slot] = _row->has(slot);
+        }
+        return true;
+    }
+
+    if (_next_row == _table->rows()) return false;
+    for (size_t slot = 0; slot < _fields.size(); slot++) {
+        int column = projection.column(slot);
+        _present[slot] = column >= 0;
+        if (column < 0) continue;
+        if (_table->kind(column) == LibraryTable::Kind::String) {
+            _fields[slot] = _table->text(_next_row, column);
+        } else {
+            _buffers[slot].clear();
+            _table->append_field(_next_row, column, _buffers[slot]);
+            _fields[slot] = _buffers[slot];
+        }
+    }
+    _next_row++;
+    return true;
+}
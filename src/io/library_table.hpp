@@ -0,0 +1,234 @@
+#ifndef LIBRARY_TABLE_H
+#define LIBRARY_TABLE_H
+
+#include <cstdint>
+#include <fstream>
+#include <initializer_list>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "compressed_file.hpp"
+#include "csv_format.hpp"
+#include "mapped_file.hpp"
+
+// A library stored by column on disk (.fldb), for the intermediates that
+// the pipeline writes and reads back at every stage.
+//
+// The file is a fixed header, a directory of columns and then each column
+// in a section of its own, so a reader that needs only the designs touches
+// only the pages of the design column. Every column is stored in one of
+// four ways:
+//
+//   Sequence  the six sequence columns, at two bits per base, with the
+//             bases outside A, C, G and T or U kept by position on the side
+//   Integer   columns of unsigned integers, such as index, begin and end,
+//             at eight bytes a row
+//   Real      columns of numbers, such as read counts, at eight bytes a row
+//   String    anything else, such as names and sublibraries, as a number
+//             per row into a dictionary of the values
+//
+// A column is stored as an integer or a real only if every value reads
+// back as the same text, so a table holds exactly the fields it was given.
+// Integers are stored in host byte order, and sections are aligned to
+// eight bytes so that the table is read in place through mmap.
+
+constexpr char LIBRARY_TABLE_MAGIC[8] = {'F', 'L', 'D', 'L', 'I', 'B', 'T', 'B'};
+constexpr uint32_t LIBRARY_TABLE_VERSION = 1;
+
+// Whether a file is a library table, told by its first bytes
+bool is_library_table(const std::string& filename);
+
+// Append a real number as the library's text files write it: as
+// std::ostream does by default, to six significant digits
+void append_real(std::string& out, double value);
+
+// A library table, mapped read-only into memory
+class LibraryTable {
+public:
+    enum class Kind : uint32_t {
+        Sequence,
+        Integer,
+        Real,
+        String
+    };
+
+    explicit LibraryTable(const std::string& filename);
+
+    size_t rows() const { return _rows; }
+    size_t columns() const { return _columns.size(); }
+
+    // The column names, as the header of the same library in CSV
+    const csv::Header& header() const { return *_header; }
+
+    Kind kind(size_t column) const { return _columns[column].kind; }
+
+    // Append the text of a field to a buffer
+    void append_field(size_t row, size_t column, std::string& out) const;
+
+    // A field of a string column, read in place
+    std::string_view text(size_t row, size_t column) const;
+
+    // The number of bases of a field of a sequence column, without reading
+    // its bases
+    size_t sequence_length(size_t row, size_t column) const;
+
+private:
+    struct Column {
+        Kind kind;
+        // Sequence: the first base of each row, and one past the last
+        const uint64_t* starts = nullptr;
+        // Sequence: whether each row is RNA
+        const uint8_t* rna = nullptr;
+        const uint64_t* words = nullptr;
+        // Sequence: bases outside A, C, G and T or U, by position
+        const uint64_t* exception_positions = nullptr;
+        const char* exception_bases = nullptr;
+        size_t exceptions = 0;
+        // Integer and real: one value per row
+        const void* values = nullptr;
+        // String: the dictionary entry of each row, and where each entry
+        // starts in the text, and one past the last
+        const uint32_t* ids = nullptr;
+        const uint64_t* offsets = nullptr;
+        const char* text = nullptr;
+        size_t entries = 0;
+    };
+
+    std::string _filename;
+    MappedFile _file;
+    size_t _rows = 0;
+    std::vector<Column> _columns;
+    std::optional<csv::Header> _header;
+
+    void _append_sequence(const Column& column, size_t row, std::string& out) const;
+};
+
+// Writes a library table a row at a time. Every column is packed as rows
+// come in and spilled to temporary files beside the table, along with its
+// values as integers and reals for as long as they all read back exactly.
+// close() then chooses how to store each column and copies its spills into
+// the file, so memory does not grow with the number of rows. String
+// columns share dictionary entries between equal values only among the
+// first distinct values of a column.
+class LibraryTableWriter {
+public:
+    LibraryTableWriter(const std::string& filename, const std::vector<std::string>& columns);
+    ~LibraryTableWriter();
+
+    LibraryTableWriter(const LibraryTableWriter&) = delete;
+    LibraryTableWriter& operator=(const LibraryTableWriter&) = delete;
+
+    // Add a row, with a field for every column in order. Missing trailing
+    // fields are empty.
+    void add(std::span<const std::string_view> fields);
+
+    // Add a packed row, followed by a field for each of the given numbers
+    void add(const csv::PackedRow& row, std::initializer_list<double> numbers);
+
+    void close();
+
+private:
+    // An array written to a temporary file, removed once copied
+    struct Spill {
+        std::string path;
+        std::fstream file;
+
+        void open(const std::string& path);
+        void write(const void* data, size_t size);
+        void copy_to(std::ofstream& out);
+        void remove();
+    };
+
+    struct SequenceColumn {
+        uint64_t bases = 0;
+        uint64_t exceptions = 0;
+        // The word being packed
+        uint64_t word = 0;
+        Spill starts;
+        Spill words;
+        Spill exception_positions;
+        Spill rna;
+        Spill exception_bases;
+    };
+
+    struct StringColumn {
+        // The entries of the first distinct values
+        std::unordered_map<std::string, uint32_t> lookup;
+        uint64_t entries = 0;
+        uint64_t bytes = 0;
+        bool integers = true;
+        bool reals = true;
+        Spill ids;
+        Spill offsets;
+        Spill text;
+        Spill integer_values;
+        Spill real_values;
+    };
+
+    std::string _filename;
+    std::ofstream _file;
+    std::vector<std::string> _names;
+    // The sequence or string column of each column
+    std::vector<int> _sequence_of;
+    std::vector<int> _string_of;
+    std::vector<SequenceColumn> _sequences;
+    std::vector<StringColumn> _strings;
+    size_t _rows = 0;
+    size_t _spills = 0;
+    bool _closed = false;
+    std::vector<std::string> _unpacked;
+    std::vector<std::string_view> _views;
+
+    void _add_sequence(SequenceColumn& column, std::string_view seq);
+    void _add_string(StringColumn& column, std::string_view value);
+    void _open_spill(Spill& spill);
+    void _remove_spills();
+};
+
+// The rows of a library, from a CSV file or a library table, read through
+// a projection. Add the columns to read to projection() before the first
+// call to next(); fields are valid until the next call.
+class LibraryRows {
+public:
+    explicit LibraryRows(const std::string& filename);
+
+    LibraryRows(const LibraryRows&) = delete;
+    LibraryRows& operator=(const LibraryRows&) = delete;
+
+    const csv::Header& header() const { return _table ? _table->header() : *_header; }
+    csv::Projection& projection() { return *_projection; }
+
+    // Whether the file is a library table
+    bool is_table() const { return _table != nullptr; }
+
+    // Move to the next row, returning false at the end. Empty lines of a
+    // CSV are skipped.
+    bool next();
+
+    // As on csv::Row
+    std::string_view operator[](size_t slot) const { return _fields[slot]; }
+    bool has(size_t slot) const { return _present[slot]; }
+    std::string_view get(size_t slot, std::string_view default_value) const {
+        return _present[slot] ? _fields[slot] : default_value;
+    }
+    std::span<const std::string_view> fields() const { return _fields; }
+
+private:
+    std::unique_ptr<LibraryTable> _table;
+    std::unique_ptr<InputFile> _csv;
+    std::optional<csv::Header> _header;
+    std::unique_ptr<csv::Projection> _projection;
+    std::unique_ptr<csv::Row> _row;
+    std::string _line;
+    bool _started = false;
+    size_t _next_row = 0;
+    std::vector<std::string_view> _fields;
+    std::vector<uint8_t> _present;
+    std::vector<std::string> _buffers;
+};
+
+#endif
@@ -0,0 +1,51 @@
+#include "mapped_file.hpp"
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::MappedFile(const std::string& filename) {
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Failed to open file: " + filename);
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+        ::close(fd);
+        throw std::runtime_error("Failed to read file: " + filename);
+    }
+
+    if (S_ISREG(st.st_mode)) {
+        _mapped = static_cast<size_t>(st.st_size);
+        if (_mapped > 0) {
+            _data = ::mmap(nullptr, _mapped, PROT_READ, MAP_SHARED, fd, 0);
+            if (_data == MAP_FAILED) {
+                _data = nullptr;
+                ::close(fd);
+                throw std::runtime_error("Failed to map file: " + filename);
+            }
+            // Callers read front to back, so let the kernel read ahead
+            ::madvise(_data, _mapped, MADV_SEQUENTIAL);
+            _view = std::string_view(static_cast<const char*>(_data), _mapped);
+        }
+    } else {
+        char buffer[1 << 16];
+        ssize_t n;
+        while ((n = ::read(fd, buffer, sizeof(buffer))) > 0) {
+            _contents.append(buffer, static_cast<size_t>(n));
+        }
+        if (n < 0) {
+            ::close(fd);
+            throw std::runtime_error("Failed to read file: " + filename);
+        }
+        _view = _contents;
+    }
+    ::close(fd);
+}
+
+MappedFile::~MappedFile() {
+    if (_data) {
+        ::munmap(_data, _mapped);
+    }
+}
@@ -0,0 +1,32 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <string>
+#include <string_view>
+
+// The contents of a file, mapped read-only into memory.
+//
+// Pages are read in as they are touched, so a multi-gigabyte file costs
+// no more memory than the part being worked on. Files that cannot be
+// mapped, such as pipes, are read into memory instead, and an empty file
+// maps to an empty view.
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& filename);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* data() const { return _view.data(); }
+    size_t size() const { return _view.size(); }
+    std::string_view view() const { return _view; }
+
+private:
+    void* _data = nullptr;
+    size_t _mapped = 0;
+    std::string _contents;
+    std::string_view _view;
+};
+
+#endif
@@ -0,0 +1,140 @@
+#include "padding_pool.hpp"
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+namespace {
+
+struct PaddingPoolHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t min_length;
+    uint64_t max_length;
+    uint64_t max_au;
+    uint64_t max_gc;
+    uint64_t max_gu;
+    uint64_t closing_gc;
+    uint64_t spacer_length;
+    uint64_t per_length;
+    uint64_t lengths;
+};
+
+struct PaddingPoolRecord {
+    uint64_t length;
+    uint64_t count;
+};
+
+static_assert(sizeof(PaddingPoolHeader) == 88, "PaddingPoolHeader must have no padding");
+
+}
+
+PaddingPool _read_padding_pool(const std::string& filename, uint64_t seed, size_t per_length) {
+    std::ifstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("Failed to open padding pool: " + filename);
+    }
+
+    PaddingPoolHeader header;
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        std::memcmp(header.magic, PADDING_POOL_MAGIC, sizeof(PADDING_POOL_MAGIC)) != 0 ||
+        header.version != PADDING_POOL_VERSION) {
+        throw std::runtime_error("Not a padding pool, or an unsupported version: " + filename);
+    }
+
+    StemConfig config;
+    config.min_length = header.min_length;
+    config.max_length = header.max_length;
+    config.max_au = header.max_au;
+    config.max_gc = header.max_gc;
+    config.max_gu = header.max_gu;
+    config.closing_gc = header.closing_gc;
+    config.spacer_length = header.spacer_length;
+
+    // The bytes left after each record, which bound what a record can
+    // claim before anything is allocated for it
+    size_t remaining = std::filesystem::file_size(filename) - sizeof(header);
+    PaddingPool pool(config, (per_length > 0) ? per_length : header.per_length, seed, true);
+    for (uint64_t ix = 0; ix < header.lengths; ix++) {
+        PaddingPoolRecord record;
+        if (!file.read(reinterpret_cast<char*>(&record), sizeof(record))) {
+            throw std::runtime_error("Truncated padding pool: " + filename);
+        }
+        remaining -= sizeof(record);
+        if (record.length == 0 || record.count > remaining / record.length) {
+            throw std::runtime_error("Corrupt padding pool: " + filename);
+        }
+        remaining -= record.length * record.count;
+        std::string bases(record.length * record.count, '\0');
+        if (!file.read(bases.data(), bases.size())) {
+            throw std::runtime_error("Truncated padding pool: " + filename);
+        }
+        pool.add(record.length, std::move(bases));
+    }
+    return pool;
+}
+
+void _write_padding_pool(const std::string& filename, const PaddingPool& pool) {
+    const StemConfig& config = pool.config();
+    std::vector<size_t> lengths = pool.lengths();
+
+    PaddingPoolHeader header{};
+    std::memcpy(header.magic, PADDING_POOL_MAGIC, sizeof(header.magic));
+    header.version = PADDING_POOL_VERSION;
+    header.min_length = config.min_length;
+    header.max_length = config.max_length;
+    header.max_au = config.max_au;
+    header.max_gc = config.max_gc;
+    header.max_gu = config.max_gu;
+    header.closing_gc = config.closing_gc;
+    header.spacer_length = config.spacer_length;
+    header.per_length = pool.per_length();
+    header.lengths = lengths.size();
+
+    std::ofstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("Failed to open output file: " + filename);
+    }
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    for (size_t length : lengths) {
+        PaddingPoolRecord record{length, pool.count(length)};
+        file.write(reinterpret_cast<const char*>(&record), sizeof(record));
+        for (size_t slot = 0; slot < record.count; slot++) {
+            std::string_view padding = pool.at(length, slot);
+            file.write(padding.data(), padding.size());
+        }
+    }
+    if (!file) {
+        throw std::runtime_error("Failed to write padding pool: " + filename);
+    }
+}
+
+std::optional<PaddingPool> _open_padding_pool(
+    const StemConfig& config,
+    size_t per_length,
+    const std::string& path,
+    uint64_t seed
+) {
+    if (!path.empty() && std::filesystem::exists(path)) {
+        PaddingPool pool = _read_padding_pool(path, seed, per_length);
+        pool.check_compatible(config);
+        return pool;
+    }
+    if (per_length == 0) {
+        if (!path.empty()) {
+            throw std::invalid_argument(
+                "The padding pool " + path + " does not exist yet. Give a pool size to build it."
+            );
+        }
+        return std::nullopt;
+    }
+    // Only a pool saved for later runs is generated in full
+    return PaddingPool(config, per_length, seed, !path.empty());
+}
+
+void _save_padding_pool(const std::optional<PaddingPool>& pool, const std::string& path) {
+    if (pool && pool->grown() && !path.empty()) {
+        _write_padding_pool(path, *pool);
+    }
+}
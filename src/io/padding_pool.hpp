@@ -0,0 +1,44 @@
+#ifndef PADDING_POOL_IO_H
+#define PADDING_POOL_IO_H
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include "../config/stem_config.hpp"
+#include "../domain/padding_pool.hpp"
+
+// A padding pool on disk (.fldpp).
+//
+// The file is a fixed header recording the stem configuration and the
+// number of paddings per length, followed by one record per length: the
+// length and count, then the paddings back to back with no separators.
+// Integers are stored in host byte order. Which paddings have been taken
+// is not recorded, so each run starts at an offset derived from its seed;
+// runs with the same seed hand out the same paddings.
+
+constexpr char PADDING_POOL_MAGIC[8] = {'F', 'L', 'D', 'P', 'A', 'D', 'P', 'L'};
+constexpr uint32_t PADDING_POOL_VERSION = 1;
+
+// Read a pool file. New lengths are generated from the given seed, with
+// the given number of paddings, or as many as the file has per length if
+// it is 0.
+PaddingPool _read_padding_pool(const std::string& filename, uint64_t seed, size_t per_length = 0);
+
+// Write a pool to a file
+void _write_padding_pool(const std::string& filename, const PaddingPool& pool);
+
+// The pool a run draws padding from: the file at path if there is one,
+// checked against the configuration, and otherwise a new pool of up to
+// per_length paddings per length, generated in full only if it is to be
+// saved to path. Empty if neither is asked for.
+std::optional<PaddingPool> _open_padding_pool(
+    const StemConfig& config,
+    size_t per_length,
+    const std::string& path,
+    uint64_t seed
+);
+
+// Write the pool back to path, if there is one and the pool has grown
+void _save_padding_pool(const std::optional<PaddingPool>& pool, const std::string& path);
+
+#endif
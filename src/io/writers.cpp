@@ -15,33 +15,59 @@ std::string output_txt(const std::string& prefix) {
     return prefix + ".txt";
 }
 
-FileWriter::FileWriter(const std::string& filename) {
+std::string output_seed(const std::string& prefix) {
+    return prefix + ".seed";
+}
+
+std::string output_fldb(const std::string& prefix) {
+    return prefix + ".fldb";
+}
+
+void _write_seed(const std::string& filename, uint64_t seed) {
+    std::ofstream file(filename);
+    if (!file.is_open()) {
+        throw std::runtime_error("Failed to open output file: " + filename);
+    }
+    file << seed << "\n";
+}
+
+FileWriter::FileWriter(const std::string& filename, size_t threads) {
     _throw_if_exists(filename);
-    _file.open(filename);
+    _file.open(filename, threads);
     if (!_file.is_open()) {
         throw std::runtime_error("Failed to open file for writing: " + filename);
     }
 }
 
 FileWriter::~FileWriter() {
-    if (_file.is_open()) {
+    try {
         _file.close();
+    } catch (const std::exception&) {
+        // Destructors must not throw; call close() to see errors
     }
 }
 
+void FileWriter::close() {
+    _file.close();
+}
+
 void FileWriter::write_line(const std::string& line) {
     _file << line << "\n";
 }
 
-CsvWriter::CsvWriter(const std::string& filename) : FileWriter(filename) {
+void FileWriter::write(std::string_view text) {
+    _file.write(text.data(), static_cast<std::streamsize>(text.size()));
+}
+
+CsvWriter::CsvWriter(const std::string& filename, size_t threads) : FileWriter(filename, threads) {
     _file << csv::header() << "\n";
 }
 
-FastaWriter::FastaWriter(const std::string& filename) : FileWriter(filename) {}
+FastaWriter::FastaWriter(const std::string& filename, size_t threads) : FileWriter(filename, threads) {}
 
 void FastaWriter::write_sequence(const std::string& name, const std::string& sequence) {
     _file << ">" << name << "\n";
     _file << sequence << "\n";
 }
 
-TxtWriter::TxtWriter(const std::string& filename) : FileWriter(filename) {}
+TxtWriter::TxtWriter(const std::string& filename, size_t threads) : FileWriter(filename, threads) {}
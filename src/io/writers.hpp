@@ -1,38 +1,53 @@
 #ifndef WRITERS_H
 #define WRITERS_H
 
+#include <cstdint>
 #include <string>
+#include <string_view>
 #include <fstream>
 #include <vector>
 #include <functional>
+#include "compressed_file.hpp"
 
 // Helper to generate output filenames from prefix
 std::string output_csv(const std::string& prefix);
 std::string output_fasta(const std::string& prefix);
 std::string output_txt(const std::string& prefix);
+std::string output_seed(const std::string& prefix);
+std::string output_fldb(const std::string& prefix);
 
-// Writer base class for common file operations
+// Record the seed a set of outputs was generated with.
+void _write_seed(const std::string& filename, uint64_t seed);
+
+// Writer base class for common file operations. Files named .gz or .zst
+// are compressed on the given number of threads.
 class FileWriter {
 public:
-    explicit FileWriter(const std::string& filename);
+    explicit FileWriter(const std::string& filename, size_t threads = 1);
     ~FileWriter();
 
     void write_line(const std::string& line);
 
+    // Write text as is, for callers that format whole blocks of records
+    void write(std::string_view text);
+
+    // Close the file, throwing if any output failed to reach it
+    void close();
+
 protected:
-    std::ofstream _file;
+    OutputFile _file;
 };
 
 // CSV writer with header support
 class CsvWriter : public FileWriter {
 public:
-    explicit CsvWriter(const std::string& filename);
+    explicit CsvWriter(const std::string& filename, size_t threads = 1);
 };
 
 // FASTA writer with sequence format
 class FastaWriter : public FileWriter {
 public:
-    explicit FastaWriter(const std::string& filename);
+    explicit FastaWriter(const std::string& filename, size_t threads = 1);
 
     void write_sequence(const std::string& name, const std::string& sequence);
 };
@@ -40,7 +55,7 @@ public:
 // TXT writer for plain sequences
 class TxtWriter : public FileWriter {
 public:
-    explicit TxtWriter(const std::string& filename);
+    explicit TxtWriter(const std::string& filename, size_t threads = 1);
 };
 
 #endif
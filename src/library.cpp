@@ -2,216 +2,370 @@
 #include "domain/sequence.hpp"
 #include "domain/padding.hpp"
 #include "utils.hpp"
+#include "io/compressed_file.hpp"
 #include "io/csv_format.hpp"
+#include "io/library_table.hpp"
+#include "io/padding_pool.hpp"
 #include "io/progress.hpp"
 #include "io/writers.hpp"
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <filesystem>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <map>
+#include <mutex>
 #include <stdexcept>
 
 //
 // Construct
 //
 
-static inline Construct _from_record(const std::string& record, const csv::Header& header, size_t row_num) {
-    std::vector<std::string> fields = _split_by_delimiter(record, ',');
+// The columns a library is read from, by their slot in a projection
+struct LibraryColumns {
+    size_t index;
+    size_t name;
+    size_t sublibrary;
+    size_t five_const;
+    size_t five_padding;
+    size_t design;
+    size_t three_padding;
+    size_t barcode;
+    size_t three_const;
+
+    explicit LibraryColumns(csv::Projection& projection) :
+        index(projection.add(csv::COL_INDEX)),
+        name(projection.add(csv::COL_NAME)),
+        sublibrary(projection.add(csv::COL_SUBLIBRARY)),
+        five_const(projection.add(csv::COL_FIVE_CONST)),
+        five_padding(projection.add(csv::COL_FIVE_PADDING)),
+        design(projection.add(csv::COL_DESIGN)),
+        three_padding(projection.add(csv::COL_THREE_PADDING)),
+        barcode(projection.add(csv::COL_BARCODE)),
+        three_const(projection.add(csv::COL_THREE_CONST)) {}
+};
+
+// Call visit(row, columns, row_num) on each record of a library CSV or
+// table
+template <typename Visit>
+static void _for_each_record(const std::string& filename, Visit visit) {
+    _throw_if_not_exists(filename);
+
+    LibraryRows rows(filename);
+    rows.header().validate();
 
-    // Get required sequence columns
-    std::string five_const = header.get(fields, csv::COL_FIVE_CONST);
-    std::string five_padding = header.get(fields, csv::COL_FIVE_PADDING);
-    std::string design = header.get(fields, csv::COL_DESIGN);
-    std::string three_padding = header.get(fields, csv::COL_THREE_PADDING);
-    std::string barcode = header.get(fields, csv::COL_BARCODE);
-    std::string three_const = header.get(fields, csv::COL_THREE_CONST);
+    LibraryColumns columns(rows.projection());
+    size_t row_num = 1;
+    while (rows.next()) {
+        visit(static_cast<const LibraryRows&>(rows), columns, row_num);
+        row_num++;
+    }
+}
 
+// Add a record to the library. If the barcodes of the file were indexed
+// up front, kept says which rows keep theirs.
+static inline void _add_record(
+    Library& library,
+    const LibraryRows& row,
+    const LibraryColumns& columns,
+    size_t row_num,
+    const std::vector<bool>* kept = nullptr
+) {
     // Get optional metadata columns with defaults
-    std::string index_str = header.get(fields, csv::COL_INDEX, std::to_string(row_num));
-    size_t index = std::stoull(index_str);
-    std::string name = header.get(fields, csv::COL_NAME, "seq_" + std::to_string(row_num));
-    std::string sublibrary = header.get(fields, csv::COL_SUBLIBRARY, "");
+    size_t index = row.has(columns.index) ? std::stoull(std::string(row[columns.index])) : row_num;
+    std::string default_name;
+    if (!row.has(columns.name)) {
+        default_name = "seq_" + std::to_string(row_num);
+    }
 
-    return Construct(
+    library.add(
         index,
-        name,
-        sublibrary,
-        five_const,
-        five_padding,
-        design,
-        three_padding,
-        barcode,
-        three_const
+        row.get(columns.name, default_name),
+        row[columns.sublibrary],
+        row[columns.five_const],
+        row[columns.five_padding],
+        row[columns.design],
+        row[columns.three_padding],
+        (!kept || (*kept)[row_num - 1]) ? row[columns.barcode] : std::string_view(),
+        row[columns.three_const],
+        kept != nullptr
     );
 }
 
-Library _from_csv(const std::string& filename) {
+Library _from_csv(
+    const std::string& filename,
+    size_t min_distance,
+    size_t min_edit_distance
+) {
 
     _throw_if_not_exists(filename);
 
-    std::ifstream file(filename);
-    std::string line;
+    // The file size bounds the text of the library
+    Library library(min_distance, min_edit_distance);
+    library.reserve(0, std::filesystem::file_size(filename));
 
-    std::getline(file, line);
-    csv::Header header(line);
-    header.validate();
+    _for_each_record(filename, [&](const LibraryRows& row, const LibraryColumns& columns, size_t row_num) {
+        _add_record(library, row, columns, row_num);
+    });
 
-    std::vector<Construct> constructs;
-    size_t row_num = 1;
+    return library;
 
-    while (std::getline(file, line)) {
-        if (!line.empty()) {
-            constructs.push_back(_from_record(line, header, row_num));
-            row_num++;
-        }
+}
+
+//
+// Arena
+//
+
+ConstructArena::Segment ConstructArena::append(std::string_view text) {
+    Segment segment{_bytes.size(), text.size()};
+    _bytes.append(text);
+    return segment;
+}
+
+void ConstructArena::allocate(Segment& segment, size_t length) {
+    if (length > segment.length) {
+        segment = Segment{_bytes.size(), length};
+        _bytes.resize(_bytes.size() + length);
     }
+}
 
-    return Library(constructs);
+void ConstructArena::assign(Segment& segment, std::string_view text) {
+    if (text.size() <= segment.length) {
+        std::copy(text.begin(), text.end(), _bytes.begin() + segment.offset);
+        segment.length = text.size();
+    } else {
+        segment = append(text);
+    }
+}
+
+std::string_view ConstructArena::view(Segment segment) const {
+    return std::string_view(_bytes).substr(segment.offset, segment.length);
+}
 
+std::span<char> ConstructArena::span(Segment segment) {
+    return std::span<char>(_bytes.data() + segment.offset, segment.length);
 }
 
+void ConstructArena::reserve(size_t bytes) {
+    _bytes.reserve(bytes);
+}
+
+void ConstructArena::clear() {
+    _bytes.clear();
+}
+
+//
+// Construct
+//
+
 Construct::Construct(
+    ConstructArena& arena,
     size_t index,
-    std::string name,
-    std::string sublibrary,
-    std::string fivep_const,
-    std::string fivep_padding,
-    std::string design,
-    std::string threep_padding,
-    std::string barcode,
-    std::string threep_const
-) : _index(index),
-    _name(name),
-    _sublibrary(sublibrary),
-    _fivep_const(fivep_const),
-    _fivep_padding(fivep_padding),
-    _design(design),
-    _threep_padding(threep_padding),
-    _barcode(barcode),
-    _threep_const(threep_const) {};
+    std::string_view name,
+    std::string_view sublibrary,
+    std::string_view fivep_const,
+    std::string_view fivep_padding,
+    std::string_view design,
+    std::string_view threep_padding,
+    std::string_view barcode,
+    std::string_view threep_const
+) : _arena(&arena), _index(index) {
+    _parts[FIVE_CONST] = arena.append(fivep_const);
+    _parts[FIVE_PADDING] = arena.append(fivep_padding);
+    _parts[DESIGN] = arena.append(design);
+    _parts[THREE_PADDING] = arena.append(threep_padding);
+    _parts[BARCODE] = arena.append(barcode);
+    _parts[THREE_CONST] = arena.append(threep_const);
+    _parts[NAME] = arena.append(name);
+    _parts[SUBLIBRARY] = arena.append(sublibrary);
+}
+
+std::string_view Construct::_view(Part part) const {
+    return _arena->view(_parts[part]);
+}
 
 std::string Construct::str() const {
-    return (
-        _fivep_const +
-        _fivep_padding +
-        _design +
-        _threep_padding +
-        _barcode +
-        _threep_const
-    );
+    std::string out;
+    out.reserve(length());
+    append_sequence(out);
+    return out;
+}
+
+void Construct::append_sequence(std::string& out) const {
+    for (size_t part = 0; part < SEQUENCE_PARTS; part++) {
+        out += _view(static_cast<Part>(part));
+    }
+}
+
+// Wrap a field in quotes, dropping any quotes inside it
+static inline void _append_quoted(std::string& out, std::string_view field) {
+    out += '"';
+    for (char c : field) {
+        if (c != '"') out += c;
+    }
+    out += '"';
 }
 
-std::string Construct::csv_record() const {
+static inline void _append_number(std::string& out, size_t value) {
+    char digits[24];
+    auto [end, error] = std::to_chars(digits, digits + sizeof(digits), value);
+    out.append(digits, end);
+}
+
+void Construct::append_csv_record(std::string& out) const {
     // Calculate 1-based begin/end (exclusive) positions of design in full sequence
     // Full sequence: 5'const + 5'padding + DESIGN + 3'padding + barcode + 3'const
     // end is exclusive, so end - begin = design.size()
-    size_t begin = _fivep_const.size() + _fivep_padding.size() + 1;
-    size_t end = begin + _design.size();
-
-    return(
-        std::to_string(_index) + "," +
-        _escape_with_quotes(_name) + "," +
-        _escape_with_quotes(_sublibrary) + "," +
-        _fivep_const + "," +
-        _fivep_padding + "," +
-        _design + "," +
-        _threep_padding + "," +
-        _barcode + "," +
-        _threep_const + "," +
-        std::to_string(begin) + "," +
-        std::to_string(end)
-    );
+    size_t begin = design_begin();
+    size_t end = begin + _parts[DESIGN].length;
+
+    _append_number(out, _index);
+    out += ',';
+    _append_quoted(out, _view(NAME));
+    out += ',';
+    _append_quoted(out, _view(SUBLIBRARY));
+    for (size_t part = 0; part < SEQUENCE_PARTS; part++) {
+        out += ',';
+        out += _view(static_cast<Part>(part));
+    }
+    out += ',';
+    _append_number(out, begin);
+    out += ',';
+    _append_number(out, end);
+    out += '\n';
+}
+
+void Construct::append_fasta_record(std::string& out) const {
+    out += '>';
+    out += _view(NAME);
+    if (_parts[SUBLIBRARY].length > 0) {
+        out += " (";
+        out += _view(SUBLIBRARY);
+        out += ')';
+    }
+    out += '\n';
+    append_sequence(out);
+    out += '\n';
 }
 
 size_t Construct::index() const {
     return _index;
 }
 
-std::string Construct::name() const {
-    if (_sublibrary.empty()) {
-        return _name;
-    }
-    return _name + " (" + _sublibrary + ")";
+std::string_view Construct::name() const {
+    return _view(NAME);
+}
+
+std::string_view Construct::part(Part part) const {
+    return _view(part);
+}
+
+size_t Construct::design_begin() const {
+    return _parts[FIVE_CONST].length + _parts[FIVE_PADDING].length + 1;
+}
+
+std::string_view Construct::sublibrary() const {
+    return _view(SUBLIBRARY);
 }
 
 size_t Construct::length() const {
-    return str().length();
+    size_t total = 0;
+    for (size_t part = 0; part < SEQUENCE_PARTS; part++) {
+        total += _parts[part].length;
+    }
+    return total;
+}
+
+std::string_view Construct::design() const {
+    return _view(DESIGN);
+}
+
+std::string_view Construct::padding() const {
+    return _view(FIVE_PADDING);
 }
 
 size_t Construct::design_length() const {
-    return _design.length();
+    return _parts[DESIGN].length;
 }
 
 void Construct::replace_polybases(std::mt19937 &gen) {
-    _fivep_const = ::replace_polybases(_fivep_const, gen);
-    _fivep_padding = ::replace_polybases(_fivep_padding, gen);
-    _design = ::replace_polybases(_design, gen);
-    _threep_padding = ::replace_polybases(_threep_padding, gen);
-    _barcode = ::replace_polybases(_barcode, gen);
-    _threep_const = ::replace_polybases(_threep_const, gen);
+    for (size_t part = 0; part < SEQUENCE_PARTS; part++) {
+        ::replace_polybases_in_place(_arena->span(_parts[part]), gen);
+    }
 }
 
 void Construct::to_rna() {
-    _fivep_const = ::to_rna(_fivep_const);
-    _fivep_padding = ::to_rna(_fivep_padding);
-    _design = ::to_rna(_design);
-    _threep_padding = ::to_rna(_threep_padding);
-    _barcode = ::to_rna(_barcode);
-    _threep_const = ::to_rna(_threep_const);
+    for (size_t part = 0; part < SEQUENCE_PARTS; part++) {
+        ::to_rna_in_place(_arena->span(_parts[part]));
+    }
 }
 
 void Construct::to_dna() {
-    _fivep_const = ::to_dna(_fivep_const);
-    _fivep_padding = ::to_dna(_fivep_padding);
-    _design = ::to_dna(_design);
-    _threep_padding = ::to_dna(_threep_padding);
-    _barcode = ::to_dna(_barcode);
-    _threep_const = ::to_dna(_threep_const);
+    for (size_t part = 0; part < SEQUENCE_PARTS; part++) {
+        ::to_dna_in_place(_arena->span(_parts[part]));
+    }
 }
 
-void Construct::replace_barcode(
-    size_t stem_length,
-    const StemConfig& config,
-    std::mt19937 &gen,
-    std::unordered_set<std::string>& existing
-) {
-    _barcode = _random_barcode(stem_length, config, gen, existing);
-    existing.insert(_barcode);
+void Construct::set_barcode(std::string_view barcode) {
+    _arena->assign(_parts[BARCODE], barcode);
+}
+
+void Construct::set_padding(std::string_view padding) {
+    _arena->assign(_parts[FIVE_PADDING], padding);
+}
+
+void Construct::reserve_padding(size_t padded_size) {
+    if (padded_size < design_length()) {
+        throw std::runtime_error("The design region is larger than the padded size (" + std::to_string(design_length()) + " vs " + std::to_string(padded_size) + ")." );
+    }
+    _arena->allocate(_parts[FIVE_PADDING], padded_size - design_length());
 }
 
 void Construct::pad(
     size_t padded_size,
     const StemConfig& config,
-    std::mt19937 &gen
+    std::mt19937 &gen,
+    const KmerScreen* screen
 ) {
     if (padded_size < design_length()) {
         throw std::runtime_error("The design region is larger than the padded size (" + std::to_string(design_length()) + " vs " + std::to_string(padded_size) + ")." );
     }
-    _fivep_padding = get_padding(padded_size - design_length(), config, gen);
+    // Padding is written straight into the arena; reserve_padding() has
+    // usually made room for it already
+    _arena->allocate(_parts[FIVE_PADDING], padded_size - design_length());
+    _parts[FIVE_PADDING].length = padded_size - design_length();
+    write_padding(_arena->span(_parts[FIVE_PADDING]), config, gen, screen);
 }
 
 bool Construct::has_barcode() const {
-    return _barcode.length() > 0;
+    return _parts[BARCODE].length > 0;
 }
 
-std::string Construct::barcode() const {
-    return _barcode;
+bool Construct::has_padding() const {
+    return _parts[FIVE_PADDING].length > 0 || _parts[THREE_PADDING].length > 0;
+}
+
+std::string_view Construct::barcode() const {
+    return _view(BARCODE);
 }
 
 void Construct::remove_barcode() {
-    _barcode = "";
+    _parts[BARCODE].length = 0;
 }
 
 void Construct::primerize(
-    const std::string& five,
-    const std::string& three
+    std::string_view five,
+    std::string_view three
 ) {
-    _fivep_const = five;
-    _threep_const = three;
+    _arena->assign(_parts[FIVE_CONST], five);
+    _arena->assign(_parts[THREE_CONST], three);
 }
 
 void Construct::remove_padding() {
-    _fivep_padding = "";
-    _threep_padding = "";
+    _parts[FIVE_PADDING].length = 0;
+    _parts[THREE_PADDING].length = 0;
 }
 
 //
@@ -220,10 +374,10 @@ void Construct::remove_padding() {
 
 static inline void _insert_or_remove(
     Construct& sequence,
-    std::unordered_set<std::string>& barcodes
+    BarcodeIndex& barcodes
 ) {
     if (sequence.has_barcode()) {
-        bool inserted =  _insert_if_not_neighbour(sequence.barcode(), barcodes);
+        bool inserted =  _insert_if_not_neighbour(std::string(sequence.barcode()), barcodes);
         if (!inserted) {
             sequence.remove_barcode();
         }
@@ -231,14 +385,59 @@ static inline void _insert_or_remove(
 }
 
 Library::Library(
-    std::vector<Construct>& sequences
-) : _sequences(sequences) {
-    _gen = _init_gen();
-    for (auto& sequence: _sequences) {
-        _insert_or_remove(sequence, _barcodes);
+    size_t min_distance,
+    size_t min_edit_distance
+) : _streams(_fresh_seed()),
+    _arena(std::make_unique<ConstructArena>()),
+    _barcodes(min_distance, min_edit_distance) {}
+
+void Library::seed(uint64_t seed) {
+    _streams = RandomStreams(seed);
+}
+
+uint64_t Library::seed() const {
+    return _streams.seed();
+}
+
+void Library::reserve(size_t constructs, size_t bytes) {
+    _sequences.reserve(constructs);
+    _barcodes.reserve(constructs);
+    _arena->reserve(bytes);
+}
+
+void Library::add(
+    size_t index,
+    std::string_view name,
+    std::string_view sublibrary,
+    std::string_view fivep_const,
+    std::string_view fivep_padding,
+    std::string_view design,
+    std::string_view threep_padding,
+    std::string_view barcode,
+    std::string_view threep_const,
+    bool indexed
+) {
+    _sequences.emplace_back(
+        *_arena,
+        index,
+        name,
+        sublibrary,
+        fivep_const,
+        fivep_padding,
+        design,
+        threep_padding,
+        barcode,
+        threep_const
+    );
+    if (!indexed) {
+        _insert_or_remove(_sequences.back(), _barcodes);
     }
 }
 
+bool Library::index_barcode(std::string_view barcode) {
+    return _insert_if_not_neighbour(std::string(barcode), _barcodes);
+}
+
 size_t Library::size() const {
     return _sequences.size();
 }
@@ -247,47 +446,193 @@ size_t Library::barcodes() const {
     return _barcodes.size();
 }
 
-void Library::to_rna() {
-    for (auto& sequence : _sequences) {
-        sequence.to_rna();
-    }
+// Constructs per unit of parallel work. Fixed, so that the random streams
+// do not depend on the thread count.
+static constexpr size_t CONSTRUCT_BLOCK = 1024;
+
+// Draws of a construct's padding before keeping one that misfolds
+static constexpr size_t MAX_FOLD_ATTEMPTS = 10;
+
+// Whether every padding hairpin of a construct holds when the padding is
+// folded together with the design
+static bool _padding_folds(
+    const Construct& construct,
+    const StemConfig& config,
+    FoldEngine& engine,
+    std::vector<Helix>& helices,
+    std::string& seq
+) {
+    helices.clear();
+    padding_helices(construct.padding(), config, 0, helices);
+    if (helices.empty()) return true;
+
+    seq.assign(construct.padding());
+    seq.append(construct.design());
+    engine.fold(seq);
+    return std::all_of(helices.begin(), helices.end(), [&](const Helix& helix) {
+        return engine.formed(helix) == helix.length;
+    });
 }
 
-void Library::to_dna() {
-    for (auto& sequence : _sequences) {
-        sequence.to_dna();
-    }
+// Call work(begin, end, block) on each block of count items, on the given
+// number of threads, and done(blocks) under a lock as blocks complete
+template <typename Work, typename Done>
+static void _for_each_block(
+    size_t count,
+    size_t threads,
+    Work work,
+    Done done
+) {
+    size_t blocks = (count + CONSTRUCT_BLOCK - 1) / CONSTRUCT_BLOCK;
+    std::atomic<size_t> next{0};
+    size_t finished = 0;
+    std::mutex mutex;
+    _run_workers(std::min(threads, std::max<size_t>(blocks, 1)), [&](size_t) {
+        for (size_t block = next++; block < blocks; block = next++) {
+            size_t begin = block * CONSTRUCT_BLOCK;
+            work(begin, std::min(begin + CONSTRUCT_BLOCK, count), block);
+
+            std::lock_guard<std::mutex> lock(mutex);
+            done(++finished);
+        }
+    });
 }
 
-void Library::replace_polybases() {
-    for (auto& sequence : _sequences) {
-        sequence.replace_polybases(_gen);
-    }
+template <typename Work>
+static void _for_each_block(size_t count, size_t threads, Work work) {
+    _for_each_block(count, threads, work, [](size_t) {});
+}
+
+void Library::clear() {
+    _first_block += (size() + CONSTRUCT_BLOCK - 1) / CONSTRUCT_BLOCK;
+    _sequences.clear();
+    _arena->clear();
+}
+
+void Library::to_rna(size_t threads) {
+    _for_each_block(size(), threads, [&](size_t begin, size_t end, size_t) {
+        for (size_t ix = begin; ix < end; ix++) {
+            _sequences[ix].to_rna();
+        }
+    });
+}
+
+void Library::to_dna(size_t threads) {
+    _for_each_block(size(), threads, [&](size_t begin, size_t end, size_t) {
+        for (size_t ix = begin; ix < end; ix++) {
+            _sequences[ix].to_dna();
+        }
+    });
+}
+
+void Library::replace_polybases(size_t threads) {
+    _for_each_block(size(), threads, [&](size_t begin, size_t end, size_t block) {
+        std::mt19937 gen = _streams.stream(RandomStreams::POLYBASES, _first_block + block);
+        for (size_t ix = begin; ix < end; ix++) {
+            _sequences[ix].replace_polybases(gen);
+        }
+    });
 }
 
 void Library::pad(
     size_t padded_size,
-    const StemConfig& config
+    const StemConfig& config,
+    bool keep_existing,
+    size_t threads,
+    PaddingPool* pool
 ) {
+    // Size every padding segment first, so the workers only write in place
+    std::vector<size_t> targets;
+    for (size_t ix = 0; ix < _sequences.size(); ix++) {
+        if (!keep_existing || !_sequences[ix].has_padding()) {
+            _sequences[ix].reserve_padding(padded_size);
+            targets.push_back(ix);
+        }
+    }
+
+    const KmerScreen* screen = _screen_or_null();
+    auto padding_length = [&](size_t ix) {
+        return padded_size - _sequences[targets[ix]].design_length();
+    };
+
+    // Hand out pooled paddings in construct order, so that which construct
+    // gets which does not depend on the thread count
+    std::vector<size_t> slots;
+    if (pool) {
+        std::map<size_t, size_t> demand;
+        for (size_t ix = 0; ix < targets.size(); ix++) {
+            demand[padding_length(ix)]++;
+        }
+        pool->fill(demand, threads, screen);
+
+        slots.reserve(targets.size());
+        for (size_t ix = 0; ix < targets.size(); ix++) {
+            slots.push_back(pool->take(padding_length(ix), screen));
+        }
+    }
+
+    // Misfolded padding is redrawn from the block's stream, so the fold
+    // check keeps the result independent of the thread count
+    std::atomic<size_t> misfolded{0};
     ProgressBar bar("Padding   ");
-    size_t count = 0;
-    for (auto& sequence : _sequences) {
-        sequence.pad(padded_size, config, _gen);
-        count++;
-        bar.update(count, size());
+    size_t blocks = (targets.size() + CONSTRUCT_BLOCK - 1) / CONSTRUCT_BLOCK;
+    _for_each_block(targets.size(), threads,
+        [&](size_t begin, size_t end, size_t block) {
+            std::mt19937 gen = _streams.stream(RandomStreams::PADDING, _first_block + block);
+            std::optional<FoldEngine> engine;
+            if (_fold_span > 0) engine.emplace(_fold_span);
+            std::vector<Helix> helices;
+            std::string seq;
+
+            for (size_t ix = begin; ix < end; ix++) {
+                Construct& construct = _sequences[targets[ix]];
+                size_t slot = pool ? slots[ix] : PaddingPool::npos;
+                if (slot != PaddingPool::npos) {
+                    construct.set_padding(pool->at(padding_length(ix), slot));
+                } else {
+                    construct.pad(padded_size, config, gen, screen);
+                }
+                if (!engine) continue;
+
+                for (size_t attempt = 1; !_padding_folds(construct, config, *engine, helices, seq); attempt++) {
+                    if (attempt == MAX_FOLD_ATTEMPTS) {
+                        misfolded++;
+                        break;
+                    }
+                    construct.pad(padded_size, config, gen, screen);
+                }
+            }
+        },
+        [&](size_t finished) {
+            bar.update(finished, blocks);
+        }
+    );
+
+    if (misfolded > 0) {
+        std::cout << "\n" << misfolded << " constructs kept padding that does not fold as designed after "
+                  << MAX_FOLD_ATTEMPTS << " attempts." << std::endl;
     }
 }
 
 void Library::barcode(
-    size_t stem_length,
-    const StemConfig& config
+    const BarcodeConfig& config,
+    size_t threads,
+    bool keep_existing
 ) {
-    ProgressBar bar("Barcoding ");
-    size_t count = 0;
-    for (auto& sequence : _sequences) {
-        sequence.replace_barcode(stem_length, config, _gen, _barcodes);
-        count++;
-        bar.update(count, size());
+    // Barcodes kept from the input are already in the index, so only the
+    // remaining rows need new ones
+    std::vector<size_t> targets;
+    for (size_t ix = 0; ix < size(); ix++) {
+        if (!keep_existing || !_sequences[ix].has_barcode()) {
+            targets.push_back(ix);
+        }
+    }
+
+    std::vector<std::string> barcodes;
+    std::mt19937 gen = _streams.stream(RandomStreams::BARCODES, _first_block);
+    _get_barcodes(targets.size(), config, gen, _barcodes, barcodes, threads, _screen_or_null());
+    for (size_t ix = 0; ix < targets.size(); ix++) {
+        _sequences[targets[ix]].set_barcode(std::move(barcodes[ix]));
     }
 }
 
@@ -300,75 +645,298 @@ void Library::primerize(
     }
 }
 
+void Library::screen(
+    size_t k,
+    const std::string& five,
+    const std::string& three
+) {
+    size_t bases = five.length() + three.length();
+    for (const Construct& sequence : _sequences) {
+        bases += sequence.design_length();
+    }
+    _screen.emplace(k);
+    _screen->reserve(bases);
+    _screen->add(five);
+    _screen->add(three);
+    for (const Construct& sequence : _sequences) {
+        _screen->add(sequence.design());
+    }
+}
+
+void Library::screen_designs(const Library& chunk) {
+    for (const Construct& sequence : chunk._sequences) {
+        _screen->add(sequence.design());
+    }
+}
+
+void Library::fold_check(size_t max_span) {
+    _fold_span = max_span;
+}
+
+const KmerScreen* Library::_screen_or_null() const {
+    return _screen ? &*_screen : nullptr;
+}
+
+// Bytes of formatted records collected before each write
+static constexpr size_t WRITE_BLOCK = 1 << 20;
+
+template <typename Writer, typename Append>
+void Library::_write(Writer& writer, Append append) const {
+    std::string block;
+    block.reserve(WRITE_BLOCK + (WRITE_BLOCK >> 2));
+    for (const Construct& sequence : _sequences) {
+        append(sequence, block);
+        if (block.size() >= WRITE_BLOCK) {
+            writer.write(block);
+            block.clear();
+        }
+    }
+    writer.write(block);
+}
+
+void Library::write_csv(CsvWriter& writer) const {
+    _write(writer, [](const Construct& sequence, std::string& out) {
+        sequence.append_csv_record(out);
+    });
+}
+
+void Library::write_fasta(FastaWriter& writer) const {
+    _write(writer, [](const Construct& sequence, std::string& out) {
+        sequence.append_fasta_record(out);
+    });
+}
+
+void Library::write_table(LibraryTableWriter& writer) const {
+    // The fields of each construct, in the order of csv::columns()
+    std::array<std::string_view, 11> fields;
+    std::string index, begin, end;
+    for (const Construct& sequence : _sequences) {
+        index = std::to_string(sequence.index());
+        begin = std::to_string(sequence.design_begin());
+        end = std::to_string(sequence.design_begin() + sequence.design().size());
+        fields[0] = index;
+        fields[1] = sequence.name();
+        fields[2] = sequence.sublibrary();
+        for (size_t part = 0; part < Construct::SEQUENCE_PARTS; part++) {
+            fields[3 + part] = sequence.part(static_cast<Construct::Part>(part));
+        }
+        fields[9] = begin;
+        fields[10] = end;
+        writer.add(fields);
+    }
+}
+
+void Library::to_table(
+    const std::string& filename
+) const {
+    LibraryTableWriter writer(filename, csv::columns());
+    write_table(writer);
+    writer.close();
+}
+
 void Library::to_csv(
     const std::string& filename
 ) const {
     CsvWriter writer(filename);
-    for (const Construct& sequence : _sequences) {
-        writer.write_line(sequence.csv_record());
-    }
+    write_csv(writer);
+    writer.close();
 }
 
 void Library::to_txt(
     const std::string& filename
 ) const {
     TxtWriter writer(filename);
-    for (const Construct& sequence : _sequences) {
-        writer.write_line(sequence.str());
-    }
+    _write(writer, [](const Construct& sequence, std::string& out) {
+        sequence.append_sequence(out);
+        out += '\n';
+    });
+    writer.close();
 }
 
 void Library::to_fasta(
     const std::string& filename
 ) const {
     FastaWriter writer(filename);
-    for (const Construct& sequence : _sequences) {
-        writer.write_sequence(sequence.name(), sequence.str());
-    }
+    write_fasta(writer);
+    writer.close();
 }
 
 void Library::save(const std::string& prefix) const {
     to_csv(output_csv(prefix));
     to_fasta(output_fasta(prefix));
+    _write_seed(output_seed(prefix), seed());
+}
+
+// Pad, barcode and primerize the constructs of a library, or of one chunk
+// of it
+static inline void _fill_library_elements(
+    Library& library,
+    const DesignConfig& config,
+    std::optional<PaddingPool>& pool
+) {
+    if (!config.skip_padding) {
+        library.pad(config.pad_to_length, config.stem, config.append, config.threads, pool ? &*pool : nullptr);
+    }
+    if (config.barcode.is_enabled()) {
+        std::cout << std::endl;
+        library.barcode(config.barcode, config.threads, config.append);
+    }
+    std::cout << "\n";
+    std::cout << "\n";
+    library.primerize(config.five_const, config.three_const);
 }
 
 static inline void _add_library_elements(
     Library& library,
-    const DesignConfig& config
+    const DesignConfig& config,
+    std::optional<PaddingPool>& pool
 ) {
     config.validate_with_library_size(library.size());
 
     // Also converts U to T
-    library.replace_polybases();
+    library.replace_polybases(config.threads);
 
     std::cout << "\n";
-    std::cout << "Processing " << std::to_string(library.size()) << " sequences." << std::endl;
+    std::cout << "Processing " << std::to_string(library.size()) << " sequences with seed " << library.seed() << "." << std::endl;
     std::cout << "───────────────────────────────────────────────\n";
 
-    if (!config.skip_padding) {
-        library.pad(config.pad_to_length, config.stem);
+    if (config.append) {
+        std::cout << "Keeping " << std::to_string(library.barcodes()) << " existing barcodes." << std::endl;
     }
-    if (config.barcode.is_enabled()) {
-        std::cout << std::endl;
-        library.barcode(config.barcode.stem_length, config.barcode.stem);
+
+    if (config.screen_kmer > 0) {
+        library.screen(config.screen_kmer, config.five_const, config.three_const);
     }
+    if (config.fold_check) {
+        library.fold_check();
+    }
+
+    _fill_library_elements(library, config, pool);
+}
+
+// Design a library chunk_size rows at a time. Only one chunk, the barcode
+// index and the k-mer screen are held in memory; the screen holds the
+// k-mers of every design.
+static void _design_in_chunks(const DesignConfig& config, std::optional<PaddingPool>& pool) {
+    Library library(config.barcode.min_distance, config.barcode.min_edit_distance);
+    library.seed(config.seed);
+
+    // Index the existing barcodes of every row first, as loading the whole
+    // library would, so that new barcodes avoid those of later chunks
+    std::vector<bool> kept;
+    _for_each_record(config.input_path, [&](const LibraryRows& row, const LibraryColumns& columns, size_t) {
+        std::string_view barcode = row[columns.barcode];
+        kept.push_back(!barcode.empty() && library.index_barcode(barcode));
+    });
+    size_t rows = kept.size();
+    config.validate_with_library_size(rows);
+
     std::cout << "\n";
-    std::cout << "\n";
-    library.primerize(config.five_const, config.three_const);
+    std::cout << "Processing " << std::to_string(rows) << " sequences in chunks of " << config.chunk_size << " with seed " << library.seed() << "." << std::endl;
+    std::cout << "───────────────────────────────────────────────\n";
+
+    if (config.append) {
+        std::cout << "Keeping " << std::to_string(library.barcodes()) << " existing barcodes." << std::endl;
+    }
+
+    // The screen needs every design up front, so it grows with the
+    // distinct k-mers of the whole library rather than with the chunk. A
+    // twin of the library, with the same seed, replaces the same polybases
+    // chunk by chunk.
+    if (config.screen_kmer > 0) {
+        library.screen(config.screen_kmer, config.five_const, config.three_const);
+        Library twin(config.barcode.min_distance, config.barcode.min_edit_distance);
+        twin.seed(config.seed);
+        auto screen_chunk = [&]() {
+            twin.replace_polybases(config.threads);
+            library.screen_designs(twin);
+            twin.clear();
+        };
+        _for_each_record(config.input_path, [&](const LibraryRows& row, const LibraryColumns& columns, size_t row_num) {
+            _add_record(twin, row, columns, row_num, &kept);
+            if (twin.size() == config.chunk_size) screen_chunk();
+        });
+        screen_chunk();
+    }
+    if (config.fold_check) {
+        library.fold_check();
+    }
+
+    std::optional<CsvWriter> csv;
+    std::optional<FastaWriter> fasta;
+    std::optional<LibraryTableWriter> table;
+    if (config.table_output) {
+        table.emplace(output_fldb(config.output_prefix), csv::columns());
+    } else {
+        csv.emplace(output_csv(config.output_prefix));
+        fasta.emplace(output_fasta(config.output_prefix));
+    }
+    size_t written = 0;
+    auto design_chunk = [&]() {
+        if (library.size() == 0) return;
+        std::cout << "\nRows " << written + 1 << " to " << written + library.size() << " of " << rows << "\n";
+        library.replace_polybases(config.threads);
+        _fill_library_elements(library, config, pool);
+        if (table) {
+            library.write_table(*table);
+        } else {
+            library.write_csv(*csv);
+            library.write_fasta(*fasta);
+        }
+        written += library.size();
+        library.clear();
+    };
+    _for_each_record(config.input_path, [&](const LibraryRows& row, const LibraryColumns& columns, size_t row_num) {
+        _add_record(library, row, columns, row_num, &kept);
+        if (library.size() == config.chunk_size) design_chunk();
+    });
+    design_chunk();
+    if (table) {
+        table->close();
+    } else {
+        csv->close();
+        fasta->close();
+    }
+
+    _write_seed(output_seed(config.output_prefix), library.seed());
 }
 
 void _design(const DesignConfig& config) {
     // Remove any existing output files
     _remove_if_exists_all(config.output_prefix, config.overwrite);
 
+    // The padding pool draws from the library's seed, and is shared by
+    // every chunk
+    std::optional<PaddingPool> pool;
+    if (!config.skip_padding) {
+        pool = _open_padding_pool(config.stem, config.padding_pool_size, config.padding_pool_path, config.seed);
+    }
+
+    if (config.chunk_size > 0) {
+        _design_in_chunks(config, pool);
+        _save_padding_pool(pool, config.padding_pool_path);
+        return;
+    }
+
     // Load the library from the provided .csv
-    Library library = _from_csv(config.input_path);
+    Library library = _from_csv(
+        config.input_path,
+        config.barcode.min_distance,
+        config.barcode.min_edit_distance
+    );
 
     // Add all desired library elements
-    _add_library_elements(library, config);
+    library.seed(config.seed);
+    _add_library_elements(library, config, pool);
 
     // Save to disk
-    library.save(config.output_prefix);
+    if (config.table_output) {
+        library.to_table(output_fldb(config.output_prefix));
+        _write_seed(output_seed(config.output_prefix), library.seed());
+    } else {
+        library.save(config.output_prefix);
+    }
+    _save_padding_pool(pool, config.padding_pool_path);
 }
 
 //
@@ -380,7 +948,7 @@ static inline std::string _PARSER_NAME = "design";
 
 // File argument
 static inline std::string _FILE_NAME = "file";
-static inline std::string _FILE_HELP = "The input .csv file.";
+static inline std::string _FILE_HELP = "The input .csv or .fldb file.";
 
 // Output argument
 static inline std::string _OUTPUT_NAME = "-o";
@@ -434,6 +1002,54 @@ static inline std::string _SPACER_NAME = "--spacer";
 static inline int _SPACER_DEFAULT = 2;
 static inline std::string _SPACER_HELP = "The length of the polyA spacer used in between consecutive padding stems.";
 
+static inline std::string _MIN_DISTANCE_NAME = "--min-distance";
+static inline int _MIN_DISTANCE_DEFAULT = 1;
+static inline std::string _MIN_DISTANCE_HELP = "The minimum Hamming distance between barcodes. A value of 1 only excludes pairing-complement neighbours.";
+
+static inline std::string _MIN_EDIT_DISTANCE_NAME = "--min-edit-distance";
+static inline int _MIN_EDIT_DISTANCE_DEFAULT = 0;
+static inline std::string _MIN_EDIT_DISTANCE_HELP = "The minimum edit distance between barcodes, counting insertions and deletions. A value of 0 disables the check.";
+
+static inline std::string _MAXIMAL_NAME = "--maximal";
+static inline std::string _MAXIMAL_HELP = "Draw barcodes from a dense greedy lexicode instead of at random.";
+
+static inline std::string _BARCODE_POOL_NAME = "--barcode-pool";
+static inline std::string _BARCODE_POOL_DEFAULT = "";
+static inline std::string _BARCODE_POOL_HELP = "Draw barcodes from a pool file written by 'barcodes --pool' instead of generating them.";
+
+static inline std::string _APPEND_NAME = "--append";
+static inline std::string _APPEND_HELP = "Keep the padding and barcodes of rows that already have them, and only fill in the rest.";
+
+static inline std::string _SCREEN_KMER_NAME = "--screen-kmer";
+static inline int _SCREEN_KMER_DEFAULT = 0;
+static inline std::string _SCREEN_KMER_HELP = "Reject padding and barcodes sharing a k-mer of this length with any design or constant region, on either strand. A value of 0 disables the screen.";
+
+static inline std::string _THREADS_NAME = "--threads";
+static inline int _THREADS_DEFAULT = 1;
+static inline std::string _THREADS_HELP = "The number of threads to pad, convert and barcode sequences with.";
+
+static inline std::string _SEED_NAME = "--seed";
+static inline std::string _SEED_DEFAULT = "";
+static inline std::string _SEED_HELP = "The seed of every random choice, for a reproducible library. A fresh seed is drawn if not given, and the seed used is written to <output>.seed.";
+
+static inline std::string _CHUNK_SIZE_NAME = "--chunk-size";
+static inline int _CHUNK_SIZE_DEFAULT = 0;
+static inline std::string _CHUNK_SIZE_HELP = "Design the library this many rows at a time, holding only one chunk and the barcode index in memory. The --screen-kmer screen is not bounded by the chunk: it holds the k-mers of every design. A value of 0 loads the whole library.";
+
+static inline std::string _PADDING_POOL_NAME = "--padding-pool";
+static inline int _PADDING_POOL_DEFAULT = 0;
+static inline std::string _PADDING_POOL_HELP = "Pre-generate up to this many paddings for each padding length, in parallel, and give each to at most one sequence before generating more. Only as many as the library needs are generated, unless the pool is saved to a file. A value of 0 generates every padding.";
+
+static inline std::string _PADDING_POOL_FILE_NAME = "--padding-pool-file";
+static inline std::string _PADDING_POOL_FILE_DEFAULT = "";
+static inline std::string _PADDING_POOL_FILE_HELP = "Load the padding pool from this file (.fldpp) if it exists, and save it there with any new lengths, to reuse it across runs. Each run starts at a slot derived from its seed, so runs with the same seed share their paddings.";
+
+static inline std::string _FOLD_CHECK_NAME = "--fold-check";
+static inline std::string _FOLD_CHECK_HELP = "Fold each padding with its design and redraw padding whose hairpins do not form.";
+
+static inline std::string _FLDB_NAME = "--fldb";
+static inline std::string _FLDB_HELP = "Write the library as a binary table, <output>.fldb, instead of .csv and .fasta, for later steps to read back quickly.";
+
 DesignArgs::DesignArgs() :
     Program(_PARSER_NAME),
     file(_parser, _FILE_NAME, _FILE_HELP),
@@ -449,6 +1065,19 @@ DesignArgs::DesignArgs() :
     max_gc(_parser, _MAX_GC_NAME, _MAX_GC_HELP, _MAX_GC_DEFAULT),
     max_gu(_parser, _MAX_GU_NAME, _MAX_GU_HELP, _MAX_GU_DEFAULT),
     closing_gc(_parser, _CLOSING_GC_NAME, _CLOSING_GC_HELP, _CLOSING_GC_DEFAULT),
-    spacer(_parser, _SPACER_NAME, _SPACER_HELP, _SPACER_DEFAULT) {
+    spacer(_parser, _SPACER_NAME, _SPACER_HELP, _SPACER_DEFAULT),
+    min_distance(_parser, _MIN_DISTANCE_NAME, _MIN_DISTANCE_HELP, _MIN_DISTANCE_DEFAULT),
+    min_edit_distance(_parser, _MIN_EDIT_DISTANCE_NAME, _MIN_EDIT_DISTANCE_HELP, _MIN_EDIT_DISTANCE_DEFAULT),
+    maximal(_parser, _MAXIMAL_NAME, _MAXIMAL_HELP),
+    barcode_pool(_parser, _BARCODE_POOL_NAME, _BARCODE_POOL_HELP, _BARCODE_POOL_DEFAULT),
+    append(_parser, _APPEND_NAME, _APPEND_HELP),
+    screen_kmer(_parser, _SCREEN_KMER_NAME, _SCREEN_KMER_HELP, _SCREEN_KMER_DEFAULT),
+    threads(_parser, _THREADS_NAME, _THREADS_HELP, _THREADS_DEFAULT),
+    seed(_parser, _SEED_NAME, _SEED_HELP, _SEED_DEFAULT),
+    chunk_size(_parser, _CHUNK_SIZE_NAME, _CHUNK_SIZE_HELP, _CHUNK_SIZE_DEFAULT),
+    padding_pool(_parser, _PADDING_POOL_NAME, _PADDING_POOL_HELP, _PADDING_POOL_DEFAULT),
+    padding_pool_file(_parser, _PADDING_POOL_FILE_NAME, _PADDING_POOL_FILE_HELP, _PADDING_POOL_FILE_DEFAULT),
+    fold_check(_parser, _FOLD_CHECK_NAME, _FOLD_CHECK_HELP),
+    fldb(_parser, _FLDB_NAME, _FLDB_HELP) {
 
 }
@@ -19,6 +19,18 @@
 #include "barcodes.hpp"
 #include "utils.hpp"
 #include "config/design_config.hpp"
+#include "domain/fold.hpp"
+#include "domain/kmer_screen.hpp"
+#include "domain/padding_pool.hpp"
+#include "domain/random_streams.hpp"
+#include "io/writers.hpp"
+#include <array>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string_view>
+
+class LibraryTableWriter;
 
 /**
  * Command-line arguments for the 'design' subcommand.
@@ -39,39 +51,122 @@ public:
     Arg<int> max_gu;
     Arg<int> closing_gc;
     Arg<int> spacer;
+    Arg<int> min_distance;
+    Arg<int> min_edit_distance;
+    Arg<bool> maximal;
+    Arg<std::string> barcode_pool;
+    Arg<bool> append;
+    Arg<int> screen_kmer;
+    Arg<int> threads;
+    Arg<std::string> seed;
+    Arg<int> chunk_size;
+    Arg<int> padding_pool;
+    Arg<std::string> padding_pool_file;
+    Arg<bool> fold_check;
+    Arg<bool> fldb;
 
     DesignArgs();
 };
 
+/**
+ * The text of every construct in a library, stored back to back in one
+ * buffer. A Segment addresses a piece of it by offset and length, so
+ * constructs hold no strings of their own and a library of a million rows
+ * is a handful of allocations.
+ *
+ * Rewriting a segment with text no longer than it overwrites it in place;
+ * longer text is appended and the old bytes are abandoned.
+ */
+class ConstructArena {
+public:
+    struct Segment {
+        size_t offset = 0;
+        size_t length = 0;
+    };
+
+    /// Copy text to the end of the arena.
+    Segment append(std::string_view text);
+
+    /// Replace the text of a segment.
+    void assign(Segment& segment, std::string_view text);
+
+    /// Make room for a segment of the given length, so that assigning
+    /// text of that length later writes in place and never grows the arena.
+    void allocate(Segment& segment, size_t length);
+
+    /// Read or edit the text of a segment in place.
+    std::string_view view(Segment segment) const;
+    std::span<char> span(Segment segment);
+
+    /// Pre-size the buffer for the given number of bytes.
+    void reserve(size_t bytes);
+
+    /// Drop all text, keeping the buffer for reuse.
+    void clear();
+
+private:
+    std::string _bytes;
+};
+
 /**
  * A single library construct consisting of a design sequence and its
  * surrounding library elements (primers, padding, barcode).
  *
  * The construct structure (5' to 3'):
  *   [5' const] [5' padding] [design] [3' padding] [barcode] [3' const]
+ *
+ * The text of each part lives in the arena of the library the construct
+ * belongs to, which must outlive it.
  */
 class Construct {
 public:
+    /// The parts of a construct, in sequence order, then its metadata.
+    enum Part : size_t {
+        FIVE_CONST,
+        FIVE_PADDING,
+        DESIGN,
+        THREE_PADDING,
+        BARCODE,
+        THREE_CONST,
+        NAME,
+        SUBLIBRARY,
+        PARTS
+    };
+
+    /// The number of parts that make up the sequence.
+    static constexpr size_t SEQUENCE_PARTS = NAME;
+
     Construct(
+        ConstructArena& arena,
         size_t index,
-        std::string name,
-        std::string sublibrary,
-        std::string fivep_const,
-        std::string fivep_padding,
-        std::string design,
-        std::string threep_padding,
-        std::string barcode,
-        std::string threep_const
+        std::string_view name,
+        std::string_view sublibrary,
+        std::string_view fivep_const,
+        std::string_view fivep_padding,
+        std::string_view design,
+        std::string_view threep_padding,
+        std::string_view barcode,
+        std::string_view threep_const
     );
 
     /// Get the full construct sequence.
     std::string str() const;
 
-    /// Get the construct as a CSV record.
-    std::string csv_record() const;
+    /// Append the full sequence, a CSV record or a FASTA record to a
+    /// buffer, without intermediate strings.
+    void append_sequence(std::string& out) const;
+    void append_csv_record(std::string& out) const;
+    void append_fasta_record(std::string& out) const;
+
+    /// Get the construct name and sublibrary.
+    std::string_view name() const;
+    std::string_view sublibrary() const;
 
-    /// Get the construct name.
-    std::string name() const;
+    /// Get any part of the construct.
+    std::string_view part(Part part) const;
+
+    /// Get the 1-based position of the design in the full sequence.
+    size_t design_begin() const;
 
     /// Get the total length of the construct.
     size_t length() const;
@@ -89,24 +184,40 @@ public:
     void replace_polybases(std::mt19937& gen);
 
     /// Add 5' and 3' constant regions.
-    void primerize(const std::string& five, const std::string& three);
+    void primerize(std::string_view five, std::string_view three);
+
+    /// Set the barcode sequence.
+    void set_barcode(std::string_view barcode);
 
-    /// Generate a unique barcode for this construct.
-    void replace_barcode(
-        size_t stem_length,
+    /// Make room in the arena for the padding that pad() will write.
+    void reserve_padding(size_t padded_size);
+
+    /// Set the 5' padding to a given sequence, such as one from a pool.
+    void set_padding(std::string_view padding);
+
+    /// Add padding hairpins to reach the target size, redrawing any that
+    /// share a k-mer with the screen.
+    void pad(
+        size_t padded_size,
         const StemConfig& config,
         std::mt19937& gen,
-        std::unordered_set<std::string>& existing
+        const KmerScreen* screen = nullptr
     );
 
-    /// Add padding hairpins to reach the target size.
-    void pad(size_t padded_size, const StemConfig& config, std::mt19937& gen);
-
     /// Check if this construct has a barcode.
     bool has_barcode() const;
 
+    /// Check if this construct has padding.
+    bool has_padding() const;
+
     /// Get the barcode sequence.
-    std::string barcode() const;
+    std::string_view barcode() const;
+
+    /// Get the design sequence.
+    std::string_view design() const;
+
+    /// Get the 5' padding sequence.
+    std::string_view padding() const;
 
     /// Get the original 1-based index in the input file.
     size_t index() const;
@@ -118,15 +229,11 @@ public:
     void remove_padding();
 
 private:
+    ConstructArena* _arena;
     size_t _index;
-    std::string _name;
-    std::string _sublibrary;
-    std::string _fivep_const;
-    std::string _fivep_padding;
-    std::string _design;
-    std::string _threep_padding;
-    std::string _barcode;
-    std::string _threep_const;
+    std::array<ConstructArena::Segment, PARTS> _parts;
+
+    std::string_view _view(Part part) const;
 };
 
 /**
@@ -137,11 +244,51 @@ private:
  * - Generating unique barcodes
  * - Converting between DNA/RNA
  * - Exporting to CSV, FASTA, and TXT formats
+ *
+ * A library owns the arena its constructs live in, so it can be moved but
+ * not copied.
+ *
+ * The per-construct stages run on any number of threads. Constructs are
+ * split into fixed blocks, and each block draws from its own stream of the
+ * library's random streams, so the result depends only on the seed and
+ * never on the thread count.
  */
 class Library {
 public:
-    Library() = default;
-    Library(std::vector<Construct>& sequences);
+    explicit Library(size_t min_distance = 1, size_t min_edit_distance = 0);
+
+    /// Pre-size for the given number of constructs and bytes of text.
+    void reserve(size_t constructs, size_t bytes);
+
+    /// Set or get the master seed that every random stage draws from.
+    void seed(uint64_t seed);
+    uint64_t seed() const;
+
+    /// Add a construct. An existing barcode too close to an earlier one
+    /// is removed, unless it was already indexed with index_barcode().
+    void add(
+        size_t index,
+        std::string_view name,
+        std::string_view sublibrary,
+        std::string_view fivep_const,
+        std::string_view fivep_padding,
+        std::string_view design,
+        std::string_view threep_padding,
+        std::string_view barcode,
+        std::string_view threep_const,
+        bool indexed = false
+    );
+
+    /// Index a barcode ahead of adding its construct, so that a library
+    /// designed in chunks knows every existing barcode up front. Returns
+    /// false, leaving the index unchanged, if it is too close to an
+    /// earlier one.
+    bool index_barcode(std::string_view barcode);
+
+    /// Drop every construct, keeping the barcode index, the screen and the
+    /// seed, so that the next chunk of a large library can be loaded.
+    /// Later chunks draw from streams of their own.
+    void clear();
 
     /// Get the number of constructs in the library.
     size_t size() const;
@@ -158,37 +305,94 @@ public:
     /// Export to FASTA format.
     void to_fasta(const std::string& filename) const;
 
-    /// Export to all formats (CSV, FASTA, TXT).
+    /// Export to CSV and FASTA, and record the seed next to them.
     void save(const std::string& prefix) const;
 
+    /// Append every construct to an open CSV or FASTA writer.
+    void write_csv(CsvWriter& writer) const;
+    void write_fasta(FastaWriter& writer) const;
+
+    /// Export to a library table (.fldb), with the columns of the CSV.
+    void to_table(const std::string& filename) const;
+
+    /// Append every construct to an open library table writer.
+    void write_table(LibraryTableWriter& writer) const;
+
     /// Convert all sequences to RNA.
-    void to_rna();
+    void to_rna(size_t threads = 1);
 
     /// Convert all sequences to DNA.
-    void to_dna();
+    void to_dna(size_t threads = 1);
 
     /// Replace degenerate bases in all sequences.
-    void replace_polybases();
-
-    /// Generate unique barcodes for all sequences.
-    void barcode(size_t stem_length, const StemConfig& config);
-
-    /// Add padding to all sequences to reach target size.
-    void pad(size_t padded_size, const StemConfig& config);
+    void replace_polybases(size_t threads = 1);
+
+    /// Generate unique barcodes for all sequences, or only for those
+    /// without one if keep_existing is set.
+    void barcode(const BarcodeConfig& config, size_t threads = 1, bool keep_existing = false);
+
+    /// Add padding to all sequences to reach target size, or only to
+    /// those without padding if keep_existing is set. With a pool, each
+    /// construct takes the next unused padding of its length from it, and
+    /// only those left over are generated. With the fold check on, padding
+    /// whose hairpins do not fold as designed next to the design is redrawn.
+    void pad(
+        size_t padded_size,
+        const StemConfig& config,
+        bool keep_existing = false,
+        size_t threads = 1,
+        PaddingPool* pool = nullptr
+    );
 
     /// Add constant regions to all sequences.
     void primerize(const std::string& five, const std::string& three);
 
+    /// Screen new padding and barcodes against the k-mers of every design
+    /// and the given constant regions.
+    void screen(
+        size_t k,
+        const std::string& five,
+        const std::string& three
+    );
+
+    /// Add the designs of another library to the screen, for libraries
+    /// designed in chunks.
+    void screen_designs(const Library& chunk);
+
+    /// Check that new padding folds as designed next to each design,
+    /// folding with pairs spanning at most max_span bases.
+    void fold_check(size_t max_span = FoldEngine::DEFAULT_MAX_SPAN);
+
 private:
-    std::mt19937 _gen;
+    RandomStreams _streams;
+    // The first stream of this chunk of the library
+    size_t _first_block = 0;
+    std::unique_ptr<ConstructArena> _arena;
     std::vector<Construct> _sequences;
-    std::unordered_set<std::string> _barcodes;
-};
+    BarcodeIndex _barcodes;
+    std::optional<KmerScreen> _screen;
+    // The span to fold padding with, or 0 to skip the fold check
+    size_t _fold_span = 0;
+
+    const KmerScreen* _screen_or_null() const;
 
-/// Load a library from a CSV file.
-Library _from_csv(const std::string& filename);
+    // Format every construct into a buffer and write it out in blocks
+    template <typename Writer, typename Append>
+    void _write(Writer& writer, Append append) const;
+};
 
-/// Run the design pipeline with the given configuration.
+/// Load a library from a CSV file or a library table (.fldb).
+Library _from_csv(
+    const std::string& filename,
+    size_t min_distance = 1,
+    size_t min_edit_distance = 0
+);
+
+/// Run the design pipeline with the given configuration. With a chunk size,
+/// the input is read and written that many rows at a time, in three passes:
+/// one to index existing barcodes, one to build the k-mer screen if asked
+/// for, and one to design and write each chunk. With table output, the
+/// library is written to <prefix>.fldb instead of .csv and .fasta.
 void _design(const DesignConfig& config);
 
 #endif
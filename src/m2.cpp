@@ -1,11 +1,12 @@
 #include "m2.hpp"
+#include "domain/nucleotide_kernels.hpp"
 #include "domain/sequence.hpp"
 #include "io/fasta_io.hpp"
 
 static inline void _write_single_mutant_all(
     FastaOutputStream& out,
-    const std::string& header,
-    const std::string& sequence,
+    std::string_view header,
+    std::string_view sequence,
     int pos,
     Alphabet alphabet
 ) {
@@ -15,45 +16,43 @@ static inline void _write_single_mutant_all(
             continue;
         }
 
-        std::string mutant = sequence;
+        std::string mutant(sequence);
         mutant[pos] = mutant_base;
 
-        std::string name = header + "_mm_" + std::to_string(pos) + "_" + original_base + "_" + mutant_base;
+        std::string name = std::string(header) + "_mm_" + std::to_string(pos) + "_" + original_base + "_" + mutant_base;
         out.write(name, mutant);
     }
 }
 
 static inline void _write_single_mutant(
     FastaOutputStream& out,
-    const std::string& header,
-    const std::string& sequence,
+    std::string_view header,
+    std::string_view sequence,
     int pos,
-    Alphabet alphabet
+    char mutant_base
 ) {
-    char original_base = sequence[pos];
-    char mutant_base;
-    try {
-        mutant_base = complement(original_base, alphabet);
-    } catch (const std::exception& e) {
+    // Bases without a complement are left alone
+    if (mutant_base == 'N') {
         return;
     }
+    char original_base = sequence[pos];
 
-    std::string mutant = sequence;
+    std::string mutant(sequence);
     mutant[pos] = mutant_base;
 
-    std::string name = header + "_mm_" + std::to_string(pos) + "_" + original_base + "_" + mutant_base;
+    std::string name = std::string(header) + "_mm_" + std::to_string(pos) + "_" + original_base + "_" + mutant_base;
     out.write(name, mutant);
 }
 
 
 static inline void _write_single_mutants(
     FastaOutputStream& out,
-    const std::string& header,
-    const std::string& sequence,
+    std::string_view header,
+    std::string_view sequence,
     bool all
 ) {
     // Write wild type
-    out.write(header + "_wt", sequence);
+    out.write(std::string(header) + "_wt", sequence);
 
     Alphabet alphabet = detect_alphabet(sequence);
 
@@ -64,8 +63,10 @@ static inline void _write_single_mutants(
             _write_single_mutant_all(out, header, sequence, i, alphabet);
         }
     } else {
+        std::string complements(sequence);
+        complement_in_place(complements, alphabet);
         for (size_t i = 0; i < seq_len; i++) {
-            _write_single_mutant(out, header, sequence, i, alphabet);
+            _write_single_mutant(out, header, sequence, i, complements[i]);
         }
     }
 }
@@ -81,9 +82,10 @@ void _m2(
 
     FastaOutputStream out(output);
 
-    for_each_fasta(input, [&](const FastaEntry& entry) {
+    for_each_fasta_record(input, [&](const FastaRecord& entry) {
         _write_single_mutants(out, entry.name, entry.sequence, all);
     });
+    out.close();
 }
 
 static inline std::string _PARSER_NAME = "m2";
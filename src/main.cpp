@@ -18,6 +18,8 @@ SuperProgram::SuperProgram() : _parent(PROGRAM, VERSION) {
     _parent.add_subparser(torna._parser);
     _parent.add_subparser(todna._parser);
     _parent.add_subparser(diff._parser);
+    _parent.add_subparser(demux._parser);
+    _parent.add_subparser(fold_check._parser);
 };
 void SuperProgram::parse(int argc, char** argv) {
     _parent.parse_args(argc, argv);
@@ -41,6 +43,8 @@ MODE SuperProgram::mode() const {
     if (torna.used(_parent))      return MODE::ToRna;
     if (todna.used(_parent))      return MODE::ToDna;
     if (diff.used(_parent))       return MODE::Diff;
+    if (demux.used(_parent))      return MODE::Demux;
+    if (fold_check.used(_parent)) return MODE::FoldCheck;
     throw std::runtime_error("Unknown subcommand.");
 }
 
@@ -63,7 +67,8 @@ int main(int argc, char** argv) {
                 InspectArgs& opt = parent.inspect;
                 _inspect(
                     opt.files,
-                    opt.sort
+                    opt.sort,
+                    _thread_count(opt.threads)
                 );
                 break;
             }
@@ -74,7 +79,8 @@ int main(int argc, char** argv) {
                     opt.file,
                     opt.output,
                     opt.overwrite,
-                    opt.sublibrary
+                    opt.sublibrary,
+                    _thread_count(opt.threads)
                 );
                 break;
             }
@@ -99,23 +105,46 @@ int main(int argc, char** argv) {
                 // Barcode config
                 config.barcode.stem_length = opt.barcode_length;
                 config.barcode.stem = config.stem;  // Use same stem config for barcodes
+                config.barcode.min_distance = _min_distance(opt.min_distance);
+                config.barcode.min_edit_distance = _min_edit_distance(opt.min_edit_distance);
+                config.barcode.maximal = opt.maximal;
+                config.barcode.pool_path = opt.barcode_pool;
+                config.append = opt.append;
+                config.screen_kmer = _screen_kmer(opt.screen_kmer);
+                config.threads = _thread_count(opt.threads);
+                config.seed = _seed(opt.seed);
+                config.chunk_size = _chunk_size(opt.chunk_size);
+                config.padding_pool_size = _padding_pool_size(opt.padding_pool);
+                config.padding_pool_path = opt.padding_pool_file;
+                config.fold_check = opt.fold_check;
+                config.table_output = opt.fldb;
                 _design(config);
                 break;
             }
 
             case MODE::Barcodes: {
                 BarcodesArgs& opt = parent.barcodes;
-                StemConfig config;
-                config.max_au = opt.max_au;
-                config.max_gc = opt.max_gc;
-                config.max_gu = opt.max_gu;
-                config.closing_gc = opt.closing_gc;
+                BarcodeConfig config;
+                config.stem_length = opt.stem_length;
+                config.stem.max_au = opt.max_au;
+                config.stem.max_gc = opt.max_gc;
+                config.stem.max_gu = opt.max_gu;
+                config.stem.closing_gc = opt.closing_gc;
+                config.min_distance = _min_distance(opt.min_distance);
+                config.min_edit_distance = _min_edit_distance(opt.min_edit_distance);
+                config.maximal = opt.maximal;
+                uint64_t seed = _seed(opt.seed);
+                if (!config.maximal) {
+                    std::cout << "Seed: " << seed << "\n";
+                }
                 _barcodes(
                     opt.count,
                     opt.output,
+                    opt.pool,
                     opt.overwrite,
-                    opt.stem_length,
-                    config
+                    config,
+                    _thread_count(opt.threads),
+                    seed
                 );
                 break;
             }
@@ -133,12 +162,15 @@ int main(int argc, char** argv) {
 
             case MODE::Random: {
                 RandomArgs& opt = parent.random;
+                uint64_t seed = _seed(opt.seed);
+                std::cout << "Seed: " << seed << "\n";
                 _random(
                     opt.output,
                     opt.overwrite,
                     opt.count,
                     opt.length,
-                    opt.fasta
+                    opt.fasta,
+                    seed
                 );
                 break;
             }
@@ -187,7 +219,8 @@ int main(int argc, char** argv) {
                     opt.output,
                     opt.overwrite,
                     opt.descending,
-                    opt.sort_by_reads
+                    opt.sort_by_reads,
+                    opt.fldb
                 );
                 break;
             }
@@ -201,7 +234,8 @@ int main(int argc, char** argv) {
                     opt.barcode_reads,
                     opt.output,
                     opt.overwrite,
-                    opt.sort_by_reads
+                    opt.sort_by_reads,
+                    opt.fldb
                 );
                 break;
             }
@@ -223,10 +257,21 @@ int main(int argc, char** argv) {
                 config.stem.closing_gc = opt.closing_gc;
                 config.stem.spacer_length = opt.spacer;
                 config.barcode_length = opt.barcode_length;
+                config.min_distance = _min_distance(opt.min_distance);
+                config.min_edit_distance = _min_edit_distance(opt.min_edit_distance);
+                config.maximal = opt.maximal;
+                config.barcode_pool = opt.barcode_pool;
+                config.append_to = opt.append_to;
+                config.screen_kmer = _screen_kmer(opt.screen_kmer);
                 config.no_barcodes = opt.no_barcodes;
                 config.generate_m2 = opt.m2;
                 config.predict = opt.predict;
                 config.sort_by_reads = opt.sort_by_reads;
+                config.threads = _thread_count(opt.threads);
+                config.seed = _seed(opt.seed);
+                config.chunk_size = _chunk_size(opt.chunk_size);
+                config.padding_pool_size = _padding_pool_size(opt.padding_pool);
+                config.padding_pool_path = opt.padding_pool_file;
                 _pipeline(config);
                 break;
             }
@@ -268,6 +313,44 @@ int main(int argc, char** argv) {
                 return identical ? EXIT_SUCCESS : EXIT_FAILURE;
             }
 
+            case MODE::Demux: {
+                DemuxArgs& opt = parent.demux;
+                if (opt.max_mismatches < 0) {
+                    throw std::invalid_argument("The number of mismatches cannot be negative.");
+                }
+                _demux(
+                    opt.file,
+                    opt.library,
+                    opt.output,
+                    opt.fastq_dir,
+                    static_cast<size_t>(opt.max_mismatches),
+                    opt.reverse_complement,
+                    opt.overwrite,
+                    _thread_count(opt.threads)
+                );
+                break;
+            }
+
+            case MODE::FoldCheck: {
+                FoldCheckArgs& opt = parent.fold_check;
+                if (opt.max_span < 0) {
+                    throw std::invalid_argument("The maximum base pair span cannot be negative.");
+                }
+                StemConfig config;
+                config.min_length = opt.min_stem_length;
+                config.max_length = opt.max_stem_length;
+                config.spacer_length = opt.spacer;
+                FoldCheckStats stats = _fold_check(
+                    opt.file,
+                    opt.output,
+                    opt.overwrite,
+                    config,
+                    static_cast<size_t>(opt.max_span),
+                    _thread_count(opt.threads)
+                );
+                return (stats.misfolded_hairpins == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+            }
+
         }
 
     } catch (const std::exception& e) {
@@ -19,6 +19,8 @@
 #include "torna.hpp"
 #include "todna.hpp"
 #include "diff.hpp"
+#include "demux.hpp"
+#include "fold_check.hpp"
 #include "version.hpp"
 
 const auto PROGRAM = "fld";
@@ -41,7 +43,9 @@ enum class MODE {
     Prepend,
     ToRna,
     ToDna,
-    Diff
+    Diff,
+    Demux,
+    FoldCheck
 };
 
 class SuperProgram {
@@ -68,6 +72,8 @@ public:
     ToRnaArgs torna;
     ToDnaArgs todna;
     DiffArgs diff;
+    DemuxArgs demux;
+    FoldCheckArgs fold_check;
 
     SuperProgram();
     void parse(int argc, char** argv);
@@ -1,6 +1,7 @@
 #include "merge.hpp"
 #include "library.hpp"
 #include "io/csv_format.hpp"
+#include "io/library_table.hpp"
 #include <fstream>
 #include <iostream>
 #include <algorithm>
@@ -8,13 +9,14 @@
 static inline std::string _PARSER_NAME = "merge";
 
 MergeArgs::MergeArgs() : Program(_PARSER_NAME),
-    library(_parser, "--library", "Input CSV library file (without barcodes)"),
+    library(_parser, "--library", "Input CSV or .fldb library file (without barcodes)"),
     library_reads(_parser, "--library-reads", "Text file with predicted read counts (one per line)"),
     barcodes(_parser, "--barcodes", "Text file with barcode sequences (one per line)"),
     barcode_reads(_parser, "--barcode-reads", "Text file with predicted barcode read counts"),
     output(_parser, "-o", "Output prefix"),
     overwrite(_parser, "--overwrite", "Overwrite existing files", false),
-    sort_by_reads(_parser, "--sort-by-reads", "Sort output by read counts (default: preserve input order)", false)
+    sort_by_reads(_parser, "--sort-by-reads", "Sort output by read counts (default: preserve input order)", false),
+    fldb(_parser, "--fldb", "Write the output as a binary table, <output>.fldb, instead of .csv and .fasta", false)
 {
     _parser.add_description(
         "Merge barcodes into library using read-count balancing.\n\n"
@@ -25,24 +27,25 @@ MergeArgs::MergeArgs() : Program(_PARSER_NAME),
     );
 }
 
+// Rows and barcodes are held with their sequences packed, since the whole
+// library is in memory at once
 struct LibraryEntry {
     size_t original_index = 0;  // 1-based index from CSV
     std::string sublibrary;
     double reads = 0.0;
-    std::vector<std::string> fields;
+    csv::PackedRow row;
 };
 
 struct BarcodeEntry {
     size_t original_index = 0;
     double reads = 0.0;
-    std::string barcode;
+    PackedSequence barcode;
 };
 
 struct MergedEntry {
     size_t original_index = 0;  // 1-based index from CSV
     std::string sublibrary;
-    std::vector<std::string> fields;
-    std::string barcode;
+    csv::PackedRow row;
     double design_reads = 0.0;
     double barcode_reads = 0.0;
 };
@@ -54,7 +57,8 @@ void _merge(
     const std::string& barcode_reads_file,
     const std::string& output_prefix,
     bool overwrite,
-    bool sort_by_reads
+    bool sort_by_reads,
+    bool table_output
 ) {
     _throw_if_not_exists(library_csv);
     _throw_if_not_exists(library_reads_file);
@@ -62,29 +66,28 @@ void _merge(
     _throw_if_not_exists(barcode_reads_file);
     _remove_if_exists_all(output_prefix, overwrite);
 
-    // Load library CSV
-    std::ifstream in(library_csv);
-    std::string header_line;
-    std::getline(in, header_line);
-
-    csv::Header header(header_line);
+    // Load library CSV or table
+    LibraryRows rows(library_csv);
+    const csv::Header& header = rows.header();
     header.validate();
 
+    csv::Projection& projection = rows.projection();
+    projection.add_all();
+    size_t index_slot = projection.add(csv::COL_INDEX);
+    size_t sublibrary_slot = projection.add(csv::COL_SUBLIBRARY);
+
     std::vector<LibraryEntry> library_entries;
-    std::string line;
     size_t row_num = 1;
-    while (std::getline(in, line)) {
-        if (line.empty()) continue;
-        LibraryEntry entry;
-        entry.fields = _split_by_delimiter(line, ',');
+    while (rows.next()) {
         // Parse original_index and sublibrary from CSV (with defaults)
-        std::string idx_str = header.get(entry.fields, csv::COL_INDEX, std::to_string(row_num));
-        entry.original_index = std::stoull(idx_str);
-        entry.sublibrary = header.get(entry.fields, csv::COL_SUBLIBRARY, "");
-        library_entries.push_back(entry);
+        library_entries.push_back({
+            rows.has(index_slot) ? std::stoull(std::string(rows[index_slot])) : row_num,
+            std::string(rows[sublibrary_slot]),
+            0.0,
+            csv::PackedRow(header, rows.fields().first(header.size()))
+        });
         row_num++;
     }
-    in.close();
 
     // Load library reads using shared utility
     std::vector<double> lib_reads = _load_reads(library_reads_file, library_entries.size());
@@ -103,13 +106,11 @@ void _merge(
     std::vector<double> bc_reads = _load_reads(barcode_reads_file, barcodes.size());
 
     std::vector<BarcodeEntry> barcode_entries;
+    barcode_entries.reserve(barcodes.size());
     for (size_t i = 0; i < barcodes.size(); i++) {
-        BarcodeEntry entry;
-        entry.original_index = i;
-        entry.reads = bc_reads[i];
-        entry.barcode = barcodes[i];
-        barcode_entries.push_back(entry);
+        barcode_entries.push_back({i, bc_reads[i], PackedSequence(barcodes[i])});
     }
+    std::vector<std::string>().swap(barcodes);
 
     // Sort library by reads ASCENDING (low reads first)
     // This enables pairing low-read designs with high-read barcodes
@@ -126,23 +127,22 @@ void _merge(
 
     // Merge: pair low-read designs with high-read barcodes to balance coverage
     std::vector<MergedEntry> merged;
+    merged.reserve(library_entries.size());
     for (size_t i = 0; i < library_entries.size(); i++) {
-        MergedEntry entry;
-        entry.original_index = library_entries[i].original_index;
-        entry.sublibrary = library_entries[i].sublibrary;
-        entry.fields = library_entries[i].fields;
-        entry.barcode = barcode_entries[i].barcode;
-        entry.design_reads = library_entries[i].reads;
-        entry.barcode_reads = barcode_entries[i].reads;
+        MergedEntry entry{
+            library_entries[i].original_index,
+            std::move(library_entries[i].sublibrary),
+            std::move(library_entries[i].row),
+            library_entries[i].reads,
+            barcode_entries[i].reads
+        };
 
         // Replace the barcode field
-        int bc_idx = header.index_of(csv::COL_BARCODE);
-        if (bc_idx >= 0 && static_cast<size_t>(bc_idx) < entry.fields.size()) {
-            entry.fields[bc_idx] = entry.barcode;
-        }
+        entry.row.set(csv::COL_BARCODE, barcode_entries[i].barcode.str());
 
-        merged.push_back(entry);
+        merged.push_back(std::move(entry));
     }
+    std::vector<LibraryEntry>().swap(library_entries);
 
     // If not sorting by reads, re-sort by (sublibrary, original_index) for output
     if (!sort_by_reads) {
@@ -155,16 +155,30 @@ void _merge(
             });
     }
 
+    if (table_output) {
+        std::vector<std::string> columns = header.column_names();
+        columns.push_back("design_reads");
+        columns.push_back("barcode_reads");
+        LibraryTableWriter table(output_fldb(output_prefix), columns);
+        for (const auto& entry : merged) {
+            table.add(entry.row, {entry.design_reads, entry.barcode_reads});
+        }
+        table.close();
+
+        std::cout << "Merged " << merged.size() << " library entries with barcodes.\n";
+        std::cout << "Output: " << output_fldb(output_prefix) << "\n";
+        return;
+    }
+
     // Write output CSV with extra columns
     std::string csv_out = output_prefix + ".csv";
     std::ofstream out_csv(csv_out);
-    out_csv << header_line << ",design_reads,barcode_reads\n";
+    out_csv << header.str() << ",design_reads,barcode_reads\n";
+    std::string record;
     for (const auto& entry : merged) {
-        for (size_t i = 0; i < entry.fields.size(); i++) {
-            out_csv << _quote_csv_field(entry.fields[i]);
-            if (i < entry.fields.size() - 1) out_csv << ",";
-        }
-        out_csv << "," << entry.design_reads
+        record.clear();
+        entry.row.append_csv(record);
+        out_csv << record << "," << entry.design_reads
                 << "," << entry.barcode_reads << "\n";
     }
     out_csv.close();
@@ -173,18 +187,15 @@ void _merge(
     std::string fasta_out = output_prefix + ".fasta";
     std::ofstream out_fasta(fasta_out);
 
+    std::string seq;
     for (const auto& entry : merged) {
         // Get sequence columns (required)
-        std::string seq = header.get(entry.fields, csv::COL_FIVE_CONST) +
-                          header.get(entry.fields, csv::COL_FIVE_PADDING) +
-                          header.get(entry.fields, csv::COL_DESIGN) +
-                          header.get(entry.fields, csv::COL_THREE_PADDING) +
-                          header.get(entry.fields, csv::COL_BARCODE) +
-                          header.get(entry.fields, csv::COL_THREE_CONST);
+        seq.clear();
+        entry.row.append_sequence(seq);
 
         // Get optional metadata for FASTA header
-        std::string name = header.get(entry.fields, csv::COL_NAME, "sequence");
-        std::string sublibrary = header.get(entry.fields, csv::COL_SUBLIBRARY, "");
+        std::string name = entry.row.get(csv::COL_NAME, "sequence");
+        std::string sublibrary = entry.row.get(csv::COL_SUBLIBRARY, "");
 
         if (sublibrary.empty()) {
             out_fasta << ">" << name << "\n" << seq << "\n";
@@ -12,6 +12,7 @@ public:
     Arg<std::string> output;
     Arg<bool> overwrite;
     Arg<bool> sort_by_reads;
+    Arg<bool> fldb;
     MergeArgs();
 };
 
@@ -22,7 +23,8 @@ void _merge(
     const std::string& barcode_reads_file,
     const std::string& output_prefix,
     bool overwrite,
-    bool sort_by_reads = false
+    bool sort_by_reads = false,
+    bool table_output = false
 );
 
 #endif
@@ -1,23 +1,28 @@
 #include "merge_padding.hpp"
+#include "io/compressed_file.hpp"
 #include "io/csv_format.hpp"
+#include "io/library_table.hpp"
+#include "io/writers.hpp"
 #include <fstream>
 #include <iostream>
 #include <algorithm>
 #include <unordered_map>
 
+// Rows and padding are held with their sequences packed, since the whole
+// library is in memory at once
 struct PaddingLibraryEntry {
     size_t original_index = 0;
     size_t row_index = 0;  // 0-based position in CSV
     std::string sublibrary;
     size_t design_length = 0;
     double reads = 0.0;
-    std::vector<std::string> fields;
+    csv::PackedRow row;
 };
 
 struct PaddingEntry {
     size_t row_index = 0;
     double reads = 0.0;
-    std::string padding;
+    PackedSequence padding;
 };
 
 void _merge_padding(
@@ -26,7 +31,8 @@ void _merge_padding(
     const std::string& padding_file,
     const std::string& padding_reads_file,
     const std::string& output_prefix,
-    bool overwrite
+    bool overwrite,
+    bool table_output
 ) {
     _throw_if_not_exists(library_csv);
     _throw_if_not_exists(library_reads_file);
@@ -34,33 +40,32 @@ void _merge_padding(
     _throw_if_not_exists(padding_reads_file);
     _remove_if_exists_all(output_prefix, overwrite);
 
-    // Load library CSV
-    std::ifstream in(library_csv);
-    std::string header_line;
-    std::getline(in, header_line);
-
-    csv::Header header(header_line);
+    // Load library CSV or table
+    LibraryRows rows(library_csv);
+    const csv::Header& header = rows.header();
     header.validate();
 
+    csv::Projection& projection = rows.projection();
+    projection.add_all();
+    size_t index_slot = projection.add(csv::COL_INDEX);
+    size_t sublibrary_slot = projection.add(csv::COL_SUBLIBRARY);
+    size_t design_slot = projection.add(csv::COL_DESIGN);
+
     std::vector<PaddingLibraryEntry> library_entries;
-    std::string line;
     size_t row_num = 1;
     size_t row_idx = 0;
-    while (std::getline(in, line)) {
-        if (line.empty()) continue;
-        PaddingLibraryEntry entry;
-        entry.fields = _split_by_delimiter(line, ',');
-        std::string idx_str = header.get(entry.fields, csv::COL_INDEX, std::to_string(row_num));
-        entry.original_index = std::stoull(idx_str);
-        entry.sublibrary = header.get(entry.fields, csv::COL_SUBLIBRARY, "");
-        std::string design = header.get(entry.fields, csv::COL_DESIGN);
-        entry.design_length = design.size();
-        entry.row_index = row_idx;
-        library_entries.push_back(entry);
+    while (rows.next()) {
+        library_entries.push_back({
+            rows.has(index_slot) ? std::stoull(std::string(rows[index_slot])) : row_num,
+            row_idx,
+            std::string(rows[sublibrary_slot]),
+            rows[design_slot].size(),
+            0.0,
+            csv::PackedRow(header, rows.fields().first(header.size()))
+        });
         row_num++;
         row_idx++;
     }
-    in.close();
 
     // Load reads
     std::vector<double> lib_reads = _load_reads(library_reads_file, library_entries.size());
@@ -68,16 +73,14 @@ void _merge_padding(
         library_entries[i].reads = lib_reads[i];
     }
 
-    // Load padding sequences and reads
-    std::vector<std::string> padding_seqs = _load_lines(padding_file);
-    // _load_lines skips empty lines, but we need empty lines for zero-length padding.
-    // Re-read manually to preserve empty lines.
+    // Load padding sequences and reads. _load_lines skips empty lines, but
+    // we need empty lines for zero-length padding, so read them here.
+    std::vector<PackedSequence> padding_seqs;
     {
-        padding_seqs.clear();
-        std::ifstream pf(padding_file);
+        InputFile pf(padding_file);
         std::string pline;
         while (std::getline(pf, pline)) {
-            padding_seqs.push_back(pline);
+            padding_seqs.emplace_back(pline);
         }
     }
 
@@ -90,13 +93,11 @@ void _merge_padding(
     std::vector<double> pad_reads = _load_reads(padding_reads_file, padding_seqs.size());
 
     std::vector<PaddingEntry> padding_entries;
+    padding_entries.reserve(padding_seqs.size());
     for (size_t i = 0; i < padding_seqs.size(); i++) {
-        PaddingEntry entry;
-        entry.row_index = i;
-        entry.reads = pad_reads[i];
-        entry.padding = padding_seqs[i];
-        padding_entries.push_back(entry);
+        padding_entries.push_back({i, pad_reads[i], std::move(padding_seqs[i])});
     }
+    std::vector<PackedSequence>().swap(padding_seqs);
 
     // Group by design length
     std::unordered_map<size_t, std::vector<size_t>> length_groups;
@@ -104,8 +105,7 @@ void _merge_padding(
         length_groups[library_entries[i].design_length].push_back(i);
     }
 
-    // Result: maps row_index -> assigned padding
-    std::vector<std::string> assigned_padding(library_entries.size());
+    // Result: maps row_index -> assigned reads
     std::vector<double> assigned_design_reads(library_entries.size());
     std::vector<double> assigned_padding_reads(library_entries.size());
 
@@ -130,20 +130,12 @@ void _merge_padding(
         for (size_t i = 0; i < lib_idx_sorted.size(); i++) {
             size_t lib_i = lib_idx_sorted[i];
             size_t pad_i = pad_idx_sorted[i];
-            assigned_padding[lib_i] = padding_entries[pad_i].padding;
+            library_entries[lib_i].row.set(csv::COL_FIVE_PADDING, padding_entries[pad_i].padding.str());
             assigned_design_reads[lib_i] = library_entries[lib_i].reads;
             assigned_padding_reads[lib_i] = padding_entries[pad_i].reads;
         }
     }
 
-    // Apply padding to library entries
-    int pad_col = header.index_of(csv::COL_FIVE_PADDING);
-    for (size_t i = 0; i < library_entries.size(); i++) {
-        if (pad_col >= 0 && static_cast<size_t>(pad_col) < library_entries[i].fields.size()) {
-            library_entries[i].fields[pad_col] = assigned_padding[i];
-        }
-    }
-
     // Sort by (sublibrary, original_index) to restore input order
     std::vector<size_t> output_order(library_entries.size());
     std::iota(output_order.begin(), output_order.end(), 0);
@@ -155,17 +147,30 @@ void _merge_padding(
             return library_entries[a].original_index < library_entries[b].original_index;
         });
 
+    if (table_output) {
+        std::vector<std::string> columns = header.column_names();
+        columns.push_back("design_reads");
+        columns.push_back("padding_reads");
+        LibraryTableWriter table(output_fldb(output_prefix), columns);
+        for (size_t idx : output_order) {
+            table.add(library_entries[idx].row, {assigned_design_reads[idx], assigned_padding_reads[idx]});
+        }
+        table.close();
+
+        std::cout << "Merged " << library_entries.size() << " library entries with padding.\n";
+        std::cout << "Output: " << output_fldb(output_prefix) << "\n";
+        return;
+    }
+
     // Write output CSV
     std::string csv_out = output_prefix + ".csv";
     std::ofstream out_csv(csv_out);
-    out_csv << header_line << ",design_reads,padding_reads\n";
+    out_csv << header.str() << ",design_reads,padding_reads\n";
+    std::string record;
     for (size_t idx : output_order) {
-        const auto& entry = library_entries[idx];
-        for (size_t i = 0; i < entry.fields.size(); i++) {
-            out_csv << _quote_csv_field(entry.fields[i]);
-            if (i < entry.fields.size() - 1) out_csv << ",";
-        }
-        out_csv << "," << assigned_design_reads[idx]
+        record.clear();
+        library_entries[idx].row.append_csv(record);
+        out_csv << record << "," << assigned_design_reads[idx]
                 << "," << assigned_padding_reads[idx] << "\n";
     }
     out_csv.close();
@@ -173,17 +178,14 @@ void _merge_padding(
     // Write FASTA
     std::string fasta_out = output_prefix + ".fasta";
     std::ofstream out_fasta(fasta_out);
+    std::string seq;
     for (size_t idx : output_order) {
         const auto& entry = library_entries[idx];
-        std::string seq = header.get(entry.fields, csv::COL_FIVE_CONST) +
-                          header.get(entry.fields, csv::COL_FIVE_PADDING) +
-                          header.get(entry.fields, csv::COL_DESIGN) +
-                          header.get(entry.fields, csv::COL_THREE_PADDING) +
-                          header.get(entry.fields, csv::COL_BARCODE) +
-                          header.get(entry.fields, csv::COL_THREE_CONST);
-
-        std::string name = header.get(entry.fields, csv::COL_NAME, "sequence");
-        std::string sublibrary = header.get(entry.fields, csv::COL_SUBLIBRARY, "");
+        seq.clear();
+        entry.row.append_sequence(seq);
+
+        std::string name = entry.row.get(csv::COL_NAME, "sequence");
+        std::string sublibrary = entry.row.get(csv::COL_SUBLIBRARY, "");
         if (sublibrary.empty()) {
             out_fasta << ">" << name << "\n" << seq << "\n";
         } else {
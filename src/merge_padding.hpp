@@ -13,7 +13,8 @@ void _merge_padding(
     const std::string& padding_file,
     const std::string& padding_reads_file,
     const std::string& output_prefix,
-    bool overwrite
+    bool overwrite,
+    bool table_output = false
 );
 
 #endif
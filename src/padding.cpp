@@ -1,40 +1,49 @@
 #include "padding.hpp"
 #include "domain/padding.hpp"
+#include "domain/random_streams.hpp"
+#include "io/padding_pool.hpp"
 #include "utils.hpp"
 #include "io/csv_format.hpp"
+#include "io/library_table.hpp"
 #include <fstream>
 #include <iostream>
+#include <map>
 
 void _generate_padding(
     const std::string& library_csv,
     size_t pad_to,
     const StemConfig& config,
     const std::string& output_file,
-    bool overwrite
+    bool overwrite,
+    uint64_t seed,
+    size_t threads,
+    size_t pool_size,
+    const std::string& pool_path
 ) {
     _throw_if_not_exists(library_csv);
     _remove_if_exists(output_file, overwrite);
 
-    // Read library CSV to get design lengths
-    std::ifstream in(library_csv);
-    std::string header_line;
-    std::getline(in, header_line);
-
-    csv::Header header(header_line);
-    header.validate();
+    // Read the library CSV or table to get design lengths
+    LibraryRows rows(library_csv);
+    rows.header().validate();
+    size_t design_slot = rows.projection().add(csv::COL_DESIGN);
 
     std::vector<size_t> design_lengths;
-    std::string line;
-    while (std::getline(in, line)) {
-        if (line.empty()) continue;
-        std::vector<std::string> fields = _split_by_delimiter(line, ',');
-        std::string design = header.get(fields, csv::COL_DESIGN);
-        design_lengths.push_back(design.size());
+    while (rows.next()) {
+        design_lengths.push_back(rows[design_slot].size());
+    }
+
+    std::optional<PaddingPool> pool = _open_padding_pool(config, pool_size, pool_path, seed);
+    if (pool) {
+        std::map<size_t, size_t> demand;
+        for (size_t design_len : design_lengths) {
+            if (design_len < pad_to) demand[pad_to - design_len]++;
+        }
+        pool->fill(demand, threads);
     }
-    in.close();
 
     // Generate padding sequences
-    std::mt19937 gen = _init_gen();
+    std::mt19937 gen = RandomStreams(seed).stream(RandomStreams::PADDING);
     std::ofstream out(output_file);
     if (!out.is_open()) {
         throw std::runtime_error("Failed to open output file: " + output_file);
@@ -45,11 +54,16 @@ void _generate_padding(
             out << "\n";
         } else {
             size_t padding_length = pad_to - design_len;
-            std::string padding = get_padding(padding_length, config, gen);
-            out << padding << "\n";
+            size_t slot = pool ? pool->take(padding_length) : PaddingPool::npos;
+            if (slot != PaddingPool::npos) {
+                out << pool->at(padding_length, slot) << "\n";
+            } else {
+                out << get_padding(padding_length, config, gen) << "\n";
+            }
         }
     }
     out.close();
+    _save_padding_pool(pool, pool_path);
 
     std::cout << "Generated " << design_lengths.size() << " padding sequences.\n";
 }
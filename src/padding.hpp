@@ -2,17 +2,24 @@
 #define PADDING_H
 
 #include "config/stem_config.hpp"
+#include <cstdint>
 #include <string>
 
 // Generate padding sequences to a text file (one per line, in CSV row order).
 // Reads the library CSV to determine design lengths, computes padding_length
-// = pad_to - design_length for each row, and generates padding sequences.
+// = pad_to - design_length for each row, and generates padding sequences
+// from the padding stream of the seed. With a padding pool, rows take
+// pooled paddings first, as design does.
 void _generate_padding(
     const std::string& library_csv,
     size_t pad_to,
     const StemConfig& config,
     const std::string& output_file,
-    bool overwrite
+    bool overwrite,
+    uint64_t seed = 0,
+    size_t threads = 1,
+    size_t pool_size = 0,
+    const std::string& pool_path = ""
 );
 
 #endif
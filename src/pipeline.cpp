@@ -12,6 +12,8 @@
 #include "config/design_config.hpp"
 #include "io/csv_format.hpp"
 #include "io/fasta_io.hpp"
+#include "io/library_table.hpp"
+#include "io/writers.hpp"
 #include <fstream>
 #include <iostream>
 #include <filesystem>
@@ -43,10 +45,21 @@ PipelineArgs::PipelineArgs() : Program(_PARSER_NAME),
     closing_gc(_parser, "--closing-gc", "Number of closing GC pairs", 1),
     spacer(_parser, "--spacer", "Spacer length between stems", 2),
     barcode_length(_parser, "--barcode-length", "Barcode stem length (0 to disable)", 10),
+    min_distance(_parser, "--min-distance", "Minimum Hamming distance between barcodes", 1),
+    min_edit_distance(_parser, "--min-edit-distance", "Minimum edit distance between barcodes (0 to disable)", 0),
+    maximal(_parser, "--maximal", "Draw barcodes from a dense greedy lexicode instead of at random", false),
+    barcode_pool(_parser, "--barcode-pool", "Draw barcodes from a pool file written by 'barcodes --pool'", std::string("")),
+    append_to(_parser, "--append-to", "Existing library .csv to extend, keeping its padding and barcodes", std::string("")),
+    screen_kmer(_parser, "--screen-kmer", "Reject padding and barcodes sharing a k-mer of this length with a design or constant region (0 to disable)", 0),
     no_barcodes(_parser, "--no-barcodes", "Skip barcode generation", false),
     m2(_parser, "--m2", "Generate M2-seq complement sequences", false),
     predict(_parser, "--predict", "Predict reads with rn-coverage, merge barcodes, and sort by final reads", false),
-    sort_by_reads(_parser, "--sort-by-reads", "Sort output by predicted read counts (default: preserve input order)", false)
+    sort_by_reads(_parser, "--sort-by-reads", "Sort output by predicted read counts (default: preserve input order)", false),
+    threads(_parser, "--threads", "Number of threads for padding, conversion and barcode generation", 1),
+    seed(_parser, "--seed", "Seed for every random choice (drawn afresh if not given, and written to library.seed)", std::string("")),
+    chunk_size(_parser, "--chunk-size", "Design this many rows at a time to bound memory, except for the --screen-kmer screen (0 to load the whole library)", 0),
+    padding_pool(_parser, "--padding-pool", "Pre-generate up to this many paddings per padding length, each used at most once (0 to generate every padding)", 0),
+    padding_pool_file(_parser, "--padding-pool-file", "Load the padding pool from this .fldpp file if it exists, and save it there; runs with the same seed share its paddings", std::string(""))
 {
     _parser.add_description(
         "Run the complete library design pipeline.\n\n"
@@ -100,16 +113,22 @@ static void _check_design_against_fasta(
         return;
     }
 
+    csv::Projection projection(header);
+    size_t design_slot = projection.add(csv::COL_DESIGN);
+    size_t begin_slot = projection.add(csv::COL_BEGIN);
+    size_t end_slot = projection.add(csv::COL_END);
+    csv::Row fields(projection);
+
     std::string line;
     size_t row = 0;
     while (std::getline(csv_file, line)) {
         if (line.empty()) continue;
 
-        std::vector<std::string> fields = _split_by_delimiter(line, ',');
+        fields.parse(line);
 
-        std::string design = header.get(fields, csv::COL_DESIGN);
-        std::string begin_str = header.get(fields, csv::COL_BEGIN);
-        std::string end_str = header.get(fields, csv::COL_END);
+        std::string_view design = fields[design_slot];
+        std::string begin_str(fields[begin_slot]);
+        std::string end_str(fields[end_slot]);
 
         if (begin_str.empty() || end_str.empty()) {
             throw std::runtime_error("CSV row " + std::to_string(row + 1) +
@@ -147,7 +166,7 @@ static void _check_design_against_fasta(
         if (extracted != design) {
             throw std::runtime_error(
                 "Row " + std::to_string(row + 1) + ": design mismatch.\n" +
-                "  CSV design:  " + design + "\n" +
+                "  CSV design:  " + std::string(design) + "\n" +
                 "  FASTA[" + std::to_string(begin) + ":" + std::to_string(end) + "]: " + extracted);
         }
 
@@ -185,26 +204,29 @@ static void _stack_csv_files(
     }
 }
 
-// Write a .txt file by concatenating specific CSV columns per row.
-static void _csv_columns_to_txt(
-    const std::string& csv_path,
+// Write a .txt file by concatenating specific library columns per row,
+// with a prefix and suffix around each.
+static void _columns_to_txt(
+    const std::string& library_path,
     const std::string& output_path,
-    const std::vector<std::string>& columns
+    const std::vector<std::string>& columns,
+    const std::string& prefix = "",
+    const std::string& suffix = ""
 ) {
-    std::ifstream in(csv_path);
-    std::string header_line;
-    std::getline(in, header_line);
-    csv::Header header(header_line);
+    LibraryRows rows(library_path);
+    std::vector<size_t> slots;
+    for (const auto& col : columns) {
+        slots.push_back(rows.projection().add(col));
+    }
 
     std::ofstream out(output_path);
-    std::string line;
-    while (std::getline(in, line)) {
-        if (line.empty()) continue;
-        std::vector<std::string> fields = _split_by_delimiter(line, ',');
-        std::string seq;
-        for (const auto& col : columns) {
-            seq += header.get(fields, col);
+    std::string seq;
+    while (rows.next()) {
+        seq = prefix;
+        for (size_t slot : slots) {
+            seq += rows[slot];
         }
+        seq += suffix;
         out << seq << "\n";
     }
 }
@@ -260,6 +282,16 @@ void _pipeline(const PipelineConfig& config) {
             throw std::runtime_error("Input file does not exist: " + input);
         }
     }
+    if (!config.append_to.empty()) {
+        _throw_if_not_exists(config.append_to);
+        if (config.predict) {
+            throw std::invalid_argument("--append-to cannot be combined with --predict.");
+        }
+    }
+    if (config.screen_kmer > 0 && config.predict) {
+        // Padding and barcodes are then generated apart from the designs
+        throw std::invalid_argument("--screen-kmer cannot be combined with --predict.");
+    }
 
     std::vector<std::string> fasta_files = config.inputs;
     std::sort(fasta_files.begin(), fasta_files.end());
@@ -287,13 +319,20 @@ void _pipeline(const PipelineConfig& config) {
         std::string csv_output = tmp_dir + "/" + basename + ".csv";
 
         std::cout << "  " << basename << "...\n";
-        _preprocess(fasta, csv_output, true, basename);
+        _preprocess(fasta, csv_output, true, basename, config.threads);
         csv_files.push_back(csv_output);
     }
 
     // Step 3: Stack CSV files
     std::cout << "\n----- Stacking CSV files -----\n\n";
     std::string stacked_csv = tmp_dir + "/preprocessed.csv";
+    if (!config.append_to.empty()) {
+        // Rewrite the existing library with the standard columns, and put it
+        // first so that its rows keep their barcodes
+        std::string existing_csv = tmp_dir + "/existing.csv";
+        _from_csv(config.append_to).to_csv(existing_csv);
+        csv_files.insert(csv_files.begin(), existing_csv);
+    }
     _stack_csv_files(csv_files, stacked_csv);
 
     // Count sequences
@@ -330,13 +369,29 @@ void _pipeline(const PipelineConfig& config) {
         design_config.barcode.stem_length = config.no_barcodes ? 0 : config.barcode_length;
     }
     design_config.barcode.stem = config.stem;
+    design_config.barcode.min_distance = config.min_distance;
+    design_config.barcode.min_edit_distance = config.min_edit_distance;
+    design_config.barcode.maximal = config.maximal;
+    design_config.barcode.pool_path = config.barcode_pool;
+    design_config.threads = config.threads;
+    design_config.append = !config.append_to.empty();
+    design_config.screen_kmer = config.screen_kmer;
+    design_config.seed = config.seed;
+    design_config.chunk_size = config.chunk_size;
+    design_config.padding_pool_size = config.padding_pool_size;
+    design_config.padding_pool_path = config.padding_pool_path;
+
+    // With --predict: 5-step read-count balancing for padding and barcodes.
+    // The stages pass the library between them as .fldb tables, and only
+    // the final sort writes CSV.
+    bool balance = config.predict && !config.no_barcodes && config.barcode_length > 0;
+    design_config.table_output = balance;
 
     _design(design_config);
 
     std::string final_library = tmp_dir + "/library";
 
-    // With --predict: 5-step read-count balancing for padding and barcodes
-    if (config.predict && !config.no_barcodes && config.barcode_length > 0) {
+    if (balance) {
 
         // Check prerequisites
         if (!_command_exists("rn-coverage")) {
@@ -351,15 +406,18 @@ void _pipeline(const PipelineConfig& config) {
         // Generate padding and barcodes separately
         std::cout << "\n----- Generating padding for read-count balancing -----\n\n";
         std::string padding_file = tmp_dir + "/padding.txt";
-        _generate_padding(final_library + ".csv", config.pad_to, config.stem, padding_file, true);
+        _generate_padding(final_library + ".fldb", config.pad_to, config.stem, padding_file, true, config.seed,
+            config.threads, config.padding_pool_size, config.padding_pool_path);
 
         std::cout << "\n----- Generating barcodes for read-count balancing -----\n\n";
         std::string barcodes_file = tmp_dir + "/barcodes.txt";
-        _barcodes(seq_count, barcodes_file, true, config.barcode_length, config.stem);
+        BarcodeConfig barcode_config = design_config.barcode;
+        barcode_config.stem_length = config.barcode_length;
+        _barcodes(seq_count, barcodes_file, "", true, barcode_config, config.threads, config.seed);
 
         // Extract design-only sequences for prediction
         std::string designs_txt = tmp_dir + "/designs.txt";
-        _csv_columns_to_txt(final_library + ".csv", designs_txt, {csv::COL_DESIGN});
+        _columns_to_txt(final_library + ".fldb", designs_txt, {csv::COL_DESIGN});
 
         // ===== PREDICT 1: padding sequences alone =====
         std::cout << "\n----- [1/5] Predicting padding read counts -----\n\n";
@@ -388,13 +446,13 @@ void _pipeline(const PipelineConfig& config) {
         // ===== MERGE ROUND 1: attach padding =====
         std::cout << "\n----- Merging padding with read-count balancing -----\n\n";
         std::string padded_prefix = tmp_dir + "/padded";
-        _merge_padding(final_library + ".csv", design_reads, padding_file, padding_reads,
-            padded_prefix, true);
+        _merge_padding(final_library + ".fldb", design_reads, padding_file, padding_reads,
+            padded_prefix, true, true);
 
         // ===== PREDICT 4: padding + design (no constants, no barcodes) =====
         std::cout << "\n----- [4/5] Predicting padded design read counts -----\n\n";
         std::string padded_txt = tmp_dir + "/padded.txt";
-        _csv_columns_to_txt(padded_prefix + ".csv", padded_txt,
+        _columns_to_txt(padded_prefix + ".fldb", padded_txt,
             {csv::COL_FIVE_PADDING, csv::COL_DESIGN});
 
         std::string padded_reads = tmp_dir + "/padded_reads.txt";
@@ -406,34 +464,17 @@ void _pipeline(const PipelineConfig& config) {
         // ===== MERGE ROUND 2: attach barcodes =====
         std::cout << "\n----- Merging barcodes with read-count balancing -----\n\n";
         std::string merged_prefix = tmp_dir + "/merged";
-        _merge(padded_prefix + ".csv", padded_reads, barcodes_file, barcode_reads,
-            merged_prefix, true, config.sort_by_reads);
+        _merge(padded_prefix + ".fldb", padded_reads, barcodes_file, barcode_reads,
+            merged_prefix, true, config.sort_by_reads, true);
 
         // ===== PREDICT 5: final full library (with constants) =====
-        // Constants were left empty in the CSV so intermediate predictions
+        // Constants were left empty in the library so intermediate predictions
         // excluded them. Write the final .txt with constants prepended/appended.
         std::cout << "\n----- [5/5] Predicting final read counts -----\n\n";
         std::string final_txt = tmp_dir + "/final.txt";
-        {
-            std::ifstream fin(merged_prefix + ".csv");
-            std::string hdr_line;
-            std::getline(fin, hdr_line);
-            csv::Header hdr(hdr_line);
-
-            std::ofstream fout(final_txt);
-            std::string fline;
-            while (std::getline(fin, fline)) {
-                if (fline.empty()) continue;
-                std::vector<std::string> fields = _split_by_delimiter(fline, ',');
-                std::string seq = config.five_const +
-                                  hdr.get(fields, csv::COL_FIVE_PADDING) +
-                                  hdr.get(fields, csv::COL_DESIGN) +
-                                  hdr.get(fields, csv::COL_THREE_PADDING) +
-                                  hdr.get(fields, csv::COL_BARCODE) +
-                                  config.three_const;
-                fout << seq << "\n";
-            }
-        }
+        _columns_to_txt(merged_prefix + ".fldb", final_txt,
+            {csv::COL_FIVE_PADDING, csv::COL_DESIGN, csv::COL_THREE_PADDING, csv::COL_BARCODE},
+            config.five_const, config.three_const);
 
         std::string final_reads = tmp_dir + "/final_reads.txt";
         _predict_reads(final_txt,
@@ -441,45 +482,38 @@ void _pipeline(const PipelineConfig& config) {
             predict_dir + "/final",
             final_reads, "final library");
 
-        // Fill in constant regions in the merged CSV before final output
+        // Fill in constant regions in the merged library before final output
         {
-            std::ifstream fin(merged_prefix + ".csv");
-            std::string hdr_line;
-            std::getline(fin, hdr_line);
-            csv::Header hdr(hdr_line);
-
+            LibraryRows rows(merged_prefix + ".fldb");
+            rows.projection().add_all();
+            const csv::Header& hdr = rows.header();
             int five_idx = hdr.index_of(csv::COL_FIVE_CONST);
             int three_idx = hdr.index_of(csv::COL_THREE_CONST);
 
-            std::string primerized_csv = merged_prefix + "_primerized.csv";
-            std::ofstream fout(primerized_csv);
-            fout << hdr_line << "\n";
-            std::string fline;
-            while (std::getline(fin, fline)) {
-                if (fline.empty()) continue;
-                std::vector<std::string> fields = _split_by_delimiter(fline, ',');
-                if (five_idx >= 0 && static_cast<size_t>(five_idx) < fields.size()) {
+            std::string primerized = merged_prefix + "_primerized.fldb";
+            LibraryTableWriter writer(primerized, hdr.column_names());
+            std::vector<std::string_view> fields;
+            while (rows.next()) {
+                auto row = rows.fields();
+                fields.assign(row.begin(), row.begin() + hdr.size());
+                if (five_idx >= 0) {
                     fields[five_idx] = config.five_const;
                 }
-                if (three_idx >= 0 && static_cast<size_t>(three_idx) < fields.size()) {
+                if (three_idx >= 0) {
                     fields[three_idx] = config.three_const;
                 }
-                for (size_t i = 0; i < fields.size(); i++) {
-                    fout << _quote_csv_field(fields[i]);
-                    if (i < fields.size() - 1) fout << ",";
-                }
-                fout << "\n";
+                writer.add(fields);
             }
-            fout.close();
+            writer.close();
 
-            // Replace merged CSV with primerized version
-            std::filesystem::rename(primerized_csv, merged_prefix + ".csv");
+            // Replace merged library with primerized version
+            std::filesystem::rename(primerized, merged_prefix + ".fldb");
         }
 
         // Sort by final read counts
         std::cout << "\n----- Sorting by final read counts -----\n\n";
         std::string final_output = config.output_dir + "/library";
-        _sort(merged_prefix + ".csv", final_reads, final_output, true, false, config.sort_by_reads);
+        _sort(merged_prefix + ".fldb", final_reads, final_output, true, false, config.sort_by_reads);
 
     } else {
         // No prediction - copy designed library (with barcodes if enabled) to output
@@ -491,6 +525,8 @@ void _pipeline(const PipelineConfig& config) {
             std::filesystem::copy_options::overwrite_existing);
     }
 
+    _write_seed(output_seed(config.output_dir + "/library"), config.seed);
+
     // Generate RNA version with T7 promoter prefix
     std::string library_csv = config.output_dir + "/library.csv";
     std::string library_fasta = config.output_dir + "/library.fasta";
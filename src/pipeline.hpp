@@ -24,6 +24,12 @@ public:
     Arg<int> spacer;
     // Barcode options
     Arg<int> barcode_length;
+    Arg<int> min_distance;
+    Arg<int> min_edit_distance;
+    Arg<bool> maximal;
+    Arg<std::string> barcode_pool;
+    Arg<std::string> append_to;
+    Arg<int> screen_kmer;
     // Pipeline options
     Arg<bool> no_barcodes;
     Arg<bool> m2;
@@ -31,6 +37,14 @@ public:
     Arg<bool> predict;
     // Output ordering
     Arg<bool> sort_by_reads;
+    // Parallelism
+    Arg<int> threads;
+    // Reproducibility
+    Arg<std::string> seed;
+    // Memory
+    Arg<int> chunk_size;
+    Arg<int> padding_pool;
+    Arg<std::string> padding_pool_file;
     PipelineArgs();
 };
 
@@ -43,12 +57,30 @@ struct PipelineConfig {
     std::string three_const;
     StemConfig stem;
     int barcode_length;
+    size_t min_distance = 1;
+    size_t min_edit_distance = 0;
+    bool maximal = false;
+    std::string barcode_pool;
+    // Existing library to extend, if not empty
+    std::string append_to;
+    // k-mer length to screen padding and barcodes with, or 0
+    size_t screen_kmer = 0;
     bool no_barcodes;
     bool generate_m2;
     // Prediction options
     bool predict;
     // Output ordering
     bool sort_by_reads;
+    // Parallelism
+    size_t threads = 1;
+    // Master seed of every random stage
+    uint64_t seed = 0;
+    // Rows to design at a time, or 0 to load the whole library
+    size_t chunk_size = 0;
+    // Paddings to pre-generate per padding length, or 0, and a file to
+    // keep the pool in
+    size_t padding_pool_size = 0;
+    std::string padding_pool_path;
 };
 
 void _pipeline(const PipelineConfig& config);
@@ -20,7 +20,7 @@ void _prepend(
     bool overwrite
 ) {
     size_t count = transform_fasta(input_fasta, output_fasta, overwrite,
-        [&prefix](const FastaEntry& entry) { return prefix + entry.sequence; });
+        [&prefix](const FastaRecord& entry) { return std::string(prefix).append(entry.sequence); });
 
     std::cout << "Prepended '" << prefix << "' to " << count << " sequences.\n";
     std::cout << "Output: " << output_fasta << "\n";
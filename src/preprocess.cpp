@@ -1,6 +1,9 @@
 #include "preprocess.hpp"
+#include "domain/nucleotide_kernels.hpp"
+#include "io/compressed_file.hpp"
 #include "io/csv_format.hpp"
 #include "io/fasta_io.hpp"
+#include <iostream>
 
 static inline std::string _PARSER_NAME = "preprocess";
 // File
@@ -16,13 +19,18 @@ static inline std::string _OVERWRITE_HELP = "Overwrite any existing file.";
 static inline std::string _SUBLIB_NAME = "--sublibrary";
 static inline std::string _SUBLIB_HELP = "The sublibrary this .fasta belongs to.";
 static inline std::string _SUBLIB_DEFAULT = "";
+// Threads
+static inline std::string _THREADS_NAME = "--threads";
+static inline std::string _THREADS_HELP = "The number of threads to read the .fasta with.";
+static inline int _THREADS_DEFAULT = 1;
 
 PreprocessArgs::PreprocessArgs() :
     Program(_PARSER_NAME),
     file(_parser, _FILE_NAME, _FILE_HELP),
     output(_parser, _OUTPUT_NAME, _OUTPUT_HELP),
     overwrite(_parser, _OVERWRITE_NAME, _OVERWRITE_HELP),
-    sublibrary(_parser, _SUBLIB_NAME, _SUBLIB_HELP, _SUBLIB_DEFAULT) {
+    sublibrary(_parser, _SUBLIB_NAME, _SUBLIB_HELP, _SUBLIB_DEFAULT),
+    threads(_parser, _THREADS_NAME, _THREADS_HELP, _THREADS_DEFAULT) {
 
 }
 
@@ -30,21 +38,51 @@ void _preprocess(
     const std::string& fasta,
     const std::string& csv,
     bool overwrite,
-    const std::string& sublibrary
+    const std::string& sublibrary,
+    size_t threads
 ) {
     _throw_if_not_exists(fasta);
     _remove_if_exists(csv, overwrite);
 
-    std::ofstream csv_file(csv);
+    OutputFile csv_file(csv, threads);
     csv_file << csv::header() << "\n";
 
+    // Each chunk is written to its own buffer, and the buffers are written
+    // out in file order
+    std::vector<std::string> rows(std::max<size_t>(threads, 1));
+    std::vector<size_t> chunk_polybases(rows.size());
+    std::vector<size_t> chunk_counts(rows.size());
     size_t index = 0;
-    for_each_fasta(fasta, [&](const FastaEntry& entry) {
-        index++;  // 1-based indexing
-        csv_file << index;
-        csv_file << "," << _escape_with_quotes(entry.name);
-        csv_file << "," << sublibrary << ",,,";
-        csv_file << entry.sequence;
-        csv_file << ",,,\n";
+    size_t polybases = 0;
+    for_each_fasta_chunk(fasta, threads, [&](size_t slot, const FastaChunk& chunk) {
+        std::string& out = rows[slot];
+        out.clear();
+        chunk_polybases[slot] = 0;
+        size_t chunk_index = chunk.first;
+        FastaReader reader(chunk.text, chunk.ends_file);
+        FastaRecord entry;
+        while (reader.next(entry)) {
+            chunk_index++;  // 1-based indexing
+            chunk_polybases[slot] += find_polybase(entry.sequence) != std::string_view::npos;
+            out += std::to_string(chunk_index);
+            out += ',';
+            out += _escape_with_quotes(std::string(entry.name));
+            out += ',';
+            out += sublibrary;
+            out += ",,,";
+            out += entry.sequence;
+            out += ",,,\n";
+        }
+        chunk_counts[slot] = chunk_index - chunk.first;
+    }, [&](size_t slot) {
+        csv_file << rows[slot];
+        index += chunk_counts[slot];
+        polybases += chunk_polybases[slot];
     });
+    csv_file.close();
+
+    if (polybases > 0) {
+        std::cout << "  " << polybases << " of " << index << " sequences in " << fasta
+                  << " contain bases other than A, C, G, T and U, which design replaces at random.\n";
+    }
 }
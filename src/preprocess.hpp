@@ -11,6 +11,7 @@ public:
     Arg<std::string> output;
     Arg<bool> overwrite;
     Arg<std::string> sublibrary;
+    Arg<int> threads;
     PreprocessArgs();
 };
 
@@ -18,7 +19,8 @@ void _preprocess(
     const std::string& fasta,
     const std::string& csv,
     bool overwrite,
-    const std::string& sublibrary
+    const std::string& sublibrary,
+    size_t threads = 1
 );
 
 #endif
@@ -1,4 +1,5 @@
 #include "random.hpp"
+#include "domain/random_streams.hpp"
 #include "domain/sequence.hpp"
 
 
@@ -7,12 +8,13 @@ void _random(
     bool overwrite,
     int count,
     int length,
-    bool fasta
+    bool fasta,
+    uint64_t seed
 ) {
 
     _remove_if_exists(output, overwrite);
 
-    std::mt19937 gen = _init_gen();
+    std::mt19937 gen = RandomStreams(seed).stream(RandomStreams::SEQUENCES);
     std::ofstream file(output);
     if (!file.is_open()) {
         throw std::runtime_error("Failed to open output file: " + output);
@@ -60,6 +62,10 @@ static inline std::string _OVERWRITE_HELP = "Overwrite any existing file.";
 static inline std::string _FASTA_NAME = "--fasta";
 static inline std::string _FASTA_HELP = "Output in FASTA format.";
 
+static inline std::string _SEED_NAME = "--seed";
+static inline std::string _SEED_DEFAULT = "";
+static inline std::string _SEED_HELP = "The seed to draw sequences with, for reproducible output. A fresh seed is drawn and printed if not given.";
+
 
 RandomArgs::RandomArgs() :
     Program(_PARSER_NAME),
@@ -67,5 +73,6 @@ RandomArgs::RandomArgs() :
     overwrite(_parser, _OVERWRITE_NAME, _OVERWRITE_HELP),
     count(_parser, _COUNT_NAME, _COUNT_HELP),
     length(_parser, _BARCODE_LENGTH_NAME, _BARCODE_LENGTH_HELP),
-    fasta(_parser, _FASTA_NAME, _FASTA_HELP) {
+    fasta(_parser, _FASTA_NAME, _FASTA_HELP),
+    seed(_parser, _SEED_NAME, _SEED_HELP, _SEED_DEFAULT) {
 }
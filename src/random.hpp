@@ -14,6 +14,7 @@ public:
     Arg<int> count;
     Arg<int> length;
     Arg<bool> fasta;
+    Arg<std::string> seed;
 
     RandomArgs();
 
@@ -24,7 +25,8 @@ void _random(
     bool overwrite,
     int count,
     int length,
-    bool fasta
+    bool fasta,
+    uint64_t seed = 0
 );
 
 
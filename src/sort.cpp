@@ -1,6 +1,7 @@
 #include "sort.hpp"
 #include "library.hpp"
 #include "io/csv_format.hpp"
+#include "io/library_table.hpp"
 #include <fstream>
 #include <iostream>
 #include <algorithm>
@@ -8,12 +9,13 @@
 static inline std::string _PARSER_NAME = "sort";
 
 SortArgs::SortArgs() : Program(_PARSER_NAME),
-    file(_parser, "file", "Input CSV library file"),
+    file(_parser, "file", "Input CSV or .fldb library file"),
     reads(_parser, "--reads", "Text file with read counts (one per line, same order as CSV)"),
     output(_parser, "-o", "Output prefix"),
     overwrite(_parser, "--overwrite", "Overwrite existing files", false),
     descending(_parser, "--descending", "Sort in descending order (highest reads first)", false),
-    sort_by_reads(_parser, "--sort-by-reads", "Sort output by read counts (default: preserve input order)", false)
+    sort_by_reads(_parser, "--sort-by-reads", "Sort output by read counts (default: preserve input order)", false),
+    fldb(_parser, "--fldb", "Write the output as a binary table, <output>.fldb, instead of .csv and .fasta", false)
 {
     _parser.add_description(
         "Sort a library CSV by predicted read counts.\n\n"
@@ -23,11 +25,13 @@ SortArgs::SortArgs() : Program(_PARSER_NAME),
     );
 }
 
+// Rows are held with their sequences packed, since the whole library is in
+// memory at once
 struct IndexedConstruct {
     size_t original_index;  // 1-based index from CSV
     std::string sublibrary;
     double reads;
-    std::string line;
+    csv::PackedRow row;
 };
 
 void _sort(
@@ -36,41 +40,35 @@ void _sort(
     const std::string& output_prefix,
     bool overwrite,
     bool descending,
-    bool sort_by_reads
+    bool sort_by_reads,
+    bool table_output
 ) {
     _throw_if_not_exists(csv_file);
     _throw_if_not_exists(reads_file);
     _remove_if_exists_all(output_prefix, overwrite);
 
-    // Read all lines from CSV
-    std::ifstream in(csv_file);
-    std::string header_line;
-    std::getline(in, header_line);
-
-    csv::Header header(header_line);
+    // Read all rows from CSV or a table
+    LibraryRows rows(csv_file);
+    const csv::Header& header = rows.header();
     header.validate();
 
-    std::vector<std::string> lines;
-    std::string line;
-    while (std::getline(in, line)) {
-        if (!line.empty()) {
-            lines.push_back(line);
-        }
+    // Create indexed rows - extract original_index and sublibrary from CSV
+    csv::Projection& projection = rows.projection();
+    projection.add_all();
+    size_t index_slot = projection.add(csv::COL_INDEX);
+    size_t sublibrary_slot = projection.add(csv::COL_SUBLIBRARY);
+
+    std::vector<IndexedConstruct> indexed;
+    while (rows.next()) {
+        size_t orig_idx = rows.has(index_slot) ? std::stoull(std::string(rows[index_slot])) : indexed.size() + 1;
+        std::string sublib(rows[sublibrary_slot]);
+        indexed.push_back({orig_idx, std::move(sublib), 0.0, csv::PackedRow(header, rows.fields().first(header.size()))});
     }
-    in.close();
 
     // Load reads using shared utility
-    std::vector<double> reads = _load_reads(reads_file, lines.size());
-
-    // Create indexed pairs - extract original_index and sublibrary from CSV
-    std::vector<IndexedConstruct> indexed;
-    indexed.reserve(lines.size());
-    for (size_t i = 0; i < lines.size(); i++) {
-        auto fields = _split_by_delimiter(lines[i], ',');
-        std::string idx_str = header.get(fields, csv::COL_INDEX, std::to_string(i + 1));
-        size_t orig_idx = std::stoull(idx_str);
-        std::string sublib = header.get(fields, csv::COL_SUBLIBRARY, "");
-        indexed.push_back({orig_idx, sublib, reads[i], lines[i]});
+    std::vector<double> reads = _load_reads(reads_file, indexed.size());
+    for (size_t i = 0; i < indexed.size(); i++) {
+        indexed[i].reads = reads[i];
     }
 
     // Sort by reads (internal operation always happens)
@@ -97,12 +95,29 @@ void _sort(
             });
     }
 
+    if (table_output) {
+        std::vector<std::string> columns = header.column_names();
+        columns.push_back(csv::COL_READS);
+        LibraryTableWriter table(output_fldb(output_prefix), columns);
+        for (const auto& item : indexed) {
+            table.add(item.row, {item.reads});
+        }
+        table.close();
+
+        std::cout << "Sorted " << indexed.size() << " sequences by read count.\n";
+        std::cout << "Output: " << output_fldb(output_prefix) << "\n";
+        return;
+    }
+
     // Write sorted CSV
     std::string csv_out = output_prefix + ".csv";
     std::ofstream out_csv(csv_out);
-    out_csv << header_line << ",reads\n";
+    out_csv << header.str() << ",reads\n";
+    std::string record;
     for (const auto& item : indexed) {
-        out_csv << item.line << "," << item.reads << "\n";
+        record.clear();
+        item.row.append_csv(record);
+        out_csv << record << "," << item.reads << "\n";
     }
     out_csv.close();
 
@@ -110,20 +125,15 @@ void _sort(
     std::string fasta_out = output_prefix + ".fasta";
     std::ofstream out_fasta(fasta_out);
 
+    std::string seq;
     for (const auto& item : indexed) {
-        auto fields = _split_by_delimiter(item.line, ',');
-
         // Get sequence columns (required)
-        std::string seq = header.get(fields, csv::COL_FIVE_CONST) +
-                          header.get(fields, csv::COL_FIVE_PADDING) +
-                          header.get(fields, csv::COL_DESIGN) +
-                          header.get(fields, csv::COL_THREE_PADDING) +
-                          header.get(fields, csv::COL_BARCODE) +
-                          header.get(fields, csv::COL_THREE_CONST);
+        seq.clear();
+        item.row.append_sequence(seq);
 
         // Get optional metadata for FASTA header
-        std::string name = header.get(fields, csv::COL_NAME, "sequence");
-        std::string sublibrary = header.get(fields, csv::COL_SUBLIBRARY, "");
+        std::string name = item.row.get(csv::COL_NAME, "sequence");
+        std::string sublibrary = item.row.get(csv::COL_SUBLIBRARY, "");
 
         if (sublibrary.empty()) {
             out_fasta << ">" << name << "\n" << seq << "\n";
@@ -134,6 +144,6 @@ void _sort(
 
     out_fasta.close();
 
-    std::cout << "Sorted " << lines.size() << " sequences by read count.\n";
+    std::cout << "Sorted " << indexed.size() << " sequences by read count.\n";
     std::cout << "Output: " << csv_out << ", " << fasta_out << "\n";
 }
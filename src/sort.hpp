@@ -11,6 +11,7 @@ public:
     Arg<bool> overwrite;
     Arg<bool> descending;
     Arg<bool> sort_by_reads;
+    Arg<bool> fldb;
     SortArgs();
 };
 
@@ -20,7 +21,8 @@ void _sort(
     const std::string& output_prefix,
     bool overwrite,
     bool descending,
-    bool sort_by_reads = false
+    bool sort_by_reads = false,
+    bool table_output = false
 );
 
 #endif
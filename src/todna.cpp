@@ -18,8 +18,8 @@ void _to_dna(
     const std::string& output_fasta,
     bool overwrite
 ) {
-    size_t count = transform_fasta(input_fasta, output_fasta, overwrite,
-        [](const FastaEntry& entry) { return to_dna(entry.sequence); });
+    size_t count = edit_fasta(input_fasta, output_fasta, overwrite,
+        [](std::span<char> sequence) { to_dna_in_place(sequence); });
 
     std::cout << "Converted " << count << " sequences to DNA.\n";
     std::cout << "Output: " << output_fasta << "\n";
@@ -1,11 +1,24 @@
 #include "utils.hpp"
+#include "io/compressed_file.hpp"
+#include "io/csv_format.hpp"
 #include "io/writers.hpp"
+#include <charconv>
+#include <exception>
+#include <mutex>
+#include <thread>
 
 std::mt19937 _init_gen() {
     unsigned seed = std::chrono::system_clock::now().time_since_epoch().count();
     return std::mt19937(seed);
 }
 
+uint64_t _fresh_seed() {
+    std::random_device device;
+    uint64_t entropy = (static_cast<uint64_t>(device()) << 32) | device();
+    uint64_t time = std::chrono::system_clock::now().time_since_epoch().count();
+    return entropy ^ time;
+}
+
 void _throw_if_not_exists(const std::string& filename) {
     if (!std::filesystem::is_regular_file(filename)) {
         throw std::runtime_error("The file \"" + filename + "\" does not exist.");
@@ -41,23 +54,13 @@ void _remove_if_exists_all(
 ) {
     _remove_if_exists(output_csv(prefix), overwrite);
     _remove_if_exists(output_fasta(prefix), overwrite);
+    _remove_if_exists(output_seed(prefix), overwrite);
+    _remove_if_exists(output_fldb(prefix), overwrite);
 }
 
 std::vector<std::string> _split_by_delimiter(const std::string& s, char delimiter) {
     std::vector<std::string> tokens;
-    std::string token = "";
-    bool insideQuotes = false;
-    for (const auto& c : s) {
-        if (c == delimiter && !insideQuotes) {
-            tokens.push_back(token);
-            token = "";
-        } else if (c == '"') {
-            insideQuotes = !insideQuotes;
-        } else {
-            token += c;
-        }
-    }
-    tokens.push_back(token);
+    csv::split(s, delimiter, tokens);
     return tokens;
 }
 
@@ -109,9 +112,91 @@ double _percent(size_t val, size_t total) {
     return _frac(val, total) * 100;
 }
 
+size_t _min_distance(int distance) {
+    if (distance < 1) {
+        throw std::invalid_argument("The minimum barcode distance must be at least 1.");
+    }
+    return static_cast<size_t>(distance);
+}
+
+size_t _min_edit_distance(int distance) {
+    if (distance < 0) {
+        throw std::invalid_argument("The minimum barcode edit distance cannot be negative.");
+    }
+    return static_cast<size_t>(distance);
+}
+
+size_t _screen_kmer(int k) {
+    if (k < 0 || k > 32) {
+        throw std::invalid_argument("The screened k-mer length must be between 0 and 32.");
+    }
+    return static_cast<size_t>(k);
+}
+
+size_t _thread_count(int threads) {
+    if (threads < 1) {
+        throw std::invalid_argument("The number of threads must be at least 1.");
+    }
+    return static_cast<size_t>(threads);
+}
+
+size_t _chunk_size(int rows) {
+    if (rows < 0) {
+        throw std::invalid_argument("The chunk size cannot be negative.");
+    }
+    return static_cast<size_t>(rows);
+}
+
+size_t _padding_pool_size(int paddings) {
+    if (paddings < 0) {
+        throw std::invalid_argument("The padding pool size cannot be negative.");
+    }
+    return static_cast<size_t>(paddings);
+}
+
+uint64_t _seed(const std::string& seed) {
+    if (seed.empty()) {
+        return _fresh_seed();
+    }
+    uint64_t value = 0;
+    auto [end, error] = std::from_chars(seed.data(), seed.data() + seed.size(), value);
+    if (error != std::errc() || end != seed.data() + seed.size()) {
+        throw std::invalid_argument("The seed must be a non-negative integer below 2^64, not " + seed + ".");
+    }
+    return value;
+}
+
+void _run_workers(size_t threads, const std::function<void(size_t)>& work) {
+    if (threads <= 1) {
+        work(0);
+        return;
+    }
+
+    std::exception_ptr error;
+    std::mutex error_mutex;
+    std::vector<std::thread> workers;
+    workers.reserve(threads);
+    for (size_t worker = 0; worker < threads; worker++) {
+        workers.emplace_back([&, worker]() {
+            try {
+                work(worker);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(error_mutex);
+                if (!error) error = std::current_exception();
+            }
+        });
+    }
+    for (auto& thread : workers) {
+        thread.join();
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
 std::vector<double> _load_reads(const std::string& filename, size_t expected_count) {
     std::vector<double> reads;
-    std::ifstream in(filename);
+    InputFile in(filename);
     if (!in) {
         throw std::runtime_error("Cannot open reads file: " + filename);
     }
@@ -141,7 +226,7 @@ std::vector<double> _load_reads(const std::string& filename, size_t expected_cou
 
 std::vector<std::string> _load_lines(const std::string& filename) {
     std::vector<std::string> lines;
-    std::ifstream in(filename);
+    InputFile in(filename);
     if (!in) {
         throw std::runtime_error("Cannot open file: " + filename);
     }
@@ -7,9 +7,13 @@
 #include <random>
 #include <argparse/argparse.hpp>
 #include <variant>
+#include <functional>
 
 std::mt19937 _init_gen();
 
+// A fresh seed for runs given none, from the system entropy source and clock.
+uint64_t _fresh_seed();
+
 void _throw_if_not_exists(const std::string& filename);
 void _throw_if_exists(const std::string& filename);
 void _remove_if_exists(const std::string& filename);
@@ -35,6 +39,35 @@ std::string _quote_csv_field(const std::string& field);
 
 double _percent(size_t val, size_t total);
 
+// Convert a --min-distance argument to a distance, throwing if it is not positive.
+size_t _min_distance(int distance);
+
+// Convert a --min-edit-distance argument to a distance, throwing if it is negative.
+size_t _min_edit_distance(int distance);
+
+// Convert a --screen-kmer argument to a k-mer length, throwing if it is
+// negative or too long to pack. 0 disables the screen.
+size_t _screen_kmer(int k);
+
+// Convert a --threads argument to a thread count, throwing if it is not positive.
+size_t _thread_count(int threads);
+
+// Convert a --chunk-size argument to a number of rows, throwing if it is
+// negative. 0 loads the whole library.
+size_t _chunk_size(int rows);
+
+// Convert a --padding-pool argument to a number of paddings per length,
+// throwing if it is negative. 0 disables the pool.
+size_t _padding_pool_size(int paddings);
+
+// Convert a --seed argument to a seed, drawing a fresh one if it is empty
+// and throwing if it is not a non-negative integer.
+uint64_t _seed(const std::string& seed);
+
+// Run work(worker) on the given number of threads, for worker in [0, threads),
+// and wait for all of them. Rethrows the first exception raised by a worker.
+void _run_workers(size_t threads, const std::function<void(size_t)>& work);
+
 // Load a file containing one numeric value per line.
 // Pads with zeros if the file has fewer entries than expected_count.
 std::vector<double> _load_reads(
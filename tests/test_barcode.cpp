@@ -1,6 +1,10 @@
 #include "doctest.hpp"
 #include "domain/barcode.hpp"
+#include "domain/barcode_index.hpp"
+#include "domain/stem_sampler.hpp"
+#include "barcodes.hpp"
 #include <random>
+#include <unordered_set>
 
 TEST_CASE("Barcode Hamming ball contains original") {
     Barcode bc("ACGTACGT");
@@ -87,3 +91,116 @@ TEST_CASE("Barcode random avoids existing barcodes") {
     // All barcodes should be unique
     CHECK(existing.size() == 5);
 }
+
+TEST_CASE("Parallel barcoding produces mutually non-neighbouring barcodes") {
+    std::mt19937 gen(42);
+    StemConfig config;
+    config.closing_gc = 1;
+    config.max_gc = 4;
+    config.max_gu = 2;
+
+    BarcodeIndex index;
+    std::vector<std::string> barcodes;
+    _get_barcodes(3000, 7, config, gen, index, barcodes, 4);
+
+    CHECK(barcodes.size() == 3000);
+    CHECK(index.size() == 3000);
+
+    BarcodeIndex check;
+    for (const auto& barcode : barcodes) {
+        CHECK(check.insert_if_not_neighbor(barcode));
+    }
+}
+
+TEST_CASE("Barcoding is the same for a seed on any thread count") {
+    StemConfig config;
+    config.closing_gc = 1;
+    config.max_gc = 5;
+
+    auto run = [&](size_t threads) {
+        std::mt19937 gen(7);
+        BarcodeIndex index;
+        std::vector<std::string> barcodes;
+        _get_barcodes(2000, 8, config, gen, index, barcodes, threads);
+        return barcodes;
+    };
+
+    std::vector<std::string> serial = run(1);
+    CHECK(run(1) == serial);
+    CHECK(run(3) == serial);
+    CHECK(run(8) == serial);
+}
+
+TEST_CASE("Maximal barcoding is the same lexicode on any thread count") {
+    StemConfig config;
+    config.closing_gc = 1;
+    config.max_gc = 3;
+    config.max_gu = 2;
+
+    auto run = [&](size_t threads) {
+        BarcodeIndex index;
+        std::vector<std::string> barcodes;
+        _get_maximal_barcodes(0, 5, config, index, barcodes, threads);
+        return barcodes;
+    };
+
+    std::vector<std::string> serial = run(1);
+    CHECK(!serial.empty());
+    CHECK(run(4) == serial);
+
+    BarcodeIndex check;
+    for (const auto& barcode : serial) {
+        CHECK(check.insert_if_not_neighbor(barcode));
+    }
+}
+
+TEST_CASE("Maximal barcoding leaves no admissible hairpin unused") {
+    StemConfig config;
+    config.closing_gc = 1;
+    config.max_gc = 3;
+    config.max_gu = 2;
+
+    for (size_t d : {1, 3}) {
+        BarcodeIndex maximal_index(d);
+        std::vector<std::string> maximal;
+        _get_maximal_barcodes(0, 5, config, maximal_index, maximal);
+        REQUIRE(!maximal.empty());
+
+        // Every hairpin of the space is either in the code or too close to it
+        std::unordered_set<std::string> used(maximal.begin(), maximal.end());
+        StemSampler stems(5, config);
+        std::string candidate;
+        for (uint64_t rank = 0; rank < stems.size(); rank++) {
+            stems.unrank(rank, candidate);
+            if (used.count(candidate)) continue;
+            INFO("d = " << d << ", rank = " << rank << ", hairpin = " << candidate);
+            REQUIRE(maximal_index.has_neighbor(candidate));
+        }
+    }
+
+    BarcodeIndex maximal_index;
+    std::vector<std::string> maximal;
+    _get_maximal_barcodes(0, 5, config, maximal_index, maximal);
+
+    BarcodeIndex fresh;
+    std::vector<std::string> barcodes;
+    CHECK_THROWS_AS(
+        _get_maximal_barcodes(maximal.size() + 1, 5, config, fresh, barcodes),
+        BarcodesExhausted
+    );
+}
+
+TEST_CASE("Maximal barcoding refuses to build the full code of a huge space") {
+    StemConfig config;
+    config.min_length = 16;
+    config.max_length = 16;
+    config.max_gc = 16;
+
+    BarcodeIndex index;
+    std::vector<std::string> barcodes;
+    CHECK_THROWS_AS(_get_maximal_barcodes(0, 16, config, index, barcodes), std::invalid_argument);
+
+    // A bounded count stops early instead
+    _get_maximal_barcodes(10, 16, config, index, barcodes);
+    CHECK(barcodes.size() == 10);
+}
@@ -0,0 +1,80 @@
+#include "doctest.hpp"
+#include "config/design_config.hpp"
+#include "domain/barcode_capacity.hpp"
+#include "domain/barcode_index.hpp"
+#include "domain/stem_sampler.hpp"
+
+// Greedy packing over every allowed hairpin
+static uint64_t greedy_pack(size_t stem_length, const StemConfig& config, size_t d, size_t e) {
+    StemSampler stems(stem_length, config);
+    BarcodeIndex index(d, e);
+    std::string buffer;
+    for (uint64_t rank = 0; rank < stems.size(); rank++) {
+        stems.unrank(rank, buffer);
+        index.insert_if_not_neighbor(buffer);
+    }
+    return index.size();
+}
+
+TEST_CASE("Capacity counts the same hairpins as StemSampler") {
+    for (size_t max_gu : {0, 1, 3}) {
+        StemConfig config;
+        config.max_gc = 4;
+        config.max_gu = max_gu;
+        for (size_t length : {4, 7, 12}) {
+            INFO("length = " << length << ", max_gu = " << max_gu);
+            BarcodeCapacity capacity = estimate_barcode_capacity(length, config);
+            CHECK(capacity.hairpins == StemSampler(length, config).size());
+        }
+    }
+}
+
+TEST_CASE("Capacity without GU pairs is every hairpin") {
+    StemConfig config;
+    config.max_gc = 3;
+    BarcodeCapacity capacity = estimate_barcode_capacity(5, config);
+    CHECK(capacity.packing_bound == capacity.hairpins);
+    CHECK(capacity.greedy_estimate == capacity.hairpins);
+}
+
+TEST_CASE("Packing bound is above any greedy packing") {
+    StemConfig config;
+    config.max_gc = 3;
+    config.max_gu = 2;
+    for (size_t d : {1, 2, 3, 5}) {
+        for (size_t e : {0, 2, 3}) {
+            INFO("d = " << d << ", e = " << e);
+            BarcodeCapacity capacity = estimate_barcode_capacity(5, config, d, e);
+            uint64_t packed = greedy_pack(5, config, d, e);
+            CHECK(capacity.packing_bound >= packed);
+            CHECK(capacity.packing_bound <= capacity.hairpins);
+            CHECK(capacity.greedy_estimate == packed);
+        }
+    }
+    // GU pairs make neighbours, so the bound is below the hairpin count
+    CHECK(estimate_barcode_capacity(5, config).packing_bound <
+          estimate_barcode_capacity(5, config).hairpins);
+}
+
+TEST_CASE("Capacity saturates instead of overflowing") {
+    StemConfig config;
+    config.max_gc = 30;
+    config.max_gu = 30;
+    BarcodeCapacity capacity = estimate_barcode_capacity(70, config);
+    CHECK(capacity.hairpins == UINT64_MAX);
+    CHECK(capacity.packing_bound == UINT64_MAX);
+    CHECK(capacity.greedy_estimate > 0);
+}
+
+TEST_CASE("Doomed libraries fail validation") {
+    DesignConfig config;
+    config.barcode.stem_length = 4;
+    config.barcode.stem = config.stem;
+    config.barcode.stem.min_length = 4;
+    config.barcode.stem.max_length = 4;
+    CHECK_THROWS_AS(config.validate_with_library_size(1000000), std::invalid_argument);
+    CHECK_NOTHROW(config.validate_with_library_size(10));
+
+    config.barcode.min_distance = 7;
+    CHECK_THROWS_AS(config.validate_with_library_size(100), std::invalid_argument);
+}
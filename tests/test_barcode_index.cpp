@@ -0,0 +1,84 @@
+#include "doctest.hpp"
+#include "domain/barcode.hpp"
+#include "domain/barcode_index.hpp"
+#include "domain/hairpin.hpp"
+#include <random>
+
+TEST_CASE("BarcodeIndex packs hairpins with standard loops") {
+    uint64_t key;
+    CHECK(BarcodeIndex::encode("GACTTTCGAGTC", key));
+    // G-T wobble in the first pair
+    CHECK(BarcodeIndex::encode("GACTTTCGAGTT", key));
+    // Unknown loop
+    CHECK(!BarcodeIndex::encode("GACTAAAAAGTC", key));
+    // Mispaired stem
+    CHECK(!BarcodeIndex::encode("GACTTTCGAGTA", key));
+    // Not a hairpin at all
+    CHECK(!BarcodeIndex::encode("ACGTACGT", key));
+}
+
+TEST_CASE("BarcodeIndex distinguishes Watson-Crick and wobble pairs") {
+    uint64_t wc, wobble;
+    REQUIRE(BarcodeIndex::encode("GACTTTCGAGTC", wc));
+    REQUIRE(BarcodeIndex::encode("GACTTTCGAGTT", wobble));
+    CHECK(wc != wobble);
+}
+
+TEST_CASE("BarcodeIndex detects self and pairing-complement neighbours") {
+    BarcodeIndex index;
+    index.insert("GACTTTCGAGTC");
+    CHECK(index.size() == 1);
+
+    CHECK(index.has_neighbor("GACTTTCGAGTC"));
+    // C -> T on the antisense strand gives a G-U wobble
+    CHECK(index.has_neighbor("GACTTTCGAGTT"));
+    // G -> A on the sense strand gives an A-C mismatch
+    CHECK(index.has_neighbor("AACTTTCGAGTC"));
+    // Two mutations away
+    CHECK(!index.has_neighbor("AACTTTCGAGTT"));
+    // Different loop
+    CHECK(!index.has_neighbor("GACTGTGAAGTC"));
+}
+
+TEST_CASE("BarcodeIndex handles sequences that cannot be packed") {
+    BarcodeIndex index;
+    index.insert("ACGTACGT");
+    CHECK(index.size() == 1);
+    CHECK(index.has_neighbor("ACGTACGT"));
+    CHECK(index.has_neighbor("GCGTACGT"));
+    CHECK(!index.has_neighbor("TTTTTTTT"));
+    CHECK(index.insert_if_not_neighbor("TTTTTTTT"));
+    CHECK(!index.insert_if_not_neighbor("TTTTTTTC"));
+    CHECK(index.size() == 2);
+}
+
+TEST_CASE("BarcodeIndex agrees with the string Hamming ball") {
+    std::mt19937 gen(7);
+    StemConfig config;
+    config.closing_gc = 1;
+    config.max_gc = 10;
+    config.max_au = 10;
+    config.max_gu = 3;
+
+    std::unordered_set<std::string> strings;
+    BarcodeIndex index;
+
+    for (size_t ix = 0; ix < 2000; ix++) {
+        std::string seq = Hairpin::random(5, config, gen).str();
+
+        // Also query single mutants, which are often not valid hairpins
+        std::string mutant = seq;
+        mutant[ix % seq.size()] = "GTAC"[std::string("ACGT").find(seq[ix % seq.size()])];
+
+        CHECK(index.has_neighbor(seq) == Barcode(seq).has_hamming_neighbor(strings));
+        CHECK(index.has_neighbor(mutant) == Barcode(mutant).has_hamming_neighbor(strings));
+
+        bool inserted = index.insert_if_not_neighbor(seq);
+        CHECK(inserted == !Barcode(seq).has_hamming_neighbor(strings));
+        if (inserted) {
+            strings.insert(seq);
+        }
+    }
+
+    CHECK(index.size() == strings.size());
+}
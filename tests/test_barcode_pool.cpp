@@ -0,0 +1,144 @@
+#include "doctest.hpp"
+#include "test_helpers.hpp"
+#include "barcodes.hpp"
+#include "library.hpp"
+#include "preprocess.hpp"
+#include "domain/hairpin.hpp"
+#include "io/barcode_pool.hpp"
+#include <unordered_set>
+
+static BarcodeConfig pool_config() {
+    BarcodeConfig config;
+    config.stem_length = 8;
+    config.stem = StemConfig::for_padding();
+    return config;
+}
+
+TEST_CASE("Barcode pools round-trip through a file") {
+    TempDir tmpdir;
+    std::string path = tmpdir.path() + "/pool.fldbc";
+
+    BarcodeConfig config = pool_config();
+    config.min_distance = 2;
+    _barcodes(500, "", path, false, config);
+
+    BarcodePool pool(path);
+    CHECK(pool.size() == 500);
+    CHECK(pool.config().stem_length == 8);
+    CHECK(pool.config().stem.max_gc == config.stem.max_gc);
+    CHECK(pool.config().min_distance == 2);
+    CHECK(pool[0].length() == 2 * 8 + HAIRPIN_LOOP_LENGTH);
+
+    std::unordered_set<std::string> unique;
+    for (size_t ix = 0; ix < pool.size(); ix++) {
+        unique.insert(std::string(pool[ix]));
+    }
+    CHECK(unique.size() == 500);
+}
+
+TEST_CASE("Barcode pools reject incompatible configurations") {
+    TempDir tmpdir;
+    std::string path = tmpdir.path() + "/pool.fldbc";
+    _barcodes(50, "", path, false, pool_config());
+    BarcodePool pool(path);
+
+    CHECK_NOTHROW(pool.check_compatible(pool_config()));
+
+    BarcodeConfig other_length = pool_config();
+    other_length.stem_length = 9;
+    CHECK_THROWS_AS(pool.check_compatible(other_length), std::invalid_argument);
+
+    BarcodeConfig other_stem = pool_config();
+    other_stem.stem.max_gc = 3;
+    CHECK_THROWS_AS(pool.check_compatible(other_stem), std::invalid_argument);
+
+    BarcodeConfig stricter = pool_config();
+    stricter.min_edit_distance = 2;
+    CHECK_THROWS_AS(pool.check_compatible(stricter), std::invalid_argument);
+}
+
+TEST_CASE("Barcode pools reject other and truncated files") {
+    TempDir tmpdir;
+    std::string path = tmpdir.path() + "/pool.fldbc";
+    _barcodes(50, "", path, false, pool_config());
+
+    // A count whose product with the length wraps around to the file size
+    std::string wrapped = tmpdir.path() + "/wrapped.fldbc";
+    std::filesystem::copy_file(path, wrapped);
+    {
+        std::fstream file(wrapped, std::ios::binary | std::ios::in | std::ios::out);
+        uint32_t length = 0;
+        file.seekg(16);
+        file.read(reinterpret_cast<char*>(&length), sizeof(length));
+        REQUIRE(length % 4 == 0);
+        uint64_t count = 50 + (uint64_t(1) << 62);
+        file.seekp(72);
+        file.write(reinterpret_cast<const char*>(&count), sizeof(count));
+    }
+    CHECK_THROWS_AS(BarcodePool{wrapped}, std::runtime_error);
+
+    std::filesystem::resize_file(path, std::filesystem::file_size(path) - 1);
+    CHECK_THROWS_AS(BarcodePool{path}, std::runtime_error);
+
+    std::string text = tmpdir.path() + "/barcodes.txt";
+    std::ofstream(text) << "GACTTTCGAGTC\n";
+    CHECK_THROWS_AS(BarcodePool{text}, std::runtime_error);
+}
+
+TEST_CASE("Drawing from a pool skips existing neighbours") {
+    TempDir tmpdir;
+    std::string path = tmpdir.path() + "/pool.fldbc";
+    _barcodes(100, "", path, false, pool_config());
+    BarcodePool pool(path);
+
+    BarcodeIndex index;
+    index.insert(std::string(pool[0]));
+    std::vector<std::string> barcodes;
+    _get_pool_barcodes(99, pool, index, barcodes);
+    CHECK(barcodes.size() == 99);
+    CHECK(barcodes[0] == pool[1]);
+
+    CHECK_THROWS_AS(_get_pool_barcodes(1, pool, index, barcodes), BarcodesExhausted);
+}
+
+TEST_CASE("design draws barcodes from a pool") {
+    std::mt19937 gen(9);
+    TempDir tmpdir;
+    std::string fasta_path = tmpdir.path() + "/input.fasta";
+    std::string csv_path = tmpdir.path() + "/preprocessed.csv";
+    std::string pool_path = tmpdir.path() + "/pool.fldbc";
+    std::string output_prefix = tmpdir.path() + "/output";
+
+    write_random_fasta(fasta_path, 20, 60, gen);
+    _preprocess(fasta_path, csv_path, true, "test");
+
+    DesignConfig config;
+    config.input_path = csv_path;
+    config.output_prefix = output_prefix;
+    config.overwrite = true;
+    config.pad_to_length = 60;
+    config.barcode.stem_length = 8;
+    config.barcode.stem = config.stem;
+    _barcodes(40, "", pool_path, false, config.barcode);
+
+    config.barcode.pool_path = pool_path;
+    _design(config);
+
+    BarcodePool pool(pool_path);
+    std::unordered_set<std::string> pooled;
+    for (size_t ix = 0; ix < pool.size(); ix++) {
+        pooled.insert(std::string(pool[ix]));
+    }
+
+    std::ifstream file(output_prefix + ".csv");
+    std::string line;
+    std::getline(file, line);  // Skip header
+    size_t rows = 0;
+    while (std::getline(file, line)) {
+        std::vector<std::string> parts = _split_by_delimiter(line, ',');
+        REQUIRE(parts.size() >= 8);
+        CHECK(pooled.count(parts[7]) == 1);
+        rows++;
+    }
+    CHECK(rows == 20);
+}
@@ -0,0 +1,185 @@
+#include "doctest.hpp"
+#include "test_helpers.hpp"
+#include "library.hpp"
+#include "preprocess.hpp"
+#include "io/compressed_file.hpp"
+#include "io/fasta_io.hpp"
+#include <fstream>
+#include <thread>
+#include <sys/stat.h>
+
+static std::string _read_all(const std::string& path) {
+    InputFile file(path);
+    return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+static std::string _read_raw(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+// Several blocks of text, so that output is compressed in more than one
+static std::string _text(std::mt19937& gen) {
+    std::string text;
+    for (size_t line = 0; text.size() < (3 << 20); line++) {
+        text += ">seq" + std::to_string(line) + "\n" + random_sequence(random_range(20, 200, gen), gen) + "\n";
+    }
+    return text;
+}
+
+TEST_CASE("compression is chosen by extension and detected by content") {
+    CHECK(compression_for("library.csv") == Compression::None);
+    CHECK(compression_for("library.csv.gz") == Compression::Gzip);
+    CHECK(compression_for("designs.fasta.zst") == Compression::Zstd);
+
+    TempDir tmpdir;
+    std::string plain = tmpdir.path() + "/plain.txt";
+    std::string gzip = tmpdir.path() + "/named-plain.gz";
+    { OutputFile file(plain); file << "ACGT\n"; }
+    { OutputFile file(gzip); file << "ACGT\n"; }
+    CHECK(detect_compression(plain) == Compression::None);
+    CHECK(detect_compression(gzip) == Compression::Gzip);
+    CHECK(detect_compression(tmpdir.path() + "/missing") == Compression::None);
+    CHECK(_read_raw(plain) == "ACGT\n");
+    CHECK(_read_all(gzip) == "ACGT\n");
+}
+
+TEST_CASE("OutputFile compresses blocks that read back as one stream") {
+    std::mt19937 gen(23);
+    TempDir tmpdir;
+    std::string text = _text(gen);
+
+    std::vector<std::string> extensions = {"", ".gz"};
+    if (zstd_supported()) extensions.push_back(".zst");
+    for (const std::string& extension : extensions) {
+        std::string serial = tmpdir.path() + "/serial.txt" + extension;
+        std::string parallel = tmpdir.path() + "/parallel.txt" + extension;
+        { OutputFile file(serial, 1); file << text; }
+        {
+            OutputFile file(parallel, 3);
+            // Written in pieces that straddle the blocks
+            for (size_t pos = 0; pos < text.size(); pos += 100000) {
+                file << text.substr(pos, 100000);
+            }
+        }
+        CAPTURE(extension);
+        CHECK(_read_all(serial) == text);
+        CHECK(_read_raw(serial) == _read_raw(parallel));
+        if (!extension.empty()) {
+            CHECK(_read_raw(serial).size() < text.size() / 2);
+        }
+    }
+}
+
+TEST_CASE("InputFile reads lines of compressed files") {
+    TempDir tmpdir;
+    std::string path = tmpdir.path() + "/lines.txt.gz";
+    { OutputFile file(path); file << "first\n\nthird"; }
+
+    InputFile file(path);
+    REQUIRE(file.is_open());
+    std::string line;
+    std::vector<std::string> lines;
+    while (std::getline(file, line)) lines.push_back(line);
+    CHECK(lines == std::vector<std::string>{"first", "", "third"});
+
+    InputFile missing(tmpdir.path() + "/missing.txt");
+    CHECK(!missing);
+    CHECK(!missing.is_open());
+}
+
+TEST_CASE("OutputFile reports output that fails to reach the file" * doctest::skip(!std::filesystem::exists("/dev/full"))) {
+    TempDir tmpdir;
+    // /dev/full takes no writes, named so that output is compressed or not
+    for (std::string name : {"full.txt", "full.txt.gz"}) {
+        std::string path = tmpdir.path() + "/" + name;
+        std::filesystem::create_symlink("/dev/full", path);
+        OutputFile file(path);
+        REQUIRE(file.is_open());
+        file << "ACGT\n";
+        CAPTURE(name);
+        CHECK_THROWS_AS(file.close(), std::runtime_error);
+        CHECK(!file.is_open());
+        CHECK_NOTHROW(file.close());
+    }
+}
+
+TEST_CASE("InputFile reads plain and compressed files through a pipe") {
+    std::mt19937 gen(26);
+    TempDir tmpdir;
+    std::string text = _text(gen);
+
+    std::vector<std::string> extensions = {"", ".gz"};
+    if (zstd_supported()) extensions.push_back(".zst");
+    for (const std::string& extension : extensions) {
+        std::string path = tmpdir.path() + "/lines.txt" + extension;
+        { OutputFile file(path, 2); file << text; }
+        std::string pipe = tmpdir.path() + "/pipe" + extension;
+        REQUIRE(mkfifo(pipe.c_str(), 0600) == 0);
+
+        // A FIFO opens once both ends are open, so write from another thread
+        std::thread writer([&] {
+            std::ofstream out(pipe, std::ios::binary);
+            out << _read_raw(path);
+        });
+        std::string read = _read_all(pipe);
+        writer.join();
+        CAPTURE(extension);
+        CHECK(read == text);
+    }
+}
+
+TEST_CASE("FASTA files read the same compressed") {
+    std::mt19937 gen(24);
+    TempDir tmpdir;
+    std::string text = _text(gen);
+    // A wrapped entry, and an empty entry at the end which is dropped
+    text += ">wrapped\nACGT\nACGT\n>empty\n";
+    std::string plain = tmpdir.path() + "/designs.fasta";
+    std::string gzip = tmpdir.path() + "/designs.fasta.gz";
+    { OutputFile file(plain); file << text; }
+    { OutputFile file(gzip, 2); file << text; }
+
+    auto expected = read_fasta(plain);
+    auto entries = read_fasta(gzip);
+    REQUIRE(entries.size() == expected.size());
+    for (size_t ix = 0; ix < entries.size(); ix++) {
+        CHECK(entries[ix].name == expected[ix].name);
+        CHECK(entries[ix].sequence == expected[ix].sequence);
+    }
+    CHECK(entries.back().sequence == "ACGTACGT");
+    CHECK(count_fasta_entries(gzip, 2) == count_fasta_entries(plain));
+
+    // Chunks of a compressed file cover it in order
+    size_t next = 0;
+    std::vector<size_t> counts(3);
+    for_each_fasta_chunk(gzip, 3, [&](size_t slot, const FastaChunk& chunk) {
+        FastaReader reader(chunk.text, chunk.ends_file);
+        FastaRecord record;
+        counts[slot] = 0;
+        while (reader.next(record)) {
+            CHECK(record.name == expected[chunk.first + counts[slot]].name);
+            counts[slot]++;
+        }
+    }, [&](size_t slot) {
+        next += counts[slot];
+    }, 100000);
+    CHECK(next == expected.size());
+}
+
+TEST_CASE("libraries load from compressed CSV files") {
+    std::mt19937 gen(25);
+    TempDir tmpdir;
+    std::string fasta_path = tmpdir.path() + "/input.fasta";
+    write_random_fasta(fasta_path, 500, 80, gen);
+    _preprocess(fasta_path, tmpdir.path() + "/plain.csv", true, "lib");
+    _preprocess(fasta_path, tmpdir.path() + "/compressed.csv.gz", true, "lib", 2);
+    CHECK(detect_compression(tmpdir.path() + "/compressed.csv.gz") == Compression::Gzip);
+
+    Library plain = _from_csv(tmpdir.path() + "/plain.csv");
+    Library compressed = _from_csv(tmpdir.path() + "/compressed.csv.gz");
+    REQUIRE(compressed.size() == 500);
+    plain.to_csv(tmpdir.path() + "/plain_out.csv");
+    compressed.to_csv(tmpdir.path() + "/compressed_out.csv.gz");
+    CHECK(_read_all(tmpdir.path() + "/plain_out.csv") == _read_all(tmpdir.path() + "/compressed_out.csv.gz"));
+}
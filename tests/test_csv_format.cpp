@@ -1,6 +1,7 @@
 #include "doctest.hpp"
 #include "io/csv_format.hpp"
 #include <algorithm>
+#include <random>
 
 TEST_CASE("csv::header returns correct format") {
     std::string header = csv::header();
@@ -108,3 +109,108 @@ TEST_CASE("csv::Header get handles out-of-bounds gracefully") {
     CHECK(h.get(fields, csv::COL_FIVE_CONST) == "");  // Out of bounds returns empty
     CHECK(h.get(fields, csv::COL_FIVE_CONST, "default") == "default");  // Or provided default
 }
+
+TEST_CASE("csv::Row reads only the projected columns") {
+    csv::Header h("index,name,design,five_const,barcode");
+    csv::Projection projection(h);
+    size_t barcode = projection.add(csv::COL_BARCODE);
+    size_t design = projection.add(csv::COL_DESIGN);
+    size_t sublibrary = projection.add(csv::COL_SUBLIBRARY);
+    CHECK(projection.add(csv::COL_DESIGN) == design);
+    CHECK(projection.size() == 3);
+
+    csv::Row row(projection);
+    row.parse("1,seq1,ACGT,TGCA,GGAA");
+    CHECK(row[barcode] == "GGAA");
+    CHECK(row[design] == "ACGT");
+    CHECK(row[sublibrary] == "");
+    CHECK(!row.has(sublibrary));
+    CHECK(row.get(sublibrary, "default") == "default");
+
+    // A short row reads the missing columns as the default
+    row.parse("2,seq2,AAAA");
+    CHECK(row[design] == "AAAA");
+    CHECK(!row.has(barcode));
+    CHECK(row.get(barcode, "default") == "default");
+}
+
+TEST_CASE("csv::Row follows RFC 4180 quoting") {
+    csv::Header h("name,design,barcode");
+    csv::Projection projection(h);
+    projection.add_all();
+    csv::Row row(projection);
+
+    row.parse("\"a, b\",ACGT,GGAA");
+    CHECK(row[0] == "a, b");
+    CHECK(row[1] == "ACGT");
+    CHECK(row[2] == "GGAA");
+
+    row.parse("\"say \"\"hi\"\"\",\"\",\"\"\"\"");
+    CHECK(row[0] == "say \"hi\"");
+    CHECK(row[1] == "");
+    CHECK(row.has(1));
+    CHECK(row[2] == "\"");
+
+    // Quoted fields keep their commas past the width of a vector register
+    std::string name = "a long name, with commas, that spans more than one block of the scan";
+    std::string line = "\"" + name + "\",CCCC,";
+    row.parse(line);
+    CHECK(row[0] == name);
+    CHECK(row[1] == "CCCC");
+    CHECK(row[2] == "");
+}
+
+TEST_CASE("csv::split matches a field-by-field reading of random lines") {
+    std::mt19937 gen(24);
+    const std::string alphabet = "ACGT,\"x ";
+    std::uniform_int_distribution<size_t> length(0, 200);
+    std::uniform_int_distribution<size_t> pick(0, alphabet.size() - 1);
+    std::vector<std::string> fields;
+    for (size_t trial = 0; trial < 500; trial++) {
+        std::string line;
+        for (size_t i = length(gen); i > 0; i--) {
+            line += alphabet[pick(gen)];
+        }
+
+        // A character at a time: quotes toggle quoting, and a doubled quote
+        // within quotes is one quote
+        std::vector<std::string> expected(1);
+        bool quoted = false;
+        for (size_t i = 0; i < line.size(); i++) {
+            char c = line[i];
+            if (c == '"' && quoted && i + 1 < line.size() && line[i + 1] == '"') {
+                expected.back() += '"';
+                i++;
+            } else if (c == '"') {
+                quoted = !quoted;
+            } else if (c == ',' && !quoted) {
+                expected.emplace_back();
+            } else {
+                expected.back() += c;
+            }
+        }
+
+        csv::split(line, ',', fields);
+        CAPTURE(line);
+        if (line.find('"') == std::string::npos) {
+            CHECK(fields == expected);
+        } else {
+            CHECK(fields.size() == expected.size());
+        }
+    }
+}
+
+TEST_CASE("csv::PackedRow keeps the fields of a projected row") {
+    csv::Header h("index,name,sublibrary,five_const,five_padding,design,three_padding,barcode,three_const");
+    csv::Projection projection(h);
+    projection.add_all();
+    csv::Row row(projection);
+    row.parse("7,\"a,b\",lib,GG,AA,ACGU,UU,CCCC,GA");
+
+    csv::PackedRow packed(h, row.fields());
+    CHECK(packed.get(csv::COL_NAME) == "a,b");
+    CHECK(packed.get(csv::COL_DESIGN) == "ACGU");
+    std::string out;
+    packed.append_csv(out);
+    CHECK(out == "7,\"a,b\",lib,GG,AA,ACGU,UU,CCCC,GA");
+}
@@ -0,0 +1,215 @@
+#include "doctest.hpp"
+#include "test_helpers.hpp"
+#include "demux.hpp"
+#include "domain/barcode.hpp"
+#include "domain/barcode_lookup.hpp"
+#include "domain/sequence.hpp"
+#include "io/fastq_io.hpp"
+#include "utils.hpp"
+#include <zlib.h>
+
+static const std::string THREE_CONST = "AAAGAAACAACAACAACAAC";
+static const std::vector<std::string> DEMUX_BARCODES = {
+    "GACTTTCGAGTC",
+    "CTGATTCGTCAG",
+    "GGTCTTCGGACC"
+};
+
+static std::string write_demux_library(const std::string& path) {
+    std::ofstream file(path);
+    file << "index,name,five_const,five_padding,design,three_padding,barcode,three_const\n";
+    for (size_t ix = 0; ix < DEMUX_BARCODES.size(); ix++) {
+        file << ix + 1 << ",seq" << ix << ",GGAAA,,ACGUACGUACGU,,"
+             << to_rna(DEMUX_BARCODES[ix]) << "," << to_rna(THREE_CONST) << "\n";
+    }
+    return path;
+}
+
+static std::string fastq_record(const std::string& name, const std::string& sequence) {
+    return "@" + name + "\n" + sequence + "\n+\n" + std::string(sequence.length(), 'I') + "\n";
+}
+
+static std::string read_with(const std::string& barcode) {
+    return "GGAAAACGTACGTACGT" + barcode + THREE_CONST;
+}
+
+static std::string reverse_complement(const std::string& seq) {
+    std::string out(seq.rbegin(), seq.rend());
+    for (char& base : out) {
+        base = complement(base, Alphabet::DNA);
+    }
+    return out;
+}
+
+static std::vector<std::string> read_counts(const std::string& path) {
+    std::ifstream file(path);
+    std::string line;
+    std::getline(file, line);
+    std::vector<std::string> counts;
+    while (std::getline(file, line)) {
+        counts.push_back(_split_by_delimiter(line, ',').back());
+    }
+    return counts;
+}
+
+TEST_CASE("Substitution balls hold every single substitution") {
+    std::vector<std::string> ball = Barcode::substitution_ball("ACGU");
+    CHECK(ball.size() == 3 * 4 + 1);
+    CHECK(ball.back() == "ACGU");
+    std::unordered_set<std::string> unique(ball.begin(), ball.end());
+    CHECK(unique.size() == ball.size());
+    CHECK(unique.count("UCGU") == 1);
+    CHECK(unique.count("TCGU") == 0);
+}
+
+TEST_CASE("Barcode lookups correct single substitutions") {
+    BarcodeLookup lookup(DEMUX_BARCODES);
+    for (size_t ix = 0; ix < DEMUX_BARCODES.size(); ix++) {
+        const std::string& barcode = DEMUX_BARCODES[ix];
+        CHECK(lookup.find(barcode) == static_cast<int32_t>(ix));
+        CHECK(lookup.is_exact(barcode, static_cast<int32_t>(ix)));
+        for (const std::string& variant : Barcode::substitution_ball(barcode)) {
+            CHECK(lookup.find(variant) == static_cast<int32_t>(ix));
+        }
+    }
+
+    std::string corrected = DEMUX_BARCODES[0];
+    corrected[3] = 'A';
+    CHECK_FALSE(lookup.is_exact(corrected, 0));
+    CHECK(lookup.find(to_rna(DEMUX_BARCODES[1])) == 1);
+    CHECK(lookup.find("GACTTTCGAGT") == BarcodeLookup::UNMATCHED);
+    CHECK(lookup.lengths() == std::vector<size_t>{12});
+
+    // An N is the one correctable substitution, but not on top of another
+    CHECK(lookup.find("GACTTNCGAGTC") == 0);
+    CHECK_FALSE(lookup.is_exact("GACTTNCGAGTC", 0));
+    CHECK(lookup.find("GACTTNCGAGTA") == BarcodeLookup::UNMATCHED);
+    CHECK(lookup.find("GACNNTCGAGTC") == BarcodeLookup::UNMATCHED);
+
+    BarcodeLookup strict(DEMUX_BARCODES, 0);
+    CHECK(strict.find(DEMUX_BARCODES[0]) == 0);
+    CHECK(strict.find(corrected) == BarcodeLookup::UNMATCHED);
+    CHECK(strict.find("GACTTNCGAGTC") == BarcodeLookup::UNMATCHED);
+}
+
+TEST_CASE("Barcode lookups mark shared corrections as ambiguous") {
+    BarcodeLookup lookup({"AAAA", "AAAT", "CCCC", "CCCC"});
+    CHECK(lookup.find("AAAA") == 0);
+    CHECK(lookup.find("AAAT") == 1);
+    CHECK(lookup.find("AAAG") == BarcodeLookup::AMBIGUOUS);
+    CHECK(lookup.find("CAAA") == 0);
+    CHECK(lookup.find("CCCC") == BarcodeLookup::AMBIGUOUS);
+    CHECK(lookup.find("NAAA") == 0);
+    CHECK(lookup.find("AAAN") == BarcodeLookup::AMBIGUOUS);
+    CHECK(lookup.find("CCNC") == BarcodeLookup::AMBIGUOUS);
+
+    CHECK_THROWS_AS(BarcodeLookup({"AAAA"}, 2), std::invalid_argument);
+    CHECK_THROWS_AS(BarcodeLookup({std::string(33, 'A')}), std::invalid_argument);
+}
+
+TEST_CASE("FASTQ readers stream plain and gzipped files in batches") {
+    TempDir tmpdir;
+    std::string records;
+    for (size_t ix = 0; ix < 10; ix++) {
+        records += fastq_record("read" + std::to_string(ix), read_with(DEMUX_BARCODES[ix % 3]));
+    }
+    std::string plain = tmpdir.path() + "/reads.fastq";
+    std::ofstream(plain) << records;
+    std::string gzipped = tmpdir.path() + "/reads.fastq.gz";
+    gzFile file = gzopen(gzipped.c_str(), "wb");
+    gzwrite(file, records.data(), static_cast<unsigned>(records.size()));
+    gzclose(file);
+
+    for (const std::string& path : {plain, gzipped}) {
+        FastqReader reader(path);
+        std::vector<FastqRecord> batch;
+        REQUIRE(reader.read_batch(batch, 4));
+        CHECK(batch.size() == 4);
+        CHECK(batch[0].name == "read0");
+        CHECK(batch[1].sequence == read_with(DEMUX_BARCODES[1]));
+        CHECK(batch[1].quality.length() == batch[1].sequence.length());
+        REQUIRE(reader.read_batch(batch, 4));
+        REQUIRE(reader.read_batch(batch, 4));
+        CHECK(batch.size() == 2);
+        CHECK(batch[1].name == "read9");
+        CHECK_FALSE(reader.read_batch(batch, 4));
+    }
+
+    std::string truncated = tmpdir.path() + "/truncated.fastq";
+    std::ofstream(truncated) << "@read0\nACGT\n+\n";
+    FastqReader reader(truncated);
+    std::vector<FastqRecord> batch;
+    CHECK_THROWS_AS(reader.read_batch(batch, 4), std::runtime_error);
+}
+
+TEST_CASE("FASTQ appends report records that fail to reach the file" * doctest::skip(!std::filesystem::exists("/dev/full"))) {
+    CHECK_THROWS_AS(_append_fastq("/dev/full", fastq_record("read0", "ACGT")), std::runtime_error);
+}
+
+TEST_CASE("demux counts reads per construct") {
+    TempDir tmpdir;
+    std::string library = write_demux_library(tmpdir.path() + "/library.csv");
+    std::string output = tmpdir.path() + "/counts.csv";
+
+    std::string corrected = DEMUX_BARCODES[2];
+    corrected[5] = 'A';
+    std::string uncalled = DEMUX_BARCODES[0];
+    uncalled[2] = 'N';
+    std::string records;
+    records += fastq_record("exact0", read_with(DEMUX_BARCODES[0]));
+    records += fastq_record("exact1", read_with(DEMUX_BARCODES[1]));
+    records += fastq_record("exact1b", read_with(DEMUX_BARCODES[1]));
+    records += fastq_record("corrected2", read_with(corrected));
+    records += fastq_record("uncalled0", read_with(uncalled));
+    records += fastq_record("unmatched", read_with("AAAAAAAAAAAA"));
+    records += fastq_record("no_anchor", "GGAAAACGTACGTACGT" + DEMUX_BARCODES[0]);
+
+    std::string reads = tmpdir.path() + "/reads.fastq.gz";
+    gzFile file = gzopen(reads.c_str(), "wb");
+    gzwrite(file, records.data(), static_cast<unsigned>(records.size()));
+    gzclose(file);
+
+    std::string fastq_dir = tmpdir.path() + "/split";
+    DemuxStats stats = _demux(reads, library, output, fastq_dir, 1, false, false, 3);
+    CHECK(stats.reads == 7);
+    CHECK(stats.exact == 3);
+    CHECK(stats.corrected == 2);
+    CHECK(stats.unmatched == 1);
+    CHECK(stats.no_anchor == 1);
+    CHECK(read_counts(output) == std::vector<std::string>{"2", "2", "1"});
+
+    FastqReader split(fastq_dir + "/2.fastq");
+    std::vector<FastqRecord> batch;
+    REQUIRE(split.read_batch(batch, 10));
+    CHECK(batch.size() == 2);
+    CHECK(batch[0].name == "exact1");
+    CHECK(batch[1].name == "exact1b");
+
+    CHECK_THROWS(_demux(reads, library, output, "", 1, false, false));
+
+    // Without correction, the corrected reads go unmatched
+    stats = _demux(reads, library, output, "", 0, false, true);
+    CHECK(stats.corrected == 0);
+    CHECK(stats.unmatched == 3);
+}
+
+TEST_CASE("demux reverse-complements reads sequenced from the 3' end") {
+    TempDir tmpdir;
+    std::string library = write_demux_library(tmpdir.path() + "/library.csv");
+    std::string output = tmpdir.path() + "/counts.csv";
+    std::string reads = tmpdir.path() + "/reads.fastq";
+    {
+        std::ofstream file(reads);
+        for (size_t ix = 0; ix < 30; ix++) {
+            std::string read = reverse_complement(read_with(DEMUX_BARCODES[ix % 3]));
+            file << fastq_record("read" + std::to_string(ix), read);
+        }
+    }
+
+    DemuxStats stats = _demux(reads, library, output, "", 1, false, false);
+    CHECK(stats.no_anchor == 30);
+
+    stats = _demux(reads, library, output, "", 1, true, true, 4);
+    CHECK(stats.exact == 30);
+    CHECK(read_counts(output) == std::vector<std::string>{"10", "10", "10"});
+}
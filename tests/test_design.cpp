@@ -4,6 +4,7 @@
 #include "preprocess.hpp"
 #include "config/design_config.hpp"
 #include "io/csv_format.hpp"
+#include "io/writers.hpp"
 
 TEST_CASE("design produces sequences of correct padded length") {
     std::mt19937 gen(42);  // Fixed seed for reproducibility
@@ -197,3 +198,234 @@ TEST_CASE("library loading with optional columns provides defaults") {
     Library library = _from_csv(csv_path);
     CHECK(library.size() == 2);
 }
+
+TEST_CASE("library export writes every segment of each construct") {
+    TempDir tmpdir;
+    std::string csv_path = tmpdir.path() + "/library.csv";
+    std::string copy_prefix = tmpdir.path() + "/copy";
+
+    std::string header = "index,name,sublibrary,five_const,five_padding,design,three_padding,barcode,three_const,begin,end";
+    std::vector<std::string> rows = {
+        "4,\"gene_a\",\"lib\",AAA,GG,ACGT,C,TTAA,AAA,6,10",
+        "9,\"gene_b\",\"\",,,TGCA,,,,1,5"
+    };
+    {
+        std::ofstream file(csv_path);
+        file << header << "\n" << rows[0] << "\n" << rows[1] << "\n";
+    }
+
+    Library library = _from_csv(csv_path);
+    library.to_csv(output_csv(copy_prefix));
+    library.to_fasta(output_fasta(copy_prefix));
+
+    std::ifstream csv(output_csv(copy_prefix));
+    std::string line;
+    std::getline(csv, line);
+    CHECK(line == header);
+    for (const std::string& row : rows) {
+        std::getline(csv, line);
+        CHECK(line == row);
+    }
+
+    std::ifstream fasta(output_fasta(copy_prefix));
+    std::string contents((std::istreambuf_iterator<char>(fasta)), std::istreambuf_iterator<char>());
+    CHECK(contents == ">gene_a (lib)\nAAAGGACGTCTTAAAAA\n>gene_b\nTGCA\n");
+
+    // Rewriting segments reuses or extends the arena without disturbing
+    // the other segments
+    library.primerize("GGGG", "C");
+    library.to_rna();
+    library.to_txt(output_txt(copy_prefix));
+    std::ifstream txt(output_txt(copy_prefix));
+    std::getline(txt, line);
+    CHECK(line == "GGGGGGACGUCUUAAC");
+    std::getline(txt, line);
+    CHECK(line == "GGGGUGCAC");
+}
+
+TEST_CASE("design in append mode keeps existing padding and barcodes") {
+    std::mt19937 gen(77);
+    size_t N = 80;
+
+    TempDir tmpdir;
+    std::string first_fasta = tmpdir.path() + "/first.fasta";
+    std::string first_csv = tmpdir.path() + "/first.csv";
+    std::string second_fasta = tmpdir.path() + "/second.fasta";
+    std::string second_csv = tmpdir.path() + "/second.csv";
+    std::string combined_csv = tmpdir.path() + "/combined.csv";
+
+    write_random_fasta(first_fasta, 30, N, gen);
+    write_random_fasta(second_fasta, 10, N, gen);
+    _preprocess(first_fasta, first_csv, true, "first");
+    _preprocess(second_fasta, second_csv, true, "second");
+
+    DesignConfig config;
+    config.input_path = first_csv;
+    config.output_prefix = tmpdir.path() + "/first_out";
+    config.overwrite = true;
+    config.pad_to_length = N;
+    config.barcode.stem_length = 8;
+    config.barcode.stem = config.stem;
+    _design(config);
+
+    // The designed library followed by the new rows
+    {
+        std::ofstream out(combined_csv);
+        std::ifstream existing(config.output_prefix + ".csv");
+        std::ifstream added(second_csv);
+        std::string line;
+        while (std::getline(existing, line)) out << line << "\n";
+        std::getline(added, line);  // Skip header
+        while (std::getline(added, line)) out << line << "\n";
+    }
+
+    auto read_rows = [](const std::string& path) {
+        std::ifstream in(path);
+        std::string line;
+        std::getline(in, line);
+        std::vector<std::vector<std::string>> rows;
+        while (std::getline(in, line)) {
+            rows.push_back(_split_by_delimiter(line, ','));
+        }
+        return rows;
+    };
+
+    config.input_path = combined_csv;
+    config.output_prefix = tmpdir.path() + "/combined_out";
+    config.append = true;
+    _design(config);
+
+    auto before = read_rows(tmpdir.path() + "/first_out.csv");
+    auto after = read_rows(config.output_prefix + ".csv");
+    REQUIRE(before.size() == 30);
+    REQUIRE(after.size() == 40);
+
+    // Columns: index,name,sublibrary,five_const,five_padding,design,three_padding,barcode,three_const
+    std::unordered_set<std::string> barcodes;
+    for (size_t ix = 0; ix < after.size(); ix++) {
+        if (ix < before.size()) {
+            CHECK(after[ix][4] == before[ix][4]);
+            CHECK(after[ix][7] == before[ix][7]);
+        }
+        CHECK(!after[ix][7].empty());
+        barcodes.insert(after[ix][7]);
+    }
+    CHECK(barcodes.size() == 40);
+}
+
+TEST_CASE("library stages give the same output on any number of threads") {
+    std::mt19937 gen(13);
+    TempDir tmpdir;
+    std::string csv_path = tmpdir.path() + "/library.csv";
+    {
+        // Enough rows for several blocks, with degenerate bases to replace
+        std::ofstream file(csv_path);
+        file << "index,name,five_const,five_padding,design,three_padding,barcode,three_const\n";
+        for (size_t ix = 1; ix <= 3000; ix++) {
+            std::string design = random_sequence(random_range(20, 50, gen), gen);
+            design[ix % design.length()] = 'N';
+            file << ix << ",seq_" << ix << ",,," << design << ",,,\n";
+        }
+    }
+
+    auto run = [&](size_t threads) {
+        Library library = _from_csv(csv_path);
+        library.seed(2024);
+        library.replace_polybases(threads);
+        library.pad(60, StemConfig::for_padding(), false, threads);
+        library.to_rna(threads);
+        std::string prefix = tmpdir.path() + "/threads_" + std::to_string(threads);
+        library.to_txt(output_txt(prefix));
+        std::ifstream file(output_txt(prefix));
+        return std::string((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    };
+
+    std::string serial = run(1);
+    CHECK(serial.find('N') == std::string::npos);
+    CHECK(serial.find('T') == std::string::npos);
+    CHECK(run(3) == serial);
+    CHECK(run(8) == serial);
+}
+
+TEST_CASE("design in chunks matches the padding of an in-memory design") {
+    std::mt19937 gen(15);
+    TempDir tmpdir;
+    std::string fasta_path = tmpdir.path() + "/input.fasta";
+    std::string csv_path = tmpdir.path() + "/preprocessed.csv";
+    write_random_fasta(fasta_path, 2500, 60, gen);
+    _preprocess(fasta_path, csv_path, true, "test");
+
+    DesignConfig config;
+    config.input_path = csv_path;
+    config.overwrite = true;
+    config.pad_to_length = 80;
+    config.barcode.stem_length = 8;
+    config.barcode.stem = config.stem;
+    config.seed = 15;
+
+    auto run = [&](const std::string& name, size_t chunk_size) {
+        config.output_prefix = tmpdir.path() + "/" + name;
+        config.chunk_size = chunk_size;
+        _design(config);
+        std::vector<std::vector<std::string>> rows;
+        std::ifstream file(output_csv(config.output_prefix));
+        std::string line;
+        std::getline(file, line);
+        while (std::getline(file, line)) {
+            rows.push_back(_split_by_delimiter(line, ','));
+        }
+        return rows;
+    };
+
+    auto whole = run("whole", 0);
+    auto chunked = run("chunked", 1024);
+    auto ragged = run("ragged", 333);
+    REQUIRE(whole.size() == 2500);
+    REQUIRE(chunked.size() == 2500);
+    REQUIRE(ragged.size() == 2500);
+
+    // Chunks of whole blocks draw the same padding streams
+    BarcodeIndex index;
+    for (size_t ix = 0; ix < whole.size(); ix++) {
+        CHECK(chunked[ix][0] == whole[ix][0]);
+        CHECK(chunked[ix][4] == whole[ix][4]);
+        CHECK(ragged[ix][4].length() == whole[ix][4].length());
+        CHECK(index.insert_if_not_neighbor(ragged[ix][7]));
+    }
+    CHECK(std::filesystem::exists(output_seed(tmpdir.path() + "/ragged")));
+}
+
+TEST_CASE("design in chunks keeps existing barcodes of later chunks") {
+    TempDir tmpdir;
+    std::string csv_path = tmpdir.path() + "/library.csv";
+    {
+        std::ofstream file(csv_path);
+        file << "index,name,five_const,five_padding,design,three_padding,barcode,three_const\n";
+        file << "1,a,,,ACGTACGTAC,,,\n";
+        file << "2,b,,,ACGTACGTAC,,,\n";
+        file << "3,c,,,ACGTACGTAC,,GACTTTCGAGTC,\n";
+    }
+
+    DesignConfig config;
+    config.input_path = csv_path;
+    config.output_prefix = tmpdir.path() + "/output";
+    config.pad_to_length = 10;
+    config.barcode.stem_length = 4;
+    config.barcode.stem = StemConfig::for_barcode(4);
+    config.append = true;
+    config.chunk_size = 1;
+    _design(config);
+
+    std::ifstream file(output_csv(config.output_prefix));
+    std::string line;
+    std::getline(file, line);
+    std::vector<std::string> barcodes;
+    while (std::getline(file, line)) {
+        barcodes.push_back(_split_by_delimiter(line, ',')[7]);
+    }
+    REQUIRE(barcodes.size() == 3);
+    CHECK(barcodes[2] == "GACTTTCGAGTC");
+    CHECK(barcodes[0] != barcodes[2]);
+    CHECK(barcodes[1] != barcodes[2]);
+    CHECK(barcodes[0] != barcodes[1]);
+}
@@ -0,0 +1,109 @@
+#include "doctest.hpp"
+#include "test_helpers.hpp"
+#include "barcodes.hpp"
+#include "domain/barcode_index.hpp"
+#include "domain/edit_index.hpp"
+#include <algorithm>
+#include <random>
+
+static size_t reference_distance(const std::string& a, const std::string& b) {
+    std::vector<std::vector<size_t>> dp(a.length() + 1, std::vector<size_t>(b.length() + 1));
+    for (size_t ix = 0; ix <= a.length(); ix++) dp[ix][0] = ix;
+    for (size_t jx = 0; jx <= b.length(); jx++) dp[0][jx] = jx;
+    for (size_t ix = 1; ix <= a.length(); ix++) {
+        for (size_t jx = 1; jx <= b.length(); jx++) {
+            dp[ix][jx] = std::min({
+                dp[ix - 1][jx - 1] + (a[ix - 1] != b[jx - 1]),
+                dp[ix - 1][jx] + 1,
+                dp[ix][jx - 1] + 1
+            });
+        }
+    }
+    return dp[a.length()][b.length()];
+}
+
+// Apply random substitutions, insertions and deletions
+static std::string edit(std::mt19937& gen, std::string seq, size_t edits) {
+    static const char BASES[] = "ACGT";
+    std::uniform_int_distribution<int> kind(0, 2);
+    std::uniform_int_distribution<int> base(0, 3);
+    for (size_t ix = 0; ix < edits && !seq.empty(); ix++) {
+        std::uniform_int_distribution<size_t> pos(0, seq.length() - 1);
+        switch (kind(gen)) {
+            case 0: seq[pos(gen)] = BASES[base(gen)]; break;
+            case 1: seq.insert(seq.begin() + pos(gen), BASES[base(gen)]); break;
+            default: seq.erase(seq.begin() + pos(gen)); break;
+        }
+    }
+    return seq;
+}
+
+TEST_CASE("Myers edit distance agrees with the DP") {
+    std::mt19937 gen(42);
+    for (size_t ix = 0; ix < 2000; ix++) {
+        std::uniform_int_distribution<size_t> length(0, 70);
+        std::string a = random_sequence(length(gen), gen);
+        std::string b = (ix % 2) ? edit(gen, a, ix % 7) : random_sequence(length(gen), gen);
+        INFO(a << " / " << b);
+        REQUIRE(EditIndex::distance(a, b) == reference_distance(a, b));
+    }
+    CHECK(EditIndex::distance("", "ACG") == 3);
+    CHECK(EditIndex::distance("ACGT", "AGT") == 1);
+}
+
+TEST_CASE("EditIndex agrees with brute force") {
+    std::mt19937 gen(7);
+    for (size_t d : {1, 2, 3}) {
+        EditIndex index(d);
+        std::vector<std::string> stored;
+        for (size_t ix = 0; ix < 200; ix++) {
+            std::string seq = random_sequence(14, gen);
+            index.insert(seq);
+            stored.push_back(seq);
+        }
+
+        for (size_t ix = 0; ix < 2000; ix++) {
+            std::uniform_int_distribution<size_t> pick(0, stored.size() - 1);
+            std::uniform_int_distribution<size_t> edits(0, 4);
+            std::string query = edit(gen, stored[pick(gen)], edits(gen));
+
+            bool expected = false;
+            for (const std::string& seq : stored) {
+                if (reference_distance(seq, query) < d) {
+                    expected = true;
+                    break;
+                }
+            }
+            INFO("d = " << d << ", query = " << query);
+            REQUIRE(index.has_close(query) == expected);
+        }
+    }
+}
+
+TEST_CASE("BarcodeIndex rejects single indels with a minimum edit distance") {
+    BarcodeIndex index(1, 2);
+    CHECK(index.min_edit_distance() == 2);
+    index.insert("GACTTTCGAGTC");
+    // Deletion of the first base
+    CHECK(index.has_neighbor("ACTTTCGAGTC"));
+    // Insertion in the loop
+    CHECK(index.has_neighbor("GACTTTTCGAGTC"));
+    // One deletion and one insertion apart
+    CHECK(!index.has_neighbor("ACTTTCGAGTCA"));
+    CHECK(!index.has_neighbor("GACTGTGAAGTC"));
+}
+
+TEST_CASE("Barcodes generated with a minimum edit distance are separated") {
+    StemConfig config;
+    config.max_gc = 5;
+    std::mt19937 gen(3);
+    BarcodeIndex index(1, 3);
+    std::vector<std::string> barcodes;
+    _get_barcodes(200, 8, config, gen, index, barcodes, 2);
+    REQUIRE(barcodes.size() == 200);
+    for (size_t ix = 0; ix < barcodes.size(); ix++) {
+        for (size_t jx = ix + 1; jx < barcodes.size(); jx++) {
+            REQUIRE(reference_distance(barcodes[ix], barcodes[jx]) >= 3);
+        }
+    }
+}
@@ -0,0 +1,160 @@
+#include "doctest.hpp"
+#include "test_helpers.hpp"
+#include "io/fasta_io.hpp"
+#include <fstream>
+
+static std::string _write(const TempDir& tmpdir, const std::string& name, const std::string& contents) {
+    std::string path = tmpdir.path() + "/" + name;
+    std::ofstream file(path, std::ios::binary);
+    file << contents;
+    return path;
+}
+
+static std::vector<std::pair<std::string, std::string>> _records(const std::string& path) {
+    std::vector<std::pair<std::string, std::string>> records;
+    for_each_fasta_record(path, [&](const FastaRecord& record) {
+        records.push_back({std::string(record.name), std::string(record.sequence)});
+    });
+    return records;
+}
+
+TEST_CASE("FastaReader reads single and multi-line entries") {
+    TempDir tmpdir;
+    std::string path = _write(tmpdir, "mixed.fasta",
+        ">one\nACGT\n"
+        ">two words\nAC\nGT\n\nUU\n"
+        "\n>three\nGGGG");
+
+    auto records = _records(path);
+    REQUIRE(records.size() == 3);
+    CHECK(records[0] == std::pair<std::string, std::string>{"one", "ACGT"});
+    CHECK(records[1] == std::pair<std::string, std::string>{"two words", "ACGTUU"});
+    CHECK(records[2] == std::pair<std::string, std::string>{"three", "GGGG"});
+    CHECK(count_fasta_entries(path) == 3);
+}
+
+TEST_CASE("FastaReader views single-line sequences in place") {
+    TempDir tmpdir;
+    std::string path = _write(tmpdir, "single.fasta", ">a\nACGT\n>b\nAC\nGT\n");
+
+    FastaReader reader(path);
+    FastaRecord first;
+    REQUIRE(reader.next(first));
+    FastaRecord second;
+    REQUIRE(reader.next(second));
+    // The first sequence still reads correctly after the second, wrapped
+    // one is joined
+    CHECK(first.sequence == "ACGT");
+    CHECK(second.sequence == "ACGT");
+    FastaRecord none;
+    CHECK(!reader.next(none));
+    CHECK(!reader.next(none));
+}
+
+TEST_CASE("FastaReader keeps the edge cases of the line reader") {
+    TempDir tmpdir;
+
+    // An empty entry is kept, unless it is the last
+    auto records = _records(_write(tmpdir, "empty.fasta", ">a\n>b\nAC\n>c\n\n"));
+    REQUIRE(records.size() == 2);
+    CHECK(records[0].first == "a");
+    CHECK(records[0].second.empty());
+    CHECK(records[1].second == "AC");
+
+    // Carriage returns are left as they were
+    records = _records(_write(tmpdir, "crlf.fasta", ">a\r\nAC\r\n"));
+    REQUIRE(records.size() == 1);
+    CHECK(records[0].first == "a\r");
+    CHECK(records[0].second == "AC\r");
+
+    // Lines before the first header belong to no entry
+    records = _records(_write(tmpdir, "orphan.fasta", "GG\n>a\nAC\n"));
+    REQUIRE(records.size() == 1);
+    CHECK(records[0].second == "AC");
+
+    CHECK(_records(_write(tmpdir, "nothing.fasta", "")).empty());
+    CHECK(count_fasta_entries(tmpdir.path() + "/nothing.fasta") == 0);
+    CHECK_THROWS_AS(FastaReader(tmpdir.path() + "/missing.fasta"), std::runtime_error);
+}
+
+TEST_CASE("read_fasta matches the entries written") {
+    std::mt19937 gen(21);
+    TempDir tmpdir;
+    std::string path = tmpdir.path() + "/random.fasta";
+    std::vector<std::pair<std::string, std::string>> written;
+    for (size_t ix = 0; ix < 200; ix++) {
+        written.push_back({"seq" + std::to_string(ix), random_sequence(random_range(1, 80, gen), gen)});
+    }
+    write_fasta(path, written);
+
+    auto entries = read_fasta(path);
+    REQUIRE(entries.size() == written.size());
+    for (size_t ix = 0; ix < entries.size(); ix++) {
+        CHECK(entries[ix].name == written[ix].first);
+        CHECK(entries[ix].sequence == written[ix].second);
+    }
+    CHECK(_records(path) == written);
+    CHECK(count_fasta_entries(path) == 200);
+}
+
+TEST_CASE("split_fasta cuts chunks at headers") {
+    std::string text = "GG\n>a\nAC\nGT\n>b\n>c\nUU\n";
+    for (size_t bytes = 1; bytes <= text.size() + 1; bytes++) {
+        auto chunks = split_fasta(text, bytes);
+        std::string joined;
+        for (const FastaChunk& chunk : chunks) {
+            CHECK((joined.empty() || chunk.text[0] == '>'));
+            CHECK(chunk.ends_file == (&chunk == &chunks.back()));
+            joined += chunk.text;
+        }
+        CHECK(joined == text);
+    }
+    CHECK(split_fasta("", 4).empty());
+}
+
+TEST_CASE("for_each_fasta_chunk visits entries in order with their indices") {
+    std::mt19937 gen(22);
+    TempDir tmpdir;
+    std::string contents;
+    std::vector<std::pair<std::string, std::string>> expected;
+    for (size_t ix = 0; ix < 300; ix++) {
+        std::string name = "seq" + std::to_string(ix);
+        std::string seq = (ix % 17 == 5) ? "" : random_sequence(random_range(1, 60, gen), gen);
+        contents += ">" + name + "\n";
+        // Wrap some sequences, and leave blank lines between some entries
+        size_t width = (ix % 3 == 0) ? 20 : 60;
+        for (size_t pos = 0; pos < seq.size(); pos += width) {
+            contents += seq.substr(pos, width) + "\n";
+        }
+        if (ix % 7 == 0) contents += "\n";
+        expected.push_back({name, seq});
+    }
+    std::string path = _write(tmpdir, "chunked.fasta", contents);
+    REQUIRE(_records(path) == expected);
+
+    for (size_t threads : {1, 3}) {
+        for (size_t chunk_bytes : {1, 50, 1000, 1 << 20}) {
+            std::vector<std::vector<std::pair<size_t, std::string>>> slots(threads);
+            std::vector<std::pair<size_t, std::string>> seen;
+            for_each_fasta_chunk(path, threads, [&](size_t slot, const FastaChunk& chunk) {
+                slots[slot].clear();
+                FastaReader reader(chunk.text, chunk.ends_file);
+                FastaRecord record;
+                for (size_t index = chunk.first; reader.next(record); index++) {
+                    slots[slot].push_back({index, std::string(record.name)});
+                }
+            }, [&](size_t slot) {
+                seen.insert(seen.end(), slots[slot].begin(), slots[slot].end());
+            }, chunk_bytes);
+
+            CAPTURE(threads);
+            CAPTURE(chunk_bytes);
+            REQUIRE(seen.size() == expected.size());
+            for (size_t ix = 0; ix < seen.size(); ix++) {
+                CHECK(seen[ix].first == ix);
+                CHECK(seen[ix].second == expected[ix].first);
+            }
+        }
+        CHECK(count_fasta_entries(path, threads) == 300);
+    }
+}
@@ -0,0 +1,252 @@
+#include "doctest.hpp"
+#include "test_helpers.hpp"
+#include "fold_check.hpp"
+#include "library.hpp"
+#include "preprocess.hpp"
+#include "domain/fold.hpp"
+#include "domain/hairpin.hpp"
+#include "domain/padding.hpp"
+#include "io/csv_format.hpp"
+
+static bool _canonical_pair(char a, char b) {
+    std::string pair = {a, b};
+    for (const char* canonical : {"AU", "UA", "GC", "CG", "GU", "UG"}) {
+        if (pair == canonical) return true;
+    }
+    return false;
+}
+
+// Call visit on every structure of a sequence with canonical pairs that
+// close at least three unpaired bases and span at most max_span bases
+static void _enumerate(
+    const std::string& seq,
+    size_t max_span,
+    std::vector<size_t>& partners,
+    std::vector<std::pair<size_t, size_t>>& intervals,
+    const std::function<void()>& visit
+) {
+    if (intervals.empty()) {
+        visit();
+        return;
+    }
+    auto [begin, end] = intervals.back();
+    intervals.pop_back();
+    if (begin >= end) {
+        _enumerate(seq, max_span, partners, intervals, visit);
+    } else {
+        intervals.push_back({begin + 1, end});
+        _enumerate(seq, max_span, partners, intervals, visit);
+        intervals.pop_back();
+        for (size_t pair = begin + 4; pair < end && pair - begin <= max_span; pair++) {
+            if (!_canonical_pair(seq[begin], seq[pair])) continue;
+            partners[begin] = pair;
+            partners[pair] = begin;
+            intervals.push_back({pair + 1, end});
+            intervals.push_back({begin + 1, pair});
+            _enumerate(seq, max_span, partners, intervals, visit);
+            intervals.pop_back();
+            intervals.pop_back();
+            partners[begin] = FoldEngine::NO_PARTNER;
+            partners[pair] = FoldEngine::NO_PARTNER;
+        }
+    }
+    intervals.push_back({begin, end});
+}
+
+TEST_CASE("FoldEngine finds the lowest energy of every structure") {
+    std::mt19937 gen(20);
+    for (size_t trial = 0; trial < 40; trial++) {
+        std::string seq = random_sequence(random_range(6, 16, gen), gen);
+        for (char& c : seq) {
+            if (c == 'T') c = 'U';
+        }
+        size_t max_span = (trial % 2) ? 8 : 100;
+        FoldEngine engine(max_span);
+        int mfe = engine.fold(seq);
+
+        int best = 0;
+        std::vector<size_t> partners(seq.size(), FoldEngine::NO_PARTNER);
+        std::vector<std::pair<size_t, size_t>> intervals = {{0, seq.size()}};
+        _enumerate(seq, max_span, partners, intervals, [&]() {
+            if (auto energy = engine.energy(seq, partners)) {
+                best = std::min(best, *energy);
+            }
+        });
+
+        CAPTURE(seq);
+        CHECK(mfe == best);
+        CHECK(engine.energy(seq, engine.partners()) == mfe);
+    }
+}
+
+TEST_CASE("FoldEngine folds a stable hairpin") {
+    FoldEngine engine;
+    // Three GC on GC stacks and a hairpin of four
+    CHECK(engine.fold("GGGGAAAACCCC") == -498);
+    for (size_t k = 0; k < 4; k++) {
+        CHECK(engine.partner(k) == 11 - k);
+    }
+    CHECK(engine.formed({0, 11, 4}) == 4);
+
+    // Nothing pairs with A, or with an unknown base
+    CHECK(engine.fold("AAAAAAAAAAAA") == 0);
+    CHECK(engine.fold("GGGGNNNNNNNN") == 0);
+    CHECK(engine.partner(0) == FoldEngine::NO_PARTNER);
+    CHECK(engine.fold("") == 0);
+
+    // DNA and lower-case fold as RNA
+    CHECK(engine.fold("ggggaaaacccc") == -498);
+    CHECK(engine.fold("GGGGTTTTCCCC") == -498);
+}
+
+TEST_CASE("FoldEngine keeps pairs within the span") {
+    FoldEngine engine(8);
+    engine.fold("GGGGAAAACCCC");
+    for (size_t k = 0; k < 12; k++) {
+        if (engine.partner(k) != FoldEngine::NO_PARTNER) {
+            CHECK(std::max(k, engine.partner(k)) - std::min(k, engine.partner(k)) <= 8);
+        }
+    }
+    CHECK_THROWS_AS(FoldEngine(4), std::invalid_argument);
+}
+
+TEST_CASE("padding_helices finds the hairpins of generated padding") {
+    std::mt19937 gen(21);
+    StemConfig config = StemConfig::for_padding();
+    for (size_t trial = 0; trial < 200; trial++) {
+        size_t length = random_range(0, 120, gen);
+        std::string padding = get_padding(length, config, gen);
+        std::vector<Helix> helices;
+        padding_helices(padding, config, 5, helices);
+
+        // Hairpins follow one another with a spacer in between, until
+        // there is no room for another
+        size_t pos = 0;
+        for (const Helix& helix : helices) {
+            CHECK(helix.five == pos + 5);
+            CHECK(helix.three == helix.five + Hairpin::length_for(helix.length) - 1);
+            CHECK(helix.length >= config.min_length);
+            CHECK(helix.length <= config.max_length);
+            pos += Hairpin::length_for(helix.length) + config.spacer_length;
+        }
+        CHECK(length - pos < Hairpin::length_for(config.min_length) + config.spacer_length);
+    }
+
+    std::vector<Helix> helices;
+    padding_helices("AAAAAAAAAAAAAAAAAAAAAAAAAAAAAA", config, 0, helices);
+    CHECK(helices.empty());
+}
+
+TEST_CASE("hairpin_helix recognises a single hairpin") {
+    std::mt19937 gen(22);
+    std::string hairpin = Hairpin::random(8, StemConfig::for_padding(), gen).str();
+    auto helix = hairpin_helix(hairpin, 3);
+    REQUIRE(helix.has_value());
+    CHECK(helix->five == 3);
+    CHECK(helix->three == 3 + hairpin.size() - 1);
+    CHECK(helix->length == 8);
+
+    CHECK(!hairpin_helix("AAAAAAAAAAAA", 0).has_value());
+    CHECK(!hairpin_helix(hairpin.substr(1), 0).has_value());
+    CHECK(!hairpin_helix("", 0).has_value());
+}
+
+TEST_CASE("Designed hairpins fold on their own") {
+    std::mt19937 gen(23);
+    StemConfig config = StemConfig::for_padding();
+    FoldEngine engine;
+    for (size_t trial = 0; trial < 50; trial++) {
+        std::string padding = get_padding(random_range(20, 100, gen), config, gen);
+        std::vector<Helix> helices;
+        padding_helices(padding, config, 0, helices);
+        engine.fold(padding);
+        for (const Helix& helix : helices) {
+            CHECK(engine.formed(helix) == helix.length);
+        }
+    }
+}
+
+TEST_CASE("fold-check flags padding that pairs with its design") {
+    std::mt19937 gen(24);
+    TempDir tmpdir;
+    std::string library_path = tmpdir.path() + "/library.csv";
+    std::string report_path = tmpdir.path() + "/report.csv";
+
+    StemConfig config = StemConfig::for_padding();
+    std::string hairpin = Hairpin::random(8, config, gen).str();
+    std::string padding = hairpin + "AA";
+    std::string complement = hairpin;
+    std::reverse(complement.begin(), complement.end());
+    for (char& c : complement) {
+        c = (c == 'A') ? 'U' : (c == 'U' || c == 'T') ? 'A' : (c == 'G') ? 'C' : 'G';
+    }
+
+    {
+        std::ofstream file(library_path);
+        file << csv::header() << "\n";
+        file << "1,plain,,," << padding << ",AAAAAAAAAAAAAAAAAAAAAA,,,," << "\n";
+        file << "2,paired,,," << padding << "," << complement << ",,,," << "\n";
+    }
+
+    FoldCheckStats stats = _fold_check(library_path, report_path, false, config, 100, 2);
+    CHECK(stats.constructs == 2);
+    CHECK(stats.hairpins == 2);
+    CHECK(stats.misfolded_hairpins == 1);
+    CHECK(stats.misfolded_constructs == 1);
+
+    std::ifstream report(report_path);
+    std::string line;
+    std::getline(report, line);
+    CHECK(line == "index,name,element,position,stem_length,pairs_formed");
+    std::getline(report, line);
+    CHECK(line.rfind("2,paired,five_padding,1,8,", 0) == 0);
+    CHECK(!std::getline(report, line));
+
+    CHECK_THROWS(_fold_check(library_path, report_path, false, config, 100, 1));
+    CHECK_THROWS_AS(_fold_check(library_path, "", false, config, 3, 1), std::invalid_argument);
+}
+
+TEST_CASE("design with the fold check keeps padding that folds") {
+    std::mt19937 gen(25);
+    TempDir tmpdir;
+    std::string fasta_path = tmpdir.path() + "/input.fasta";
+    std::string csv_path = tmpdir.path() + "/preprocessed.csv";
+    write_random_fasta(fasta_path, 300, 40, gen);
+    _preprocess(fasta_path, csv_path, true, "test");
+
+    DesignConfig config;
+    config.input_path = csv_path;
+    config.overwrite = true;
+    config.pad_to_length = 70;
+    config.seed = 20;
+    config.fold_check = true;
+
+    auto design = [&](const std::string& name, size_t threads) {
+        config.output_prefix = tmpdir.path() + "/" + name;
+        config.threads = threads;
+        _design(config);
+        std::ifstream file(config.output_prefix + ".csv");
+        return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    };
+    std::string serial = design("serial", 1);
+    CHECK(serial == design("parallel", 3));
+
+    FoldEngine engine;
+    std::vector<Helix> helices;
+    size_t folded = 0;
+    std::ifstream file(tmpdir.path() + "/serial.csv");
+    std::string line;
+    std::getline(file, line);
+    csv::Header header(line);
+    while (std::getline(file, line)) {
+        std::vector<std::string> fields = _split_by_delimiter(line, ',');
+        std::string padding = header.get(fields, csv::COL_FIVE_PADDING);
+        helices.clear();
+        padding_helices(padding, config.stem, 0, helices);
+        engine.fold(padding + header.get(fields, csv::COL_DESIGN));
+        folded += std::all_of(helices.begin(), helices.end(), [&](const Helix& helix) {
+            return engine.formed(helix) == helix.length;
+        });
+    }
+    CHECK(folded == 300);
+}
@@ -77,3 +77,62 @@ TEST_CASE("Hairpin stem forms valid base pairs") {
         CHECK((is_au || is_gc || is_gu));
     }
 }
+
+TEST_CASE("Hairpins are the same as before hairpins were written in place") {
+    std::mt19937 gen(7);
+    StemConfig config = StemConfig::for_padding();
+    CHECK(Hairpin::random(5, config, gen).str() == "CTGTAGTGATACAG");
+    CHECK(Hairpin::random(6, config, gen).str() == "GTCCATTTCGATGGAC");
+}
+
+TEST_CASE("Writing a hairpin in place draws as Hairpin::random") {
+    StemConfig limited;
+    limited.max_au = 3;
+    limited.max_gc = 4;
+    limited.max_gu = 2;
+    limited.closing_gc = 2;
+
+    for (const StemConfig& config : {StemConfig::for_padding(), StemConfig::for_barcode(8), limited}) {
+        std::mt19937 gen(5);
+        std::mt19937 in_place_gen(5);
+        std::string buffer;
+        for (size_t stem_length = 4; stem_length <= 9; stem_length++) {
+            buffer.assign(Hairpin::length_for(stem_length), '\0');
+            Hairpin::write_random(stem_length, config, in_place_gen, buffer);
+            CHECK(buffer == Hairpin::random(stem_length, config, gen).str());
+        }
+    }
+}
+
+TEST_CASE("Writing a hairpin keeps to the pair budgets") {
+    std::mt19937 gen(3);
+    StemConfig config;
+    config.max_au = 2;
+    config.max_gc = 3;
+    config.max_gu = 2;
+    config.closing_gc = 1;
+
+    std::string buffer(Hairpin::length_for(7), '\0');
+    for (size_t trial = 0; trial < 200; trial++) {
+        Hairpin::write_random(7, config, gen, buffer);
+        size_t au = 0, gc = 0, gu = 0;
+        for (size_t ix = 0; ix < 7; ix++) {
+            char five = buffer[ix];
+            char three = buffer[buffer.size() - ix - 1];
+            au += BasePair::is_au(five, three);
+            gc += BasePair::is_gc(five, three);
+            gu += BasePair::is_gu(five, three);
+        }
+        CHECK(au + gc + gu == 7);
+        CHECK(au <= 2);
+        CHECK(gc <= 3);
+        CHECK(gu <= 2);
+        CHECK(BasePair::is_gc(buffer[0], buffer.back()));
+    }
+
+    // Seven pairs cannot fit in budgets of six
+    config.max_gu = 1;
+    CHECK_THROWS_AS(Hairpin::write_random(7, config, gen, buffer), std::invalid_argument);
+    std::string short_buffer(10, '\0');
+    CHECK_THROWS_AS(Hairpin::write_random(7, config, gen, short_buffer), std::invalid_argument);
+}
@@ -0,0 +1,119 @@
+#include "doctest.hpp"
+#include "test_helpers.hpp"
+#include "barcodes.hpp"
+#include "domain/barcode_index.hpp"
+#include "domain/hairpin.hpp"
+#include "domain/hamming_index.hpp"
+#include <algorithm>
+#include <random>
+
+static size_t hamming(const std::string& a, const std::string& b) {
+    size_t distance = 0;
+    for (size_t ix = 0; ix < a.length(); ix++) {
+        if (a[ix] != b[ix]) distance++;
+    }
+    return distance;
+}
+
+// Mutate a sequence at the given number of distinct positions
+static std::string mutate(std::mt19937& gen, std::string seq, size_t mutations) {
+    std::vector<size_t> positions(seq.length());
+    for (size_t ix = 0; ix < positions.size(); ix++) positions[ix] = ix;
+    std::shuffle(positions.begin(), positions.end(), gen);
+    std::uniform_int_distribution<int> shift(1, 3);
+    static const std::string BASES = "ACGT";
+    for (size_t ix = 0; ix < mutations; ix++) {
+        char& c = seq[positions[ix]];
+        c = BASES[(BASES.find(c) + shift(gen)) % 4];
+    }
+    return seq;
+}
+
+TEST_CASE("HammingIndex agrees with brute force") {
+    std::mt19937 gen(42);
+    StemConfig config;
+    for (auto [d, hairpins] : std::vector<std::pair<size_t, bool>>{
+             {1, false}, {2, false}, {3, false}, {4, false},
+             {2, true}, {3, true}, {4, true}}) {
+        HammingIndex index(d, hairpins);
+        std::vector<std::string> stored;
+        for (size_t ix = 0; ix < 200; ix++) {
+            std::string seq = hairpins
+                ? Hairpin::random(4, config, gen).str()
+                : random_sequence(12, gen);
+            index.insert(seq);
+            stored.push_back(seq);
+        }
+
+        for (size_t ix = 0; ix < 2000; ix++) {
+            // Queries near stored sequences exercise the close cases
+            std::uniform_int_distribution<size_t> pick(0, stored.size() - 1);
+            std::uniform_int_distribution<size_t> mutations(0, 5);
+            std::string query = mutate(gen, stored[pick(gen)], mutations(gen));
+
+            bool expected = false;
+            for (const std::string& seq : stored) {
+                if (hamming(seq, query) < d) {
+                    expected = true;
+                    break;
+                }
+            }
+            INFO("d = " << d << ", hairpins = " << hairpins << ", query = " << query);
+            REQUIRE(index.has_close(query) == expected);
+        }
+    }
+}
+
+TEST_CASE("HammingIndex keeps hairpin buckets small") {
+    std::mt19937 gen(7);
+    StemConfig config;
+    for (size_t d : {2, 3, 4}) {
+        HammingIndex index(d, true);
+        const size_t count = 4000;
+        for (size_t ix = 0; ix < count; ix++) {
+            index.insert(Hairpin::random(10, config, gen).str());
+        }
+        INFO("d = " << d << ", largest bucket = " << index.largest_bucket());
+        CHECK(index.largest_bucket() <= count / 8);
+    }
+}
+
+TEST_CASE("HammingIndex ignores sequences of other lengths") {
+    HammingIndex index(2);
+    index.insert("ACGTACGT");
+    CHECK(index.has_close("ACGTACGA"));
+    CHECK(!index.has_close("ACGTACG"));
+    CHECK(!index.has_close("ACGTACGTA"));
+}
+
+TEST_CASE("HammingIndex rejects a zero distance") {
+    CHECK_THROWS_AS(HammingIndex(0), std::invalid_argument);
+    CHECK_THROWS_AS(BarcodeIndex(0), std::invalid_argument);
+}
+
+TEST_CASE("BarcodeIndex enforces a minimum distance") {
+    BarcodeIndex index(3);
+    CHECK(index.min_distance() == 3);
+    index.insert("GACTTTCGAGTC");
+    CHECK(index.has_neighbor("GACTTTCGAGTC"));
+    // Two substitutions of any kind are too close
+    CHECK(index.has_neighbor("TACTTTCGAGTA"));
+    CHECK(!index.has_neighbor("TTCTTTCGAGTA"));
+}
+
+TEST_CASE("Barcodes generated with a minimum distance are separated") {
+    StemConfig config;
+    config.max_gc = 5;
+    for (size_t threads : {1, 3}) {
+        std::mt19937 gen(11);
+        BarcodeIndex index(3);
+        std::vector<std::string> barcodes;
+        _get_barcodes(300, 8, config, gen, index, barcodes, threads);
+        REQUIRE(barcodes.size() == 300);
+        for (size_t ix = 0; ix < barcodes.size(); ix++) {
+            for (size_t jx = ix + 1; jx < barcodes.size(); jx++) {
+                REQUIRE(hamming(barcodes[ix], barcodes[jx]) >= 3);
+            }
+        }
+    }
+}
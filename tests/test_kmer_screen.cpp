@@ -0,0 +1,143 @@
+#include "doctest.hpp"
+#include "test_helpers.hpp"
+#include "barcodes.hpp"
+#include "library.hpp"
+#include "preprocess.hpp"
+#include "domain/kmer_screen.hpp"
+#include "domain/padding.hpp"
+
+// Every k-mer of the sequence, on both strands
+static bool shares_kmer(const std::string& seq, const std::vector<std::string>& others, size_t k) {
+    auto revcomp = [](std::string s) {
+        std::reverse(s.begin(), s.end());
+        for (char& c : s) {
+            c = (c == 'A') ? 'T' : (c == 'C') ? 'G' : (c == 'G') ? 'C' : 'A';
+        }
+        return s;
+    };
+    for (size_t ix = 0; ix + k <= seq.length(); ix++) {
+        std::string kmer = seq.substr(ix, k);
+        for (const std::string& other : others) {
+            if (other.find(kmer) != std::string::npos ||
+                other.find(revcomp(kmer)) != std::string::npos) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+TEST_CASE("K-mer screens find shared k-mers on either strand") {
+    KmerScreen screen(8);
+    CHECK_FALSE(screen.hits("ACGTACGTACGT"));
+    screen.add("GGGAAACCCTTTAGC");
+    CHECK(screen.size() == 8);
+
+    CHECK(screen.hits("GGGAAACC"));
+    CHECK(screen.hits("TTTTTCCCTTTAGCTTTT"));
+    CHECK(screen.hits("GGTTTCCC"));  // Reverse complement of GGGAAACC
+    CHECK(screen.hits("GGGUUUCC"));  // U reads as T
+    CHECK_FALSE(screen.hits("GGGAAAC"));  // Too short
+    CHECK_FALSE(screen.hits("GGGANACC"));
+    CHECK_FALSE(screen.hits("CACACACACACA"));
+
+    KmerScreen broken(4);
+    broken.add("ACGNTTGA");
+    CHECK(broken.size() == 1);
+    CHECK(broken.hits("TTGA"));
+    CHECK_FALSE(broken.hits("CGNT"));
+
+    CHECK_THROWS_AS(KmerScreen(0), std::invalid_argument);
+    CHECK_THROWS_AS(KmerScreen(33), std::invalid_argument);
+}
+
+TEST_CASE("K-mer screens stay exact as they grow") {
+    std::mt19937 gen(11);
+    std::vector<std::string> sequences;
+    for (size_t ix = 0; ix < 2000; ix++) {
+        sequences.push_back(random_sequence(60, gen));
+    }
+    KmerScreen screen(32);
+    for (const std::string& seq : sequences) {
+        screen.add(seq);
+    }
+    CHECK(screen.size() > 50000);
+    for (const std::string& seq : sequences) {
+        CHECK(screen.hits(seq.substr(10, 32)));
+    }
+    size_t false_hits = 0;
+    for (size_t ix = 0; ix < 2000; ix++) {
+        false_hits += screen.hits(random_sequence(32, gen));
+    }
+    CHECK(false_hits == 0);
+}
+
+TEST_CASE("Screened barcodes and padding avoid the screen") {
+    std::mt19937 gen(5);
+    std::vector<std::string> designs;
+    KmerScreen screen(6);
+    for (size_t ix = 0; ix < 5; ix++) {
+        designs.push_back(random_sequence(40, gen));
+        screen.add(designs.back());
+    }
+
+    BarcodeIndex index;
+    std::vector<std::string> barcodes;
+    _get_barcodes(200, 6, StemConfig::for_barcode(6), gen, index, barcodes, 1, &screen);
+    _get_barcodes(200, 6, StemConfig::for_barcode(6), gen, index, barcodes, 3, &screen);
+    REQUIRE(barcodes.size() == 400);
+    for (const std::string& barcode : barcodes) {
+        CHECK_FALSE(screen.hits(barcode));
+    }
+
+    // A single disordered segment, and a single hairpin of stem 7 with its
+    // poly-A spacer, which is not screened
+    StemConfig padding = StemConfig::for_padding();
+    for (size_t ix = 0; ix < 20; ix++) {
+        std::string disordered = get_padding(19, padding, gen, &screen);
+        CHECK(disordered.length() == 19);
+        CHECK_FALSE(screen.hits(disordered));
+
+        std::string hairpin = get_padding(20, padding, gen, &screen);
+        CHECK(hairpin.substr(18) == "AA");
+        CHECK_FALSE(screen.hits(hairpin.substr(0, 18)));
+    }
+}
+
+TEST_CASE("design --screen-kmer keeps barcodes off the designs and primers") {
+    std::mt19937 gen(13);
+    TempDir tmpdir;
+    std::string fasta_path = tmpdir.path() + "/input.fasta";
+    std::string csv_path = tmpdir.path() + "/preprocessed.csv";
+    std::string output_prefix = tmpdir.path() + "/output";
+
+    write_random_fasta(fasta_path, 50, 80, gen);
+    _preprocess(fasta_path, csv_path, true, "test");
+
+    DesignConfig config;
+    config.input_path = csv_path;
+    config.output_prefix = output_prefix;
+    config.overwrite = true;
+    config.pad_to_length = 80;
+    config.skip_padding = true;
+    config.barcode.stem_length = 8;
+    config.barcode.stem = config.stem;
+    config.screen_kmer = 8;
+    _design(config);
+
+    std::ifstream file(output_prefix + ".csv");
+    std::string line;
+    std::getline(file, line);
+    std::vector<std::string> designs = {config.five_const, config.three_const};
+    std::vector<std::string> barcodes;
+    while (std::getline(file, line)) {
+        std::vector<std::string> parts = _split_by_delimiter(line, ',');
+        REQUIRE(parts.size() >= 9);
+        designs.push_back(parts[5]);
+        barcodes.push_back(parts[7]);
+    }
+    REQUIRE(barcodes.size() == 50);
+    for (const std::string& barcode : barcodes) {
+        CHECK_FALSE(shares_kmer(barcode, designs, 8));
+    }
+}
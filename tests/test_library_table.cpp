@@ -0,0 +1,338 @@
+#include "doctest.hpp"
+#include "test_helpers.hpp"
+#include "library.hpp"
+#include "merge.hpp"
+#include "preprocess.hpp"
+#include "sort.hpp"
+#include "config/design_config.hpp"
+#include "io/csv_format.hpp"
+#include "io/library_table.hpp"
+#include "io/writers.hpp"
+#include <filesystem>
+
+// Every row of a library CSV or table, as text
+static std::vector<std::vector<std::string>> read_rows(const std::string& path) {
+    LibraryRows rows(path);
+    rows.projection().add_all();
+    size_t columns = rows.header().size();
+    std::vector<std::vector<std::string>> out;
+    while (rows.next()) {
+        auto fields = rows.fields().first(columns);
+        out.emplace_back(fields.begin(), fields.end());
+    }
+    return out;
+}
+
+static void write_lines(const std::string& path, const std::vector<std::string>& lines) {
+    std::ofstream file(path);
+    for (const auto& line : lines) {
+        file << line << "\n";
+    }
+}
+
+TEST_CASE("Library tables round-trip every kind of column") {
+    TempDir tmpdir;
+    std::string path = tmpdir.path() + "/library.fldb";
+    std::vector<std::string> columns = {
+        "index", "name", "design", "barcode", "begin", "reads", "note"
+    };
+    std::vector<std::vector<std::string>> rows = {
+        {"1", "first", "ACGTACGTACGTACGTACGTACGTACGTACGTACGT", "GGCC", "0", "12.5", "a,b"},
+        {"2", "second", "acgUNNRY", "", "18446744073709551615", "3", "\"quoted\""},
+        {"10", "first", "ACGU", "TTTT", "7", "1e+07", ""},
+        {"3", "", "", "ACGT-", "12", "0.333333", "first"},
+    };
+
+    {
+        LibraryTableWriter writer(path, columns);
+        std::vector<std::string_view> fields;
+        for (const auto& row : rows) {
+            fields.assign(row.begin(), row.end());
+            writer.add(fields);
+        }
+        writer.close();
+    }
+
+    CHECK(is_library_table(path));
+    LibraryTable table(path);
+    REQUIRE(table.rows() == rows.size());
+    REQUIRE(table.columns() == columns.size());
+    CHECK(table.header().column_names() == columns);
+    CHECK(table.kind(0) == LibraryTable::Kind::Integer);
+    CHECK(table.kind(1) == LibraryTable::Kind::String);
+    CHECK(table.kind(2) == LibraryTable::Kind::Sequence);
+    CHECK(table.kind(3) == LibraryTable::Kind::Sequence);
+    CHECK(table.kind(4) == LibraryTable::Kind::Integer);
+    CHECK(table.kind(5) == LibraryTable::Kind::Real);
+    CHECK(table.kind(6) == LibraryTable::Kind::String);
+
+    std::string field;
+    for (size_t row = 0; row < rows.size(); row++) {
+        for (size_t column = 0; column < columns.size(); column++) {
+            field.clear();
+            table.append_field(row, column, field);
+            CHECK(field == rows[row][column]);
+        }
+        CHECK(table.sequence_length(row, 2) == rows[row][2].size());
+        CHECK(table.text(row, 1) == rows[row][1]);
+    }
+}
+
+TEST_CASE("Library tables keep numbers that do not read back exactly as text") {
+    TempDir tmpdir;
+    std::string path = tmpdir.path() + "/library.fldb";
+    {
+        LibraryTableWriter writer(path, {"index", "begin", "reads"});
+        std::vector<std::string_view> first = {"007", "1.5", "0.1234567"};
+        std::vector<std::string_view> second = {"8", "2", "1"};
+        writer.add(first);
+        writer.add(second);
+    }
+
+    LibraryTable table(path);
+    CHECK(table.kind(0) == LibraryTable::Kind::String);
+    CHECK(table.kind(1) == LibraryTable::Kind::Real);
+    CHECK(table.kind(2) == LibraryTable::Kind::String);
+    std::string field;
+    table.append_field(0, 0, field);
+    CHECK(field == "007");
+    field.clear();
+    table.append_field(0, 2, field);
+    CHECK(field == "0.1234567");
+}
+
+TEST_CASE("Library tables stream many rows and leave no spills behind") {
+    TempDir tmpdir;
+    std::string path = tmpdir.path() + "/library.fldb";
+    // More distinct names than the writer deduplicates, then repeats, and
+    // an index that stops being an integer on the last row
+    const size_t rows = 70000;
+    auto name = [](size_t row) { return "name" + std::to_string(row % (rows - 100)); };
+    auto index = [](size_t row) { return (row + 1 == rows) ? std::string("last") : std::to_string(row); };
+    {
+        LibraryTableWriter writer(path, {"index", "name", "design", "reads"});
+        for (size_t row = 0; row < rows; row++) {
+            std::string fields[] = {index(row), name(row), std::string(row % 40, "ACGU"[row % 4]), std::to_string(row % 7)};
+            std::vector<std::string_view> views(std::begin(fields), std::end(fields));
+            writer.add(views);
+        }
+    }
+    CHECK(std::distance(std::filesystem::directory_iterator(tmpdir.path()), {}) == 1);
+
+    LibraryTable table(path);
+    REQUIRE(table.rows() == rows);
+    CHECK(table.kind(0) == LibraryTable::Kind::String);
+    CHECK(table.kind(1) == LibraryTable::Kind::String);
+    CHECK(table.kind(3) == LibraryTable::Kind::Integer);
+    std::string field;
+    for (size_t row = 0; row < rows; row += 997) {
+        CHECK(table.text(row, 0) == index(row));
+        CHECK(table.text(row, 1) == name(row));
+        CHECK(table.sequence_length(row, 2) == row % 40);
+        field.clear();
+        table.append_field(row, 3, field);
+        CHECK(field == std::to_string(row % 7));
+    }
+    CHECK(table.text(rows - 1, 0) == "last");
+    CHECK(table.text(rows - 1, 1) == name(rows - 1));
+}
+
+TEST_CASE("Library tables reject other and truncated files") {
+    TempDir tmpdir;
+    std::string csv_path = tmpdir.path() + "/library.csv";
+    write_lines(csv_path, {"index,name,design", "1,a,ACGT"});
+    CHECK(!is_library_table(csv_path));
+    CHECK_THROWS_AS(LibraryTable{csv_path}, std::runtime_error);
+
+    std::string path = tmpdir.path() + "/library.fldb";
+    {
+        LibraryTableWriter writer(path, {"index", "design"});
+        std::vector<std::string_view> fields = {"1", "ACGTACGT"};
+        writer.add(fields);
+    }
+    std::filesystem::resize_file(path, std::filesystem::file_size(path) - 8);
+    CHECK(is_library_table(path));
+    CHECK_THROWS_AS(LibraryTable{path}, std::runtime_error);
+}
+
+// Overwrite a uint64_t of a file in place
+static void patch(const std::string& path, size_t at, uint64_t value) {
+    std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+    file.seekp(static_cast<std::streamoff>(at));
+    file.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+static uint64_t read_u64(const std::string& path, size_t at) {
+    std::ifstream file(path, std::ios::binary);
+    file.seekg(static_cast<std::streamoff>(at));
+    uint64_t value = 0;
+    file.read(reinterpret_cast<char*>(&value), sizeof(value));
+    return value;
+}
+
+TEST_CASE("Library tables reject corrupt sections and counts") {
+    TempDir tmpdir;
+    std::string original = tmpdir.path() + "/original.fldb";
+    {
+        LibraryTableWriter writer(original, {"name", "design"});
+        std::vector<std::string_view> first = {"a", "ACGTNCGTACGT"};
+        std::vector<std::string_view> second = {"b", "ACNT"};
+        writer.add(first);
+        writer.add(second);
+    }
+    REQUIRE_NOTHROW(LibraryTable{original});
+
+    // The header, then a directory entry of 32 bytes per column, whose
+    // name offset and section offset are the second and third uint64_t
+    size_t directory = 24;
+    uint64_t name_section = read_u64(original, directory + 8 + 8);
+    uint64_t design_section = read_u64(original, directory + 32 + 8 + 8);
+    // Past the counts of each section: string offsets, and sequence starts
+    // then one word of bases then exception positions
+    uint64_t offsets = name_section + 16;
+    uint64_t starts = design_section + 16;
+    uint64_t exceptions = starts + 3 * 8 + 8;
+
+    auto check_rejected = [&](size_t at, uint64_t value) {
+        std::string path = tmpdir.path() + "/patched.fldb";
+        std::filesystem::copy_file(original, path, std::filesystem::copy_options::overwrite_existing);
+        patch(path, at, value);
+        CAPTURE(at);
+        CHECK_THROWS_AS(LibraryTable{path}, std::runtime_error);
+    };
+
+    // Columns and name offsets that overflow the bounds arithmetic
+    check_rejected(8, uint64_t(0xffffffff) | (uint64_t(2) << 32));
+    check_rejected(directory + 8, uint64_t(-1));
+    check_rejected(16, uint64_t(-1));
+    // Starts out of order, and exceptions past the end or out of order
+    check_rejected(starts + 8, 17);
+    check_rejected(exceptions, 16);
+    check_rejected(exceptions + 8, 3);
+    // String offsets out of order
+    check_rejected(offsets, 2);
+}
+
+TEST_CASE("Library rows read CSV files and tables alike") {
+    TempDir tmpdir;
+    std::string csv_path = tmpdir.path() + "/library.csv";
+    write_lines(csv_path, {"index,name,design", "1,a,ACGT", "", "2,b,GGNN"});
+
+    std::string table_path = tmpdir.path() + "/library.fldb";
+    {
+        LibraryTableWriter writer(table_path, {"index", "name", "design"});
+        std::vector<std::string_view> first = {"1", "a", "ACGT"};
+        std::vector<std::string_view> second = {"2", "b", "GGNN"};
+        writer.add(first);
+        writer.add(second);
+    }
+
+    for (const auto& path : {csv_path, table_path}) {
+        LibraryRows rows(path);
+        CHECK(rows.is_table() == (path == table_path));
+        size_t design = rows.projection().add(csv::COL_DESIGN);
+        size_t barcode = rows.projection().add(csv::COL_BARCODE);
+        std::vector<std::string> designs;
+        while (rows.next()) {
+            designs.emplace_back(rows[design]);
+            CHECK(!rows.has(barcode));
+            CHECK(rows.get(barcode, "none") == "none");
+        }
+        CHECK(designs == std::vector<std::string>{"ACGT", "GGNN"});
+    }
+}
+
+TEST_CASE("design writes the same library to a table as to CSV") {
+    std::mt19937 gen(25);
+    TempDir tmpdir;
+    std::string fasta_path = tmpdir.path() + "/input.fasta";
+    std::string csv_path = tmpdir.path() + "/preprocessed.csv";
+    write_random_fasta(fasta_path, 1500, 60, gen);
+    _preprocess(fasta_path, csv_path, true, "test");
+
+    DesignConfig config;
+    config.input_path = csv_path;
+    config.overwrite = true;
+    config.pad_to_length = 80;
+    config.barcode.stem_length = 8;
+    config.barcode.stem = config.stem;
+    config.seed = 25;
+
+    for (size_t chunk_size : {0, 512}) {
+        config.chunk_size = chunk_size;
+        config.output_prefix = tmpdir.path() + "/text";
+        config.table_output = false;
+        _design(config);
+        config.output_prefix = tmpdir.path() + "/table";
+        config.table_output = true;
+        _design(config);
+
+        CHECK(!std::filesystem::exists(output_csv(config.output_prefix)));
+        CHECK(!std::filesystem::exists(output_fasta(config.output_prefix)));
+        auto text = read_rows(output_csv(tmpdir.path() + "/text"));
+        REQUIRE(text.size() == 1500);
+        CHECK(read_rows(output_fldb(config.output_prefix)) == text);
+
+        // A table reads back into the same library as the CSV
+        Library library = _from_csv(output_fldb(config.output_prefix));
+        std::string reread = output_csv(tmpdir.path() + "/reread_" + std::to_string(chunk_size));
+        library.to_csv(reread);
+        CHECK(read_rows(reread) == text);
+    }
+}
+
+TEST_CASE("merge and sort read and write tables as they do CSV") {
+    std::mt19937 gen(26);
+    TempDir tmpdir;
+    std::string csv_path = tmpdir.path() + "/library.csv";
+    std::vector<std::string> lines = {"index,name,sublibrary,five_const,five_padding,design,three_padding,barcode,three_const"};
+    std::vector<std::string> reads;
+    std::vector<std::string> barcodes;
+    std::vector<std::string> barcode_reads;
+    for (size_t ix = 1; ix <= 200; ix++) {
+        lines.push_back(std::to_string(ix) + ",seq_" + std::to_string(ix) + "," +
+            (ix % 3 ? "a" : "b") + ",,," + random_sequence(random_range(20, 40, gen), gen) + ",,,");
+        reads.push_back(std::to_string(random_range(1, 1000, gen)) + ".25");
+    }
+    for (size_t ix = 0; ix < 250; ix++) {
+        barcodes.push_back(random_sequence(12, gen));
+        barcode_reads.push_back(std::to_string(random_range(1, 1000, gen)));
+    }
+    write_lines(csv_path, lines);
+    std::string reads_path = tmpdir.path() + "/reads.txt";
+    std::string barcodes_path = tmpdir.path() + "/barcodes.txt";
+    std::string barcode_reads_path = tmpdir.path() + "/barcode_reads.txt";
+    write_lines(reads_path, reads);
+    write_lines(barcodes_path, barcodes);
+    write_lines(barcode_reads_path, barcode_reads);
+
+    std::string table_path = tmpdir.path() + "/library.fldb";
+    {
+        auto rows = read_rows(csv_path);
+        LibraryTableWriter writer(table_path, csv::Header(lines[0]).column_names());
+        std::vector<std::string_view> fields;
+        for (const auto& row : rows) {
+            fields.assign(row.begin(), row.end());
+            writer.add(fields);
+        }
+    }
+
+    std::string text = tmpdir.path() + "/merged_text";
+    std::string table = tmpdir.path() + "/merged_table";
+    _merge(csv_path, reads_path, barcodes_path, barcode_reads_path, text, true, true);
+    _merge(table_path, reads_path, barcodes_path, barcode_reads_path, table, true, true, true);
+    auto merged = read_rows(output_csv(text));
+    REQUIRE(merged.size() == 200);
+    CHECK(read_rows(output_fldb(table)) == merged);
+
+    std::string sorted_text = tmpdir.path() + "/sorted_text";
+    std::string sorted_table = tmpdir.path() + "/sorted_table";
+    _sort(output_csv(text), reads_path, sorted_text, true, false);
+    _sort(output_fldb(table), reads_path, sorted_table, true, false);
+    CHECK(read_rows(output_csv(sorted_table)) == read_rows(output_csv(sorted_text)));
+
+    std::ifstream text_fasta(output_fasta(sorted_text));
+    std::ifstream table_fasta(output_fasta(sorted_table));
+    CHECK(std::string(std::istreambuf_iterator<char>(table_fasta), {}) ==
+        std::string(std::istreambuf_iterator<char>(text_fasta), {}));
+}
@@ -0,0 +1,95 @@
+#include "doctest.hpp"
+#include "domain/nucleotide_kernels.hpp"
+#include <algorithm>
+#include <random>
+
+// Sequences of every length around the vector widths, mixing bases of both
+// cases with polybase codes and other bytes
+static std::vector<std::string> kernel_inputs() {
+    static const std::string ALPHABET = "ACGTUACGTUacgtuNRYKMSWBDHVn-*\x01\xff";
+    std::mt19937 gen(16);
+    std::uniform_int_distribution<size_t> pick(0, ALPHABET.size() - 1);
+    std::uniform_int_distribution<size_t> rare(0, 15);
+    std::vector<std::string> inputs;
+    for (size_t length = 0; length <= 100; length++) {
+        std::string concrete, mixed;
+        for (size_t ix = 0; ix < length; ix++) {
+            concrete += "ACGTU"[rare(gen) % 5];
+            mixed += ALPHABET[pick(gen)];
+        }
+        inputs.push_back(concrete);
+        inputs.push_back(mixed);
+        // A single polybase among concrete bases
+        if (length > 0) {
+            std::string odd = concrete;
+            odd[rare(gen) % length] = 'N';
+            inputs.push_back(odd);
+        }
+    }
+    return inputs;
+}
+
+TEST_CASE("replace_base_in_place converts either case") {
+    for (std::string seq : kernel_inputs()) {
+        std::string expected = seq;
+        for (char& c : expected) {
+            if (c == 'U') c = 'T';
+            else if (c == 'u') c = 't';
+        }
+        replace_base_in_place(seq, 'U', 'T');
+        CHECK(seq == expected);
+    }
+}
+
+TEST_CASE("complement_in_place complements bases and masks the rest") {
+    for (const std::string& input : kernel_inputs()) {
+        for (Alphabet alphabet : {Alphabet::DNA, Alphabet::RNA}) {
+            std::string expected = input;
+            for (char& c : expected) {
+                c = Sequence::is_valid_base(c) ? complement(c, alphabet) : 'N';
+            }
+            std::string seq = input;
+            complement_in_place(seq, alphabet);
+            CHECK(seq == expected);
+
+            std::reverse(expected.begin(), expected.end());
+            seq = input;
+            reverse_complement_in_place(seq, alphabet);
+            CHECK(seq == expected);
+        }
+    }
+}
+
+TEST_CASE("find_polybase finds the first non-base") {
+    for (const std::string& seq : kernel_inputs()) {
+        size_t expected = std::string::npos;
+        for (size_t ix = 0; ix < seq.size(); ix++) {
+            if (std::string("ACGTU").find(seq[ix]) == std::string::npos) {
+                expected = ix;
+                break;
+            }
+        }
+        CHECK(find_polybase(seq) == expected);
+    }
+}
+
+TEST_CASE("find_base and count_gc ignore case") {
+    for (const std::string& seq : kernel_inputs()) {
+        size_t u = std::min(seq.find('U'), seq.find('u'));
+        CHECK(find_base(seq, 'U') == u);
+
+        size_t gc = std::count_if(seq.begin(), seq.end(), [](char c) {
+            return c == 'G' || c == 'C' || c == 'g' || c == 'c';
+        });
+        CHECK(count_gc(seq) == gc);
+    }
+}
+
+TEST_CASE("replace_polybases keeps concrete bases and converts U") {
+    std::mt19937 gen(1);
+    std::string seq = replace_polybases("ACGUNNRYacgu", gen);
+    CHECK(seq.substr(0, 4) == "ACGT");
+    CHECK(find_polybase(seq) == std::string::npos);
+    CHECK(std::string("AG").find(seq[6]) != std::string::npos);
+    CHECK(std::string("CT").find(seq[7]) != std::string::npos);
+}
@@ -0,0 +1,132 @@
+#include "doctest.hpp"
+#include "domain/packed_sequence.hpp"
+#include "io/csv_format.hpp"
+#include <algorithm>
+#include <unordered_set>
+
+static std::string _random_bases(size_t length, std::mt19937& gen, std::string_view bases = "ACGT") {
+    std::uniform_int_distribution<size_t> dist(0, bases.size() - 1);
+    std::string seq(length, 'A');
+    for (char& c : seq) {
+        c = bases[dist(gen)];
+    }
+    return seq;
+}
+
+TEST_CASE("PackedSequence round-trips through packing") {
+    std::mt19937 gen(17);
+    for (std::string seq : {"", "A", "ACGT", "ACGU", "GGGGCCCCAAAATTTT", "ACGTNRYKMSWVDHB", "acgtACGT", "ACGU-T.x"}) {
+        PackedSequence packed(seq);
+        CHECK(packed.str() == seq);
+        CHECK(packed.length() == seq.size());
+    }
+    for (size_t length : {31, 32, 33, 63, 64, 65, 200}) {
+        std::string seq = _random_bases(length, gen, "ACGTNacgt");
+        PackedSequence packed(seq);
+        CHECK(packed.str() == seq);
+        for (size_t ix = 0; ix < length; ix++) {
+            CHECK(packed[ix] == seq[ix]);
+        }
+    }
+}
+
+TEST_CASE("PackedSequence keeps plain bases out of the side channel") {
+    CHECK(PackedSequence("ACGTACGT").degenerate() == 0);
+    CHECK(PackedSequence("ACGUACGU").degenerate() == 0);
+    CHECK(PackedSequence("ACGUACGU").alphabet() == Alphabet::RNA);
+    CHECK(PackedSequence("ACNTA").degenerate() == 1);
+    // A T in an RNA sequence is not a base of its alphabet
+    CHECK(PackedSequence("ACGUT").degenerate() == 1);
+    CHECK(PackedSequence("acgt").degenerate() == 4);
+}
+
+TEST_CASE("PackedSequence unpacks part of a sequence") {
+    std::mt19937 gen(3);
+    std::string seq = _random_bases(100, gen, "ACGTN");
+    PackedSequence packed(seq);
+    for (size_t pos : {0, 1, 31, 32, 50, 99, 100}) {
+        std::string out = "prefix";
+        packed.append_to(out, pos, 40);
+        CHECK(out == "prefix" + seq.substr(pos, 40));
+    }
+    std::string out;
+    CHECK_THROWS_AS(packed.append_to(out, 101), std::out_of_range);
+}
+
+TEST_CASE("PackedSequence orders and compares as its string") {
+    std::mt19937 gen(5);
+    std::vector<std::string> seqs = {"", "A", "AA", "AC", "C", "CA", "T", "U", "ACGU", "ACGT", "ACN", "acg"};
+    for (size_t ix = 0; ix < 50; ix++) {
+        seqs.push_back(_random_bases(gen() % 70, gen, ix % 2 ? "ACGT" : "ACGTN"));
+    }
+    for (const std::string& a : seqs) {
+        for (const std::string& b : seqs) {
+            PackedSequence pa(a);
+            PackedSequence pb(b);
+            CHECK((pa == pb) == (a == b));
+            CHECK((pa <=> pb) == (a <=> b));
+            if (a == b) {
+                CHECK(pa.hash() == pb.hash());
+            }
+        }
+    }
+
+    std::unordered_set<PackedSequence> unique;
+    for (const std::string& seq : seqs) {
+        unique.insert(PackedSequence(seq));
+    }
+    std::unordered_set<std::string> strings(seqs.begin(), seqs.end());
+    CHECK(unique.size() == strings.size());
+}
+
+TEST_CASE("PackedSequence Hamming distance counts differing bases") {
+    std::mt19937 gen(11);
+    for (size_t trial = 0; trial < 200; trial++) {
+        size_t length = gen() % 100;
+        std::string a = _random_bases(length, gen, trial % 2 ? "ACGT" : "ACGTNR");
+        std::string b = _random_bases(length, gen, trial % 2 ? "ACGT" : "ACGTNR");
+        size_t expected = 0;
+        for (size_t ix = 0; ix < length; ix++) {
+            expected += a[ix] != b[ix];
+        }
+        CHECK(PackedSequence(a).hamming_distance(PackedSequence(b)) == expected);
+    }
+
+    // T and U are the same base
+    CHECK(PackedSequence("ACGT").hamming_distance(PackedSequence("ACGU")) == 0);
+    CHECK(PackedSequence("ACGUT").hamming_distance(PackedSequence("ACGTT")) == 0);
+    CHECK(PackedSequence("ANGT").hamming_distance(PackedSequence("AAGT")) == 1);
+    CHECK_THROWS_AS(PackedSequence("ACG").hamming_distance(PackedSequence("AC")), std::invalid_argument);
+}
+
+TEST_CASE("PackedSequence converts between alphabets as Sequence does") {
+    for (std::string seq : {"ACGT", "ACGU", "ACGUT", "acgtu", "ACG", "NACGTU"}) {
+        PackedSequence packed{Sequence(seq)};
+        CHECK(packed.to_dna().str() == Sequence(seq).to_dna().str());
+        CHECK(packed.to_rna().str() == Sequence(seq).to_rna().str());
+        CHECK(packed.to_dna() == PackedSequence(to_dna(seq)));
+        CHECK(packed.to_rna() == PackedSequence(to_rna(seq)));
+        CHECK(packed.to_sequence().str() == seq);
+    }
+}
+
+TEST_CASE("PackedRow keeps every field of a CSV row") {
+    csv::Header header("index,name,five_const,five_padding,design,three_padding,barcode,three_const,notes");
+    std::vector<std::string> fields = {"3", "seq, one", "GGAA", "", "ACGUNACGU", "CC", "TTTT", "AAAG", "x"};
+    csv::PackedRow row(header, fields);
+
+    CHECK(row.get(csv::COL_NAME) == "seq, one");
+    CHECK(row.get(csv::COL_DESIGN) == "ACGUNACGU");
+    CHECK(row.get(csv::COL_FIVE_PADDING) == "");
+    CHECK(row.get(csv::COL_SUBLIBRARY, "none") == "none");
+
+    std::string seq;
+    row.append_sequence(seq);
+    CHECK(seq == "GGAAACGUNACGUCCTTTTAAAG");
+
+    row.set(csv::COL_BARCODE, "GCGC");
+    row.set(csv::COL_NAME, "renamed");
+    std::string record;
+    row.append_csv(record);
+    CHECK(record == "3,renamed,GGAA,,ACGUNACGU,CC,GCGC,AAAG,x");
+}
@@ -0,0 +1,192 @@
+#include "doctest.hpp"
+#include "test_helpers.hpp"
+#include "library.hpp"
+#include "preprocess.hpp"
+#include "domain/padding_pool.hpp"
+#include "io/padding_pool.hpp"
+#include "io/csv_format.hpp"
+#include "utils.hpp"
+#include <unordered_set>
+
+TEST_CASE("Padding pools hand out each padding once") {
+    StemConfig config = StemConfig::for_padding();
+    PaddingPool pool(config, 300, 4);
+    pool.fill({{25, 2}, {60, 500}, {0, 5}}, 1);
+
+    // A length gets only as many paddings as it needs, up to the pool size
+    CHECK(pool.lengths() == std::vector<size_t>{25, 60});
+    CHECK(pool.count(25) == 2);
+    CHECK(pool.count(60) == 300);
+    CHECK(pool.count(0) == 0);
+
+    std::unordered_set<std::string> taken;
+    for (size_t ix = 0; ix < 300; ix++) {
+        size_t slot = pool.take(60);
+        REQUIRE(slot != PaddingPool::npos);
+        std::string_view padding = pool.at(60, slot);
+        CHECK(padding.size() == 60);
+        taken.insert(std::string(padding));
+    }
+    CHECK(taken.size() == 300);
+    CHECK(pool.remaining(60) == 0);
+    CHECK(pool.take(60) == PaddingPool::npos);
+    CHECK(pool.take(61) == PaddingPool::npos);
+    CHECK(pool.remaining(25) == 2);
+}
+
+TEST_CASE("Padding pools grow with demand the same as when filled at once") {
+    StemConfig config = StemConfig::for_padding();
+    PaddingPool whole(config, 600, 6);
+    whole.fill({{35, 600}}, 1);
+
+    // Demand split across fills, with paddings taken in between
+    PaddingPool grown(config, 600, 6);
+    grown.fill({{35, 3}}, 1);
+    CHECK(grown.count(35) == 3);
+    CHECK(grown.take(35) == 0);
+    grown.fill({{35, 300}}, 3);
+    CHECK(grown.count(35) == 301);
+    grown.fill({{35, 1000}}, 2);
+    CHECK(grown.count(35) == 600);
+    for (size_t slot = 0; slot < 600; slot++) {
+        CHECK(grown.at(35, slot) == whole.at(35, slot));
+    }
+
+    // A full pool is generated in full whatever the demand
+    PaddingPool full(config, 600, 6, true);
+    full.fill({{35, 1}}, 1);
+    CHECK(full.count(35) == 600);
+}
+
+TEST_CASE("Padding pools are the same on any number of threads") {
+    StemConfig config = StemConfig::for_padding();
+    PaddingPool serial(config, 700, 8);
+    PaddingPool parallel(config, 700, 8);
+    serial.fill({{40, 700}, {80, 700}}, 1);
+    parallel.fill({{40, 700}, {80, 700}}, 4);
+    for (size_t length : {40, 80}) {
+        for (size_t slot = 0; slot < 700; slot++) {
+            CHECK(serial.at(length, slot) == parallel.at(length, slot));
+        }
+    }
+}
+
+TEST_CASE("Padding pools round-trip through a file") {
+    TempDir tmpdir;
+    std::string path = tmpdir.path() + "/pool.fldpp";
+    StemConfig config = StemConfig::for_padding();
+    PaddingPool pool(config, 50, 2);
+    pool.fill({{30, 50}, {45, 50}}, 1);
+    _write_padding_pool(path, pool);
+
+    PaddingPool loaded = _read_padding_pool(path, 2);
+    CHECK(!loaded.grown());
+    CHECK(loaded.per_length() == 50);
+    CHECK(loaded.lengths() == pool.lengths());
+    for (size_t slot = 0; slot < 50; slot++) {
+        CHECK(loaded.at(45, slot) == pool.at(45, slot));
+    }
+    CHECK_NOTHROW(loaded.check_compatible(config));
+
+    // A loaded pool is taken from a slot derived from the seed, wrapping
+    // around so that each padding is still handed out once
+    size_t first = loaded.take(45);
+    std::unordered_set<size_t> slots{first};
+    for (size_t slot = loaded.take(45); slot != PaddingPool::npos; slot = loaded.take(45)) {
+        slots.insert(slot);
+    }
+    CHECK(slots.size() == 50);
+    CHECK(_read_padding_pool(path, 2).take(45) == first);
+    std::unordered_set<size_t> starts;
+    for (uint64_t seed = 0; seed < 8; seed++) {
+        starts.insert(_read_padding_pool(path, seed).take(45));
+    }
+    CHECK(starts.size() > 1);
+
+    StemConfig other = config;
+    other.max_gc = 3;
+    CHECK_THROWS_AS(_open_padding_pool(other, 0, path, 2), std::invalid_argument);
+
+    // A count far beyond what the file holds is refused before allocating
+    std::string damaged = tmpdir.path() + "/damaged.fldpp";
+    std::filesystem::copy_file(path, damaged);
+    {
+        std::fstream file(damaged, std::ios::binary | std::ios::in | std::ios::out);
+        uint64_t count = uint64_t(1) << 60;
+        file.seekp(88 + sizeof(uint64_t));
+        file.write(reinterpret_cast<const char*>(&count), sizeof(count));
+    }
+    CHECK_THROWS_AS(_read_padding_pool(damaged, 2), std::runtime_error);
+
+    std::filesystem::resize_file(path, std::filesystem::file_size(path) - 1);
+    CHECK_THROWS_AS(_read_padding_pool(path, 2), std::runtime_error);
+
+    CHECK_THROWS_AS(_open_padding_pool(config, 0, tmpdir.path() + "/missing.fldpp", 2), std::invalid_argument);
+    CHECK(!_open_padding_pool(config, 0, "", 2).has_value());
+}
+
+TEST_CASE("design draws padding from a pool") {
+    std::mt19937 gen(19);
+    TempDir tmpdir;
+    std::string fasta_path = tmpdir.path() + "/input.fasta";
+    std::string csv_path = tmpdir.path() + "/preprocessed.csv";
+    write_random_fasta(fasta_path, 3000, 50, gen);
+    _preprocess(fasta_path, csv_path, true, "test");
+
+    DesignConfig config;
+    config.input_path = csv_path;
+    config.overwrite = true;
+    config.pad_to_length = 60;
+    config.seed = 12;
+    config.padding_pool_size = 40;
+    config.padding_pool_path = tmpdir.path() + "/pool.fldpp";
+
+    auto paddings = [&](const std::string& prefix) {
+        std::vector<std::string> result;
+        std::ifstream file(prefix + ".csv");
+        std::string line;
+        std::getline(file, line);
+        csv::Header header(line);
+        while (std::getline(file, line)) {
+            result.push_back(header.get(_split_by_delimiter(line, ','), csv::COL_FIVE_PADDING));
+        }
+        return result;
+    };
+
+    config.output_prefix = tmpdir.path() + "/created";
+    _design(config);
+    CHECK(std::filesystem::exists(config.padding_pool_path));
+    CHECK(paddings(tmpdir.path() + "/created").size() == 3000);
+
+    // Runs that reuse the pool file give the same paddings on any thread count
+    config.padding_pool_size = 0;
+    config.output_prefix = tmpdir.path() + "/serial";
+    config.threads = 1;
+    _design(config);
+
+    config.output_prefix = tmpdir.path() + "/parallel";
+    config.threads = 4;
+    _design(config);
+
+    std::vector<std::string> serial = paddings(tmpdir.path() + "/serial");
+    CHECK(serial.size() == 3000);
+    CHECK(serial == paddings(tmpdir.path() + "/parallel"));
+
+    PaddingPool pool = _read_padding_pool(config.padding_pool_path, 12);
+    std::unordered_set<std::string> pooled;
+    for (size_t length : pool.lengths()) {
+        for (size_t slot = 0; slot < pool.count(length); slot++) {
+            pooled.insert(std::string(pool.at(length, slot)));
+        }
+    }
+    std::unordered_set<std::string> seen;
+    size_t from_pool = 0;
+    for (const std::string& padding : serial) {
+        if (padding.empty()) continue;
+        if (pooled.count(padding)) {
+            CHECK(seen.insert(padding).second);
+            from_pool++;
+        }
+    }
+    CHECK(from_pool > 0);
+}
@@ -139,3 +139,21 @@ TEST_CASE("preprocess handles commas in FASTA headers") {
     // Name field (index 1) should have the name with comma preserved
     CHECK(fields[csv::NAME] == name_with_comma);
 }
+
+TEST_CASE("preprocess writes the same rows on any number of threads") {
+    std::mt19937 gen(22);
+    TempDir tmpdir;
+    std::string fasta_path = tmpdir.path() + "/large.fasta";
+    // Larger than one chunk, so that the file is read in parallel
+    write_random_fasta(fasta_path, 60000, 150, gen);
+
+    auto preprocess = [&](const std::string& name, size_t threads) {
+        std::string csv_path = tmpdir.path() + "/" + name + ".csv";
+        _preprocess(fasta_path, csv_path, true, "lib", threads);
+        std::ifstream file(csv_path);
+        return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    };
+    std::string serial = preprocess("serial", 1);
+    CHECK(serial == preprocess("parallel", 3));
+    CHECK(std::count(serial.begin(), serial.end(), '\n') == 60001);
+}
@@ -0,0 +1,92 @@
+#include "doctest.hpp"
+#include "test_helpers.hpp"
+#include "library.hpp"
+#include "preprocess.hpp"
+#include "random.hpp"
+#include "domain/random_streams.hpp"
+#include "io/writers.hpp"
+
+TEST_CASE("Philox4x32-10 matches the reference answers") {
+    using Block = std::array<uint32_t, 4>;
+    CHECK(RandomStreams::philox({0, 0, 0, 0}, {0, 0}) ==
+        Block{0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8});
+    CHECK(RandomStreams::philox(
+        {0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff}, {0xffffffff, 0xffffffff}
+    ) == Block{0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd});
+    CHECK(RandomStreams::philox(
+        {0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344}, {0xa4093822, 0x299f31d0}
+    ) == Block{0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1});
+}
+
+TEST_CASE("Random streams are reproducible and distinct") {
+    RandomStreams streams(42);
+    CHECK(streams.seed() == 42);
+
+    auto first = [](std::mt19937 gen) { return gen(); };
+    CHECK(first(streams.stream(RandomStreams::PADDING, 5)) ==
+        first(RandomStreams(42).stream(RandomStreams::PADDING, 5)));
+    CHECK(first(streams.stream(RandomStreams::PADDING, 5)) !=
+        first(streams.stream(RandomStreams::PADDING, 6)));
+    CHECK(first(streams.stream(RandomStreams::PADDING, 5)) !=
+        first(streams.stream(RandomStreams::BARCODES, 5)));
+    CHECK(first(streams.stream(RandomStreams::PADDING, 5)) !=
+        first(RandomStreams(43).stream(RandomStreams::PADDING, 5)));
+}
+
+TEST_CASE("Seed arguments are parsed or drawn") {
+    CHECK(_seed("0") == 0);
+    CHECK(_seed("18446744073709551615") == UINT64_MAX);
+    CHECK_THROWS_AS(_seed("-1"), std::invalid_argument);
+    CHECK_THROWS_AS(_seed("12ab"), std::invalid_argument);
+    CHECK_THROWS_AS(_seed("18446744073709551616"), std::invalid_argument);
+    CHECK_NOTHROW(_seed(""));
+}
+
+TEST_CASE("design with a seed is reproducible and records it") {
+    std::mt19937 gen(14);
+    TempDir tmpdir;
+    std::string fasta_path = tmpdir.path() + "/input.fasta";
+    std::string csv_path = tmpdir.path() + "/preprocessed.csv";
+    write_random_fasta(fasta_path, 50, 80, gen);
+    _preprocess(fasta_path, csv_path, true, "test");
+
+    DesignConfig config;
+    config.input_path = csv_path;
+    config.overwrite = true;
+    config.pad_to_length = 100;
+    config.barcode.stem_length = 8;
+    config.barcode.stem = config.stem;
+    config.seed = 123456789;
+
+    auto run = [&](const std::string& name, size_t threads) {
+        config.output_prefix = tmpdir.path() + "/" + name;
+        config.threads = threads;
+        _design(config);
+        std::ifstream file(output_csv(config.output_prefix));
+        return std::string((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    };
+
+    std::string first = run("first", 1);
+    CHECK(run("second", 1) == first);
+    CHECK(run("threaded", 4) == first);
+
+    std::ifstream seed(output_seed(tmpdir.path() + "/first"));
+    std::string line;
+    std::getline(seed, line);
+    CHECK(line == "123456789");
+
+    config.seed = 987654321;
+    CHECK(run("other", 1) != first);
+}
+
+TEST_CASE("random sequences are reproducible from a seed") {
+    TempDir tmpdir;
+    auto run = [&](uint64_t seed) {
+        std::string path = tmpdir.path() + "/random.txt";
+        _random(path, true, 20, 30, false, seed);
+        std::ifstream file(path);
+        return std::string((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    };
+    CHECK(run(5) == run(5));
+    CHECK(run(5) != run(6));
+}
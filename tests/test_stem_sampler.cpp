@@ -0,0 +1,182 @@
+#include "doctest.hpp"
+#include "domain/barcode.hpp"
+#include "domain/hairpin.hpp"
+#include "domain/stem_sampler.hpp"
+#include <random>
+#include <unordered_set>
+
+// Count allowed stems by brute force over all pair choices
+static uint64_t brute_force_stems(size_t stem_length, const StemConfig& config) {
+    size_t free = stem_length - config.closing_gc;
+    uint64_t total = 1;
+    for (size_t ix = 0; ix < free; ix++) total *= 3;
+
+    uint64_t count = 0;
+    for (uint64_t code = 0; code < total; code++) {
+        size_t au = 0, gc = config.closing_gc, gu = 0;
+        uint64_t rest = code;
+        for (size_t ix = 0; ix < free; ix++, rest /= 3) {
+            switch (rest % 3) {
+                case 0: au++; break;
+                case 1: gc++; break;
+                default: gu++; break;
+            }
+        }
+        if (au <= config.max_au && gc <= config.max_gc && gu <= config.max_gu) {
+            count++;
+        }
+    }
+    return count << stem_length;
+}
+
+static void check_hairpin(const std::string& seq, size_t stem_length, const StemConfig& config) {
+    REQUIRE(seq.length() == 2 * stem_length + HAIRPIN_LOOP_LENGTH);
+    size_t au = 0, gc = 0, gu = 0;
+    for (size_t ix = 0; ix < stem_length; ix++) {
+        char five = seq[ix];
+        char three = seq[seq.length() - ix - 1];
+        if (BasePair::is_au(five, three)) au++;
+        else if (BasePair::is_gc(five, three)) gc++;
+        else if (BasePair::is_gu(five, three)) gu++;
+        else FAIL("Unpaired bases in stem: " << seq);
+        if (ix < config.closing_gc) CHECK(BasePair::is_gc(five, three));
+    }
+    CHECK(au <= config.max_au);
+    CHECK(gc <= config.max_gc);
+    CHECK(gu <= config.max_gu);
+}
+
+TEST_CASE("StemSampler counts match brute force") {
+    for (size_t max_gu : {0, 1, 2}) {
+        for (size_t max_gc : {1, 2, 3, 10}) {
+            StemConfig config;
+            config.closing_gc = 1;
+            config.max_au = 3;
+            config.max_gc = max_gc;
+            config.max_gu = max_gu;
+
+            StemSampler sampler(5, config);
+            INFO("max_gc = " << max_gc << ", max_gu = " << max_gu);
+            CHECK(sampler.stem_count() == brute_force_stems(5, config));
+            CHECK(sampler.size() == sampler.stem_count() * Hairpin::tetraloops().size());
+        }
+    }
+}
+
+TEST_CASE("StemSampler unranks every hairpin exactly once") {
+    StemConfig config;
+    config.closing_gc = 1;
+    config.max_au = 2;
+    config.max_gc = 3;
+    config.max_gu = 1;
+
+    StemSampler sampler(4, config);
+    std::unordered_set<std::string> seen;
+    std::string buffer;
+    for (uint64_t rank = 0; rank < sampler.size(); rank++) {
+        sampler.unrank(rank, buffer);
+        check_hairpin(buffer, 4, config);
+        seen.insert(buffer);
+    }
+    CHECK(seen.size() == sampler.size());
+    CHECK_THROWS(sampler.unrank(sampler.size(), buffer));
+}
+
+TEST_CASE("StemSampler samples valid hairpins") {
+    std::mt19937 gen(42);
+    StemConfig config;
+    config.closing_gc = 2;
+    config.max_gc = 4;
+    config.max_gu = 1;
+
+    StemSampler sampler(10, config);
+    std::string buffer;
+    for (size_t ix = 0; ix < 500; ix++) {
+        sampler.sample(gen, buffer);
+        check_hairpin(buffer, 10, config);
+    }
+}
+
+TEST_CASE("StemSampler rejects more closing pairs than the GC limit") {
+    StemConfig config;
+    config.closing_gc = 3;
+    config.max_gc = 2;
+    CHECK_THROWS_AS(StemSampler(8, config), std::invalid_argument);
+}
+
+TEST_CASE("RankPermutation visits every rank exactly once") {
+    std::mt19937 gen(11);
+    for (uint64_t size : {0, 1, 2, 5, 16, 17, 1000, 4097}) {
+        INFO("size = " << size);
+        RankPermutation walk(size, gen);
+        std::vector<bool> seen(size);
+        uint64_t value;
+        size_t visited = 0;
+        bool in_order = true;
+        while (walk.next(value)) {
+            REQUIRE(value < size);
+            CHECK(!seen[value]);
+            seen[value] = true;
+            in_order = in_order && value == visited;
+            visited++;
+        }
+        CHECK(visited == size);
+        CHECK(!walk.next(value));
+        if (size >= 16) CHECK(!in_order);
+    }
+
+    // Spaces too large to enumerate are walked without allocating them
+    RankPermutation huge(UINT64_MAX, gen);
+    uint64_t value;
+    std::unordered_set<uint64_t> first;
+    for (size_t ix = 0; ix < 1000; ix++) {
+        REQUIRE(huge.next(value));
+        first.insert(value);
+    }
+    CHECK(first.size() == 1000);
+}
+
+TEST_CASE("BarcodeSampler fills the hairpin space up to capacity") {
+    std::mt19937 gen(42);
+    StemConfig config;
+    config.closing_gc = 1;
+    config.max_gc = 2;
+    config.max_gu = 0;
+
+    // Without GU pairs no two stems are neighbours, so every hairpin fits
+    BarcodeSampler sampler(4, config);
+    uint64_t capacity = sampler.stems().size();
+
+    BarcodeIndex index;
+    for (uint64_t ix = 0; ix < capacity; ix++) {
+        Barcode barcode = sampler.next(gen, index);
+        REQUIRE(!index.has_neighbor(barcode.str()));
+        index.insert(barcode.str());
+    }
+    CHECK(index.size() == capacity);
+    CHECK_THROWS_AS(sampler.next(gen, index), std::runtime_error);
+    CHECK(sampler.enumerating());
+}
+
+TEST_CASE("BarcodeSampler terminates when neighbours exhaust the space") {
+    std::mt19937 gen(7);
+    StemConfig config;
+    config.closing_gc = 1;
+    config.max_gc = 3;
+    config.max_gu = 2;
+
+    BarcodeSampler sampler(4, config);
+    BarcodeIndex index;
+    size_t placed = 0;
+    while (true) {
+        try {
+            Barcode barcode = sampler.next(gen, index);
+            index.insert(barcode.str());
+            placed++;
+        } catch (const std::runtime_error&) {
+            break;
+        }
+    }
+    CHECK(placed > 0);
+    CHECK(placed < sampler.stems().size());
+}